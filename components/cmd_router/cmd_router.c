@@ -482,7 +482,7 @@ static void register_set_ap_ip(void)
 static struct {
     struct arg_str *add_del;
     struct arg_str *TCP_UDP;
-    struct arg_int *ext_port;
+    struct arg_str *ext_port;
     struct arg_str *int_ip;
     struct arg_int *int_port;
     struct arg_end *end;
@@ -517,16 +517,49 @@ int portmap(int argc, char **argv)
         return 1;
     }
 
-    uint16_t ext_port = portmap_args.ext_port->ival[0];
-    uint32_t int_ip = esp_ip4addr_aton((char *)portmap_args.int_ip->sval[0]);
+    /* External port is either a single port or a range "first-last" */
+    unsigned int first, last;
+    const char *ports = portmap_args.ext_port->sval[0];
+    int n = sscanf(ports, "%u-%u", &first, &last);
+    if (n == 1) {
+        last = first;
+    }
+    if (n < 1 || first > 65535 || last > 65535 || last < first) {
+        printf("Invalid port or port range '%s'\n", ports);
+        return 1;
+    }
+    uint16_t ext_port = first;
+    uint16_t count = last - first + 1;
+    uint32_t int_ip = 0;
     uint16_t int_port = portmap_args.int_port->ival[0];
+    if (add && resolve_portmap_target(portmap_args.int_ip->sval[0], &int_ip) != ESP_OK) {
+        printf("No DHCP lease for %s\n", portmap_args.int_ip->sval[0]);
+        return 1;
+    }
 
     //printf("portmap %d %d %x %d %x %d\n", add, tcp_udp, my_ip, ext_port, int_ip, int_port);
 
+    esp_err_t err;
     if (add) {
-        add_portmap(tcp_udp, ext_port, int_ip, int_port);
+        err = add_portmap_range(tcp_udp, ext_port, count, int_ip, int_port);
     } else {
-        del_portmap(tcp_udp, ext_port);
+        err = del_portmap(tcp_udp, ext_port);
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        printf("Portmap table full\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        printf("Ports overlap an existing portmapping\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Port range exceeds 65535\n");
+        return 1;
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("No such portmapping\n");
+        return 1;
+    } else if (err != ESP_OK) {
+        printf("Portmap failed: %s\n", esp_err_to_name(err));
+        return 1;
     }
 
     return ESP_OK;
@@ -536,9 +569,9 @@ static void register_portmap(void)
 {
     portmap_args.add_del = arg_str1(NULL, NULL, "[add|del]", "add or delete portmapping");
     portmap_args.TCP_UDP = arg_str1(NULL, NULL, "[TCP|UDP]", "TCP or UDP port");
-    portmap_args.ext_port = arg_int1(NULL, NULL, "<ext_portno>", "external port number");
-    portmap_args.int_ip = arg_str1(NULL, NULL, "<int_ip>", "internal IP");
-    portmap_args.int_port = arg_int1(NULL, NULL, "<int_portno>", "internal port number");
+    portmap_args.ext_port = arg_str1(NULL, NULL, "<ext_portno>[-<last>]", "external port number or range");
+    portmap_args.int_ip = arg_str1(NULL, NULL, "<int_ip|mac>", "internal IP, or client MAC to reserve its DHCP address");
+    portmap_args.int_port = arg_int1(NULL, NULL, "<int_portno>", "internal (first) port number");
     portmap_args.end = arg_end(5);
 
     const esp_console_cmd_t cmd = {
@@ -47,7 +47,9 @@ esp_err_t get_config_param_str(char* name, char** param);
 
 void print_portmap_tab();
 esp_err_t add_portmap(uint8_t proto, uint16_t mport, uint32_t daddr, uint16_t dport);
+esp_err_t add_portmap_range(uint8_t proto, uint16_t mport, uint16_t count, uint32_t daddr, uint16_t dport);
 esp_err_t del_portmap(uint8_t proto, uint16_t mport);
+esp_err_t resolve_portmap_target(const char* target, uint32_t* daddr);
 
 #ifdef __cplusplus
 }
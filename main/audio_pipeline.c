@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "audio_pipeline.h"
+
+// 配置
+#define TAG "AUDIO_PIPELINE"
+#define AUDIO_TIMER_RESOLUTION_HZ 40000000  // 40 MHz，44.1 kHz下误差<0.01%
+
+// 单生产者单消费者环形缓冲区，存放已转换的输出字
+// head只由生产者任务写，tail只由定时器中断写，均为自由递增计数
+typedef struct {
+    uint32_t* buf;
+    uint32_t mask;                 // 容量-1（容量为2的幂）
+    uint32_t limit;                // 最大缓冲样本数（block_size * latency_blocks）
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+} audio_ring_t;
+
+// 状态
+static audio_pipeline_config_t s_cfg;
+static audio_ring_t s_ring;
+static gptimer_handle_t s_timer = NULL;
+static TaskHandle_t s_task = NULL;
+static volatile bool s_running = false;
+static volatile uint32_t s_underruns = 0;
+static uint32_t s_low_water;       // 缓冲降到此值时唤醒生产者
+static audio_pipeline_stats_t s_stats;
+static int16_t* s_pcm = NULL;      // 渲染用的PCM块
+
+// 抖动统计（仅由中断更新）
+static const uint32_t s_jitter_limits_us[] = AUDIO_JITTER_BUCKET_LIMITS_US;
+static uint32_t s_jitter_limits_cyc[AUDIO_JITTER_BUCKETS - 1];
+static uint32_t s_period_cyc;
+static uint32_t s_last_cyc;
+static uint64_t s_jitter_sum_cyc;
+static uint32_t s_jitter_max_cyc;
+static uint32_t s_jitter_ticks;
+static uint32_t s_jitter_hist[AUDIO_JITTER_BUCKETS];
+static uint64_t s_isr_sum_cyc;
+static uint32_t s_isr_max_cyc;
+static uint32_t s_isr_count;
+static volatile bool s_jitter_reset = false;
+
+static inline bool is_pow2(uint32_t v)
+{
+    return v && !(v & (v - 1));
+}
+
+static uint32_t round_up_pow2(uint32_t v)
+{
+    uint32_t p = 1;
+    while (p < v) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// 每个采样周期的定时器计数（取整）
+static inline uint32_t period_ticks(uint32_t sample_rate)
+{
+    return (AUDIO_TIMER_RESOLUTION_HZ + sample_rate / 2) / sample_rate;
+}
+
+// 记录本次中断相对理想周期的偏差，now为进入中断时的周期计数
+static inline void IRAM_ATTR jitter_record(uint32_t now)
+{
+    uint32_t period = now - s_last_cyc;
+    s_last_cyc = now;
+
+    if (s_jitter_reset) {
+        s_jitter_reset = false;
+        s_jitter_sum_cyc = 0;
+        s_jitter_max_cyc = 0;
+        s_jitter_ticks = 0;
+        memset(s_jitter_hist, 0, sizeof(s_jitter_hist));
+        s_isr_sum_cyc = 0;
+        s_isr_max_cyc = 0;
+        s_isr_count = 0;
+        return;
+    }
+
+    uint32_t dev = period > s_period_cyc ? period - s_period_cyc : s_period_cyc - period;
+    s_jitter_sum_cyc += dev;
+    if (dev > s_jitter_max_cyc) {
+        s_jitter_max_cyc = dev;
+    }
+
+    int b = 0;
+    while (b < AUDIO_JITTER_BUCKETS - 1 && dev >= s_jitter_limits_cyc[b]) {
+        b++;
+    }
+    s_jitter_hist[b]++;
+    s_jitter_ticks++;
+}
+
+// 记录从进入中断到输出回调返回的耗时
+static inline void IRAM_ATTR isr_cost_record(uint32_t start)
+{
+    uint32_t cost = esp_cpu_get_cycle_count() - start;
+    s_isr_sum_cyc += cost;
+    if (cost > s_isr_max_cyc) {
+        s_isr_max_cyc = cost;
+    }
+    s_isr_count++;
+}
+
+// 采样定时器中断：取一个输出字交给输出回调
+static bool IRAM_ATTR pipeline_timer_cb(gptimer_handle_t timer, const gptimer_alarm_event_data_t* edata, void* user_ctx)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    jitter_record(start);
+
+    uint32_t tail = atomic_load_explicit(&s_ring.tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&s_ring.head, memory_order_acquire);
+
+    if (head == tail) {
+        s_underruns++;
+        return false;
+    }
+
+    uint32_t word = s_ring.buf[tail & s_ring.mask];
+    atomic_store_explicit(&s_ring.tail, tail + 1, memory_order_release);
+    s_cfg.sink(word);
+    isr_cost_record(start);
+
+    // 腾出一整块空间时唤醒生产者
+    BaseType_t woken = pdFALSE;
+    if (head - tail - 1 == s_low_water) {
+        vTaskNotifyGiveFromISR(s_task, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+static esp_err_t pipeline_timer_init(void)
+{
+    const gptimer_config_t timer_cfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = AUDIO_TIMER_RESOLUTION_HZ,
+        .intr_priority = AUDIO_PIPELINE_INTR_PRIORITY,
+    };
+    esp_err_t err = gptimer_new_timer(&timer_cfg, &s_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count = period_ticks(s_cfg.sample_rate),
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    const gptimer_event_callbacks_t cbs = {
+        .on_alarm = pipeline_timer_cb,
+    };
+
+    // 中断分配在调用者所在核心，因此必须在生产者任务内调用
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(s_timer, &alarm_cfg));
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(s_timer, &cbs, NULL));
+    ESP_ERROR_CHECK(gptimer_enable(s_timer));
+
+    s_period_cyc = esp_clk_cpu_freq() / s_cfg.sample_rate;
+    for (int b = 0; b < AUDIO_JITTER_BUCKETS - 1; b++) {
+        s_jitter_limits_cyc[b] = s_jitter_limits_us[b] * (esp_clk_cpu_freq() / 1000000);
+    }
+    s_jitter_reset = true;
+    return gptimer_start(s_timer);
+}
+
+static void pipeline_timer_deinit(void)
+{
+    if (s_timer) {
+        gptimer_stop(s_timer);
+        gptimer_disable(s_timer);
+        gptimer_del_timer(s_timer);
+        s_timer = NULL;
+    }
+}
+
+// 渲染一块并记录耗时
+static void render_block(void)
+{
+    uint32_t head = atomic_load_explicit(&s_ring.head, memory_order_relaxed);
+
+    uint32_t* words = &s_ring.buf[head & s_ring.mask];
+
+    int64_t start = esp_timer_get_time();
+    s_cfg.render(s_pcm, s_cfg.block_size, s_cfg.ctx);
+    if (s_cfg.convert) {
+        s_cfg.convert(s_pcm, words, s_cfg.block_size);
+    } else {
+        for (uint32_t i = 0; i < s_cfg.block_size; i++) {
+            words[i] = (uint16_t)s_pcm[i];
+        }
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    atomic_store_explicit(&s_ring.head, head + s_cfg.block_size, memory_order_release);
+
+    s_stats.blocks++;
+    s_stats.last_block_us = elapsed;
+    if (elapsed > s_stats.max_block_us) {
+        s_stats.max_block_us = elapsed;
+    }
+    // 指数平均，权重1/8
+    s_stats.avg_block_us = s_stats.blocks == 1 ? elapsed
+                         : s_stats.avg_block_us - (s_stats.avg_block_us >> 3) + (elapsed >> 3);
+}
+
+// 生产者任务：缓冲区有整块空间时渲染
+static void pipeline_task(void* arg)
+{
+    // 先预填充缓冲区再启动定时器
+    while (s_running &&
+           atomic_load_explicit(&s_ring.head, memory_order_relaxed) + s_cfg.block_size <= s_ring.limit) {
+        render_block();
+    }
+
+    if (pipeline_timer_init() != ESP_OK) {
+        ESP_LOGE(TAG, "创建采样定时器失败");
+        s_running = false;
+    } else {
+        ESP_LOGI(TAG, "音频管线已启动: %lu Hz, 块=%u, 延迟=%lu us, 核心%d",
+                 s_cfg.sample_rate, s_cfg.block_size, s_stats.latency_us, xPortGetCoreID());
+    }
+
+    // 超时兜底：两个块时长
+    TickType_t wait = pdMS_TO_TICKS(2000 * s_cfg.block_size / s_cfg.sample_rate) + 1;
+
+    while (s_running) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        for (;;) {
+            uint32_t head = atomic_load_explicit(&s_ring.head, memory_order_relaxed);
+            uint32_t tail = atomic_load_explicit(&s_ring.tail, memory_order_acquire);
+            if (!s_running || head - tail + s_cfg.block_size > s_ring.limit) {
+                break;
+            }
+            render_block();
+        }
+    }
+
+    pipeline_timer_deinit();
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t audio_pipeline_start(const audio_pipeline_config_t* config)
+{
+    if (!config || !config->render || !config->sink || config->sample_rate == 0 ||
+        !is_pow2(config->block_size) || config->latency_blocks < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_running || s_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_cfg = *config;
+
+    uint32_t limit = (uint32_t)s_cfg.block_size * s_cfg.latency_blocks;
+    uint32_t capacity = round_up_pow2(limit);
+    s_ring.buf = heap_caps_calloc(capacity, sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_pcm = heap_caps_calloc(s_cfg.block_size, sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_ring.buf || !s_pcm) {
+        free(s_ring.buf);
+        free(s_pcm);
+        s_ring.buf = NULL;
+        s_pcm = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    s_ring.mask = capacity - 1;
+    s_ring.limit = limit;
+    atomic_store(&s_ring.head, 0);
+    atomic_store(&s_ring.tail, 0);
+    s_low_water = limit - s_cfg.block_size;
+    s_underruns = 0;
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.sample_rate = s_cfg.sample_rate;
+    s_stats.block_size = s_cfg.block_size;
+    s_stats.latency_us = (uint32_t)((uint64_t)limit * 1000000 / s_cfg.sample_rate);
+
+    s_running = true;
+    BaseType_t core = s_cfg.task_core < 0 ? tskNO_AFFINITY : s_cfg.task_core;
+    if (xTaskCreatePinnedToCore(pipeline_task, "audio_pipeline", s_cfg.task_stack,
+                                NULL, s_cfg.task_priority, &s_task, core) != pdPASS) {
+        ESP_LOGE(TAG, "创建音频管线任务失败");
+        s_running = false;
+        free(s_ring.buf);
+        free(s_pcm);
+        s_ring.buf = NULL;
+        s_pcm = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_stop(void)
+{
+    if (!s_running && !s_task) {
+        return ESP_OK;
+    }
+
+    s_running = false;
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+
+    // 等待任务结束
+    for (int i = 0; i < 50 && s_task; i++) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+    if (s_task) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    free(s_ring.buf);
+    free(s_pcm);
+    s_ring.buf = NULL;
+    s_pcm = NULL;
+    return ESP_OK;
+}
+
+esp_err_t audio_pipeline_get_stats(audio_pipeline_stats_t* stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = s_stats;
+    stats->underruns = s_underruns;
+    stats->fill = atomic_load(&s_ring.head) - atomic_load(&s_ring.tail);
+
+    uint32_t block_us = (uint32_t)((uint64_t)s_cfg.block_size * 1000000 / (s_cfg.sample_rate ? s_cfg.sample_rate : 1));
+    stats->cpu_permille = block_us ? (uint32_t)((uint64_t)s_stats.avg_block_us * 1000 / block_us) : 0;
+    return ESP_OK;
+}
+
+uint64_t audio_pipeline_actual_rate_mhz(uint32_t sample_rate)
+{
+    if (sample_rate == 0) {
+        return 0;
+    }
+    return (uint64_t)AUDIO_TIMER_RESOLUTION_HZ * 1000 / period_ticks(sample_rate);
+}
+
+esp_err_t audio_pipeline_get_jitter(audio_jitter_stats_t* jitter)
+{
+    if (!jitter) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t cyc_per_us = esp_clk_cpu_freq() / 1000000;
+    uint32_t ticks = s_jitter_ticks;
+
+    jitter->ticks = ticks;
+    jitter->period_ns = s_period_cyc * 1000 / cyc_per_us;
+    jitter->mean_ns = ticks ? (uint32_t)(s_jitter_sum_cyc * 1000 / cyc_per_us / ticks) : 0;
+    jitter->max_ns = s_jitter_max_cyc * 1000 / cyc_per_us;
+    memcpy(jitter->histogram, s_jitter_hist, sizeof(jitter->histogram));
+
+    uint32_t isr_count = s_isr_count;
+    uint32_t isr_mean_cyc = isr_count ? (uint32_t)(s_isr_sum_cyc / isr_count) : 0;
+    jitter->isr_mean_ns = isr_mean_cyc * 1000 / cyc_per_us;
+    jitter->isr_max_ns = s_isr_max_cyc * 1000 / cyc_per_us;
+    jitter->isr_permille = s_period_cyc ? isr_mean_cyc * 1000 / s_period_cyc : 0;
+    return ESP_OK;
+}
+
+void audio_pipeline_reset_stats(void)
+{
+    s_stats.max_block_us = 0;
+    s_underruns = 0;
+    s_jitter_reset = true;
+}
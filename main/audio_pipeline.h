@@ -0,0 +1,100 @@
+#ifndef AUDIO_PIPELINE_H
+#define AUDIO_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// 默认参数
+#define AUDIO_PIPELINE_BLOCK_SIZE 256      // 每块样本数（必须为2的幂）
+#define AUDIO_PIPELINE_LATENCY_BLOCKS 4    // 环形缓冲区深度（块数）
+#define AUDIO_PIPELINE_TASK_STACK_SIZE 4096
+#define AUDIO_PIPELINE_TASK_PRIORITY 6
+#define AUDIO_PIPELINE_TASK_CORE 1         // Wi-Fi/tcpip默认在核心0
+#define AUDIO_PIPELINE_INTR_PRIORITY 3     // 采样定时器中断优先级（C中断可用的最高级）
+
+// 抖动直方图分桶上限（微秒），最后一桶为超出部分
+#define AUDIO_JITTER_BUCKETS 5
+#define AUDIO_JITTER_BUCKET_LIMITS_US {1, 2, 5, 10}
+
+// 渲染回调：在生产者任务中填充一整块PCM样本
+typedef void (*audio_render_cb_t)(int16_t* buf, size_t frames, void* ctx);
+
+// 转换回调：在生产者任务中将一块PCM预先转换为输出字（如APLL系数）
+typedef void (*audio_convert_cb_t)(const int16_t* pcm, uint32_t* words, size_t frames);
+
+// 输出回调：在定时器中断中按采样率逐个调用，必须放在IRAM中
+typedef void (*audio_sink_cb_t)(uint32_t word);
+
+// 管线配置
+typedef struct {
+    uint32_t sample_rate;        // 消费者采样率（Hz）
+    uint16_t block_size;         // 每块样本数（2的幂）
+    uint8_t latency_blocks;      // 缓冲块数，延迟 = block_size * latency_blocks / sample_rate
+    uint8_t task_priority;       // 生产者任务优先级
+    int8_t task_core;            // 生产者任务及定时器中断所在核心，-1为不绑定
+    uint16_t task_stack;         // 生产者任务栈大小（字节）
+    audio_render_cb_t render;
+    audio_convert_cb_t convert;  // 为NULL时输出字即PCM样本
+    audio_sink_cb_t sink;
+    void* ctx;                   // 传给render的上下文
+} audio_pipeline_config_t;
+
+#define AUDIO_PIPELINE_DEFAULT_CONFIG() {                   \
+    .sample_rate = 44100,                                   \
+    .block_size = AUDIO_PIPELINE_BLOCK_SIZE,                \
+    .latency_blocks = AUDIO_PIPELINE_LATENCY_BLOCKS,        \
+    .task_priority = AUDIO_PIPELINE_TASK_PRIORITY,          \
+    .task_core = AUDIO_PIPELINE_TASK_CORE,                  \
+    .task_stack = AUDIO_PIPELINE_TASK_STACK_SIZE,           \
+    .render = NULL,                                         \
+    .convert = NULL,                                        \
+    .sink = NULL,                                           \
+    .ctx = NULL,                                            \
+}
+
+// 运行统计
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t block_size;
+    uint32_t latency_us;         // 缓冲区满时的输出延迟
+    uint32_t blocks;             // 已渲染块数
+    uint32_t underruns;          // 中断取不到样本的次数
+    uint32_t fill;               // 当前缓冲样本数
+    uint32_t last_block_us;      // 最近一块的渲染耗时
+    uint32_t avg_block_us;       // 平均渲染耗时（指数平均）
+    uint32_t max_block_us;       // 最大渲染耗时
+    uint32_t cpu_permille;       // 平均渲染耗时占块时长的千分比
+} audio_pipeline_stats_t;
+
+// 采样定时器中断的时序抖动（相对理想周期的偏差）和处理耗时统计
+typedef struct {
+    uint32_t ticks;              // 已统计的中断次数
+    uint32_t period_ns;          // 理想周期
+    uint32_t mean_ns;            // 平均绝对偏差
+    uint32_t max_ns;             // 最大绝对偏差
+    uint32_t histogram[AUDIO_JITTER_BUCKETS];
+    uint32_t isr_mean_ns;        // 中断处理平均耗时（含输出回调）
+    uint32_t isr_max_ns;         // 中断处理最大耗时
+    uint32_t isr_permille;       // 平均耗时占采样周期的千分比
+} audio_jitter_stats_t;
+
+// 启动管线：创建生产者任务和采样定时器
+esp_err_t audio_pipeline_start(const audio_pipeline_config_t* config);
+
+// 停止管线并释放缓冲区
+esp_err_t audio_pipeline_stop(void);
+
+// 获取运行统计
+esp_err_t audio_pipeline_get_stats(audio_pipeline_stats_t* stats);
+
+// 获取采样中断抖动统计
+esp_err_t audio_pipeline_get_jitter(audio_jitter_stats_t* jitter);
+
+// 定时器周期取整后的实际输出采样率（毫赫兹），与标称值可能有微小偏差
+uint64_t audio_pipeline_actual_rate_mhz(uint32_t sample_rate);
+
+// 清零耗时峰值、欠载计数和抖动统计
+void audio_pipeline_reset_stats(void);
+
+#endif /* AUDIO_PIPELINE_H */
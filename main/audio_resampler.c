@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "audio_resampler.h"
+
+// 配置
+#define TAG "AUDIO_RESAMPLER"
+#define COEF_SHIFT 15
+#define PHASE_BITS 6                     // log2(AUDIO_RESAMPLER_PHASES)
+#define INTERP_BITS 12                   // 相间插值系数精度
+#define CUTOFF_RATIO 0.45                // 截止频率相对较低采样率的比例
+#define KAISER_BETA 7.0
+
+_Static_assert((1 << PHASE_BITS) == AUDIO_RESAMPLER_PHASES, "PHASE_BITS mismatch");
+_Static_assert((AUDIO_RESAMPLER_TAPS & 1) == 0, "AUDIO_RESAMPLER_TAPS must be even");
+
+// 零阶修正贝塞尔函数（Kaiser窗）
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 25; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser窗截断的sinc低通，cutoff为相对输入采样率的归一化频率
+static void design_filter(audio_resampler_t* rs, double cutoff)
+{
+    const double half = AUDIO_RESAMPLER_TAPS / 2.0;
+    const double i0_beta = bessel_i0(KAISER_BETA);
+
+    for (int p = 0; p <= AUDIO_RESAMPLER_PHASES; p++) {
+        double mu = (double)p / AUDIO_RESAMPLER_PHASES;
+        double h[AUDIO_RESAMPLER_TAPS];
+        double sum = 0.0;
+
+        for (int t = 0; t < AUDIO_RESAMPLER_TAPS; t++) {
+            // 抽头t对应的输入样本相对插值点的距离
+            double d = t - (half - 1.0) - mu;
+            double x = 2.0 * cutoff * d;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = d / half;
+            double w = (fabs(r) < 1.0) ? bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+            h[t] = sinc * w;
+            sum += h[t];
+        }
+
+        // 每相直流增益归一化为1
+        for (int t = 0; t < AUDIO_RESAMPLER_TAPS; t++) {
+            rs->coef[p][t] = (int16_t)lround(h[t] / sum * (1 << COEF_SHIFT));
+        }
+    }
+}
+
+void audio_resampler_reset(audio_resampler_t* rs)
+{
+    // 预置TAPS-1个零作为历史
+    memset(rs->buf, 0, rs->capacity * rs->channels * sizeof(int16_t));
+    rs->avail = AUDIO_RESAMPLER_TAPS - 1;
+    rs->pos = 0;
+}
+
+esp_err_t audio_resampler_init(audio_resampler_t* rs, uint32_t in_rate, uint32_t out_rate,
+                               uint8_t channels, size_t max_frames,
+                               audio_render_cb_t source, void* source_ctx)
+{
+    if (!rs || !source || in_rate == 0 || out_rate == 0 || max_frames == 0 ||
+        channels < 1 || channels > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(rs, 0, sizeof(*rs));
+    rs->source = source;
+    rs->source_ctx = source_ctx;
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    rs->max_frames = max_frames;
+    rs->step = ((uint64_t)in_rate << 32) / out_rate;
+
+    if (in_rate == out_rate) {
+        ESP_LOGI(TAG, "输入输出采样率相同(%lu Hz)，直通", in_rate);
+        return ESP_OK;
+    }
+
+    // 一次输出max_frames最多需要的输入样本数，加上滤波器历史
+    size_t max_in = (size_t)(((uint64_t)max_frames * rs->step) >> 32) + 2;
+    rs->capacity = max_in + AUDIO_RESAMPLER_TAPS;
+    rs->buf = malloc(rs->capacity * channels * sizeof(int16_t));
+    rs->coef = malloc((AUDIO_RESAMPLER_PHASES + 1) * sizeof(*rs->coef));
+    if (!rs->buf || !rs->coef) {
+        audio_resampler_deinit(rs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 降采样时截止频率随输出采样率下移以抑制混叠
+    double ratio = in_rate > out_rate ? (double)out_rate / in_rate : 1.0;
+    design_filter(rs, CUTOFF_RATIO * ratio);
+    audio_resampler_reset(rs);
+
+    ESP_LOGI(TAG, "重采样器: %lu Hz -> %lu Hz, %u声道, %d相x%d抽头",
+             in_rate, out_rate, channels, AUDIO_RESAMPLER_PHASES, AUDIO_RESAMPLER_TAPS);
+    return ESP_OK;
+}
+
+void audio_resampler_deinit(audio_resampler_t* rs)
+{
+    free(rs->buf);
+    free(rs->coef);
+    rs->buf = NULL;
+    rs->coef = NULL;
+}
+
+static inline int32_t dot(const int16_t* x, const int16_t* h, uint32_t stride)
+{
+    int32_t acc = 0;
+    for (int t = 0; t < AUDIO_RESAMPLER_TAPS; t++) {
+        acc += x[t * stride] * h[t];
+    }
+    return acc;
+}
+
+void audio_resampler_render(int16_t* out, size_t frames, void* ctx)
+{
+    audio_resampler_t* rs = (audio_resampler_t*)ctx;
+    uint32_t ch = rs->channels;
+
+    if (!rs->buf) {
+        rs->source(out, frames, rs->source_ctx);
+        return;
+    }
+
+    while (frames > 0) {
+        size_t n = frames < rs->max_frames ? frames : rs->max_frames;
+
+        // 最后一个输出需要的输入位于 idx_last .. idx_last+TAPS-1
+        size_t idx_last = (size_t)((rs->pos + (n - 1) * rs->step) >> 32);
+        size_t needed = idx_last + AUDIO_RESAMPLER_TAPS;
+        if (needed > rs->avail) {
+            rs->source(rs->buf + rs->avail * ch, needed - rs->avail, rs->source_ctx);
+            rs->avail = needed;
+        }
+
+        uint64_t pos = rs->pos;
+        for (size_t i = 0; i < n; i++) {
+            const int16_t* x = rs->buf + (size_t)(pos >> 32) * ch;
+            uint32_t frac = (uint32_t)pos;
+            uint32_t phase = frac >> (32 - PHASE_BITS);
+            int32_t mu = (int32_t)((frac >> (32 - PHASE_BITS - INTERP_BITS)) & ((1 << INTERP_BITS) - 1));
+
+            for (uint32_t c = 0; c < ch; c++) {
+                // 相邻两相分别卷积后线性插值
+                int32_t y0 = dot(x + c, rs->coef[phase], ch) >> COEF_SHIFT;
+                int32_t y1 = dot(x + c, rs->coef[phase + 1], ch) >> COEF_SHIFT;
+                int32_t y = y0 + (((y1 - y0) * mu) >> INTERP_BITS);
+
+                if (y > 32767) y = 32767;
+                if (y < -32768) y = -32768;
+                out[i * ch + c] = (int16_t)y;
+            }
+            pos += rs->step;
+        }
+
+        // 丢弃不再需要的输入，保留滤波器历史
+        size_t consumed = (size_t)(pos >> 32);
+        rs->avail -= consumed;
+        memmove(rs->buf, rs->buf + consumed * ch, rs->avail * ch * sizeof(int16_t));
+        rs->pos = pos - ((uint64_t)consumed << 32);
+
+        out += n * ch;
+        frames -= n;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_pipeline.h"
+
+// 多相FIR配置
+#define AUDIO_RESAMPLER_TAPS 16      // 每相抽头数（偶数）
+#define AUDIO_RESAMPLER_PHASES 64    // 相数，相间线性插值
+
+// 重采样器状态
+// 以拉取方式工作：输出一块时只向上游渲染所需数量的输入样本
+typedef struct {
+    audio_render_cb_t source;        // 上游渲染回调（输入采样率）
+    void* source_ctx;
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint8_t channels;                // 1或2，多声道时样本交错存放
+    uint64_t step;                   // 每输出样本前进的输入样本数（Q32）
+    uint64_t pos;                    // 下一个输出在缓冲区中的位置（Q32）
+    size_t max_frames;               // 单次最多输出样本数
+    size_t avail;                    // 缓冲区中的有效输入帧数
+    size_t capacity;                 // 缓冲区容量（帧）
+    int16_t* buf;                    // 历史样本 + 本次新渲染的输入
+    int16_t (*coef)[AUDIO_RESAMPLER_TAPS];  // [PHASES + 1][TAPS]，Q15
+} audio_resampler_t;
+
+// 初始化：设计抗混叠滤波器并分配缓冲区
+// max_frames为每次调用audio_resampler_render的最大输出帧数
+// channels为2时上游和输出均为左右交错的立体声
+esp_err_t audio_resampler_init(audio_resampler_t* rs, uint32_t in_rate, uint32_t out_rate,
+                               uint8_t channels, size_t max_frames,
+                               audio_render_cb_t source, void* source_ctx);
+
+// 释放缓冲区
+void audio_resampler_deinit(audio_resampler_t* rs);
+
+// 清空历史样本和相位
+void audio_resampler_reset(audio_resampler_t* rs);
+
+// 渲染回调：ctx为audio_resampler_t*，可直接作为audio_pipeline的render
+void audio_resampler_render(int16_t* buf, size_t frames, void* ctx);
+
+#endif /* AUDIO_RESAMPLER_H */
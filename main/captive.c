@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "lwip/ip4_addr.h"
+
+#include "captive.h"
+
+// 强制门户请求分类
+// 各系统关联AP后会密集发送连接检测请求，这里只查编译期生成的常量表，
+// 不分配内存；长度在编译期算好，先比长度再比内容
+
+#define STR(s) s, sizeof(s) - 1
+
+typedef struct {
+    const char* str;
+    uint8_t len;
+    captive_os_t os;
+    const char* body;                   // 已联网时的响应体，NULL表示204
+} captive_match_t;
+
+#define APPLE_SUCCESS "<HTML><HEAD><TITLE>Success</TITLE></HEAD><BODY>Success</BODY></HTML>"
+#define NM_ONLINE "NetworkManager is online\n"
+
+// 连接检测域名
+static const captive_match_t probe_hosts[] = {
+    { STR("connectivitycheck.gstatic.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("connectivitycheck.android.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("clients1.google.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("clients3.google.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("connect.rom.miui.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("connectivitycheck.platform.hicloud.com"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("captive.apple.com"), CAPTIVE_OS_APPLE, APPLE_SUCCESS },
+    { STR("www.appleiphonecell.com"), CAPTIVE_OS_APPLE, APPLE_SUCCESS },
+    { STR("www.msftconnecttest.com"), CAPTIVE_OS_WINDOWS, "Microsoft Connect Test" },
+    { STR("www.msftncsi.com"), CAPTIVE_OS_WINDOWS, "Microsoft NCSI" },
+    { STR("detectportal.firefox.com"), CAPTIVE_OS_FIREFOX, "success\n" },
+    { STR("connectivity-check.ubuntu.com"), CAPTIVE_OS_LINUX, NULL },
+    { STR("nmcheck.gnome.org"), CAPTIVE_OS_LINUX, NM_ONLINE },
+};
+
+// 连接检测路径，Host被改写或缺失时按路径识别
+static const captive_match_t probe_paths[] = {
+    { STR("/generate_204"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("/gen_204"), CAPTIVE_OS_ANDROID, NULL },
+    { STR("/hotspot-detect.html"), CAPTIVE_OS_APPLE, APPLE_SUCCESS },
+    { STR("/library/test/success.html"), CAPTIVE_OS_APPLE, APPLE_SUCCESS },
+    { STR("/ncsi.txt"), CAPTIVE_OS_WINDOWS, "Microsoft NCSI" },
+    { STR("/connecttest.txt"), CAPTIVE_OS_WINDOWS, "Microsoft Connect Test" },
+    { STR("/success.txt"), CAPTIVE_OS_FIREFOX, "success\n" },
+    { STR("/check_network_status.txt"), CAPTIVE_OS_LINUX, NM_ONLINE },
+};
+
+// User-Agent中的特征串
+static const captive_match_t probe_agents[] = {
+    { STR("CaptiveNetworkSupport"), CAPTIVE_OS_APPLE, APPLE_SUCCESS },
+    { STR("Microsoft NCSI"), CAPTIVE_OS_WINDOWS, "Microsoft NCSI" },
+    { STR("NetworkManager"), CAPTIVE_OS_LINUX, NM_ONLINE },
+    { STR("Dalvik"), CAPTIVE_OS_ANDROID, NULL },
+};
+
+static const char* const os_names[CAPTIVE_OS_COUNT] = {
+    [CAPTIVE_OS_ANDROID] = "android",
+    [CAPTIVE_OS_APPLE] = "apple",
+    [CAPTIVE_OS_WINDOWS] = "windows",
+    [CAPTIVE_OS_FIREFOX] = "firefox",
+    [CAPTIVE_OS_LINUX] = "linux",
+    [CAPTIVE_OS_OTHER] = "other",
+};
+
+static uint32_t ap_addr;
+static char portal_url[sizeof("http://255.255.255.255/")] = "http://192.168.4.1/";
+static uint32_t counts[CAPTIVE_OS_COUNT];
+
+void captive_init(uint32_t ap_ip)
+{
+    ip4_addr_t addr = { .addr = ap_ip };
+    ap_addr = ap_ip;
+    snprintf(portal_url, sizeof(portal_url), "http://" IPSTR "/", IP2STR(&addr));
+}
+
+const char* captive_portal_url(void)
+{
+    return portal_url;
+}
+
+// host去掉端口和结尾的点后的长度
+static size_t host_len(const char* host)
+{
+    size_t len = strcspn(host, ":");
+    if (len > 0 && host[len - 1] == '.') {
+        len--;
+    }
+    return len;
+}
+
+// Host是否为AP地址（带或不带端口）
+static bool host_is_ap(const char* host, size_t len)
+{
+    char buf[16];
+    ip4_addr_t addr;
+    if (len == 0 || len >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, host, len);
+    buf[len] = '\0';
+    return ip4addr_aton(buf, &addr) && addr.addr == ap_addr;
+}
+
+static const captive_match_t* match_host(const char* host, size_t len)
+{
+    for (size_t i = 0; i < sizeof(probe_hosts) / sizeof(probe_hosts[0]); i++) {
+        if (probe_hosts[i].len == len && strncasecmp(probe_hosts[i].str, host, len) == 0) {
+            return &probe_hosts[i];
+        }
+    }
+    return NULL;
+}
+
+static const captive_match_t* match_path(const char* uri)
+{
+    size_t len = strcspn(uri, "?");
+    for (size_t i = 0; i < sizeof(probe_paths) / sizeof(probe_paths[0]); i++) {
+        if (probe_paths[i].len == len && strncmp(probe_paths[i].str, uri, len) == 0) {
+            return &probe_paths[i];
+        }
+    }
+    return NULL;
+}
+
+static const captive_match_t* match_agent(const char* user_agent)
+{
+    for (size_t i = 0; i < sizeof(probe_agents) / sizeof(probe_agents[0]); i++) {
+        if (strstr(user_agent, probe_agents[i].str) != NULL) {
+            return &probe_agents[i];
+        }
+    }
+    return NULL;
+}
+
+captive_result_t captive_classify(const char* uri, const char* host, const char* user_agent, bool online)
+{
+    captive_result_t res = { .action = CAPTIVE_REDIRECT, .os = CAPTIVE_OS_OTHER, .body = NULL };
+    size_t hlen = host_len(host);
+
+    if (host_is_ap(host, hlen)) {
+        res.action = CAPTIVE_SERVE;
+        return res;
+    }
+
+    const captive_match_t* m = match_host(host, hlen);
+    if (!m) {
+        m = match_path(uri);
+    }
+    if (!m) {
+        m = match_agent(user_agent);
+    }
+    if (m) {
+        res.os = m->os;
+        res.body = m->body;
+        if (online) {
+            res.action = CAPTIVE_ONLINE;
+        } else if (m->os == CAPTIVE_OS_APPLE) {
+            res.action = CAPTIVE_APPLE_PAGE;
+        }
+    }
+    counts[res.os]++;
+    return res;
+}
+
+bool captive_is_probe_host(const char* host)
+{
+    return match_host(host, host_len(host)) != NULL;
+}
+
+const char* captive_os_name(captive_os_t os)
+{
+    return os < CAPTIVE_OS_COUNT ? os_names[os] : "?";
+}
+
+void captive_get_counts(uint32_t out[CAPTIVE_OS_COUNT])
+{
+    memcpy(out, counts, sizeof(counts));
+}
+
+void captive_reset_counts(void)
+{
+    memset(counts, 0, sizeof(counts));
+}
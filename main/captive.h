@@ -0,0 +1,48 @@
+#ifndef CAPTIVE_H
+#define CAPTIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 连接检测请求来自的系统
+typedef enum {
+    CAPTIVE_OS_ANDROID,
+    CAPTIVE_OS_APPLE,
+    CAPTIVE_OS_WINDOWS,
+    CAPTIVE_OS_FIREFOX,
+    CAPTIVE_OS_LINUX,
+    CAPTIVE_OS_OTHER,                   // 非检测请求，访问了其他网站
+    CAPTIVE_OS_COUNT
+} captive_os_t;
+
+// 对请求的处理方式
+typedef enum {
+    CAPTIVE_SERVE,                      // 直接访问AP地址，正常提供页面
+    CAPTIVE_REDIRECT,                   // 302到配网页面
+    CAPTIVE_APPLE_PAGE,                 // Apple CNA：返回跳转到配网页面的HTML
+    CAPTIVE_ONLINE,                     // 已联网：返回该系统期望的检测结果（204或固定文本）
+} captive_action_t;
+
+typedef struct {
+    captive_action_t action;
+    captive_os_t os;
+    const char* body;                   // CAPTIVE_ONLINE的响应体，NULL表示204
+} captive_result_t;
+
+// 按AP地址生成重定向目标，AP地址确定后调用一次
+void captive_init(uint32_t ap_ip);
+
+// 按URI、Host和User-Agent查表分类，headers可为空串；online表示上行已连通
+captive_result_t captive_classify(const char* uri, const char* host, const char* user_agent, bool online);
+
+// 域名是否为某系统的连接检测域名，DNS转发器用于在未配置时本地应答
+bool captive_is_probe_host(const char* host);
+
+// 重定向地址，如"http://192.168.4.1/"
+const char* captive_portal_url(void);
+
+const char* captive_os_name(captive_os_t os);
+void captive_get_counts(uint32_t counts[CAPTIVE_OS_COUNT]);
+void captive_reset_counts(void);
+
+#endif /* CAPTIVE_H */
@@ -0,0 +1,361 @@
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "router_globals.h"
+#include "channel_plan.h"
+#include "wifi_scan.h"
+
+// 配置
+#define TAG "CHANNEL_PLAN"
+#define OVERLAP_SPAN 5                      // 2.4GHz信道间隔5MHz，相距5个信道以上的AP互不干扰
+
+static SemaphoreHandle_t s_lock;            // esp_timer任务、事件循环任务和控制台共用的状态
+static esp_timer_handle_t s_timer;
+static bool s_ap_only;
+static bool s_scanning;
+static bool s_want;                         // 需要规划，扫描未能开始时由定时器重试
+static int64_t s_last_plan_us;
+static channel_plan_t s_plan;
+
+// 两个信道的重叠程度，同信道为OVERLAP_SPAN，相距OVERLAP_SPAN以上为0
+static int overlap(int a, int b)
+{
+    int d = abs(a - b);
+    return d >= OVERLAP_SPAN ? 0 : OVERLAP_SPAN - d;
+}
+
+static int second_channel(const wifi_ap_record_t* r)
+{
+    if (r->second == WIFI_SECOND_CHAN_ABOVE) {
+        return r->primary + 4;
+    } else if (r->second == WIFI_SECOND_CHAN_BELOW) {
+        return r->primary - 4;
+    }
+    return 0;
+}
+
+// 邻居AP对信道的影响：每个AP计10分，信号每强1dB再加1分，按重叠程度折算
+static int neighbor_cost(const wifi_ap_record_t* r, int ch)
+{
+    int rssi = r->rssi + 100;
+    rssi = rssi < 0 ? 0 : rssi > 70 ? 70 : rssi;
+    int o = overlap(ch, r->primary);
+    int sec = second_channel(r);
+    if (sec > 0 && overlap(ch, sec) > o) {
+        o = overlap(ch, sec);
+    }
+    return (10 + rssi) * o / OVERLAP_SPAN;
+}
+
+// 按20/40MHz共存规则检查HT40：与40MHz中心相距不到5个信道的较强邻居，
+// 只有主信道相同且次信道一致（或为HT20）时才不冲突；返回冲突中信号最强的邻居
+static const wifi_ap_record_t* ht40_blocker(const wifi_ap_record_t* recs, uint16_t n, int primary, int second)
+{
+    const wifi_ap_record_t* worst = NULL;
+    int center2 = primary + second;         // 中心信道的两倍，避免小数
+    for (uint16_t i = 0; i < n; i++) {
+        const wifi_ap_record_t* r = &recs[i];
+        if (r->rssi < CHANNEL_PLAN_BUSY_RSSI || abs(r->primary * 2 - center2) >= OVERLAP_SPAN * 2) {
+            continue;
+        }
+        int sec = second_channel(r);
+        if (r->primary == primary && (sec == 0 || sec == second)) {
+            continue;
+        }
+        if (!worst || r->rssi > worst->rssi) {
+            worst = r;
+        }
+    }
+    return worst;
+}
+
+// 根据扫描结果规划；primary不为0时信道已由上游决定，up_second为上游AP的次信道
+static void plan_compute(const wifi_ap_record_t* recs, uint16_t n, int schan, int nchan,
+                         int primary, wifi_second_chan_t up_second, channel_plan_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->valid = true;
+    out->aps = n;
+    int last = schan + nchan - 1;
+    if (last > CHANNEL_PLAN_MAX_CH) {
+        last = CHANNEL_PLAN_MAX_CH;
+    }
+
+    for (int ch = schan; ch <= last; ch++) {
+        int cost = 0;
+        for (uint16_t i = 0; i < n; i++) {
+            cost += neighbor_cost(&recs[i], ch);
+        }
+        out->cost[ch] = cost > UINT16_MAX ? UINT16_MAX : cost;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        if (recs[i].primary <= CHANNEL_PLAN_MAX_CH && out->ap_count[recs[i].primary] < UINT8_MAX) {
+            out->ap_count[recs[i].primary]++;
+        }
+    }
+
+    // 候选次信道：上游为HT40时只能与上游一致，上游为HT20时AP也只用HT20
+    int candidates[2];
+    int nc = 0;
+    if (primary != 0) {
+        out->follows_uplink = true;
+        if (up_second == WIFI_SECOND_CHAN_ABOVE) {
+            candidates[nc++] = primary + 4;
+        } else if (up_second == WIFI_SECOND_CHAN_BELOW) {
+            candidates[nc++] = primary - 4;
+        }
+    } else {
+        int best_cost = INT32_MAX;
+        for (int ch = schan; ch <= last; ch++) {
+            int cost = out->cost[ch];
+            if (ch != 1 && ch != 6 && ch != 11) {
+                cost += CHANNEL_PLAN_ODD_PENALTY;
+            }
+            if (cost < best_cost) {
+                best_cost = cost;
+                primary = ch;
+            }
+        }
+        if (primary + 4 <= last) {
+            candidates[nc++] = primary + 4;
+        }
+        if (primary - 4 >= schan) {
+            candidates[nc++] = primary - 4;
+        }
+    }
+    out->channel = primary;
+    out->second = WIFI_SECOND_CHAN_NONE;
+
+    // 次信道取更空闲的一个，两个都有冲突时记下较弱冲突中的邻居
+    int best_sec = 0;
+    const wifi_ap_record_t* blocker = NULL;
+    for (int i = 0; i < nc; i++) {
+        int sec = candidates[i];
+        const wifi_ap_record_t* b = ht40_blocker(recs, n, primary, sec);
+        if (!b) {
+            if (best_sec == 0 || out->cost[sec] < out->cost[best_sec]) {
+                best_sec = sec;
+            }
+        } else if (!blocker || b->rssi < blocker->rssi) {
+            blocker = b;
+        }
+    }
+    if (best_sec != 0) {
+        out->second = best_sec > primary ? WIFI_SECOND_CHAN_ABOVE : WIFI_SECOND_CHAN_BELOW;
+    } else if (blocker) {
+        memcpy(out->blocker, blocker->ssid, sizeof(out->blocker) - 1);
+        out->blocker_channel = blocker->primary;
+        out->blocker_rssi = blocker->rssi;
+    }
+}
+
+// 应用规划结果；只有热点时同时设置主信道和次信道，连接上游时信道由上游决定，只设置带宽
+static void plan_apply(const channel_plan_t* plan)
+{
+    wifi_bandwidth_t bw = plan->second == WIFI_SECOND_CHAN_NONE ? WIFI_BW_HT20 : WIFI_BW_HT40;
+    esp_wifi_set_bandwidth(WIFI_IF_AP, bw);
+
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_AP, &cfg) == ESP_OK && cfg.ap.channel != plan->channel) {
+        cfg.ap.channel = plan->channel;
+        esp_wifi_set_config(WIFI_IF_AP, &cfg);
+    }
+    if (!plan->follows_uplink) {
+        esp_wifi_set_channel(plan->channel, plan->second);
+    }
+
+    if (bw == WIFI_BW_HT40) {
+        ESP_LOGI(TAG, "AP信道%d，HT40次信道在%s", plan->channel,
+            plan->second == WIFI_SECOND_CHAN_ABOVE ? "上方" : "下方");
+    } else if (plan->blocker_channel != 0) {
+        ESP_LOGW(TAG, "AP信道%d，只能使用HT20：%s（信道%d，%ddBm）在40MHz范围内", plan->channel,
+            plan->blocker, plan->blocker_channel, plan->blocker_rssi);
+    } else {
+        ESP_LOGW(TAG, "AP信道%d，只能使用HT20：%s", plan->channel,
+            plan->follows_uplink ? "上游AP为HT20" : "信道两侧都没有40MHz的空间");
+    }
+}
+
+static void scan_done(void)
+{
+    uint16_t n = CHANNEL_PLAN_SCAN_RECORDS;
+    wifi_ap_record_t* recs = malloc(sizeof(wifi_ap_record_t) * n);
+    if (!recs) {
+        esp_wifi_clear_ap_list();
+        n = 0;
+    } else if (esp_wifi_scan_get_ap_records(&n, recs) != ESP_OK) {
+        n = 0;
+    }
+    if (s_ap_only) {
+        esp_wifi_set_mode(WIFI_MODE_AP);
+    }
+
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) != ESP_OK) {
+        country.schan = 1;
+        country.nchan = 13;
+    }
+
+    // 上游AP本身不计入拥挤度
+    int primary = 0;
+    wifi_second_chan_t up_second = WIFI_SECOND_CHAN_NONE;
+    wifi_ap_record_t up;
+    if (!s_ap_only && esp_wifi_sta_get_ap_info(&up) == ESP_OK) {
+        primary = up.primary;
+        up_second = up.second;
+        for (uint16_t i = 0; i < n; i++) {
+            if (memcmp(recs[i].bssid, up.bssid, 6) == 0) {
+                recs[i] = recs[--n];
+                break;
+            }
+        }
+    }
+
+    channel_plan_t plan;
+    bool ok = s_ap_only || primary != 0;
+    if (ok) {
+        plan_compute(recs, n, country.schan, country.nchan, primary, up_second, &plan);
+        plan.time_s = esp_timer_get_time() / 1000000;
+    }
+    free(recs);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_scanning = false;
+    bool changed = ok && (!s_plan.valid || s_plan.channel != plan.channel || s_plan.second != plan.second);
+    if (ok) {
+        s_plan = plan;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (changed) {
+        plan_apply(&plan);
+    }
+}
+
+static void plan_start(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_scanning) {
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    s_scanning = true;
+    s_want = false;
+    s_last_plan_us = esp_timer_get_time();
+    xSemaphoreGive(s_lock);
+
+    // 扫描需要STA接口，只有热点时临时切换到APSTA
+    if (s_ap_only) {
+        esp_wifi_set_mode(WIFI_MODE_APSTA);
+    }
+    // 正在关联或uplinks正在扫描时会被拒绝，由定时器重试
+    if (wifi_scan_start("channel_plan", scan_done) != ESP_OK) {
+        if (s_ap_only) {
+            esp_wifi_set_mode(WIFI_MODE_AP);
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_scanning = false;
+        s_want = true;
+        xSemaphoreGive(s_lock);
+    }
+}
+
+// 重试被拒绝的扫描；定期重新规划只在没有客户端时进行，改变信道会断开客户端
+static void timer_cb(void* arg)
+{
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool start = !s_scanning && s_want;
+    if (!s_scanning && CHANNEL_PLAN_INTERVAL_MIN > 0 && connect_count == 0 &&
+        now - s_last_plan_us >= (int64_t)CHANNEL_PLAN_INTERVAL_MIN * 60 * 1000000) {
+        start = start || s_ap_only || ap_connect;
+    }
+    xSemaphoreGive(s_lock);
+    if (start) {
+        plan_start();
+    }
+}
+
+static void channel_plan_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        // 上游信道变化（首次连接或切换了上行）后重新决定带宽
+        wifi_ap_record_t up;
+        bool replan;
+        if (esp_wifi_sta_get_ap_info(&up) != ESP_OK) {
+            return;
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        replan = !s_plan.valid || s_plan.channel != up.primary;
+        xSemaphoreGive(s_lock);
+        if (replan) {
+            plan_start();
+        }
+    }
+}
+
+esp_err_t channel_plan_init(bool ap_only)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_ap_only = ap_only;
+
+    const esp_timer_create_args_t args = {
+        .callback = timer_cb,
+        .name = "channel_plan",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = wifi_scan_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!ap_only) {
+        err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, channel_plan_event_handler, NULL, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    err = esp_timer_start_periodic(s_timer, CHANNEL_PLAN_RETRY_MS * 1000);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (ap_only) {
+        plan_start();
+    }
+    return ESP_OK;
+}
+
+esp_err_t channel_plan_run(void)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_ap_only && !ap_connect) {
+        // 连接上游后按上游信道规划
+        return ESP_ERR_INVALID_STATE;
+    }
+    plan_start();
+    return ESP_OK;
+}
+
+void channel_plan_get(channel_plan_t* out)
+{
+    if (!s_lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_plan;
+    xSemaphoreGive(s_lock);
+}
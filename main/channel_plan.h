@@ -0,0 +1,49 @@
+#ifndef CHANNEL_PLAN_H
+#define CHANNEL_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+#include "sdkconfig.h"
+
+// AP信道规划：扫描周围的AP，按数量和信号强度估算各信道的拥挤度
+// 只有热点时选择最空闲的信道；连接上游时AP信道跟随上游，只决定能否使用HT40
+// 关闭CONFIG_CHANNEL_PLAN时模块照常编译，只是不启动
+
+// 配置
+#ifdef CONFIG_CHANNEL_PLAN
+#define CHANNEL_PLAN_INTERVAL_MIN CONFIG_CHANNEL_PLAN_INTERVAL
+#else
+#define CHANNEL_PLAN_INTERVAL_MIN 0
+#endif
+#define CHANNEL_PLAN_MAX_CH 14
+#define CHANNEL_PLAN_BUSY_RSSI (-75)        // 此强度以上的邻居AP落在40MHz影响范围内时只用HT20
+#define CHANNEL_PLAN_RETRY_MS 5000          // 扫描被拒绝（正在关联或其他模块在扫描）后的重试间隔
+#define CHANNEL_PLAN_SCAN_RECORDS 32
+#define CHANNEL_PLAN_ODD_PENALTY 5          // 1/6/11以外的信道与两侧都重叠，略微降低优先级
+
+typedef struct {
+    bool valid;
+    bool follows_uplink;                    // 连接上游时信道由上游决定
+    uint8_t channel;
+    wifi_second_chan_t second;              // WIFI_SECOND_CHAN_NONE表示HT20
+    uint32_t time_s;                        // 规划时距启动的秒数
+    uint16_t aps;                           // 扫描到的AP数
+    uint8_t ap_count[CHANNEL_PLAN_MAX_CH + 1];  // 各信道上的AP数，下标为信道号
+    uint16_t cost[CHANNEL_PLAN_MAX_CH + 1];     // 各信道的拥挤度，越小越空闲
+    // 不能使用HT40时，影响范围内信号最强的邻居
+    char blocker[33];
+    uint8_t blocker_channel;
+    int8_t blocker_rssi;
+} channel_plan_t;
+
+// 在esp_wifi_start之后调用；ap_only为true时立即扫描并选择信道，否则在连上上游后规划
+esp_err_t channel_plan_init(bool ap_only);
+
+// 重新扫描并规划；改变信道会使已连接的客户端重新关联
+esp_err_t channel_plan_run(void);
+
+void channel_plan_get(channel_plan_t* out);
+
+#endif /* CHANNEL_PLAN_H */
@@ -0,0 +1,263 @@
+/* Console commands for the audio/FM subsystem
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_console.h"
+#include "argtable3/argtable3.h"
+
+#include "audio_pipeline.h"
+#include "midi_synth.h"
+#include "fm_transmitter.h"
+#include "cmd_audio.h"
+#ifdef CONFIG_FM_RDS
+#include "fm_rds.h"
+#include "router_globals.h"
+#endif
+
+static void register_audio_stats(void);
+static void register_fm_stats(void);
+static void register_fm_tune(void);
+#ifdef CONFIG_FM_RDS
+static void register_rds(void);
+#endif
+
+void register_audio(void)
+{
+    register_audio_stats();
+    register_fm_stats();
+    register_fm_tune();
+#ifdef CONFIG_FM_RDS
+    register_rds();
+#endif
+}
+
+/** Arguments used by 'audio_stats' function */
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} audio_stats_args;
+
+/* 'audio_stats' command */
+static int audio_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &audio_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, audio_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    audio_pipeline_stats_t stats;
+    audio_pipeline_get_stats(&stats);
+
+    printf("Sample rate: %lu Hz, block: %u samples, latency: %lu us\n",
+        stats.sample_rate, stats.block_size, stats.latency_us);
+    printf("Blocks rendered: %lu, buffered: %lu samples, underruns: %lu\n",
+        stats.blocks, stats.fill, stats.underruns);
+    printf("Render time per block: last %lu us, avg %lu us, max %lu us\n",
+        stats.last_block_us, stats.avg_block_us, stats.max_block_us);
+    printf("Render CPU: %lu.%lu%%\n", stats.cpu_permille / 10, stats.cpu_permille % 10);
+    printf("Synth voices: %lu/%d in use, %lu stolen\n",
+        midi_synth_active_count(), MIDI_SYNTH_MAX_VOICES, midi_synth_steal_count());
+
+    if (audio_stats_args.reset->count > 0) {
+        audio_pipeline_reset_stats();
+    }
+    return 0;
+}
+
+static void register_audio_stats(void)
+{
+    audio_stats_args.reset = arg_lit0("r", "reset", "reset peak and underrun counters");
+    audio_stats_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "audio_stats",
+        .help = "Show audio render pipeline statistics",
+        .hint = NULL,
+        .func = &audio_stats,
+        .argtable = &audio_stats_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'fm_stats' function */
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} fm_stats_args;
+
+/* 'fm_stats' command */
+static int fm_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &fm_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, fm_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    static const uint32_t limits[] = AUDIO_JITTER_BUCKET_LIMITS_US;
+    audio_pipeline_stats_t stats;
+    audio_jitter_stats_t jitter;
+    audio_pipeline_get_stats(&stats);
+    audio_pipeline_get_jitter(&jitter);
+
+    printf("FM transmitter %s, deviation rate: %lu Hz\n",
+        fm_transmitter_is_enabled() ? "enabled" : "disabled", stats.sample_rate);
+    printf("Timer ticks: %lu, period: %lu ns, underruns: %lu\n",
+        jitter.ticks, jitter.period_ns, stats.underruns);
+    uint32_t retune_last, retune_max;
+    fm_transmitter_get_retune_us(&retune_last, &retune_max);
+    printf("Carrier: %lu Hz, retune: last %lu us, max %lu us\n",
+        fm_transmitter_get_frequency(), retune_last, retune_max);
+    printf("ISR: mean %lu ns, max %lu ns, load %lu.%lu%%\n",
+        jitter.isr_mean_ns, jitter.isr_max_ns, jitter.isr_permille / 10, jitter.isr_permille % 10);
+    uint32_t sdm_partial, sdm_full;
+    fm_transmitter_get_sdm_cycles(&sdm_partial, &sdm_full);
+    printf("APLL update (measured at boot): %lu cycles low byte only, %lu cycles full write\n",
+        sdm_partial, sdm_full);
+    printf("Jitter: mean %lu ns, max %lu ns\n", jitter.mean_ns, jitter.max_ns);
+    for (int i = 0; i < AUDIO_JITTER_BUCKETS; i++) {
+        if (i < AUDIO_JITTER_BUCKETS - 1) {
+            printf("  < %2lu us: %lu\n", limits[i], jitter.histogram[i]);
+        } else {
+            printf("  >=%2lu us: %lu\n", limits[i - 1], jitter.histogram[i]);
+        }
+    }
+
+    if (fm_stats_args.reset->count > 0) {
+        audio_pipeline_reset_stats();
+    }
+    return 0;
+}
+
+static void register_fm_stats(void)
+{
+    fm_stats_args.reset = arg_lit0("r", "reset", "reset jitter statistics");
+    fm_stats_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "fm_stats",
+        .help = "Show FM deviation timing, ISR load and jitter statistics",
+        .hint = NULL,
+        .func = &fm_stats,
+        .argtable = &fm_stats_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'fm_tune' function */
+static struct {
+    struct arg_int *freq;
+    struct arg_end *end;
+} fm_tune_args;
+
+/* 'fm_tune' command */
+static int fm_tune(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &fm_tune_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, fm_tune_args.end, argv[0]);
+        return 1;
+    }
+
+    int khz = fm_tune_args.freq->ival[0];
+    if (khz < 1000 || khz > 200000) {
+        printf("Frequency out of range: %d kHz\n", khz);
+        return 1;
+    }
+
+    esp_err_t err = fm_transmitter_set_frequency((uint32_t)khz * 1000);
+    if (err != ESP_OK) {
+        printf("Retune failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    uint32_t last_us;
+    fm_transmitter_get_retune_us(&last_us, NULL);
+    printf("Carrier set to %d kHz in %lu us\n", khz, last_us);
+    return 0;
+}
+
+static void register_fm_tune(void)
+{
+    fm_tune_args.freq = arg_int1(NULL, NULL, "<kHz>", "carrier frequency in kHz");
+    fm_tune_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "fm_tune",
+        .help = "Retune the FM carrier without interrupting audio",
+        .hint = NULL,
+        .func = &fm_tune,
+        .argtable = &fm_tune_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+#ifdef CONFIG_FM_RDS
+/** Arguments used by 'rds' function */
+static struct {
+    struct arg_str *ps;
+    struct arg_str *rt;
+    struct arg_int *pi;
+    struct arg_lit *automatic;
+    struct arg_end *end;
+} rds_args;
+
+/* 'rds' command */
+static int rds(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &rds_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, rds_args.end, argv[0]);
+        return 1;
+    }
+
+    if (rds_args.pi->count > 0) {
+        fm_rds_set_pi((uint16_t)rds_args.pi->ival[0]);
+    }
+    if (rds_args.ps->count > 0) {
+        fm_rds_set_ps(rds_args.ps->sval[0]);
+    }
+    if (rds_args.rt->count > 0) {
+        fm_rds_set_rt(rds_args.rt->sval[0]);
+    }
+    if (rds_args.automatic->count > 0) {
+        fm_rds_set_auto(true);
+        fm_rds_update_router_state(ap_ssid, connect_count);
+    }
+
+    uint16_t pi;
+    char ps[FM_RDS_PS_LEN + 1];
+    char rt[FM_RDS_RT_LEN + 1];
+    fm_rds_get_text(&pi, ps, sizeof(ps), rt, sizeof(rt));
+    printf("PI: 0x%04X, text: %s\n", pi, fm_rds_is_auto() ? "auto" : "manual");
+    printf("PS: '%s'\n", ps);
+    printf("RT: '%s'\n", rt);
+    printf("Groups sent: %lu\n", fm_rds_group_count());
+    return 0;
+}
+
+static void register_rds(void)
+{
+    rds_args.ps = arg_str0("p", "ps", "<name>", "program service name (max 8 chars)");
+    rds_args.rt = arg_str0("t", "rt", "<text>", "radiotext (max 64 chars)");
+    rds_args.pi = arg_int0("i", "pi", "<code>", "program identification code");
+    rds_args.automatic = arg_lit0("a", "auto", "derive PS/RT from the AP SSID and client count");
+    rds_args.end = arg_end(4);
+
+    const esp_console_cmd_t cmd = {
+        .command = "rds",
+        .help = "Show or set the RDS program service name and radiotext",
+        .hint = NULL,
+        .func = &rds,
+        .argtable = &rds_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+#endif
@@ -15,6 +15,9 @@ extern "C" {
 #include "cmd_system.h"
 #include "cmd_nvs.h"
 #include "cmd_router.h"
+#include "cmd_audio.h"
+#include "cmd_net.h"
+#include "cmd_tasks.h"
 
 #ifdef __cplusplus
 }
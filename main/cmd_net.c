@@ -0,0 +1,934 @@
+/* Console commands for the NAPT/network subsystem
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_console.h"
+#include "esp_mac.h"
+#include "argtable3/argtable3.h"
+#include "lwip/ip4_addr.h"
+
+#include "napt_stats.h"
+#include "napt_config.h"
+#include "napt_fastpath.h"
+#include "dns_forwarder.h"
+#include "captive.h"
+#include "dhcp_leases.h"
+#include "link_manager.h"
+#include "uplinks.h"
+#include "channel_plan.h"
+#include "shaper.h"
+#include "cmd_net.h"
+
+static void register_napt_stats(void);
+static void register_napt_config(void);
+static void register_napt_fastpath(void);
+static void register_dns_stats(void);
+static void register_captive(void);
+static void register_leases(void);
+static void register_link(void);
+static void register_uplinks(void);
+static void register_channel(void);
+static void register_shaper(void);
+
+void register_net(void)
+{
+    register_napt_stats();
+    register_napt_config();
+    register_napt_fastpath();
+    register_dns_stats();
+    register_captive();
+    register_leases();
+    register_link();
+    register_uplinks();
+    register_channel();
+    register_shaper();
+}
+
+static void print_client(const napt_client_stats_t *c)
+{
+    ip4_addr_t addr;
+    addr.addr = c->addr;
+    printf("  " IPSTR "\tup %llu B/%lu pkts (%lu B/s)\tdown %llu B/%lu pkts (%lu B/s)\n",
+        IP2STR(&addr), c->tx_bytes, c->tx_pkts, c->tx_rate, c->rx_bytes, c->rx_pkts, c->rx_rate);
+}
+
+/** Arguments used by 'napt_stats' function */
+static struct {
+    struct arg_lit *clients;
+    struct arg_lit *reset;
+    struct arg_end *end;
+} napt_stats_args;
+
+/* 'napt_stats' command */
+static int napt_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &napt_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, napt_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    napt_stats_t stats;
+    napt_stats_get(&stats);
+
+    if (stats.table_valid) {
+        uint32_t active = stats.active_tcp + stats.active_udp + stats.active_icmp;
+        printf("NAPT table: %lu/%lu entries (TCP %lu, UDP %lu, ICMP %lu)\n",
+            active, stats.table_size, stats.active_tcp, stats.active_udp, stats.active_icmp);
+        printf("Evictions: %lu (%lu/s)\n", stats.evictions, stats.evict_rate);
+    } else {
+        printf("NAPT table: %lu entries max, occupancy not available (IP_NAPT_STATS off)\n",
+            stats.table_size);
+    }
+    printf("New table entries: TCP %lu (%lu/s), UDP %lu (%lu/s), ICMP %lu (%lu/s)\n",
+        stats.tcp_new, stats.tcp_new_rate, stats.udp_new, stats.udp_new_rate,
+        stats.icmp_new, stats.icmp_new_rate);
+    printf("Active clients: %lu\n", stats.clients);
+
+    if (stats.top_count > 0) {
+        printf("Top talkers:\n");
+        for (size_t i = 0; i < stats.top_count; i++) {
+            print_client(&stats.top[i]);
+        }
+    }
+
+    if (napt_stats_args.clients->count > 0) {
+        napt_client_stats_t *clients = malloc(sizeof(napt_client_stats_t) * NAPT_STATS_CLIENTS);
+        if (clients == NULL) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        size_t n = napt_stats_get_clients(clients, NAPT_STATS_CLIENTS);
+        printf("Clients:\n");
+        for (size_t i = 0; i < n; i++) {
+            print_client(&clients[i]);
+        }
+        free(clients);
+    }
+
+    if (napt_stats_args.reset->count > 0) {
+        napt_stats_reset();
+    }
+    return 0;
+}
+
+static void register_napt_stats(void)
+{
+    napt_stats_args.clients = arg_lit0("c", "clients", "list counters of all clients");
+    napt_stats_args.reset = arg_lit0("r", "reset", "reset client counters");
+    napt_stats_args.end = arg_end(2);
+
+    const esp_console_cmd_t cmd = {
+        .command = "napt_stats",
+        .help = "Show NAPT table occupancy and per-client traffic statistics",
+        .hint = NULL,
+        .func = &napt_stats,
+        .argtable = &napt_stats_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'napt_config' function */
+static struct {
+    struct arg_int *max;
+    struct arg_end *end;
+} napt_config_args;
+
+/* 'napt_config' command */
+static int napt_config(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &napt_config_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, napt_config_args.end, argv[0]);
+        return 1;
+    }
+
+    if (napt_config_args.max->count > 0) {
+        int entries = napt_config_args.max->ival[0];
+        if (entries != 0 && (entries < NAPT_CONFIG_MIN_ENTRIES || entries > NAPT_CONFIG_MAX_ENTRIES)) {
+            printf("Table size must be 0 (default) or %d..%d\n", NAPT_CONFIG_MIN_ENTRIES, NAPT_CONFIG_MAX_ENTRIES);
+            return 1;
+        }
+        esp_err_t err = napt_config_set_entries((uint16_t)entries);
+        if (err != ESP_OK) {
+            printf("Failed to save table size: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+        printf("Table size saved, restart to apply\n");
+        return 0;
+    }
+
+    napt_config_t config;
+    napt_config_get(&config);
+    if (config.requested) {
+        printf("Table size: %u entries (requested %u)\n", config.entries, config.requested);
+    } else {
+        printf("Table size: %u entries (default)\n", config.entries);
+    }
+    printf("Allocated from: %s\n", config.psram ? "PSRAM" : "internal RAM");
+    printf("Idle timeouts (compile time): TCP %lus, TCP closing %lus, UDP %lus, ICMP %lus\n",
+        config.tcp_timeout_s, config.tcp_fin_timeout_s, config.udp_timeout_s, config.icmp_timeout_s);
+
+    // 新建表项视为未命中，其余上行包视为命中已有表项
+    napt_stats_t stats;
+    napt_stats_get(&stats);
+    uint32_t miss = stats.new_rate;
+    uint32_t hit = stats.uplink_pkt_rate > miss ? stats.uplink_pkt_rate - miss : 0;
+    printf("Lookups: %lu hit/s, %lu miss/s (estimated from new TCP/UDP/ICMP flows)\n", hit, miss);
+    if (stats.table_valid) {
+        uint32_t active = stats.active_tcp + stats.active_udp + stats.active_icmp;
+        printf("Occupancy: %lu/%lu, evictions %lu (%lu/s)\n",
+            active, stats.table_size, stats.evictions, stats.evict_rate);
+    }
+    return 0;
+}
+
+static void register_napt_config(void)
+{
+    napt_config_args.max = arg_int0("m", "max", "<entries>", "NAPT table size saved to NVS, 0 for default");
+    napt_config_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "napt_config",
+        .help = "Show NAPT table sizing and timeouts, or set the table size (applied after restart)",
+        .hint = NULL,
+        .func = &napt_config,
+        .argtable = &napt_config_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'napt_fastpath' function */
+static struct {
+    struct arg_lit *enable;
+    struct arg_lit *disable;
+    struct arg_lit *flush;
+    struct arg_end *end;
+} napt_fastpath_args;
+
+/* 'napt_fastpath' command */
+static int napt_fastpath(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &napt_fastpath_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, napt_fastpath_args.end, argv[0]);
+        return 1;
+    }
+    if (napt_fastpath_args.enable->count > 0 && napt_fastpath_args.disable->count > 0) {
+        printf("Use either --enable or --disable\n");
+        return 1;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (napt_fastpath_args.enable->count > 0) {
+        err = napt_fastpath_set_enabled(true);
+    } else if (napt_fastpath_args.disable->count > 0) {
+        err = napt_fastpath_set_enabled(false);
+    } else if (napt_fastpath_args.flush->count > 0) {
+        err = napt_fastpath_flush();
+    }
+    if (err != ESP_OK) {
+        printf("Failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    napt_fastpath_stats_t stats;
+    napt_fastpath_get_stats(&stats);
+    printf("Fast path: %s, %lu/%d flows cached\n", stats.enabled ? "enabled" : "disabled",
+        stats.flows, NAPT_FASTPATH_SETS * NAPT_FASTPATH_WAYS);
+    printf("Forwarded: %lu uplink, %lu downlink packets\n", stats.hits_out, stats.hits_in);
+    printf("Learned %lu flows, replaced %lu, refreshed via lwIP %lu times\n",
+        stats.learned, stats.replaced, stats.refreshes);
+    return 0;
+}
+
+static void register_napt_fastpath(void)
+{
+    napt_fastpath_args.enable = arg_lit0("e", "enable", "enable the fast path");
+    napt_fastpath_args.disable = arg_lit0("d", "disable", "disable the fast path, all packets go through lwIP");
+    napt_fastpath_args.flush = arg_lit0("f", "flush", "drop all cached flows");
+    napt_fastpath_args.end = arg_end(3);
+
+    const esp_console_cmd_t cmd = {
+        .command = "napt_fastpath",
+        .help = "Show or switch the fast path for established NAPT flows",
+        .hint = NULL,
+        .func = &napt_fastpath,
+        .argtable = &napt_fastpath_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'dns_stats' function */
+static struct {
+    struct arg_lit *flush;
+    struct arg_lit *reset;
+    struct arg_end *end;
+} dns_stats_args;
+
+/* 'dns_stats' command */
+static int dns_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &dns_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, dns_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    dns_forwarder_stats_t stats;
+    dns_forwarder_get_stats(&stats);
+    if (!stats.running) {
+        printf("DNS forwarder is not running\n");
+        return 1;
+    }
+
+    ip4_addr_t upstream;
+    upstream.addr = stats.upstream;
+    uint32_t answered = stats.hits + stats.misses;
+    printf("Upstream: " IPSTR ", %lu/%d answers cached\n", IP2STR(&upstream),
+        stats.cache_entries, DNS_FORWARDER_CACHE);
+    printf("Queries: %lu, cache hits %lu (%lu%%), forwarded %lu, coalesced %lu\n",
+        stats.queries, stats.hits, answered ? stats.hits * 100 / answered : 0,
+        stats.misses, stats.coalesced);
+    printf("Local captive answers: %lu, upstream timeouts: %lu, dropped: %lu\n",
+        stats.local, stats.timeouts, stats.dropped);
+
+    static const uint16_t bounds[] = DNS_FORWARDER_LAT_BOUNDS;
+    printf("Upstream latency:\n");
+    for (size_t i = 0; i < DNS_FORWARDER_LAT_BUCKETS; i++) {
+        if (i < DNS_FORWARDER_LAT_BUCKETS - 1) {
+            printf("  <= %4u ms\t%lu\n", bounds[i], stats.latency[i]);
+        } else {
+            printf("  >  %4u ms\t%lu\n", bounds[i - 1], stats.latency[i]);
+        }
+    }
+
+    if (dns_stats_args.flush->count > 0) {
+        dns_forwarder_flush();
+    }
+    if (dns_stats_args.reset->count > 0) {
+        dns_forwarder_reset_stats();
+    }
+    return 0;
+}
+
+static void register_dns_stats(void)
+{
+    dns_stats_args.flush = arg_lit0("f", "flush", "drop all cached answers");
+    dns_stats_args.reset = arg_lit0("r", "reset", "reset counters after printing");
+    dns_stats_args.end = arg_end(2);
+
+    const esp_console_cmd_t cmd = {
+        .command = "dns_stats",
+        .help = "Show DNS forwarder cache hit rate and upstream latency",
+        .hint = NULL,
+        .func = &dns_stats,
+        .argtable = &dns_stats_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'captive' function */
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} captive_args;
+
+/* 'captive' command */
+static int captive(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &captive_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, captive_args.end, argv[0]);
+        return 1;
+    }
+
+    uint32_t counts[CAPTIVE_OS_COUNT];
+    captive_get_counts(counts);
+    printf("Captive portal requests (portal %s):\n", captive_portal_url());
+    for (int os = 0; os < CAPTIVE_OS_COUNT; os++) {
+        printf("  %-8s %lu\n", captive_os_name(os), counts[os]);
+    }
+
+    if (captive_args.reset->count > 0) {
+        captive_reset_counts();
+    }
+    return 0;
+}
+
+static void register_captive(void)
+{
+    captive_args.reset = arg_lit0("r", "reset", "reset counters after printing");
+    captive_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "captive",
+        .help = "Show connectivity-check requests per OS answered by the captive portal",
+        .hint = NULL,
+        .func = &captive,
+        .argtable = &captive_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'leases' function */
+static struct {
+    struct arg_str *reserve;
+    struct arg_str *ip;
+    struct arg_str *del;
+    struct arg_end *end;
+} leases_args;
+
+/* 'leases' command */
+static int leases(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &leases_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, leases_args.end, argv[0]);
+        return 1;
+    }
+
+    uint8_t mac[6];
+    esp_err_t err = ESP_OK;
+    if (leases_args.reserve->count > 0) {
+        if (!dhcp_leases_parse_mac(leases_args.reserve->sval[0], mac)) {
+            printf("Invalid MAC address '%s'\n", leases_args.reserve->sval[0]);
+            return 1;
+        }
+        uint32_t ip = leases_args.ip->count > 0 ? ipaddr_addr(leases_args.ip->sval[0]) : 0;
+        err = dhcp_leases_reserve(mac, ip);
+    } else if (leases_args.del->count > 0) {
+        if (!dhcp_leases_parse_mac(leases_args.del->sval[0], mac)) {
+            printf("Invalid MAC address '%s'\n", leases_args.del->sval[0]);
+            return 1;
+        }
+        err = dhcp_leases_unreserve(mac);
+    }
+    if (err == ESP_ERR_NOT_FOUND) {
+        printf("No lease or reservation for this MAC\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        printf("Address is reserved for another client\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Address is not usable in the AP subnet\n");
+        return 1;
+    } else if (err != ESP_OK) {
+        printf("Failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    dhcp_lease_info_t *list = malloc(sizeof(dhcp_lease_info_t) * DHCP_LEASES_MAX);
+    if (list == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    size_t n = dhcp_leases_get_all(list, DHCP_LEASES_MAX);
+    printf("%u/%d entries\n", (unsigned)n, DHCP_LEASES_MAX);
+    for (size_t i = 0; i < n; i++) {
+        ip4_addr_t addr;
+        addr.addr = list[i].ip;
+        printf("  " MACSTR "  " IPSTR "\t%s", MAC2STR(list[i].mac), IP2STR(&addr),
+            list[i].reserved ? "reserved" : "dynamic ");
+        if (list[i].bound) {
+            printf("  %5lus left", list[i].remaining);
+        } else {
+            printf("  %-11s", "offline");
+        }
+        printf("  %s\n", list[i].hostname);
+    }
+    free(list);
+    return 0;
+}
+
+static void register_leases(void)
+{
+    leases_args.reserve = arg_str0("r", "reserve", "<mac>", "reserve an address for this client");
+    leases_args.ip = arg_str0("i", "ip", "<ip>", "address to reserve, default is the client's current one");
+    leases_args.del = arg_str0("d", "delete", "<mac>", "remove the reservation");
+    leases_args.end = arg_end(3);
+
+    const esp_console_cmd_t cmd = {
+        .command = "leases",
+        .help = "Show DHCP leases, reserve or release addresses",
+        .hint = NULL,
+        .func = &leases,
+        .argtable = &leases_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'link' function */
+static struct {
+    struct arg_lit *clear;
+    struct arg_end *end;
+} link_args;
+
+/* 'link' command */
+static int link_status(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &link_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, link_args.end, argv[0]);
+        return 1;
+    }
+
+    link_stats_t stats;
+    link_manager_get_stats(&stats);
+    if (!stats.running) {
+        printf("Upstream WiFi is not configured\n");
+        return 1;
+    }
+
+    printf("Uplink %s for %lus, AP " MACSTR " channel %u, RSSI %d dBm\n",
+        stats.up ? "up" : "down", stats.up_s, MAC2STR(stats.bssid), stats.channel, stats.rssi);
+    uint32_t total = stats.total_up_s + stats.total_down_s;
+    printf("Boot %lu: up %lus, down %lus (%lu%% available)\n", stats.boot,
+        stats.total_up_s, stats.total_down_s, total ? stats.total_up_s * 100 / total : 0);
+    printf("Connects %lu, disconnects %lu, flaps %lu, fast reconnects %lu, last reconnect %lu ms\n",
+        stats.connects, stats.disconnects, stats.flaps, stats.fast_reconnects, stats.last_reconnect_ms);
+    if (stats.retry_in_ms > 0) {
+        printf("Retry #%lu in %lu ms\n", stats.attempt, stats.retry_in_ms);
+    }
+
+    link_event_t *events = malloc(sizeof(link_event_t) * LINK_MANAGER_LOG);
+    if (events == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    size_t n = link_manager_get_events(events, LINK_MANAGER_LOG);
+    printf("%u of %lu disconnects logged:\n", (unsigned)n, stats.logged);
+    for (size_t i = 0; i < n; i++) {
+        printf("  boot %lu %7lus  reason %3u  RSSI %4d  ch %2u  up %6lus  retries %3u  ",
+            events[i].boot, events[i].time_s, events[i].reason, events[i].rssi,
+            events[i].channel, events[i].up_s, events[i].retries);
+        if (events[i].reconnect_ms == LINK_MANAGER_NO_RECONNECT) {
+            printf("not recovered\n");
+        } else {
+            printf("back in %lu ms\n", events[i].reconnect_ms);
+        }
+    }
+    free(events);
+
+    if (link_args.clear->count > 0) {
+        link_manager_clear_events();
+    }
+    return 0;
+}
+
+static void register_link(void)
+{
+    link_args.clear = arg_lit0("c", "clear", "clear the disconnect log after printing");
+    link_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "link",
+        .help = "Show uplink uptime, flaps, reconnect backoff and recent disconnect reasons",
+        .hint = NULL,
+        .func = &link_status,
+        .argtable = &link_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'uplinks' function */
+static struct {
+    struct arg_str *add;
+    struct arg_str *password;
+    struct arg_int *priority;
+    struct arg_str *del;
+    struct arg_lit *scan;
+    struct arg_end *end;
+} uplinks_args;
+
+static void print_score(int score)
+{
+    if (score == UPLINKS_NO_SCORE) {
+        printf("    -");
+    } else {
+        printf("%5d", score);
+    }
+}
+
+/* 'uplinks' command */
+static int uplinks(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &uplinks_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, uplinks_args.end, argv[0]);
+        return 1;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (uplinks_args.add->count > 0) {
+        int priority = uplinks_args.priority->count > 0 ? uplinks_args.priority->ival[0] : 1;
+        if (priority < 0 || priority > 9) {
+            printf("Priority must be 0-9\n");
+            return 1;
+        }
+        const char *password = uplinks_args.password->count > 0 ? uplinks_args.password->sval[0] : "";
+        err = uplinks_add(uplinks_args.add->sval[0], password, priority);
+    } else if (uplinks_args.del->count > 0) {
+        err = uplinks_del(uplinks_args.del->sval[0]);
+    } else if (uplinks_args.scan->count > 0) {
+        err = uplinks_scan();
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        printf("Upstream WiFi is not configured\n");
+        return 1;
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("No such uplink\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Invalid SSID or password, or the primary uplink cannot be deleted\n");
+        return 1;
+    } else if (err == ESP_ERR_NO_MEM) {
+        printf("Uplink table is full (%d)\n", UPLINKS_MAX);
+        return 1;
+    } else if (err != ESP_OK) {
+        printf("Failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    uplink_info_t *list = malloc(sizeof(uplink_info_t) * UPLINKS_MAX);
+    uplink_roam_t *history = malloc(sizeof(uplink_roam_t) * UPLINKS_HISTORY);
+    if (list == NULL || history == NULL) {
+        free(list);
+        free(history);
+        printf("Out of memory\n");
+        return 1;
+    }
+    size_t n = uplinks_get_all(list, UPLINKS_MAX);
+    printf("  #  prio  RSSI  ch  score  peak kbps  SSID\n");
+    for (size_t i = 0; i < n; i++) {
+        printf("%c %u  %4u  ", list[i].current ? '*' : ' ', list[i].index, list[i].profile.priority);
+        if (list[i].seen) {
+            printf("%4d  %2u  ", list[i].rssi, list[i].channel);
+        } else {
+            printf("   -   -  ");
+        }
+        print_score(list[i].score);
+        printf("  %9lu  %s%s\n", list[i].profile.peak_kbps, list[i].profile.ssid,
+            list[i].cooling ? " (failed, cooling down)" : "");
+    }
+
+    size_t h = uplinks_get_history(history, UPLINKS_HISTORY);
+    if (h > 0) {
+        printf("Roam history:\n");
+    }
+    for (size_t i = 0; i < h; i++) {
+        printf("  %7lus  %u -> %u  %-6s  score ", history[i].time_s, history[i].from, history[i].to,
+            history[i].lost ? "lost" : "better");
+        print_score(history[i].score_from);
+        printf(" -> ");
+        print_score(history[i].score_to);
+        if (history[i].downtime_ms == UINT32_MAX) {
+            printf("  no address\n");
+        } else {
+            printf("  up after %lu ms\n", history[i].downtime_ms);
+        }
+    }
+    free(list);
+    free(history);
+    return 0;
+}
+
+static void register_uplinks(void)
+{
+    uplinks_args.add = arg_str0("a", "add", "<ssid>", "add or update a backup uplink");
+    uplinks_args.password = arg_str0("p", "password", "<password>", "password of the added uplink");
+    uplinks_args.priority = arg_int0("P", "priority", "<0-9>", "0 is most preferred, default 1");
+    uplinks_args.del = arg_str0("d", "delete", "<ssid>", "remove a backup uplink");
+    uplinks_args.scan = arg_lit0("s", "scan", "scan now and switch if a better uplink is found");
+    uplinks_args.end = arg_end(5);
+
+    const esp_console_cmd_t cmd = {
+        .command = "uplinks",
+        .help = "Show uplink profiles with scores and roam history, add or remove backup uplinks",
+        .hint = NULL,
+        .func = &uplinks,
+        .argtable = &uplinks_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'channel' function */
+static struct {
+    struct arg_lit *scan;
+    struct arg_end *end;
+} channel_args;
+
+/* 'channel' command */
+static int channel(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &channel_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, channel_args.end, argv[0]);
+        return 1;
+    }
+
+    if (channel_args.scan->count > 0) {
+        esp_err_t err = channel_plan_run();
+        if (err == ESP_ERR_INVALID_STATE) {
+            printf("Channel planner is disabled or the uplink is not connected\n");
+            return 1;
+        }
+        printf("Scanning, run 'channel' again in a few seconds\n");
+        return 0;
+    }
+
+    channel_plan_t plan;
+    channel_plan_get(&plan);
+    if (!plan.valid) {
+        printf("No channel plan yet\n");
+        return 1;
+    }
+
+    printf("AP channel %u, %s", plan.channel, plan.second == WIFI_SECOND_CHAN_NONE ? "HT20" : "HT40");
+    if (plan.second != WIFI_SECOND_CHAN_NONE) {
+        printf(" (secondary %s)", plan.second == WIFI_SECOND_CHAN_ABOVE ? "above" : "below");
+    }
+    printf("%s, planned %lus after boot from %u APs\n", plan.follows_uplink ? ", follows uplink" : "",
+        plan.time_s, plan.aps);
+    if (plan.second == WIFI_SECOND_CHAN_NONE && plan.blocker_channel != 0) {
+        printf("HT40 blocked by '%s' on channel %u at %d dBm\n", plan.blocker, plan.blocker_channel,
+            plan.blocker_rssi);
+    } else if (plan.second == WIFI_SECOND_CHAN_NONE && plan.follows_uplink) {
+        printf("HT40 not possible: the uplink AP uses 20 MHz\n");
+    }
+    printf("  ch  APs  cost\n");
+    for (int ch = 1; ch <= CHANNEL_PLAN_MAX_CH; ch++) {
+        if (plan.cost[ch] == 0 && plan.ap_count[ch] == 0 && ch > 13) {
+            continue;
+        }
+        printf("%c %2d  %3u  %4u\n", ch == plan.channel ? '*' : ' ', ch, plan.ap_count[ch], plan.cost[ch]);
+    }
+    return 0;
+}
+
+static void register_channel(void)
+{
+    channel_args.scan = arg_lit0("s", "scan", "scan and re-plan now (may move the AP and disconnect clients)");
+    channel_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd = {
+        .command = "channel",
+        .help = "Show the AP channel plan and per-channel congestion",
+        .hint = NULL,
+        .func = &channel,
+        .argtable = &channel_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
+
+/** Arguments used by 'shaper' function */
+static struct {
+    struct arg_str *client;
+    struct arg_lit *def;
+    struct arg_lit *total;
+    struct arg_int *up;
+    struct arg_int *down;
+    struct arg_str *del;
+    struct arg_lit *clear;
+    struct arg_end *end;
+} shaper_args;
+
+/* Client given as MAC or IP; mac_out is set to NULL for an IP */
+static bool parse_shaper_client(const char *str, uint8_t mac[6], const uint8_t **mac_out, uint32_t *ip)
+{
+    if (dhcp_leases_parse_mac(str, mac)) {
+        *mac_out = mac;
+        *ip = 0;
+        return true;
+    }
+    *mac_out = NULL;
+    *ip = ipaddr_addr(str);
+    return *ip != IPADDR_NONE;
+}
+
+/* Omitted -u/-d keep the current value */
+static bool shaper_limit_arg(shaper_limit_t *limit)
+{
+    if (shaper_args.up->count > 0) {
+        if (shaper_args.up->ival[0] < 0) {
+            return false;
+        }
+        limit->up_kbps = shaper_args.up->ival[0];
+    }
+    if (shaper_args.down->count > 0) {
+        if (shaper_args.down->ival[0] < 0) {
+            return false;
+        }
+        limit->down_kbps = shaper_args.down->ival[0];
+    }
+    return true;
+}
+
+static void print_kbps(const char *label, uint32_t kbps)
+{
+    if (kbps == 0) {
+        printf("%s unlimited", label);
+    } else {
+        printf("%s %lu kbps", label, kbps);
+    }
+}
+
+static void print_limit(const shaper_limit_t *limit)
+{
+    print_kbps("up", limit->up_kbps);
+    print_kbps(", down", limit->down_kbps);
+    printf("\n");
+}
+
+/* 'shaper' command */
+static int shaper(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &shaper_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, shaper_args.end, argv[0]);
+        return 1;
+    }
+
+    uint8_t mac_buf[6];
+    const uint8_t *mac;
+    uint32_t ip;
+    esp_err_t err = ESP_OK;
+    if (shaper_args.total->count > 0 || shaper_args.def->count > 0) {
+        shaper_config_t cfg;
+        shaper_get_config(&cfg);
+        if (!shaper_limit_arg(shaper_args.total->count > 0 ? &cfg.total : &cfg.client)) {
+            printf("Rates must not be negative\n");
+            return 1;
+        }
+        err = shaper_set_config(&cfg);
+    } else if (shaper_args.client->count > 0) {
+        if (!parse_shaper_client(shaper_args.client->sval[0], mac_buf, &mac, &ip)) {
+            printf("Invalid client '%s', expected a MAC or IP address\n", shaper_args.client->sval[0]);
+            return 1;
+        }
+        shaper_limit_t limit = { 0 };
+        shaper_rule_t rules[SHAPER_RULES];
+        size_t n = shaper_get_rules(rules, SHAPER_RULES);
+        for (size_t i = 0; i < n; i++) {
+            if (mac ? memcmp(rules[i].mac, mac, 6) == 0 : rules[i].ip == ip) {
+                limit = rules[i].limit;
+                break;
+            }
+        }
+        if (!shaper_limit_arg(&limit)) {
+            printf("Rates must not be negative\n");
+            return 1;
+        }
+        err = shaper_set_rule(mac, ip, &limit);
+    } else if (shaper_args.del->count > 0) {
+        if (!parse_shaper_client(shaper_args.del->sval[0], mac_buf, &mac, &ip)) {
+            printf("Invalid client '%s', expected a MAC or IP address\n", shaper_args.del->sval[0]);
+            return 1;
+        }
+        err = shaper_del_rule(mac, ip);
+    } else if (shaper_args.clear->count > 0) {
+        err = shaper_clear_rules();
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        printf("Shaper is disabled\n");
+        return 1;
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("No rule for this client\n");
+        return 1;
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        printf("Address is not in the AP subnet or rate is too high\n");
+        return 1;
+    } else if (err == ESP_ERR_NO_MEM) {
+        printf("Rule table is full (%d)\n", SHAPER_RULES);
+        return 1;
+    } else if (err != ESP_OK) {
+        printf("Failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    shaper_stats_t stats;
+    shaper_get_stats(&stats);
+    if (!stats.running) {
+        printf("Shaper is disabled\n");
+        return 0;
+    }
+    shaper_config_t cfg;
+    shaper_get_config(&cfg);
+    printf("Total:  ");
+    print_limit(&cfg.total);
+    printf("Client: ");
+    print_limit(&cfg.client);
+
+    shaper_rule_t rules[SHAPER_RULES];
+    size_t n = shaper_get_rules(rules, SHAPER_RULES);
+    if (n > 0) {
+        printf("Rules:\n");
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (rules[i].ip == 0) {
+            printf("  " MACSTR "  ", MAC2STR(rules[i].mac));
+        } else {
+            ip4_addr_t addr;
+            addr.addr = rules[i].ip;
+            printf("  %-17s  ", ip4addr_ntoa(&addr));
+        }
+        print_limit(&rules[i].limit);
+    }
+
+    static const char *const dir_names[SHAPER_DIRS] = { "up", "down" };
+    for (int dir = 0; dir < SHAPER_DIRS; dir++) {
+        const shaper_queue_stats_t *q = &stats.q[dir];
+        printf("%-4s %s: %u queued (max %u), %lu passed, %lu delayed, %lu dropped\n", dir_names[dir],
+            stats.active[dir] ? "shaping" : "idle", q->depth, q->max_depth, q->passed, q->queued, q->drops);
+    }
+
+    shaper_client_t *clients = malloc(sizeof(shaper_client_t) * SHAPER_CLIENTS);
+    if (clients == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    n = shaper_get_clients(clients, SHAPER_CLIENTS);
+    if (n > 0) {
+        printf("  client           limit up/down kbps   queue up/down  max up/down  drops up/down\n");
+    }
+    for (size_t i = 0; i < n; i++) {
+        const shaper_client_t *c = &clients[i];
+        ip4_addr_t addr;
+        addr.addr = c->addr;
+        printf("  %-15s  %8lu/%-8lu  %6u/%-6u  %5u/%-5u  %6lu/%lu\n", ip4addr_ntoa(&addr),
+            c->limit.up_kbps, c->limit.down_kbps,
+            c->q[SHAPER_UP].depth, c->q[SHAPER_DOWN].depth,
+            c->q[SHAPER_UP].max_depth, c->q[SHAPER_DOWN].max_depth,
+            c->q[SHAPER_UP].drops, c->q[SHAPER_DOWN].drops);
+    }
+    free(clients);
+    return 0;
+}
+
+static void register_shaper(void)
+{
+    shaper_args.client = arg_str0("c", "client", "<mac|ip>", "add or update the rule of a client");
+    shaper_args.def = arg_lit0(NULL, "default", "set the rate of clients without a rule");
+    shaper_args.total = arg_lit0(NULL, "total", "set the rate shared by all clients");
+    shaper_args.up = arg_int0("u", "up", "<kbps>", "upload rate, 0 is unlimited");
+    shaper_args.down = arg_int0("d", "down", "<kbps>", "download rate, 0 is unlimited");
+    shaper_args.del = arg_str0("x", "delete", "<mac|ip>", "remove the rule of a client");
+    shaper_args.clear = arg_lit0(NULL, "clear", "remove all client rules");
+    shaper_args.end = arg_end(7);
+
+    const esp_console_cmd_t cmd = {
+        .command = "shaper",
+        .help = "Show per-client rate limits and queues, set limits by MAC or IP",
+        .hint = NULL,
+        .func = &shaper,
+        .argtable = &shaper_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
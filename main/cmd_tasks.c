@@ -0,0 +1,233 @@
+/* Console commands for task placement and CPU usage
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_console.h"
+#include "argtable3/argtable3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "task_config.h"
+#include "cmd_tasks.h"
+
+#define TASKS_SAMPLE_MS 1000
+#define TASKS_EXTRA 8           /* room for tasks created while sampling */
+
+static void register_tasks_cmd(void);
+
+void register_tasks(void)
+{
+    register_tasks_cmd();
+}
+
+static TaskStatus_t *task_snapshot(UBaseType_t *count, configRUN_TIME_COUNTER_TYPE *total)
+{
+    UBaseType_t size = uxTaskGetNumberOfTasks() + TASKS_EXTRA;
+    TaskStatus_t *tasks = malloc(sizeof(TaskStatus_t) * size);
+    if (tasks == NULL) {
+        return NULL;
+    }
+    *count = uxTaskGetSystemState(tasks, size, total);
+    return tasks;
+}
+
+static void print_core(const TaskStatus_t *t)
+{
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    if (t->xCoreID == tskNO_AFFINITY) {
+        printf("%-5s", "*");
+    } else {
+        printf("%-5d", (int)t->xCoreID);
+    }
+#else
+    printf("%-5s", "?");
+#endif
+}
+
+/* Per-task CPU usage over one sample period, stack high-water mark and core */
+static int print_task_usage(void)
+{
+    UBaseType_t start_count, end_count;
+    configRUN_TIME_COUNTER_TYPE start_total = 0, end_total = 0;
+
+    TaskStatus_t *start = task_snapshot(&start_count, &start_total);
+    if (start == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    vTaskDelay(pdMS_TO_TICKS(TASKS_SAMPLE_MS));
+#endif
+    TaskStatus_t *end = task_snapshot(&end_count, &end_total);
+    if (end == NULL) {
+        free(start);
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    /* Run time counters are summed over all cores */
+    uint64_t elapsed = (uint64_t)(end_total - start_total) * portNUM_PROCESSORS;
+
+    printf("%-16s %-5s %-5s %-6s %s\n", "Task", "Core", "Prio", "CPU%", "Stack free");
+    for (UBaseType_t i = 0; i < end_count; i++) {
+        const TaskStatus_t *t = &end[i];
+        printf("%-16s ", t->pcTaskName);
+        print_core(t);
+        printf(" %-5u ", (unsigned)t->uxCurrentPriority);
+
+        bool found = false;
+        for (UBaseType_t j = 0; j < start_count; j++) {
+            if (start[j].xHandle == t->xHandle) {
+                if (elapsed > 0) {
+                    uint64_t run = t->ulRunTimeCounter - start[j].ulRunTimeCounter;
+                    unsigned permille = (unsigned)(run * 1000 / elapsed);
+                    printf("%3u.%u  ", permille / 10, permille % 10);
+                    found = true;
+                }
+                break;
+            }
+        }
+        if (!found) {
+            printf("%-6s ", "-");
+        }
+        printf("%lu\n", (unsigned long)t->usStackHighWaterMark);
+    }
+#if !CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    printf("CPU usage requires CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
+#endif
+
+    free(start);
+    free(end);
+    return 0;
+}
+
+static void print_placement(void)
+{
+    printf("%-8s %-5s %-5s %-6s %s\n", "Name", "Core", "Prio", "Stack", "Source");
+    for (int id = 0; id < TASK_COUNT; id++) {
+        const task_placement_t *p = task_config_get(id);
+        printf("%-8s %-5d %-5u %-6u %s\n", task_config_name(id), p->core, p->priority, p->stack,
+            task_config_is_overridden(id) ? "NVS" : "Kconfig");
+    }
+}
+
+static void print_placement_limits(void)
+{
+    printf("Invalid placement: core -1..%d, priority 1..%d, stack %d..%d\n",
+        portNUM_PROCESSORS - 1, configMAX_PRIORITIES - 1, TASK_CONFIG_MIN_STACK, TASK_CONFIG_MAX_STACK);
+}
+
+/** Arguments used by 'tasks' function */
+static struct {
+    struct arg_lit *list;
+    struct arg_str *set;
+    struct arg_int *core;
+    struct arg_int *priority;
+    struct arg_int *stack;
+    struct arg_str *reset;
+    struct arg_end *end;
+} tasks_args;
+
+/* 'tasks' command */
+static int tasks(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &tasks_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, tasks_args.end, argv[0]);
+        return 1;
+    }
+
+    if (tasks_args.reset->count > 0) {
+        int id = task_config_find(tasks_args.reset->sval[0]);
+        if (id < 0) {
+            printf("Unknown task '%s'\n", tasks_args.reset->sval[0]);
+            return 1;
+        }
+        esp_err_t err = task_config_reset(id);
+        if (err != ESP_OK) {
+            printf("Failed to reset: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+        printf("Placement of '%s' reset to Kconfig default, restart to apply\n", task_config_name(id));
+        return 0;
+    }
+
+    if (tasks_args.set->count > 0) {
+        int id = task_config_find(tasks_args.set->sval[0]);
+        if (id < 0) {
+            printf("Unknown task '%s'\n", tasks_args.set->sval[0]);
+            return 1;
+        }
+        // 先按原始int检查范围再收窄，避免超范围的值截断后恰好合法
+        int core = tasks_args.core->count > 0 ? tasks_args.core->ival[0] : 0;
+        int priority = tasks_args.priority->count > 0 ? tasks_args.priority->ival[0] : 1;
+        int stack = tasks_args.stack->count > 0 ? tasks_args.stack->ival[0] : TASK_CONFIG_MIN_STACK;
+        if (core < -1 || core >= portNUM_PROCESSORS || priority < 1 || priority >= configMAX_PRIORITIES ||
+            stack < TASK_CONFIG_MIN_STACK || stack > TASK_CONFIG_MAX_STACK) {
+            print_placement_limits();
+            return 1;
+        }
+        task_placement_t p = *task_config_get(id);
+        if (tasks_args.core->count > 0) {
+            p.core = (int8_t)core;
+        }
+        if (tasks_args.priority->count > 0) {
+            p.priority = (uint8_t)priority;
+        }
+        if (tasks_args.stack->count > 0) {
+            p.stack = (uint16_t)stack;
+        }
+        esp_err_t err = task_config_set(id, &p);
+        if (err == ESP_ERR_INVALID_ARG) {
+            print_placement_limits();
+            return 1;
+        } else if (err != ESP_OK) {
+            printf("Failed to save: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+        printf("Placement of '%s' saved, restart to apply\n", task_config_name(id));
+        return 0;
+    }
+
+    if (tasks_args.list->count > 0) {
+        print_placement();
+        return 0;
+    }
+    return print_task_usage();
+}
+
+static void register_tasks_cmd(void)
+{
+    tasks_args.list = arg_lit0("l", "list", "show the task placement table");
+    // 任务名列表由task_config生成，argtable只保存指针，缓冲区须为静态
+    static char set_help[64];
+    size_t len = snprintf(set_help, sizeof(set_help), "save placement of a task (");
+    for (int id = 0; id < TASK_COUNT && len < sizeof(set_help); id++) {
+        len += snprintf(set_help + len, sizeof(set_help) - len, "%s%s",
+                        task_config_name(id), id + 1 < TASK_COUNT ? ", " : ")");
+    }
+    tasks_args.set = arg_str0("s", "set", "<name>", set_help);
+    tasks_args.core = arg_int0("c", "core", "<core>", "core for --set, -1 for any core");
+    tasks_args.priority = arg_int0("p", "priority", "<prio>", "priority for --set");
+    tasks_args.stack = arg_int0("k", "stack", "<bytes>", "stack size for --set");
+    tasks_args.reset = arg_str0("r", "reset", "<name>", "drop the saved placement of a task");
+    tasks_args.end = arg_end(6);
+
+    const esp_console_cmd_t cmd = {
+        .command = "tasks",
+        .help = "Show per-task CPU usage, stack headroom and core, or edit the task placement table",
+        .hint = NULL,
+        .func = &tasks,
+        .argtable = &tasks_args
+    };
+    ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
+}
@@ -0,0 +1,18 @@
+/* Console commands for task placement and CPU usage
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Register task functions
+void register_tasks(void);
+
+#ifdef __cplusplus
+}
+#endif
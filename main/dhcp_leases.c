@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/def.h"
+#include "lwip/ip4_addr.h"
+#include "router_globals.h"
+#include "dhcp_leases.h"
+
+// 配置
+#define TAG "DHCP_LEASES"
+#define HASH_SIZE (1 << DHCP_LEASES_HASH_BITS)
+#define HASH_MASK (HASH_SIZE - 1)
+#define SLOT_EMPTY (-1)
+
+#define LEASE_VALID 0x01
+#define LEASE_RESERVED 0x02
+
+_Static_assert(DHCP_LEASES_MAX * 2 <= HASH_SIZE, "lease hash index too small");
+_Static_assert(DHCP_LEASES_MAX <= 100, "lease NVS keys use two digits");
+_Static_assert(DHCP_LEASES_MAX <= 32, "dirty lease slots are a 32-bit mask");
+_Static_assert(DHCP_LEASES_POOL_FIRST + DHCP_LEASES_POOL_SIZE <= 255, "lease pool exceeds a /24");
+
+// NVS中的存储格式，地址只存主机号，AP网段变化后仍然有效
+typedef struct {
+    uint8_t mac[6];
+    uint8_t flags;
+    uint8_t host;
+} lease_record_t;
+
+typedef struct {
+    lease_record_t rec;
+    bool stored;                        // NVS中已有或即将写入相同的记录，续租时不再写flash
+    uint32_t expires;                   // 开机后的秒数，不晚于当前时间表示没有有效租约
+    char hostname[32];
+} lease_t;
+
+// 租约按槽位存放，槽位号即NVS键号
+static lease_t s_leases[DHCP_LEASES_MAX];
+
+// MAC开放寻址索引，存放槽位号
+static int8_t s_index[HASH_SIZE];
+
+// 网段内已占用的主机号，含网络地址、广播地址和AP自身
+static uint32_t s_used[256 / 32];
+
+// 客户端DECLINE的主机号及其到期时间，until为0表示空位
+typedef struct {
+    uint8_t host;
+    uint32_t until;
+} declined_t;
+
+static declined_t s_declined[DHCP_LEASES_DECLINE_MAX];
+
+static uint32_t s_net;                  // 网络字节序
+static uint32_t s_mask;
+static SemaphoreHandle_t s_lock;
+static uint32_t s_dirty;                // 待写入NVS的槽位，受s_lock保护
+static esp_timer_handle_t s_flush_timer;
+
+static inline uint32_t now_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static inline uint32_t lease_hash(const uint8_t mac[6])
+{
+    // OUI相同的设备很常见，主要靠后三个字节区分
+    uint32_t key = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) ^
+                   ((uint32_t)mac[0] << 8 | mac[1]);
+    return (key * 2654435761u) >> (32 - DHCP_LEASES_HASH_BITS);
+}
+
+static inline bool host_used(uint8_t host)
+{
+    return s_used[host / 32] & (1u << (host % 32));
+}
+
+static inline void host_mark(uint8_t host, bool used)
+{
+    if (used) {
+        s_used[host / 32] |= 1u << (host % 32);
+    } else {
+        s_used[host / 32] &= ~(1u << (host % 32));
+    }
+}
+
+static bool host_declined(uint8_t host, uint32_t now)
+{
+    for (int i = 0; i < DHCP_LEASES_DECLINE_MAX; i++) {
+        if (s_declined[i].until > now && s_declined[i].host == host) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 空闲且不在DECLINE冷却期内的主机号才能分配
+static inline bool host_free(uint8_t host, uint32_t now)
+{
+    return !host_used(host) && !host_declined(host, now);
+}
+
+static inline uint32_t host_ip(uint8_t host)
+{
+    return s_net | lwip_htonl(host);
+}
+
+// 地址在AP网段内时返回主机号，否则返回0
+static uint8_t ip_host(uint32_t ip)
+{
+    if ((ip & s_mask) != s_net) {
+        return 0;
+    }
+    uint32_t host = lwip_ntohl(ip & ~s_mask);
+    return host < 255 ? host : 0;
+}
+
+// 返回索引表中的位置，未找到时返回应插入的空位置
+static uint32_t index_probe(const uint8_t mac[6], bool* found)
+{
+    uint32_t i = lease_hash(mac);
+    while (s_index[i] != SLOT_EMPTY) {
+        if (memcmp(s_leases[s_index[i]].rec.mac, mac, 6) == 0) {
+            *found = true;
+            return i;
+        }
+        i = (i + 1) & HASH_MASK;
+    }
+    *found = false;
+    return i;
+}
+
+// 线性探测的后移删除，与portmap的索引相同
+static void index_remove(uint32_t i)
+{
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & HASH_MASK;
+        if (s_index[j] == SLOT_EMPTY) {
+            break;
+        }
+        uint32_t k = lease_hash(s_leases[s_index[j]].rec.mac);
+        // k不在(i, j]循环区间内时，j处的元素可以前移到i
+        bool movable = (i <= j) ? (k <= i || k > j) : (k <= i && k > j);
+        if (movable) {
+            s_index[i] = s_index[j];
+            i = j;
+        }
+    }
+    s_index[i] = SLOT_EMPTY;
+}
+
+static int find_slot(const uint8_t mac[6])
+{
+    bool found;
+    uint32_t i = index_probe(mac, &found);
+    return found ? s_index[i] : SLOT_EMPTY;
+}
+
+static void slot_key(char* key, size_t size, int slot)
+{
+    snprintf(key, size, DHCP_LEASES_NVS_PREFIX "%02d", slot);
+}
+
+static void flush_schedule(uint32_t delay_ms)
+{
+    if (s_flush_timer && !esp_timer_is_active(s_flush_timer)) {
+        esp_timer_start_once(s_flush_timer, (uint64_t)delay_ms * 1000);
+    }
+}
+
+// 槽位的记录变化后调用（调用者持有s_lock）：有效的记录写入NVS，已删除的擦除
+// 只做标记，由flush_timer_cb在锁外写flash
+static void slot_persist(int slot)
+{
+    s_leases[slot].stored = (s_leases[slot].rec.flags & LEASE_VALID) != 0;
+    s_dirty |= 1u << slot;
+    flush_schedule(DHCP_LEASES_FLUSH_MS);
+}
+
+// 持锁复制待写入的记录，释放锁后写NVS，失败的槽位重新标记并稍后重试
+static void flush_timer_cb(void* arg)
+{
+    // 持锁的都是短操作，取不到锁时稍后再来，不阻塞esp_timer任务
+    if (xSemaphoreTake(s_lock, 0) != pdTRUE) {
+        flush_schedule(DHCP_LEASES_FLUSH_MS);
+        return;
+    }
+    uint32_t dirty = s_dirty;
+    s_dirty = 0;
+    lease_record_t recs[DHCP_LEASES_MAX];
+    for (int slot = 0; slot < DHCP_LEASES_MAX; slot++) {
+        if (dirty & (1u << slot)) {
+            const lease_t* l = &s_leases[slot];
+            recs[slot] = l->rec;
+            if (!l->stored) {
+                recs[slot].flags = 0;   // 擦除，包括删除后被未确认的客户端占用的槽位
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (!dirty) {
+        return;
+    }
+
+    uint32_t failed = 0;
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        for (int slot = 0; slot < DHCP_LEASES_MAX; slot++) {
+            if (!(dirty & (1u << slot))) {
+                continue;
+            }
+            char key[8];
+            slot_key(key, sizeof(key), slot);
+            esp_err_t e;
+            if (recs[slot].flags & LEASE_VALID) {
+                e = nvs_set_blob(nvs, key, &recs[slot], sizeof(lease_record_t));
+            } else {
+                e = nvs_erase_key(nvs, key);
+                if (e == ESP_ERR_NVS_NOT_FOUND) {
+                    e = ESP_OK;
+                }
+            }
+            if (e != ESP_OK) {
+                failed |= 1u << slot;
+                err = e;
+            }
+        }
+        esp_err_t commit = nvs_commit(nvs);
+        nvs_close(nvs);
+        if (commit != ESP_OK) {
+            err = commit;
+            failed = dirty;
+        }
+    } else {
+        failed = dirty;
+    }
+
+    if (failed) {
+        ESP_LOGW(TAG, "写入租约失败(%s)，%d秒后重试", esp_err_to_name(err), DHCP_LEASES_RETRY_MS / 1000);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_dirty |= failed;
+        flush_schedule(DHCP_LEASES_RETRY_MS);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+static void slot_insert(int slot, const uint8_t mac[6], uint8_t host, uint8_t flags)
+{
+    bool found;
+    lease_t* l = &s_leases[slot];
+    memset(l, 0, sizeof(*l));
+    memcpy(l->rec.mac, mac, 6);
+    l->rec.host = host;
+    l->rec.flags = LEASE_VALID | flags;
+    s_index[index_probe(mac, &found)] = slot;
+    host_mark(host, true);
+}
+
+static void slot_remove(int slot)
+{
+    lease_t* l = &s_leases[slot];
+    bool found;
+    uint32_t i = index_probe(l->rec.mac, &found);
+    if (found) {
+        index_remove(i);
+    }
+    host_mark(l->rec.host, false);
+    bool stored = l->stored;
+    memset(l, 0, sizeof(*l));
+    if (stored) {
+        slot_persist(slot);
+    }
+}
+
+// 没有有效租约的动态条目中，最早到期的一条
+static int oldest_expired(uint32_t now)
+{
+    int best = SLOT_EMPTY;
+    for (int i = 0; i < DHCP_LEASES_MAX; i++) {
+        const lease_t* l = &s_leases[i];
+        if ((l->rec.flags & LEASE_VALID) && !(l->rec.flags & LEASE_RESERVED) && l->expires <= now &&
+            (best == SLOT_EMPTY || l->expires < s_leases[best].expires)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// 空闲槽位，没有时淘汰最早到期的动态条目
+static int slot_alloc(uint32_t now)
+{
+    for (int i = 0; i < DHCP_LEASES_MAX; i++) {
+        if (!(s_leases[i].rec.flags & LEASE_VALID)) {
+            return i;
+        }
+    }
+    int slot = oldest_expired(now);
+    if (slot != SLOT_EMPTY) {
+        slot_remove(slot);
+    }
+    return slot;
+}
+
+// 地址池中的空闲主机号，池满时淘汰最早到期的动态条目
+static uint8_t pool_alloc(uint32_t now)
+{
+    for (int retry = 0; retry < 2; retry++) {
+        for (uint8_t h = DHCP_LEASES_POOL_FIRST; h < DHCP_LEASES_POOL_FIRST + DHCP_LEASES_POOL_SIZE; h++) {
+            if (host_free(h, now)) {
+                return h;
+            }
+        }
+        int slot = oldest_expired(now);
+        if (slot == SLOT_EMPTY) {
+            break;
+        }
+        slot_remove(slot);
+    }
+    return 0;
+}
+
+esp_err_t dhcp_leases_init(uint32_t ap_ip, uint32_t netmask)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_flush_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = flush_timer_cb,
+            .name = "dhcp_leases",
+        };
+        esp_err_t err = esp_timer_create(&args, &s_flush_timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (lwip_ntohl(netmask) < 0xFFFFFF00u) {
+        ESP_LOGW(TAG, "只管理/24以内的网段");
+        netmask = PP_HTONL(0xFFFFFF00u);
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memset(s_leases, 0, sizeof(s_leases));
+    memset(s_index, SLOT_EMPTY, sizeof(s_index));
+    s_dirty = 0;
+    memset(s_used, 0, sizeof(s_used));
+    memset(s_declined, 0, sizeof(s_declined));
+    s_net = ap_ip & netmask;
+    s_mask = netmask;
+    host_mark(0, true);
+    host_mark(255, true);
+    for (uint32_t h = lwip_ntohl(~netmask) + 1; h < 255; h++) {
+        host_mark(h, true);             // 比/24小的网段之外的主机号
+    }
+    host_mark(ip_host(ap_ip), true);
+
+    nvs_handle_t nvs;
+    size_t loaded = 0;
+    if (nvs_open(PARAM_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        for (int slot = 0; slot < DHCP_LEASES_MAX; slot++) {
+            char key[8];
+            lease_record_t rec;
+            size_t len = sizeof(rec);
+            slot_key(key, sizeof(key), slot);
+            if (nvs_get_blob(nvs, key, &rec, &len) != ESP_OK || len != sizeof(rec)) {
+                continue;
+            }
+            if (!(rec.flags & LEASE_VALID) || host_used(rec.host) || find_slot(rec.mac) != SLOT_EMPTY) {
+                ESP_LOGW(TAG, "忽略无效的租约记录 %s", key);
+                continue;
+            }
+            slot_insert(slot, rec.mac, rec.host, rec.flags & LEASE_RESERVED);
+            s_leases[slot].stored = true;
+            loaded++;
+        }
+        nvs_close(nvs);
+    }
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "已加载%u条地址绑定", (unsigned)loaded);
+    return ESP_OK;
+}
+
+esp_err_t dhcp_leases_offer(const uint8_t mac[6], uint32_t requested, uint32_t* ip)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t now = now_s();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (slot == SLOT_EMPTY) {
+        // 客户端请求的空闲地址优先，换一个AP重连时往往还记得原来的地址
+        uint8_t host = ip_host(requested);
+        if (host == 0 || !host_free(host, now)) {
+            host = pool_alloc(now);
+        }
+        slot = host ? slot_alloc(now) : SLOT_EMPTY;
+        if (slot == SLOT_EMPTY) {
+            err = ESP_ERR_NO_MEM;
+            goto out;
+        }
+        slot_insert(slot, mac, host, 0);
+    }
+
+    // 为未确认的客户端暂留地址
+    lease_t* l = &s_leases[slot];
+    if (l->expires < now + DHCP_LEASES_OFFER_S) {
+        l->expires = now + DHCP_LEASES_OFFER_S;
+    }
+    *ip = host_ip(l->rec.host);
+
+out:
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t dhcp_leases_bind(const uint8_t mac[6], uint32_t ip, const char* hostname, uint32_t* lease_s)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t now = now_s();
+    uint8_t host = ip_host(ip);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (slot == SLOT_EMPTY) {
+        // 重启后租约表中没有的客户端（INIT-REBOOT），地址空闲时直接认可
+        if (host == 0 || !host_free(host, now) || (slot = slot_alloc(now)) == SLOT_EMPTY) {
+            err = ESP_ERR_INVALID_STATE;
+            goto out;
+        }
+        slot_insert(slot, mac, host, 0);
+    }
+
+    lease_t* l = &s_leases[slot];
+    if (l->rec.host != host) {
+        err = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+    l->expires = now + DHCP_LEASES_TIME_S;
+    if (hostname) {
+        strlcpy(l->hostname, hostname, sizeof(l->hostname));
+    }
+    // 续租只更新内存，地址绑定变化时才写NVS
+    if (!l->stored) {
+        slot_persist(slot);
+    }
+    *lease_s = DHCP_LEASES_TIME_S;
+
+out:
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void dhcp_leases_release(const uint8_t mac[6])
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (slot != SLOT_EMPTY) {
+        // 保留绑定，客户端再次连接时仍分配同一地址
+        s_leases[slot].expires = 0;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void dhcp_leases_decline(const uint8_t mac[6], uint32_t ip)
+{
+    uint32_t now = now_s();
+    uint8_t host = ip_host(ip);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (host == 0 || slot == SLOT_EMPTY || s_leases[slot].rec.host != host) {
+        goto out;
+    }
+
+    // 记入冷却表，表满时替换最早到期的一项
+    int d = 0;
+    for (int i = 1; i < DHCP_LEASES_DECLINE_MAX; i++) {
+        if (s_declined[i].until < s_declined[d].until) {
+            d = i;
+        }
+    }
+    s_declined[d].host = host;
+    s_declined[d].until = now + DHCP_LEASES_DECLINE_S;
+
+    ip4_addr_t addr = { .addr = ip };
+    lease_t* l = &s_leases[slot];
+    if (l->rec.flags & LEASE_RESERVED) {
+        // 保留地址不能换，只能由管理员处理冲突
+        ESP_LOGW(TAG, "保留地址 " IPSTR " 已被其他设备占用", IP2STR(&addr));
+        l->expires = 0;
+    } else {
+        ESP_LOGW(TAG, "地址 " IPSTR " 已被其他设备占用，%d秒内不再分配", IP2STR(&addr), DHCP_LEASES_DECLINE_S);
+        slot_remove(slot);
+    }
+
+out:
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t dhcp_leases_reserve(const uint8_t mac[6], uint32_t ip)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t now = now_s();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (ip == 0) {
+        if (slot == SLOT_EMPTY) {
+            err = ESP_ERR_NOT_FOUND;
+            goto out;
+        }
+        ip = host_ip(s_leases[slot].rec.host);
+    }
+
+    uint8_t host = ip_host(ip);
+    if (host == 0) {
+        err = ESP_ERR_INVALID_ARG;
+        goto out;
+    }
+    if (slot == SLOT_EMPTY || s_leases[slot].rec.host != host) {
+        // 地址被其他客户端占用：动态分配的让出，保留的不动
+        for (int i = 0; i < DHCP_LEASES_MAX; i++) {
+            const lease_t* other = &s_leases[i];
+            if (i != slot && (other->rec.flags & LEASE_VALID) && other->rec.host == host) {
+                if (other->rec.flags & LEASE_RESERVED) {
+                    err = ESP_ERR_INVALID_STATE;
+                    goto out;
+                }
+                slot_remove(i);
+                break;
+            }
+        }
+        if (host_used(host)) {
+            err = ESP_ERR_INVALID_ARG;  // 网络地址、广播地址或AP自身
+            goto out;
+        }
+    }
+
+    if (slot == SLOT_EMPTY) {
+        slot = slot_alloc(now);
+        if (slot == SLOT_EMPTY) {
+            err = ESP_ERR_NO_MEM;
+            goto out;
+        }
+        slot_insert(slot, mac, host, LEASE_RESERVED);
+    } else {
+        lease_t* l = &s_leases[slot];
+        if (l->rec.host != host) {
+            // 客户端续租时收到NAK，重新获取保留的地址
+            host_mark(l->rec.host, false);
+            host_mark(host, true);
+            l->rec.host = host;
+            l->expires = 0;
+        }
+        l->rec.flags |= LEASE_RESERVED;
+    }
+    slot_persist(slot);
+
+out:
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t dhcp_leases_unreserve(const uint8_t mac[6])
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (slot == SLOT_EMPTY || !(s_leases[slot].rec.flags & LEASE_RESERVED)) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (s_leases[slot].expires <= now_s()) {
+        slot_remove(slot);
+    } else {
+        s_leases[slot].rec.flags &= ~LEASE_RESERVED;
+        slot_persist(slot);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t dhcp_leases_pin(const uint8_t mac[6], uint32_t* ip)
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_slot(mac);
+    if (slot == SLOT_EMPTY) {
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        lease_t* l = &s_leases[slot];
+        if (!(l->rec.flags & LEASE_RESERVED)) {
+            l->rec.flags |= LEASE_RESERVED;
+            slot_persist(slot);
+        }
+        *ip = host_ip(l->rec.host);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+size_t dhcp_leases_get_all(dhcp_lease_info_t* out, size_t max)
+{
+    size_t n = 0;
+    uint32_t now = now_s();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < DHCP_LEASES_MAX && n < max; i++) {
+        const lease_t* l = &s_leases[i];
+        if (!(l->rec.flags & LEASE_VALID)) {
+            continue;
+        }
+        dhcp_lease_info_t* o = &out[n++];
+        memcpy(o->mac, l->rec.mac, 6);
+        o->ip = host_ip(l->rec.host);
+        o->reserved = l->rec.flags & LEASE_RESERVED;
+        o->bound = l->expires > now;
+        o->remaining = o->bound ? l->expires - now : 0;
+        strlcpy(o->hostname, l->hostname, sizeof(o->hostname));
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+bool dhcp_leases_parse_mac(const char* str, uint8_t mac[6])
+{
+    unsigned int b[6];
+    char tail;
+    if (sscanf(str, "%x:%x:%x:%x:%x:%x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (b[i] > 0xFF) {
+            return false;
+        }
+        mac[i] = b[i];
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef DHCP_LEASES_H
+#define DHCP_LEASES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// 租约表配置
+#define DHCP_LEASES_MAX 32              // 保留地址和动态租约共用
+#define DHCP_LEASES_HASH_BITS 6         // MAC索引表大小2^6，负载因子不超过1/2
+#define DHCP_LEASES_POOL_FIRST 2        // 动态地址池：AP网段的.2 ~ .(2 + 32 - 1)
+#define DHCP_LEASES_POOL_SIZE 32
+#define DHCP_LEASES_TIME_S 7200         // 租期
+#define DHCP_LEASES_OFFER_S 30          // OFFER后等待REQUEST的时间
+#define DHCP_LEASES_NVS_PREFIX "dl"     // 每条绑定一个NVS键：dl00 ~ dl31
+#define DHCP_LEASES_FLUSH_MS 1000       // 绑定变化后延迟写NVS，合并短时间内的多次修改
+#define DHCP_LEASES_RETRY_MS 10000      // 写NVS失败后重试的间隔
+#define DHCP_LEASES_DECLINE_S 600       // 客户端DECLINE的地址在此时间内不再分配（RFC 2131 4.3.3）
+#define DHCP_LEASES_DECLINE_MAX 8       // 同时记录的被拒绝地址数，满时替换最早到期的
+
+// 对外展示的租约信息
+typedef struct {
+    uint8_t mac[6];
+    uint32_t ip;                        // 网络字节序
+    bool reserved;
+    bool bound;                         // false表示只有NVS中记下的地址，当前没有租约
+    uint32_t remaining;                 // 剩余租期（秒）
+    char hostname[32];
+} dhcp_lease_info_t;
+
+// 按AP网段初始化，从NVS加载保留地址和上次分配的地址
+esp_err_t dhcp_leases_init(uint32_t ap_ip, uint32_t netmask);
+
+// 以下由DHCP服务器在tcpip线程中调用，按MAC哈希查找，不扫描整表
+// 绑定变化只标记槽位，由定时器在esp_timer任务中写NVS，tcpip线程不等待flash
+// 为客户端选择地址：已有绑定或保留地址优先，其次是客户端请求的地址，最后从地址池分配
+esp_err_t dhcp_leases_offer(const uint8_t mac[6], uint32_t requested, uint32_t* ip);
+// 确认租约，地址不属于该客户端时返回ESP_ERR_INVALID_STATE（应回复NAK）
+esp_err_t dhcp_leases_bind(const uint8_t mac[6], uint32_t ip, const char* hostname, uint32_t* lease_s);
+void dhcp_leases_release(const uint8_t mac[6]);
+// 客户端发现地址已被占用：该地址在DHCP_LEASES_DECLINE_S内不再分配，动态绑定删除，下次DISCOVER换一个地址
+// ip不是该客户端的地址时忽略
+void dhcp_leases_decline(const uint8_t mac[6], uint32_t ip);
+
+// 保留地址，ip为0时保留客户端当前的地址；稍后写入NVS
+esp_err_t dhcp_leases_reserve(const uint8_t mac[6], uint32_t ip);
+esp_err_t dhcp_leases_unreserve(const uint8_t mac[6]);
+
+// 端口映射按MAC指定目标时使用：返回保留地址，尚未保留时保留其当前地址
+esp_err_t dhcp_leases_pin(const uint8_t mac[6], uint32_t* ip);
+
+size_t dhcp_leases_get_all(dhcp_lease_info_t* out, size_t max);
+
+// "aa:bb:cc:dd:ee:ff"格式的MAC地址
+bool dhcp_leases_parse_mac(const char* str, uint8_t mac[6]);
+
+#endif /* DHCP_LEASES_H */
@@ -0,0 +1,324 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/def.h"
+#include "dhcp_leases.h"
+#include "dhcp_server.h"
+
+// 配置
+#define TAG "DHCP_SERVER"
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_CLIENT_PORT 68
+#define DHCP_MAGIC_COOKIE 0x63825363u
+#define DHCP_MSG_MAX 576                // 客户端报文上限（RFC 2131最小保证值）
+#define DHCP_REPLY_MIN 300              // BOOTP最小报文长度，部分客户端要求
+
+// BOOTP报文字段偏移
+#define BOOTP_OFF_OP 0
+#define BOOTP_OFF_HTYPE 1
+#define BOOTP_OFF_HLEN 2
+#define BOOTP_OFF_XID 4
+#define BOOTP_OFF_FLAGS 10
+#define BOOTP_OFF_CIADDR 12
+#define BOOTP_OFF_YIADDR 16
+#define BOOTP_OFF_GIADDR 24
+#define BOOTP_OFF_CHADDR 28
+#define BOOTP_OFF_COOKIE 236
+#define BOOTP_OFF_OPTIONS 240
+
+#define BOOTP_REQUEST 1
+#define BOOTP_REPLY 2
+
+// DHCP报文类型
+#define DHCP_DISCOVER 1
+#define DHCP_OFFER 2
+#define DHCP_REQUEST 3
+#define DHCP_DECLINE 4
+#define DHCP_ACK 5
+#define DHCP_NAK 6
+#define DHCP_RELEASE 7
+#define DHCP_INFORM 8
+
+// DHCP选项
+#define OPT_PAD 0
+#define OPT_SUBNET_MASK 1
+#define OPT_ROUTER 3
+#define OPT_DNS 6
+#define OPT_HOSTNAME 12
+#define OPT_REQUESTED_IP 50
+#define OPT_LEASE_TIME 51
+#define OPT_MSG_TYPE 53
+#define OPT_SERVER_ID 54
+#define OPT_T1 58
+#define OPT_T2 59
+#define OPT_END 255
+
+// 请求中用到的选项
+typedef struct {
+    uint8_t type;
+    uint32_t requested_ip;
+    uint32_t server_id;
+    char hostname[32];
+} dhcp_req_t;
+
+static esp_netif_t* s_esp_netif;
+static struct netif* s_netif;
+static struct udp_pcb* s_pcb;
+static uint32_t s_server_ip;
+static uint32_t s_netmask;
+static volatile uint32_t s_dns;
+
+// 只在tcpip线程中使用
+static uint8_t s_rx[DHCP_MSG_MAX];
+static uint8_t s_tx[DHCP_MSG_MAX];
+
+static inline uint32_t get32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static bool parse_options(const uint8_t* msg, size_t len, dhcp_req_t* req)
+{
+    memset(req, 0, sizeof(*req));
+    size_t off = BOOTP_OFF_OPTIONS;
+    while (off < len) {
+        uint8_t code = msg[off++];
+        if (code == OPT_PAD) {
+            continue;
+        }
+        if (code == OPT_END || off >= len) {
+            break;
+        }
+        uint8_t olen = msg[off++];
+        if (off + olen > len) {
+            return false;
+        }
+        const uint8_t* v = msg + off;
+        switch (code) {
+        case OPT_MSG_TYPE:
+            if (olen == 1) {
+                req->type = v[0];
+            }
+            break;
+        case OPT_REQUESTED_IP:
+            if (olen == 4) {
+                req->requested_ip = get32(v);
+            }
+            break;
+        case OPT_SERVER_ID:
+            if (olen == 4) {
+                req->server_id = get32(v);
+            }
+            break;
+        case OPT_HOSTNAME: {
+            size_t n = olen < sizeof(req->hostname) - 1 ? olen : sizeof(req->hostname) - 1;
+            memcpy(req->hostname, v, n);
+            req->hostname[n] = '\0';
+            break;
+        }
+        default:
+            break;
+        }
+        off += olen;
+    }
+    return req->type != 0;
+}
+
+static uint8_t* put_opt(uint8_t* p, uint8_t code, uint8_t len, const void* v)
+{
+    *p++ = code;
+    *p++ = len;
+    memcpy(p, v, len);
+    return p + len;
+}
+
+static uint8_t* put_opt32(uint8_t* p, uint8_t code, uint32_t v)
+{
+    return put_opt(p, code, 4, &v);
+}
+
+// 组装并发送应答，lease为0时不带租期（NAK和INFORM的ACK）
+static void send_reply(const uint8_t* req, uint8_t type, uint32_t yiaddr, uint32_t lease)
+{
+    memset(s_tx, 0, DHCP_REPLY_MIN);
+    s_tx[BOOTP_OFF_OP] = BOOTP_REPLY;
+    s_tx[BOOTP_OFF_HTYPE] = 1;
+    s_tx[BOOTP_OFF_HLEN] = 6;
+    memcpy(s_tx + BOOTP_OFF_XID, req + BOOTP_OFF_XID, 4);
+    memcpy(s_tx + BOOTP_OFF_FLAGS, req + BOOTP_OFF_FLAGS, 2);
+    if (type != DHCP_NAK) {
+        memcpy(s_tx + BOOTP_OFF_CIADDR, req + BOOTP_OFF_CIADDR, 4);
+    }
+    memcpy(s_tx + BOOTP_OFF_YIADDR, &yiaddr, 4);
+    memcpy(s_tx + BOOTP_OFF_CHADDR, req + BOOTP_OFF_CHADDR, 16);
+    uint32_t cookie = PP_HTONL(DHCP_MAGIC_COOKIE);
+    memcpy(s_tx + BOOTP_OFF_COOKIE, &cookie, 4);
+
+    uint8_t* p = s_tx + BOOTP_OFF_OPTIONS;
+    p = put_opt(p, OPT_MSG_TYPE, 1, &type);
+    p = put_opt32(p, OPT_SERVER_ID, s_server_ip);
+    if (type != DHCP_NAK) {
+        p = put_opt32(p, OPT_SUBNET_MASK, s_netmask);
+        p = put_opt32(p, OPT_ROUTER, s_server_ip);
+        uint32_t dns = s_dns;
+        if (dns != 0) {
+            p = put_opt32(p, OPT_DNS, dns);
+        }
+    }
+    if (lease > 0) {
+        p = put_opt32(p, OPT_LEASE_TIME, lwip_htonl(lease));
+        p = put_opt32(p, OPT_T1, lwip_htonl(lease / 2));
+        p = put_opt32(p, OPT_T2, lwip_htonl(lease / 8 * 7));
+    }
+    *p++ = OPT_END;
+
+    size_t len = p - s_tx;
+    if (len < DHCP_REPLY_MIN) {
+        len = DHCP_REPLY_MIN;
+    }
+
+    struct pbuf* pb = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!pb) {
+        return;
+    }
+    pbuf_take(pb, s_tx, len);
+
+    // 续租的客户端已有地址，直接单播；其余广播，客户端此时还不能接收单播
+    uint32_t ciaddr = get32(req + BOOTP_OFF_CIADDR);
+    ip_addr_t dst = IPADDR4_INIT(type != DHCP_NAK && ciaddr != 0 ? ciaddr : IPADDR_BROADCAST);
+    udp_sendto_if(s_pcb, pb, &dst, DHCP_CLIENT_PORT, s_netif);
+    pbuf_free(pb);
+}
+
+static void notify_assigned(const uint8_t* mac, uint32_t ip)
+{
+    // 与esp_netif的dhcps一样发出事件，便于其他模块感知新客户端
+    ip_event_ap_staipassigned_t evt = { .esp_netif = s_esp_netif };
+    evt.ip.addr = ip;
+    memcpy(evt.mac, mac, 6);
+    esp_event_post(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, &evt, sizeof(evt), 0);
+}
+
+static void dhcp_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port)
+{
+    size_t len = pbuf_copy_partial(p, s_rx, sizeof(s_rx), 0);
+    pbuf_free(p);
+
+    dhcp_req_t req;
+    if (len < BOOTP_OFF_OPTIONS || s_rx[BOOTP_OFF_OP] != BOOTP_REQUEST || s_rx[BOOTP_OFF_HLEN] != 6 ||
+        get32(s_rx + BOOTP_OFF_COOKIE) != PP_HTONL(DHCP_MAGIC_COOKIE) ||
+        get32(s_rx + BOOTP_OFF_GIADDR) != 0 || !parse_options(s_rx, len, &req)) {
+        return;
+    }
+
+    const uint8_t* mac = s_rx + BOOTP_OFF_CHADDR;
+    uint32_t ciaddr = get32(s_rx + BOOTP_OFF_CIADDR);
+    uint32_t ip, lease;
+
+    switch (req.type) {
+    case DHCP_DISCOVER:
+        if (dhcp_leases_offer(mac, req.requested_ip, &ip) == ESP_OK) {
+            send_reply(s_rx, DHCP_OFFER, ip, DHCP_LEASES_TIME_S);
+        } else {
+            ESP_LOGW(TAG, "地址池已满，无法为 " MACSTR " 分配地址", MAC2STR(mac));
+        }
+        break;
+
+    case DHCP_REQUEST:
+        // 客户端选择了其他服务器
+        if (req.server_id != 0 && req.server_id != s_server_ip) {
+            dhcp_leases_release(mac);
+            break;
+        }
+        // SELECTING/INIT-REBOOT带请求地址选项，RENEWING/REBINDING使用ciaddr
+        ip = req.requested_ip ? req.requested_ip : ciaddr;
+        if (dhcp_leases_bind(mac, ip, req.hostname[0] ? req.hostname : NULL, &lease) == ESP_OK) {
+            send_reply(s_rx, DHCP_ACK, ip, lease);
+            if (ciaddr == 0) {
+                notify_assigned(mac, ip);
+            }
+        } else {
+            ESP_LOGI(TAG, "拒绝 " MACSTR " 请求的地址", MAC2STR(mac));
+            send_reply(s_rx, DHCP_NAK, 0, 0);
+        }
+        break;
+
+    case DHCP_DECLINE:
+        // 客户端用ARP发现地址已被占用，请求地址选项中是被拒绝的地址
+        if (req.server_id == 0 || req.server_id == s_server_ip) {
+            dhcp_leases_decline(mac, req.requested_ip);
+        }
+        break;
+
+    case DHCP_RELEASE:
+        dhcp_leases_release(mac);
+        break;
+
+    case DHCP_INFORM:
+        if (ciaddr != 0) {
+            send_reply(s_rx, DHCP_ACK, 0, 0);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void start_cb(void* arg)
+{
+    s_pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (!s_pcb) {
+        ESP_LOGE(TAG, "创建UDP控制块失败");
+        return;
+    }
+    ip_set_option(s_pcb, SOF_BROADCAST);
+    if (udp_bind(s_pcb, IP4_ADDR_ANY, DHCP_SERVER_PORT) != ERR_OK) {
+        ESP_LOGE(TAG, "绑定端口%d失败", DHCP_SERVER_PORT);
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+        return;
+    }
+    // 只服务AP接口，上行网络中的DHCP请求不处理
+    udp_bind_netif(s_pcb, s_netif);
+    udp_recv(s_pcb, dhcp_recv, NULL);
+}
+
+esp_err_t dhcp_server_start(esp_netif_t* ap, uint32_t dns)
+{
+    esp_netif_ip_info_t info;
+    s_netif = esp_netif_get_netif_impl(ap);
+    if (!s_netif || esp_netif_get_ip_info(ap, &info) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_esp_netif = ap;
+    s_server_ip = info.ip.addr;
+    s_netmask = info.netmask.addr;
+    s_dns = dns;
+
+    esp_err_t err = dhcp_leases_init(s_server_ip, s_netmask);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (tcpip_callback(start_cb, NULL) != ERR_OK) {
+        return ESP_FAIL;
+    }
+
+    esp_ip4_addr_t pool = { .addr = (s_server_ip & s_netmask) | PP_HTONL(DHCP_LEASES_POOL_FIRST) };
+    ESP_LOGI(TAG, "DHCP服务器已启动，地址池 " IPSTR " 起%d个", IP2STR(&pool), DHCP_LEASES_POOL_SIZE);
+    return ESP_OK;
+}
+
+void dhcp_server_set_dns(uint32_t dns)
+{
+    s_dns = dns;
+}
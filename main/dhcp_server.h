@@ -0,0 +1,16 @@
+#ifndef DHCP_SERVER_H
+#define DHCP_SERVER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// AP侧的DHCP服务器，代替esp_netif自带的dhcps，地址由dhcp_leases分配
+
+// 启动前需先停止esp_netif的dhcps并设置好AP地址；dns为下发给客户端的DNS服务器
+esp_err_t dhcp_server_start(esp_netif_t* ap, uint32_t dns);
+
+// 修改下发的DNS服务器，新的租约和续租生效
+void dhcp_server_set_dns(uint32_t dns);
+
+#endif /* DHCP_SERVER_H */
@@ -0,0 +1,721 @@
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "lwip/ip4_addr.h"
+#include "captive.h"
+#include "task_config.h"
+#include "dns_forwarder.h"
+
+// 配置
+#define TAG "DNS_FWD"
+
+#define DNS_HDR_LEN 12
+#define DNS_NAME_MAX 255
+#define DNS_KEY_MAX (DNS_NAME_MAX + 5)   // 域名 + QTYPE + QCLASS + EDNS标志
+
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_OPCODE 0x7800
+#define DNS_FLAG_AA 0x0400
+#define DNS_FLAG_TC 0x0200
+#define DNS_FLAG_RD 0x0100
+#define DNS_FLAG_RA 0x0080
+#define DNS_RCODE_MASK 0x000F
+#define DNS_RCODE_NXDOMAIN 3
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_OPT 41
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+
+// 缓存键：小写的QNAME（线格式）+ QTYPE + QCLASS + 是否带EDNS
+// 带EDNS的应答可能超过512字节，不能发给不带EDNS的客户端，因此分开缓存
+typedef struct {
+    uint8_t data[DNS_KEY_MAX];
+    uint16_t len;
+    uint16_t qtype;
+    uint16_t qclass;
+    uint16_t qend;                      // 问题段结束的偏移
+    uint32_t hash;
+} dns_key_t;
+
+// 缓存条目，data中依次存放键和应答报文
+typedef struct {
+    uint8_t* data;
+    uint16_t key_len;
+    uint16_t resp_len;
+    uint32_t hash;
+    uint32_t ttl;                       // 秒
+    int64_t stored_us;
+    uint32_t last_used;                 // LRU时钟，最小者被替换
+} cache_entry_t;
+
+typedef struct {
+    struct sockaddr_in addr;
+    uint16_t id;
+} waiter_t;
+
+// 等待上游应答的查询，相同的查询只发一次
+// 应答必须来自发出查询的套接字和上游地址，ID和问题一致
+typedef struct {
+    bool used;
+    uint16_t upstream_id;
+    uint8_t sock;                       // s_up中的下标
+    uint32_t upstream;                  // 查询发往的上游地址（网络字节序）
+    uint8_t waiters_count;
+    int64_t sent_us;
+    dns_key_t key;
+    waiter_t waiters[DNS_FORWARDER_WAITERS];
+} pending_t;
+
+// 与上游通信的套接字
+typedef struct {
+    int fd;
+    uint8_t inflight;                   // 在途查询数
+    uint16_t sent;                      // 当前端口已发出的查询数
+} up_sock_t;
+
+static const uint16_t s_lat_bounds[DNS_FORWARDER_LAT_BUCKETS - 1] = DNS_FORWARDER_LAT_BOUNDS;
+
+static int s_srv = -1;                  // 绑定在AP地址上，接收客户端查询
+static up_sock_t s_up[DNS_FORWARDER_UP_SOCKS];
+static uint32_t s_listen_addr;
+static bool s_captive;
+static volatile uint32_t s_upstream;
+static volatile bool s_flush_req;
+static volatile bool s_reset_req;
+
+// 以下只在转发任务中访问
+static cache_entry_t s_cache[DNS_FORWARDER_CACHE];
+static uint32_t s_lru_clock;
+static pending_t s_pending[DNS_FORWARDER_PENDING];
+static uint8_t s_buf[DNS_FORWARDER_MAX_MSG];
+static dns_forwarder_stats_t s_stats;
+
+static inline uint16_t get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static inline uint32_t get32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void put32(uint8_t* p, uint32_t v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v & 0xFFFF);
+}
+
+// 解析唯一的问题，生成缓存键，name得到点分形式的域名
+static bool parse_question(const uint8_t* msg, size_t len, dns_key_t* key, char* name)
+{
+    if (len < DNS_HDR_LEN || get16(msg + 4) != 1) {
+        return false;
+    }
+
+    size_t off = DNS_HDR_LEN;
+    size_t n = 0;
+    key->len = 0;
+    for (;;) {
+        if (off >= len) {
+            return false;
+        }
+        uint8_t l = msg[off];
+        if (l == 0) {
+            key->data[key->len++] = 0;
+            off++;
+            break;
+        }
+        // 问题段不应使用压缩指针；线格式域名连同结尾的根标签不超过DNS_NAME_MAX字节
+        if ((l & 0xC0) != 0 || off + 1 + l > len || key->len + 1 + l + 1 > DNS_NAME_MAX) {
+            return false;
+        }
+        key->data[key->len++] = l;
+        if (n > 0) {
+            name[n++] = '.';
+        }
+        for (size_t i = 0; i < l; i++) {
+            uint8_t c = (uint8_t)tolower(msg[off + 1 + i]);
+            key->data[key->len++] = c;
+            name[n++] = (char)c;
+        }
+        off += 1 + l;
+    }
+    name[n] = '\0';
+
+    if (off + 4 > len) {
+        return false;
+    }
+    key->qtype = get16(msg + off);
+    key->qclass = get16(msg + off + 2);
+    memcpy(key->data + key->len, msg + off, 4);
+    key->len += 4;
+    key->data[key->len++] = get16(msg + 10) > 0;
+    key->qend = off + 4;
+
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < key->len; i++) {
+        h = (h ^ key->data[i]) * 16777619u;
+    }
+    key->hash = h;
+    return true;
+}
+
+static bool key_equal(const dns_key_t* key, uint32_t hash, const uint8_t* data, uint16_t len)
+{
+    return key->hash == hash && key->len == len && memcmp(key->data, data, len) == 0;
+}
+
+// 跳过一个可能压缩的域名，出错返回0
+static size_t skip_name(const uint8_t* msg, size_t len, size_t off)
+{
+    while (off < len) {
+        uint8_t l = msg[off];
+        if (l == 0) {
+            return off + 1;
+        }
+        if ((l & 0xC0) == 0xC0) {
+            return off + 2 <= len ? off + 2 : 0;
+        }
+        if (l & 0xC0) {
+            return 0;
+        }
+        off += 1 + l;
+    }
+    return 0;
+}
+
+// 遍历应答中的资源记录：求最小TTL，并将每条记录的TTL减去elapsed秒
+static bool walk_ttls(uint8_t* msg, size_t len, uint32_t elapsed, uint32_t* min_ttl)
+{
+    if (len < DNS_HDR_LEN) {
+        return false;
+    }
+    size_t off = DNS_HDR_LEN;
+    for (uint16_t i = get16(msg + 4); i > 0; i--) {
+        off = skip_name(msg, len, off);
+        if (off == 0 || off + 4 > len) {
+            return false;
+        }
+        off += 4;
+    }
+
+    uint32_t min = UINT32_MAX;
+    uint32_t rrs = (uint32_t)get16(msg + 6) + get16(msg + 8) + get16(msg + 10);
+    for (; rrs > 0; rrs--) {
+        off = skip_name(msg, len, off);
+        if (off == 0 || off + 10 > len) {
+            return false;
+        }
+        // OPT记录的TTL字段是EDNS标志，不是时间
+        if (get16(msg + off) != DNS_TYPE_OPT) {
+            uint32_t ttl = get32(msg + off + 4);
+            if (elapsed > 0) {
+                ttl = ttl > elapsed ? ttl - elapsed : 0;
+                put32(msg + off + 4, ttl);
+            }
+            if (ttl < min) {
+                min = ttl;
+            }
+        }
+        off += 10 + get16(msg + off + 8);
+        if (off > len) {
+            return false;
+        }
+    }
+    if (min_ttl) {
+        *min_ttl = min;
+    }
+    return true;
+}
+
+static void cache_free(cache_entry_t* e)
+{
+    free(e->data);
+    e->data = NULL;
+    s_stats.cache_entries--;
+}
+
+static cache_entry_t* cache_lookup(const dns_key_t* key, int64_t now)
+{
+    for (size_t i = 0; i < DNS_FORWARDER_CACHE; i++) {
+        cache_entry_t* e = &s_cache[i];
+        if (!e->data || !key_equal(key, e->hash, e->data, e->key_len)) {
+            continue;
+        }
+        if (now - e->stored_us >= (int64_t)e->ttl * 1000000) {
+            cache_free(e);
+            return NULL;
+        }
+        e->last_used = ++s_lru_clock;
+        return e;
+    }
+    return NULL;
+}
+
+static void cache_insert(const dns_key_t* key, const uint8_t* resp, size_t len, uint32_t ttl, int64_t now)
+{
+    cache_entry_t* slot = NULL;
+    for (size_t i = 0; i < DNS_FORWARDER_CACHE; i++) {
+        cache_entry_t* e = &s_cache[i];
+        if (e->data && key_equal(key, e->hash, e->data, e->key_len)) {
+            slot = e;
+            break;
+        }
+        if (!slot || (slot->data && (!e->data || e->last_used < slot->last_used))) {
+            slot = e;
+        }
+    }
+    if (slot->data) {
+        cache_free(slot);
+    }
+
+    slot->data = malloc(key->len + len);
+    if (!slot->data) {
+        return;
+    }
+    memcpy(slot->data, key->data, key->len);
+    memcpy(slot->data + key->len, resp, len);
+    slot->key_len = key->len;
+    slot->resp_len = len;
+    slot->hash = key->hash;
+    slot->ttl = ttl;
+    slot->stored_us = now;
+    slot->last_used = ++s_lru_clock;
+    s_stats.cache_entries++;
+}
+
+static void cache_flush(void)
+{
+    for (size_t i = 0; i < DNS_FORWARDER_CACHE; i++) {
+        if (s_cache[i].data) {
+            cache_free(&s_cache[i]);
+        }
+    }
+}
+
+static void reply(const struct sockaddr_in* to, uint8_t* msg, size_t len, uint16_t id)
+{
+    put16(msg, id);
+    sendto(s_srv, msg, len, 0, (const struct sockaddr*)to, sizeof(*to));
+}
+
+// 未配置上行时，连接检测域名的A记录指向AP，其他类型返回空应答
+static void answer_local(const struct sockaddr_in* from, size_t len, const dns_key_t* key)
+{
+    uint16_t flags = get16(s_buf + 2);
+    bool has_a = key->qtype == DNS_TYPE_A || key->qtype == DNS_TYPE_ANY;
+
+    len = key->qend;
+    put16(s_buf + 2, DNS_FLAG_QR | DNS_FLAG_AA | (flags & DNS_FLAG_RD) | DNS_FLAG_RA);
+    put16(s_buf + 6, has_a ? 1 : 0);
+    put16(s_buf + 8, 0);
+    put16(s_buf + 10, 0);
+    if (has_a) {
+        uint8_t* rr = s_buf + len;
+        put16(rr, 0xC000 | DNS_HDR_LEN);    // 指向问题中的域名
+        put16(rr + 2, DNS_TYPE_A);
+        put16(rr + 4, DNS_CLASS_IN);
+        put32(rr + 6, DNS_FORWARDER_LOCAL_TTL);
+        put16(rr + 10, 4);
+        memcpy(rr + 12, &s_listen_addr, 4);
+        len += 16;
+    }
+    sendto(s_srv, s_buf, len, 0, (const struct sockaddr*)from, sizeof(*from));
+    s_stats.local++;
+}
+
+// 创建套接字并绑定随机源端口，端口都被占用时由lwIP分配
+static bool up_open(up_sock_t* u)
+{
+    u->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (u->fd < 0) {
+        return false;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    for (int attempt = 0; attempt <= 8; attempt++) {
+        uint16_t port = attempt < 8 ? DNS_FORWARDER_PORT_MIN + esp_random() % (65536 - DNS_FORWARDER_PORT_MIN) : 0;
+        addr.sin_port = htons(port);
+        if (bind(u->fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            u->inflight = 0;
+            u->sent = 0;
+            return true;
+        }
+    }
+    close(u->fd);
+    u->fd = -1;
+    return false;
+}
+
+static void up_close(up_sock_t* u)
+{
+    if (u->fd >= 0) {
+        close(u->fd);
+        u->fd = -1;
+    }
+}
+
+// 端口用满且没有在途查询时换新端口
+static void up_rotate(up_sock_t* u)
+{
+    if (u->fd >= 0 && u->inflight == 0 && u->sent >= DNS_FORWARDER_PORT_QUERIES) {
+        up_close(u);
+        if (!up_open(u)) {
+            ESP_LOGW(TAG, "重新绑定上游套接字失败");
+        }
+    }
+}
+
+// 随机选一个可用的上游套接字，都不可用时返回-1
+static int up_pick(void)
+{
+    uint32_t start = esp_random() % DNS_FORWARDER_UP_SOCKS;
+    for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+        int k = (start + i) % DNS_FORWARDER_UP_SOCKS;
+        if (s_up[k].fd >= 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static pending_t* pending_alloc(void)
+{
+    for (size_t i = 0; i < DNS_FORWARDER_PENDING; i++) {
+        if (!s_pending[i].used) {
+            return &s_pending[i];
+        }
+    }
+    return NULL;
+}
+
+static bool upstream_id_used(uint16_t id)
+{
+    for (size_t i = 0; i < DNS_FORWARDER_PENDING; i++) {
+        if (s_pending[i].used && s_pending[i].upstream_id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void handle_query(void)
+{
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    int len = recvfrom(s_srv, s_buf, sizeof(s_buf), 0, (struct sockaddr*)&from, &from_len);
+    if (len < DNS_HDR_LEN) {
+        return;
+    }
+    s_stats.queries++;
+
+    dns_key_t key;
+    char name[DNS_NAME_MAX + 1];
+    uint16_t flags = get16(s_buf + 2);
+    if ((flags & (DNS_FLAG_QR | DNS_FLAG_OPCODE)) != 0 || !parse_question(s_buf, len, &key, name)) {
+        s_stats.dropped++;
+        return;
+    }
+    uint16_t id = get16(s_buf);
+
+    if (s_captive && key.qclass == DNS_CLASS_IN && captive_is_probe_host(name)) {
+        answer_local(&from, len, &key);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    cache_entry_t* e = cache_lookup(&key, now);
+    if (e) {
+        // 报文缓冲区此时已不再需要查询内容，直接用来组装应答
+        memcpy(s_buf, e->data + e->key_len, e->resp_len);
+        walk_ttls(s_buf, e->resp_len, (uint32_t)((now - e->stored_us) / 1000000), NULL);
+        reply(&from, s_buf, e->resp_len, id);
+        s_stats.hits++;
+        return;
+    }
+
+    // 相同的查询已在途，等待同一个上游应答
+    for (size_t i = 0; i < DNS_FORWARDER_PENDING; i++) {
+        pending_t* p = &s_pending[i];
+        if (p->used && key_equal(&key, p->key.hash, p->key.data, p->key.len)) {
+            if (p->waiters_count < DNS_FORWARDER_WAITERS) {
+                p->waiters[p->waiters_count].addr = from;
+                p->waiters[p->waiters_count].id = id;
+                p->waiters_count++;
+                s_stats.coalesced++;
+            } else {
+                s_stats.dropped++;
+            }
+            return;
+        }
+    }
+
+    uint32_t upstream = s_upstream;
+    pending_t* p = pending_alloc();
+    int sock = up_pick();
+    if (!p || upstream == 0 || sock < 0) {
+        s_stats.dropped++;
+        return;
+    }
+
+    uint16_t upstream_id;
+    do {
+        upstream_id = esp_random() & 0xFFFF;
+    } while (upstream_id_used(upstream_id));
+
+    p->used = true;
+    p->upstream_id = upstream_id;
+    p->sock = (uint8_t)sock;
+    p->upstream = upstream;
+    p->waiters_count = 1;
+    p->waiters[0].addr = from;
+    p->waiters[0].id = id;
+    p->sent_us = now;
+    memcpy(&p->key, &key, sizeof(key));
+
+    struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_FORWARDER_PORT),
+        .sin_addr.s_addr = upstream,
+    };
+    put16(s_buf, upstream_id);
+    sendto(s_up[sock].fd, s_buf, len, 0, (struct sockaddr*)&to, sizeof(to));
+    s_up[sock].inflight++;
+    s_up[sock].sent++;
+    s_stats.misses++;
+}
+
+static void record_latency(int64_t us)
+{
+    uint32_t ms = us / 1000;
+    size_t i = 0;
+    while (i < DNS_FORWARDER_LAT_BUCKETS - 1 && ms > s_lat_bounds[i]) {
+        i++;
+    }
+    s_stats.latency[i]++;
+}
+
+// 查询结束（收到应答或超时），释放在途表项
+static void pending_done(pending_t* p)
+{
+    up_sock_t* u = &s_up[p->sock];
+    p->used = false;
+    if (u->inflight > 0) {
+        u->inflight--;
+    }
+    up_rotate(u);
+}
+
+static void handle_reply(int sock)
+{
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    int len = recvfrom(s_up[sock].fd, s_buf, sizeof(s_buf), 0, (struct sockaddr*)&from, &from_len);
+    if (len < DNS_HDR_LEN || from.sin_port != htons(DNS_FORWARDER_PORT)) {
+        return;
+    }
+
+    dns_key_t key;
+    char name[DNS_NAME_MAX + 1];
+    if (!parse_question(s_buf, len, &key, name)) {
+        return;
+    }
+
+    // 来源、套接字、ID和问题都要与在途查询一致；上游可能去掉OPT记录，比较时不含EDNS标志
+    uint16_t id = get16(s_buf);
+    pending_t* p = NULL;
+    for (size_t i = 0; i < DNS_FORWARDER_PENDING; i++) {
+        pending_t* q = &s_pending[i];
+        if (q->used && q->sock == sock && q->upstream == from.sin_addr.s_addr &&
+            q->upstream_id == id && q->key.len == key.len &&
+            memcmp(q->key.data, key.data, key.len - 1) == 0) {
+            p = q;
+            break;
+        }
+    }
+    if (!p) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    record_latency(now - p->sent_us);
+
+    uint16_t flags = get16(s_buf + 2);
+    uint16_t rcode = flags & DNS_RCODE_MASK;
+    uint32_t ttl;
+    if (!(flags & DNS_FLAG_TC) && (rcode == 0 || rcode == DNS_RCODE_NXDOMAIN) &&
+        get16(s_buf + 6) + get16(s_buf + 8) > 0 && walk_ttls(s_buf, len, 0, &ttl) && ttl > 0) {
+        cache_insert(&p->key, s_buf, len, MIN(ttl, DNS_FORWARDER_MAX_TTL), now);
+    }
+
+    for (size_t i = 0; i < p->waiters_count; i++) {
+        reply(&p->waiters[i].addr, s_buf, len, p->waiters[i].id);
+    }
+    pending_done(p);
+}
+
+static void expire_pending(int64_t now)
+{
+    for (size_t i = 0; i < DNS_FORWARDER_PENDING; i++) {
+        pending_t* p = &s_pending[i];
+        if (p->used && now - p->sent_us > DNS_FORWARDER_TIMEOUT_MS * 1000LL) {
+            pending_done(p);
+            s_stats.timeouts++;
+        }
+    }
+}
+
+static void dns_forwarder_task(void* arg)
+{
+    for (;;) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(s_srv, &fds);
+        int max_fd = s_srv;
+        for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+            if (s_up[i].fd >= 0) {
+                FD_SET(s_up[i].fd, &fds);
+                max_fd = MAX(max_fd, s_up[i].fd);
+            }
+        }
+        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+        int n = select(max_fd + 1, &fds, NULL, NULL, &tv);
+
+        if (s_flush_req) {
+            s_flush_req = false;
+            cache_flush();
+        }
+        if (s_reset_req) {
+            s_reset_req = false;
+            uint32_t entries = s_stats.cache_entries;
+            memset(&s_stats, 0, sizeof(s_stats));
+            s_stats.cache_entries = entries;
+        }
+
+        if (n > 0) {
+            if (FD_ISSET(s_srv, &fds)) {
+                handle_query();
+            }
+            for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+                if (s_up[i].fd >= 0 && FD_ISSET(s_up[i].fd, &fds)) {
+                    handle_reply(i);
+                }
+            }
+        }
+        expire_pending(esp_timer_get_time());
+
+        // 换端口时未能重新绑定的套接字
+        for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+            if (s_up[i].fd < 0) {
+                up_open(&s_up[i]);
+            }
+        }
+    }
+}
+
+esp_err_t dns_forwarder_start(uint32_t listen_addr, bool captive)
+{
+    if (s_srv >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+        s_up[i].fd = -1;
+    }
+
+    s_srv = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s_srv < 0) {
+        ESP_LOGE(TAG, "创建套接字失败");
+        goto fail;
+    }
+    int up_count = 0;
+    for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+        up_count += up_open(&s_up[i]);
+    }
+    if (up_count == 0) {
+        ESP_LOGE(TAG, "创建上游套接字失败");
+        goto fail;
+    } else if (up_count < DNS_FORWARDER_UP_SOCKS) {
+        ESP_LOGW(TAG, "只创建了%d个上游套接字", up_count);
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_FORWARDER_PORT),
+        .sin_addr.s_addr = listen_addr,
+    };
+    if (bind(s_srv, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "绑定端口%d失败", DNS_FORWARDER_PORT);
+        goto fail;
+    }
+
+    s_listen_addr = listen_addr;
+    s_captive = captive;
+
+    const task_placement_t* placement = task_config_get(TASK_DNS);
+    BaseType_t core = placement->core < 0 ? tskNO_AFFINITY : placement->core;
+    if (xTaskCreatePinnedToCore(dns_forwarder_task, "dns_fwd", placement->stack,
+                                NULL, placement->priority, NULL, core) != pdPASS) {
+        ESP_LOGE(TAG, "创建DNS转发任务失败");
+        goto fail;
+    }
+
+    ip4_addr_t ip = { .addr = listen_addr };
+    ESP_LOGI(TAG, "DNS转发器监听 " IPSTR ":%d，缓存%d条%s", IP2STR(&ip), DNS_FORWARDER_PORT,
+             DNS_FORWARDER_CACHE, captive ? "，未配置上行，检测域名指向本机" : "");
+    return ESP_OK;
+
+fail:
+    if (s_srv >= 0) {
+        close(s_srv);
+        s_srv = -1;
+    }
+    for (int i = 0; i < DNS_FORWARDER_UP_SOCKS; i++) {
+        up_close(&s_up[i]);
+    }
+    return ESP_FAIL;
+}
+
+void dns_forwarder_set_upstream(uint32_t addr)
+{
+    if (addr != s_upstream) {
+        // 上游变化后旧的缓存未必适用
+        s_upstream = addr;
+        s_flush_req = true;
+    }
+}
+
+void dns_forwarder_flush(void)
+{
+    s_flush_req = true;
+}
+
+void dns_forwarder_reset_stats(void)
+{
+    s_reset_req = true;
+}
+
+void dns_forwarder_get_stats(dns_forwarder_stats_t* out)
+{
+    memcpy(out, &s_stats, sizeof(*out));
+    out->running = s_srv >= 0;
+    out->upstream = s_upstream;
+}
@@ -0,0 +1,57 @@
+#ifndef DNS_FORWARDER_H
+#define DNS_FORWARDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// 转发器配置
+// 关闭CONFIG_DNS_FORWARDER时模块照常编译，只是不启动
+#ifdef CONFIG_DNS_FORWARDER
+#define DNS_FORWARDER_CACHE CONFIG_DNS_FORWARDER_CACHE
+#else
+#define DNS_FORWARDER_CACHE 1
+#endif
+#define DNS_FORWARDER_PORT 53
+#define DNS_FORWARDER_MAX_MSG 1232          // EDNS建议的UDP报文上限
+#define DNS_FORWARDER_PENDING 8             // 同时等待上游应答的查询
+#define DNS_FORWARDER_UP_SOCKS 4            // 与上游通信的套接字，各绑定一个随机源端口，查询随机选用
+#define DNS_FORWARDER_PORT_QUERIES 32       // 一个源端口发出这么多查询后，空闲时换新端口
+#define DNS_FORWARDER_PORT_MIN 49152        // 随机源端口范围（IANA动态端口）
+#define DNS_FORWARDER_WAITERS 4             // 每个查询合并的客户端请求数
+#define DNS_FORWARDER_TIMEOUT_MS 3000       // 上游未应答的查询在此之后丢弃，由客户端重试
+#define DNS_FORWARDER_MAX_TTL 3600          // 缓存时间上限（秒）
+#define DNS_FORWARDER_LOCAL_TTL 10          // 本地应答的TTL（秒）
+#define DNS_FORWARDER_LAT_BUCKETS 8
+
+// 上游延迟直方图各桶的上限（毫秒），最后一桶为超出部分
+#define DNS_FORWARDER_LAT_BOUNDS { 5, 10, 20, 50, 100, 200, 500 }
+
+typedef struct {
+    bool running;
+    uint32_t upstream;                      // 上游DNS地址（网络字节序）
+    uint32_t queries;                       // 收到的客户端查询
+    uint32_t hits;                          // 缓存命中
+    uint32_t misses;                        // 转发到上游
+    uint32_t coalesced;                     // 合并到已在途查询的请求
+    uint32_t local;                         // 本地应答的强制门户域名
+    uint32_t timeouts;                      // 上游超时
+    uint32_t dropped;                       // 格式错误或在途表已满
+    uint32_t cache_entries;
+    uint32_t latency[DNS_FORWARDER_LAT_BUCKETS];
+} dns_forwarder_stats_t;
+
+// 在AP地址上启动转发任务；captive为true时连接检测域名解析到AP地址
+esp_err_t dns_forwarder_start(uint32_t listen_addr, bool captive);
+
+// 上行获取到DNS服务器后调用，地址为网络字节序
+void dns_forwarder_set_upstream(uint32_t addr);
+
+// 清空缓存和计数，可在任意任务中调用（由转发任务执行）
+void dns_forwarder_flush(void);
+void dns_forwarder_reset_stats(void);
+
+void dns_forwarder_get_stats(dns_forwarder_stats_t* out);
+
+#endif /* DNS_FORWARDER_H */
@@ -9,7 +9,6 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <pthread.h>
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_console.h"
@@ -46,51 +45,38 @@
 
 
 #include "router_globals.h"
+#include "portmap.h"
+#include "napt_hook.h"
+#include "napt_stats.h"
+#include "napt_config.h"
+#include "task_config.h"
+#include "status_ui.h"
+#include "dns_forwarder.h"
+#include "dhcp_server.h"
+#include "dhcp_leases.h"
+#include "link_manager.h"
+#include "uplinks.h"
+#include "channel_plan.h"
+#include "shaper.h"
 #include "fm_transmitter.h"
 #include "midi_player.h"
-
-// On board LED
-#if defined(CONFIG_IDF_TARGET_ESP32S3)
-#define BLINK_GPIO 44
-#else
-#define BLINK_GPIO 2
+#include "audio_pipeline.h"
+#include "audio_resampler.h"
+#ifdef CONFIG_FM_RDS
+#include "fm_rds.h"
 #endif
 
 static const char *TAG = "ESP32 NAT router";
 
-// FM音频输出任务
-#define FM_AUDIO_TASK_STACK_SIZE 4096
-#define FM_AUDIO_TASK_PRIORITY 6
-
-static TaskHandle_t fm_audio_task_handle = NULL;
-
-// FM音频输出任务函数
-static void fm_audio_task(void* arg)
-{
-    ESP_LOGI(TAG, "FM音频输出任务已启动");
-    
-    // 音频样本输出间隔
-    const int sample_delay = 1000 / MIDI_SAMPLE_RATE;
-    
-    while (1) {
-        // 获取当前MIDI音频样本
-        uint8_t audio_sample = midi_player_get_current_sample();
-        
-        // 发送音频样本到FM发射器
-        fm_transmitter_send_sample(audio_sample);
-        
-        // 延迟以达到采样率
-        vTaskDelay(sample_delay / portTICK_PERIOD_MS);
-    }
-}
-
-// BOOT button GPIO (usually GPIO0 on most ESP32 boards)
-#define BOOT_BUTTON_GPIO 0
-#define BUTTON_PRESS_TIME_MS 5000  // 5 seconds
-
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t wifi_event_group;
 
+/* Converts the synth rate to the FM modulation rate */
+static audio_resampler_t audio_resampler;
+#ifdef CONFIG_FM_STEREO
+static fm_mpx_t fm_mpx;
+#endif
+
 /* The event group allows multiple bits for each event, but we only care about one event
  * - are we connected to the AP with an IP? */
 const int WIFI_CONNECTED_BIT = BIT0;
@@ -106,15 +92,6 @@ bool has_static_ip = false;
 uint32_t my_ip;
 uint32_t my_ap_ip;
 
-struct portmap_table_entry {
-  u32_t daddr;
-  u16_t mport;
-  u16_t dport;
-  u8_t proto;
-  u8_t valid;
-};
-struct portmap_table_entry portmap_tab[IP_PORTMAP_MAX];
-
 esp_netif_t* wifiAP;
 esp_netif_t* wifiSTA;
 
@@ -186,120 +163,29 @@ static void factory_reset(void)
     esp_restart();
 }
 
-esp_err_t apply_portmap_tab() {
-    for (int i = 0; i<IP_PORTMAP_MAX; i++) {
-        if (portmap_tab[i].valid) {
-            ip_portmap_add(portmap_tab[i].proto, my_ip, portmap_tab[i].mport, portmap_tab[i].daddr, portmap_tab[i].dport);
-        }
-    }
-    return ESP_OK;
-}
-
-esp_err_t delete_portmap_tab() {
-    for (int i = 0; i<IP_PORTMAP_MAX; i++) {
-        if (portmap_tab[i].valid) {
-            ip_portmap_remove(portmap_tab[i].proto, portmap_tab[i].mport);
-        }
-    }
-    return ESP_OK;
-}
-
 void print_portmap_tab() {
-    for (int i = 0; i<IP_PORTMAP_MAX; i++) {
-        if (portmap_tab[i].valid) {
-            printf ("%s", portmap_tab[i].proto == PROTO_TCP?"TCP ":"UDP ");
-            ip4_addr_t addr;
-            addr.addr = my_ip;
-            printf (IPSTR":%d -> ", IP2STR(&addr), portmap_tab[i].mport);
-            addr.addr = portmap_tab[i].daddr;
-            printf (IPSTR":%d\n", IP2STR(&addr), portmap_tab[i].dport);
-        }
-    }
-}
-
-esp_err_t get_portmap_tab() {
-    esp_err_t err;
-    nvs_handle_t nvs;
-    size_t len;
-
-    err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = nvs_get_blob(nvs, "portmap_tab", NULL, &len);
-    if (err == ESP_OK) {
-        if (len != sizeof(portmap_tab)) {
-            err = ESP_ERR_NVS_INVALID_LENGTH;
-        } else {
-            err = nvs_get_blob(nvs, "portmap_tab", portmap_tab, &len);
-            if (err != ESP_OK) {
-                memset(portmap_tab, 0, sizeof(portmap_tab));
-            }
-        }
-    }
-    nvs_close(nvs);
-
-    return err;
+    portmap_print();
 }
 
 esp_err_t add_portmap(u8_t proto, u16_t mport, u32_t daddr, u16_t dport) {
-    esp_err_t err;
-    nvs_handle_t nvs;
-
-    for (int i = 0; i<IP_PORTMAP_MAX; i++) {
-        if (!portmap_tab[i].valid) {
-            portmap_tab[i].proto = proto;
-            portmap_tab[i].mport = mport;
-            portmap_tab[i].daddr = daddr;
-            portmap_tab[i].dport = dport;
-            portmap_tab[i].valid = 1;
-
-            err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
-            if (err != ESP_OK) {
-                return err;
-            }
-            err = nvs_set_blob(nvs, "portmap_tab", portmap_tab, sizeof(portmap_tab));
-            if (err == ESP_OK) {
-                err = nvs_commit(nvs);
-                if (err == ESP_OK) {
-                    ESP_LOGI(TAG, "New portmap table stored.");
-                }
-            }
-            nvs_close(nvs);
-
-            ip_portmap_add(proto, my_ip, mport, daddr, dport);
+    return portmap_add(proto, mport, daddr, dport);
+}
 
-            return ESP_OK;
-        }
-    }
-    return ESP_ERR_NO_MEM;
+esp_err_t add_portmap_range(u8_t proto, u16_t mport, u16_t count, u32_t daddr, u16_t dport) {
+    return portmap_add_range(proto, mport, count, daddr, dport);
 }
 
 esp_err_t del_portmap(u8_t proto, u16_t mport) {
-    esp_err_t err;
-    nvs_handle_t nvs;
-
-    for (int i = 0; i<IP_PORTMAP_MAX; i++) {
-        if (portmap_tab[i].valid && portmap_tab[i].mport == mport && portmap_tab[i].proto == proto) {
-            portmap_tab[i].valid = 0;
-
-            err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
-            if (err != ESP_OK) {
-                return err;
-            }
-            err = nvs_set_blob(nvs, "portmap_tab", portmap_tab, sizeof(portmap_tab));
-            if (err == ESP_OK) {
-                err = nvs_commit(nvs);
-                if (err == ESP_OK) {
-                    ESP_LOGI(TAG, "New portmap table stored.");
-                }
-            }
-            nvs_close(nvs);
+    return portmap_del(proto, mport);
+}
 
-            ip_portmap_remove(proto, mport);
-            return ESP_OK;
-        }
+// 端口映射目标可以是IP地址，也可以是客户端MAC：按MAC时保留其地址，DHCP重新分配后映射仍然有效
+esp_err_t resolve_portmap_target(const char* target, u32_t* daddr) {
+    uint8_t mac[6];
+    if (dhcp_leases_parse_mac(target, mac)) {
+        return dhcp_leases_pin(mac, daddr);
     }
+    *daddr = esp_ip4addr_aton(target);
     return ESP_OK;
 }
 
@@ -397,106 +283,17 @@ static void initialize_console(void)
 #endif
 }
 
-void * led_status_thread(void * p)
-{
-    gpio_reset_pin(BLINK_GPIO);
-    gpio_set_direction(BLINK_GPIO, GPIO_MODE_OUTPUT);
-
-    while (true)
-    {
-        gpio_set_level(BLINK_GPIO, ap_connect);
-
-        for (int i = 0; i < connect_count; i++)
-        {
-            gpio_set_level(BLINK_GPIO, 1 - ap_connect);
-            vTaskDelay(50 / portTICK_PERIOD_MS);
-            gpio_set_level(BLINK_GPIO, ap_connect);
-            vTaskDelay(50 / portTICK_PERIOD_MS);
-        }
-
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
-}
-
-/* BOOT按钮监控任务 */
-void * boot_button_monitor_thread(void * p)
-{
-    // 配置BOOT按钮GPIO
-    gpio_reset_pin(BOOT_BUTTON_GPIO);
-    gpio_set_direction(BOOT_BUTTON_GPIO, GPIO_MODE_INPUT);
-    gpio_set_pull_mode(BOOT_BUTTON_GPIO, GPIO_PULLUP_ONLY);
-
-    ESP_LOGI(TAG, "BOOT button monitor started on GPIO%d", BOOT_BUTTON_GPIO);
-
-    while (true) {
-        // 检测按钮按下（低电平）
-        if (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
-            ESP_LOGI(TAG, "BOOT button pressed, starting timer...");
-
-            uint32_t press_start_time = xTaskGetTickCount();
-            bool led_state = false;
-            uint32_t last_led_toggle = press_start_time;
-
-            // 按钮按下期间，LED快速闪烁提示
-            while (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
-                uint32_t current_time = xTaskGetTickCount();
-                uint32_t press_duration = (current_time - press_start_time) * portTICK_PERIOD_MS;
-
-                // LED每100ms闪烁一次
-                if ((current_time - last_led_toggle) * portTICK_PERIOD_MS >= 100) {
-                    led_state = !led_state;
-                    gpio_set_level(BLINK_GPIO, led_state);
-                    last_led_toggle = current_time;
-                }
-
-                // 检查是否达到5秒
-                if (press_duration >= BUTTON_PRESS_TIME_MS) {
-                    ESP_LOGI(TAG, "BOOT button held for %ld ms, initiating factory reset!", press_duration);
-
-                    // LED常亮2秒表示即将重置
-                    gpio_set_level(BLINK_GPIO, 1);
-                    vTaskDelay(2000 / portTICK_PERIOD_MS);
-
-                    // 执行出厂重置
-                    factory_reset();
-                    return NULL; // 不会执行到这里，因为会重启
-                }
-
-                vTaskDelay(10 / portTICK_PERIOD_MS); // 10ms检查间隔
-            }
-
-            // 按钮释放，恢复LED正常状态
-            uint32_t final_press_duration = (xTaskGetTickCount() - press_start_time) * portTICK_PERIOD_MS;
-            ESP_LOGI(TAG, "BOOT button released after %ld ms", final_press_duration);
-
-            // 如果按下时间不足5秒，LED闪烁2次表示取消
-            if (final_press_duration < BUTTON_PRESS_TIME_MS) {
-                for (int i = 0; i < 4; i++) {
-                    gpio_set_level(BLINK_GPIO, i % 2);
-                    vTaskDelay(150 / portTICK_PERIOD_MS);
-                }
-            }
-        }
-
-        vTaskDelay(50 / portTICK_PERIOD_MS); // 50ms检查间隔
-    }
-}
-
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     esp_netif_dns_info_t dns;
 
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
-    {
-        esp_wifi_connect();
-    }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    // STA的连接和重连由link_manager负责
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
-        ESP_LOGI(TAG,"disconnected - retry to connect to the AP");
+        ESP_LOGI(TAG,"disconnected from the AP");
         ap_connect = false;
-        esp_wifi_connect();
-        ESP_LOGI(TAG, "retry to connect to the AP");
+        status_ui_update();
         xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
@@ -504,13 +301,19 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
         ap_connect = true;
+        status_ui_update();
         my_ip = event->ip_info.ip.addr;
-        delete_portmap_tab();
-        apply_portmap_tab();
-        if (esp_netif_get_dns_info(wifiSTA, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK)
+        portmap_apply(my_ip);
+        if (esp_netif_get_dns_info(wifiSTA, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK && dns.ip.u_addr.ip4.addr != 0)
         {
-            esp_netif_set_dns_info(wifiAP, ESP_NETIF_DNS_MAIN, &dns);
+#ifdef CONFIG_DNS_FORWARDER
+            // 客户端的DNS仍指向本机，由转发器使用上行的DNS
+            dns_forwarder_set_upstream(dns.ip.u_addr.ip4.addr);
+            ESP_LOGI(TAG, "set upstream dns to:" IPSTR, IP2STR(&(dns.ip.u_addr.ip4)));
+#else
+            dhcp_server_set_dns(dns.ip.u_addr.ip4.addr);
             ESP_LOGI(TAG, "set dns to:" IPSTR, IP2STR(&(dns.ip.u_addr.ip4)));
+#endif
         }
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
     }
@@ -537,11 +340,19 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     {
         connect_count++;
         ESP_LOGI(TAG,"%d. station connected", connect_count);
+        status_ui_update();
+#ifdef CONFIG_FM_RDS
+        fm_rds_update_router_state(ap_ssid, connect_count);
+#endif
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STADISCONNECTED)
     {
         connect_count--;
         ESP_LOGI(TAG,"station disconnected - %d remain", connect_count);
+        status_ui_update();
+#ifdef CONFIG_FM_RDS
+        fm_rds_update_router_state(ap_ssid, connect_count);
+#endif
     }
 }
 
@@ -551,12 +362,14 @@ const int CONNECTED_BIT = BIT0;
 
 void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, const char* ent_identity, const char* passwd, const char* static_ip, const char* subnet_mask, const char* gateway_addr, const uint8_t* ap_mac, const char* ap_ssid, const char* ap_passwd, const char* ap_ip)
 {
-    esp_netif_dns_info_t dnsserver;
+    uint32_t dhcp_dns;
     // esp_netif_dns_info_t dnsinfo;
 
     wifi_event_group = xEventGroupCreate();
   
     esp_netif_init();
+    // NAPT表需要在第一次添加端口映射或启用NAPT之前按配置分配
+    napt_config_apply();
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     wifiAP = esp_netif_create_default_wifi_ap();
     wifiSTA = esp_netif_create_default_wifi_sta();
@@ -569,7 +382,7 @@ void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, c
         ipInfo_sta.netmask.addr = esp_ip4addr_aton(subnet_mask);
         esp_netif_dhcpc_stop(wifiSTA); // Don't run a DHCP client
         esp_netif_set_ip_info(wifiSTA, &ipInfo_sta);
-        apply_portmap_tab();
+        portmap_apply(my_ip);
     }
 
     my_ap_ip = esp_ip4addr_aton(ap_ip);
@@ -580,9 +393,7 @@ void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, c
     esp_netif_set_ip4_addr(&ipInfo_ap.netmask, 255,255,255,0);
     esp_netif_dhcps_stop(wifiAP); // stop before setting ip WifiAP
     esp_netif_set_ip_info(wifiAP, &ipInfo_ap);
-    
-    // 启用IPv6支持
-    esp_netif_dhcps_start(wifiAP);
+    // AP侧的DHCP由dhcp_server接管，在下面确定DNS后启动
     
     // IPv6配置暂时注释，等待进一步确认支持情况
     // 为AP接口启用IPv6
@@ -652,6 +463,10 @@ void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, c
         if (mac != NULL) {
             ESP_ERROR_CHECK(esp_wifi_set_mac(ESP_IF_WIFI_STA, mac));
         }
+        // 断线后退避重连，并记录断线原因和重连用时
+        ESP_ERROR_CHECK(link_manager_init());
+        // 主上行之外的备用上行，断线或有更好的上行时切换
+        ESP_ERROR_CHECK(uplinks_init(wifiSTA, has_static_ip ? &ipInfo_sta : NULL));
     } else {
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP) );
     }
@@ -663,12 +478,16 @@ void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, c
     }
 
 
-    // DNS服务由LWIP DHCP服务器自动处理 (CONFIG_LWIP_DHCPS_ADD_DNS=y)
-
-    // // Set custom dns server address for dhcp server
-    dnsserver.ip.u_addr.ip4.addr = esp_ip4addr_aton(DEFAULT_DNS);
-    dnsserver.ip.type = ESP_IPADDR_TYPE_V4;
-    esp_netif_set_dns_info(wifiAP, ESP_NETIF_DNS_MAIN, &dnsserver);
+    // Set custom dns server address for dhcp server
+#ifdef CONFIG_DNS_FORWARDER
+    // 客户端使用本机的DNS转发器，上行获取到DNS之前转发到默认DNS
+    dns_forwarder_set_upstream(esp_ip4addr_aton(DEFAULT_DNS));
+    dhcp_dns = my_ap_ip;
+#else
+    dhcp_dns = esp_ip4addr_aton(DEFAULT_DNS);
+#endif
+    // 租约表持久化到NVS，保留地址的客户端重连后地址不变，端口映射随之有效
+    ESP_ERROR_CHECK(dhcp_server_start(wifiAP, dhcp_dns));
 
     // esp_netif_get_dns_info(ESP_IF_WIFI_AP, ESP_NETIF_DNS_MAIN, &dnsinfo);
     // ESP_LOGI(TAG, "DNS IP:" IPSTR, IP2STR(&dnsinfo.ip.u_addr.ip4));
@@ -676,9 +495,26 @@ void wifi_init(const uint8_t* mac, const char* ssid, const char* ent_username, c
     xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT,
         pdFALSE, pdTRUE, JOIN_TIMEOUT_MS / portTICK_PERIOD_MS);
     ESP_ERROR_CHECK(esp_wifi_start());
+
+    // 端口区间映射在收包路径上匹配，同时统计各客户端流量
+    napt_stats_init(my_ap_ip, ipInfo_ap.netmask.addr);
+    napt_hook_install(wifiSTA, wifiAP);
+#ifdef CONFIG_CLIENT_SHAPER
+    // 按客户端限速，各客户端的队列轮流发送，单个客户端的大流量不拖慢其他客户端
+    shaper_init(my_ap_ip, ipInfo_ap.netmask.addr);
+#endif
+#ifdef CONFIG_DNS_FORWARDER
+    // 未配置上行时，连接检测域名解析到本机以弹出配网页面
+    dns_forwarder_start(my_ap_ip, strlen(ssid) == 0);
+#endif
     
+#ifdef CONFIG_CHANNEL_PLAN
+    // 按扫描结果选择AP信道，40MHz与邻居重叠时退回20MHz；连接上游时跟随上游信道
+    ESP_ERROR_CHECK(channel_plan_init(strlen(ssid) == 0));
+#else
     // 设置WiFi带宽为40MHz
     ESP_ERROR_CHECK(esp_wifi_set_bandwidth(WIFI_IF_AP, WIFI_BW_HT40));
+#endif
 
     if (strlen(ssid) > 0) {
         ESP_LOGI(TAG, "wifi_init_apsta finished.");
@@ -792,14 +628,15 @@ void app_main(void)
         ap_ip = param_set_default(DEFAULT_AP_IP);
     }
 
-    get_portmap_tab();
+    portmap_init();
+    task_config_init();
 
     // Setup WIFI
     wifi_init(mac, ssid, ent_username, ent_identity, passwd, static_ip, subnet_mask, gateway_addr, ap_mac, ap_ssid, ap_passwd, ap_ip);
 
-    pthread_t t1, t2;
-    pthread_create(&t1, NULL, led_status_thread, NULL);
-    pthread_create(&t2, NULL, boot_button_monitor_thread, NULL);
+    if (status_ui_init(factory_reset) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start LED/button handling");
+    }
 
     ip_napt_enable(my_ap_ip, 1);
     ESP_LOGI(TAG, "NAT is enabled");
@@ -822,6 +659,9 @@ void app_main(void)
     register_system();
     register_nvs();
     register_router();
+    register_audio();
+    register_net();
+    register_tasks();
 
     /* Prompt to be printed before each line.
      * This can be customized, made dynamic, etc.
@@ -836,7 +676,7 @@ void app_main(void)
     }
     
     // 初始化MIDI播放器
-    if (midi_player_init() != ESP_OK) {
+    if (midi_player_init(MIDI_SAMPLE_RATE) != ESP_OK) {
         ESP_LOGE(TAG, "MIDI播放器初始化失败");
     } else {
         ESP_LOGI(TAG, "MIDI播放器初始化成功");
@@ -857,12 +697,41 @@ void app_main(void)
         ESP_LOGI(TAG, "开始播放MIDI文件: %s", midi_file_path);
     }
     
-    // 创建FM音频输出任务
-    if (xTaskCreate(fm_audio_task, "fm_audio_task", FM_AUDIO_TASK_STACK_SIZE, 
-                    NULL, FM_AUDIO_TASK_PRIORITY, &fm_audio_task_handle) != pdPASS) {
-        ESP_LOGE(TAG, "创建FM音频输出任务失败");
+    // 启动块渲染音频管线
+    // 合成器按MIDI_SAMPLE_RATE渲染，经重采样后按调制速率输出
+    audio_pipeline_config_t audio_cfg = AUDIO_PIPELINE_DEFAULT_CONFIG();
+    audio_cfg.sample_rate = FM_MOD_RATE_HZ;
+    audio_cfg.task_core = task_config_get(TASK_AUDIO)->core;
+    audio_cfg.task_priority = task_config_get(TASK_AUDIO)->priority;
+    audio_cfg.task_stack = task_config_get(TASK_AUDIO)->stack;
+    audio_cfg.sink = fm_transmitter_apply_sdm;
+#ifdef CONFIG_FM_STEREO
+    // 立体声：合成器 -> 重采样 -> 左右处理链和MPX编码，复合信号原样交给中断
+    audio_cfg.render = fm_mpx_render;
+    audio_cfg.convert = NULL;
+    audio_cfg.ctx = &fm_mpx;
+    esp_err_t audio_err = audio_resampler_init(&audio_resampler, MIDI_SAMPLE_RATE, FM_MOD_RATE_HZ, 2,
+                                               FM_MPX_CHUNK, midi_player_render_stereo, NULL);
+    if (audio_err == ESP_OK) {
+        audio_err = fm_mpx_init(&fm_mpx, audio_pipeline_actual_rate_mhz(FM_MOD_RATE_HZ),
+                                audio_resampler_render, &audio_resampler);
+    }
+#ifdef CONFIG_FM_RDS
+    fm_rds_update_router_state(ap_ssid, connect_count);
+#endif
+#else
+    audio_cfg.render = audio_resampler_render;
+    audio_cfg.convert = fm_transmitter_encode_block;
+    audio_cfg.ctx = &audio_resampler;
+    esp_err_t audio_err = audio_resampler_init(&audio_resampler, MIDI_SAMPLE_RATE, FM_MOD_RATE_HZ, 1,
+                                               audio_cfg.block_size, midi_player_render, NULL);
+#endif
+    if (audio_err != ESP_OK) {
+        ESP_LOGE(TAG, "音频处理链初始化失败: %s", esp_err_to_name(audio_err));
+    } else if (audio_pipeline_start(&audio_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "启动音频管线失败");
     } else {
-        ESP_LOGI(TAG, "FM音频输出任务已创建");
+        ESP_LOGI(TAG, "音频管线已启动");
     }
     
     printf("\n"
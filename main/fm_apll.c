@@ -0,0 +1,69 @@
+#include <math.h>
+#include "fm_apll.h"
+
+// 计算APLL配置
+fm_apll_cfg_t fm_calc_apll(uint32_t xtal_hz, uint32_t fout_hz, uint32_t dev_hz)
+{
+    uint32_t XTAL = xtal_hz;
+    fm_apll_cfg_t c = {0};
+    
+    // 1) 选择o_div使VCO ≥350 MHz
+    while (c.o_div < 31) {
+        if (fout_hz * 2 * (c.o_div + 2) >= 350000000UL) break;
+        ++c.o_div;
+    }
+    
+    // 2) 计算分子部分 (4 + sdm2 + frac16/65536)
+    double mul = (double)fout_hz * 2 * (c.o_div + 2) / XTAL;
+    c.sdm2 = (uint8_t)mul - 4;  // 整数部分
+    double frac = mul - (c.sdm2 + 4);  // 0…<1
+    uint32_t f16 = lround(frac * 65536.0);  // 0…65535
+
+    if (f16 == 65536) {  // 处理四舍五入溢出
+        f16 = 0;
+        ++c.sdm2;
+    }
+    c.base_frac16 = (uint16_t)f16;
+
+    // 保持至少±dev_frac16的余量
+    if (c.base_frac16 < c.dev_frac16) {
+        c.base_frac16 += c.dev_frac16;
+    } else if (c.base_frac16 > 65535 - c.dev_frac16) {
+        c.base_frac16 -= c.dev_frac16;
+    }
+
+    // 3) 计算在当前o_div下1Hz对应的分数LSB数
+    double lsb_hz = XTAL / (2.0 * (c.o_div + 2) * 65536);
+    c.dev_frac16 = (uint16_t)lround(dev_hz / lsb_hz);
+
+    return c;
+}
+
+double fm_apll_out_hz(uint32_t xtal_hz, uint32_t word)
+{
+    uint32_t o_div = (word >> 24) & 0x1F;
+    uint32_t sdm2 = (word >> 16) & 0xFF;
+    uint32_t frac16 = word & 0xFFFF;
+    return (double)xtal_hz * (4 + sdm2 + frac16 / 65536.0) / (2.0 * (o_div + 2));
+}
+
+// 根据APLL配置构建频偏查找表
+void fm_build_dev_lut(const fm_apll_cfg_t* cfg, uint32_t* lut)
+{
+    for (int i = 0; i < 256; i++) {
+        // 将0-255范围转换为-128到127
+        int16_t audio = (int16_t)i - 128;
+
+        // 计算频率偏移（-dev_frac16到+dev_frac16）
+        int16_t delta = (audio * cfg->dev_frac16) / 128;
+
+        lut[i] = fm_calc_sdm(cfg, delta);
+    }
+}
+
+void fm_build_dev_fine(const fm_apll_cfg_t* cfg, uint16_t* fine)
+{
+    for (int lo = 0; lo < 256; lo++) {
+        fine[lo] = (uint16_t)(((uint32_t)lo * cfg->dev_frac16) >> 15);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef FM_APLL_H
+#define FM_APLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// APLL系数计算（不访问硬件）：fout = xtal * (4 + sdm2 + frac16/65536) / (2 * (o_div + 2))
+// 系数打包为 sdm0 | sdm1 << 8 | sdm2 << 16 | o_div << 24
+
+// 载波经I2S0 MCLK从CLK_OUT1输出，频率为APLL / FM_MCLK_DIV
+// fm_transmitter在通道初始化后和每次重调谐时把MCLK分频器强制为此值，APLL目标频率按此换算
+#define FM_MCLK_DIV 1
+
+// APLL配置结构
+typedef struct {
+    uint8_t o_div;         // 输出分频器
+    uint8_t sdm2;          // 整数部分
+    uint16_t base_frac16;  // 基准分数部分（16位）
+    uint16_t dev_frac16;   // 偏差分数部分（16位）
+    bool is_rev0;          // 是否为ESP32 rev0芯片（由调用者填写）
+} fm_apll_cfg_t;
+
+// 按晶振频率计算载波fout_hz、最大频偏dev_hz对应的APLL配置
+fm_apll_cfg_t fm_calc_apll(uint32_t xtal_hz, uint32_t fout_hz, uint32_t dev_hz);
+
+// 打包系数对应的APLL输出频率（Hz）
+double fm_apll_out_hz(uint32_t xtal_hz, uint32_t word);
+
+// 计算给定频率偏移下的APLL系数（打包），总是内联，可在IRAM中断中调用
+static inline __attribute__((always_inline)) uint32_t fm_calc_sdm(const fm_apll_cfg_t* cfg, int32_t delta_frac16)
+{
+    int32_t frac32 = (int32_t)cfg->base_frac16 + delta_frac16;
+    int32_t sdm2 = cfg->sdm2;  // 工作副本
+
+    // 处理分数部分的借位/进位
+    if (frac32 < 0) {
+        int32_t borrow = (-frac32 + 65535) >> 16;  // 借位次数
+        frac32 += borrow * 65536;
+        sdm2 -= borrow;
+    } else if (frac32 > 65535) {
+        int32_t carry = frac32 >> 16;  // 进位次数
+        frac32 -= carry * 65536;
+        sdm2 += carry;
+    }
+
+    // 限制sdm2在有效范围内(0…63)
+    if (sdm2 < 0) {
+        sdm2 = 0;
+        frac32 = 0;
+    }
+    if (sdm2 > 63) {
+        sdm2 = 63;
+        frac32 = 65535;
+    }
+
+    uint32_t sdm0 = frac32 & 0xFF;
+    uint32_t sdm1 = (frac32 >> 8) & 0xFF;
+    return sdm0 | (sdm1 << 8) | ((uint32_t)sdm2 << 16) | ((uint32_t)cfg->o_div << 24);
+}
+
+// 构建8位样本（0~255，128为载波中心）到打包系数的频偏查找表
+void fm_build_dev_lut(const fm_apll_cfg_t* cfg, uint32_t* lut);
+
+// 构建16位样本低字节的频偏细调表：fine[lo] = (lo * dev_frac16) >> 15
+void fm_build_dev_fine(const fm_apll_cfg_t* cfg, uint16_t* fine);
+
+// 16位样本 -> 打包系数，只查两张表：高字节查lut（已处理借位/进位和限幅），低字节的细调直接加到打包字上，
+// 分数部分的进位自然进入sdm2；与fm_calc_sdm(cfg, (sample * dev_frac16) >> 15)相差不超过2 LSB
+// 表中没有被限幅的项（广播频段的载波都不会）时成立
+static inline __attribute__((always_inline)) uint32_t fm_lut_sdm(const uint32_t* lut, const uint16_t* fine, int16_t sample)
+{
+    return lut[((uint16_t)sample >> 8) ^ 0x80] + fine[sample & 0xFF];
+}
+
+#endif /* FM_APLL_H */
@@ -0,0 +1,217 @@
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "fm_dsp.h"
+
+// 配置
+#define TAG "FM_DSP"
+#define COEF_SHIFT 14
+#define COEF_ONE (1 << COEF_SHIFT)
+#define GAIN_SHIFT 15
+#define GAIN_ONE (1 << GAIN_SHIFT)
+#define LOOKAHEAD_SHIFT 5            // log2(FM_DSP_LOOKAHEAD)
+#define PREEMPHASIS_POLE_HZ 20000.0  // 限制高频提升的极点
+
+_Static_assert((1 << LOOKAHEAD_SHIFT) == FM_DSP_LOOKAHEAD, "LOOKAHEAD_SHIFT mismatch");
+
+static inline int32_t to_q14(double v)
+{
+    return (int32_t)lround(v * COEF_ONE);
+}
+
+// 双线性变换 (1 + s*t1) / (1 + s*t2)
+static void preemphasis_design(fm_dsp_t* dsp, uint32_t sample_rate, uint32_t tau_us)
+{
+    double k = 2.0 * sample_rate;
+    double t1 = tau_us * 1e-6;
+    double t2 = 1.0 / (2.0 * M_PI * PREEMPHASIS_POLE_HZ);
+    double norm = 1.0 + k * t2;
+
+    dsp->pe_b0 = to_q14((1.0 + k * t1) / norm);
+    dsp->pe_b1 = to_q14((1.0 - k * t1) / norm);
+    dsp->pe_a1 = to_q14((1.0 - k * t2) / norm);
+}
+
+// 二阶Butterworth低通（RBJ）
+static void lowpass_design(fm_dsp_t* dsp, uint32_t sample_rate, uint32_t cutoff_hz)
+{
+    double w0 = 2.0 * M_PI * cutoff_hz / sample_rate;
+    double alpha = sin(w0) / (2.0 * M_SQRT1_2);
+    double cosw = cos(w0);
+    double a0 = 1.0 + alpha;
+
+    dsp->lp_b0 = to_q14((1.0 - cosw) / 2.0 / a0);
+    dsp->lp_b1 = to_q14((1.0 - cosw) / a0);
+    dsp->lp_b2 = dsp->lp_b0;
+    dsp->lp_a1 = to_q14(-2.0 * cosw / a0);
+    dsp->lp_a2 = to_q14((1.0 - alpha) / a0);
+}
+
+void fm_dsp_reset(fm_dsp_t* dsp)
+{
+    dsp->pe_x1 = dsp->pe_y1 = 0;
+    dsp->lp_x1 = dsp->lp_x2 = dsp->lp_y1 = dsp->lp_y2 = 0;
+    memset(dsp->line, 0, sizeof(dsp->line));
+    dsp->pos = 0;
+    dsp->target_prev = GAIN_ONE;
+    dsp->gain_start = GAIN_ONE;
+    dsp->gain_end = GAIN_ONE;
+    dsp->min_gain = GAIN_ONE;
+}
+
+esp_err_t fm_dsp_init(fm_dsp_t* dsp, const fm_dsp_config_t* config)
+{
+    if (!dsp || !config || config->sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(dsp, 0, sizeof(*dsp));
+
+    dsp->pe_enabled = (config->preemphasis_us > 0);
+    if (dsp->pe_enabled) {
+        preemphasis_design(dsp, config->sample_rate, config->preemphasis_us);
+    }
+
+    // 截止频率需低于奈奎斯特频率
+    dsp->lp_enabled = config->lowpass && config->sample_rate > 2 * FM_DSP_LOWPASS_HZ;
+    if (dsp->lp_enabled) {
+        lowpass_design(dsp, config->sample_rate, FM_DSP_LOWPASS_HZ);
+    }
+
+    // 每段回升步长 = 满增益 * 分段长度 / 恢复时间内的样本数
+    uint32_t release_samples = config->sample_rate * FM_DSP_RELEASE_MS / 1000;
+    dsp->release_step = release_samples > FM_DSP_LOOKAHEAD
+                        ? (int32_t)((uint64_t)GAIN_ONE * FM_DSP_LOOKAHEAD / release_samples)
+                        : GAIN_ONE;
+
+    fm_dsp_reset(dsp);
+
+    ESP_LOGI(TAG, "音频处理链: %lu Hz, 预加重%u us, 低通%s, 限幅预读%d样本",
+             config->sample_rate, config->preemphasis_us,
+             dsp->lp_enabled ? "开" : "关", 2 * FM_DSP_LOOKAHEAD);
+    return ESP_OK;
+}
+
+static void preemphasis_run(fm_dsp_t* dsp, const int16_t* in, int32_t* out, uint32_t n)
+{
+    if (!dsp->pe_enabled) {
+        for (uint32_t i = 0; i < n; i++) {
+            out[i] = in[i];
+        }
+        return;
+    }
+
+    int32_t x1 = dsp->pe_x1;
+    int32_t y1 = dsp->pe_y1;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t x = in[i];
+        int64_t acc = (int64_t)dsp->pe_b0 * x + (int64_t)dsp->pe_b1 * x1 - (int64_t)dsp->pe_a1 * y1;
+        y1 = (int32_t)(acc >> COEF_SHIFT);
+        x1 = x;
+        out[i] = y1;
+    }
+    dsp->pe_x1 = x1;
+    dsp->pe_y1 = y1;
+}
+
+static void lowpass_run(fm_dsp_t* dsp, int32_t* buf, uint32_t n)
+{
+    if (!dsp->lp_enabled) {
+        return;
+    }
+
+    int32_t x1 = dsp->lp_x1, x2 = dsp->lp_x2;
+    int32_t y1 = dsp->lp_y1, y2 = dsp->lp_y2;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t x = buf[i];
+        int64_t acc = (int64_t)dsp->lp_b0 * x + (int64_t)dsp->lp_b1 * x1 + (int64_t)dsp->lp_b2 * x2
+                    - (int64_t)dsp->lp_a1 * y1 - (int64_t)dsp->lp_a2 * y2;
+        int32_t y = (int32_t)(acc >> COEF_SHIFT);
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        buf[i] = y;
+    }
+    dsp->lp_x1 = x1;
+    dsp->lp_x2 = x2;
+    dsp->lp_y1 = y1;
+    dsp->lp_y2 = y2;
+}
+
+// 刚写满的分段允许的最大增益
+static int32_t segment_target(const int32_t* seg)
+{
+    int32_t peak = 0;
+    for (uint32_t i = 0; i < FM_DSP_LOOKAHEAD; i++) {
+        int32_t a = seg[i] < 0 ? -seg[i] : seg[i];
+        if (a > peak) peak = a;
+    }
+    if (peak <= FM_DSP_LIMIT) {
+        return GAIN_ONE;
+    }
+    return (int32_t)(((int64_t)FM_DSP_LIMIT << GAIN_SHIFT) / peak);
+}
+
+// 每输出一段后更新增益斜坡：终点不超过正在输出段和下一段的允许增益，
+// 起点为上一段终点，因此整段增益都不会让峰值越界
+static void limiter_advance(fm_dsp_t* dsp, const int32_t* filled)
+{
+    int32_t target = segment_target(filled);
+    int32_t g = dsp->gain_end + dsp->release_step;
+    if (g > dsp->target_prev) g = dsp->target_prev;
+    if (g > target) g = target;
+
+    dsp->gain_start = dsp->gain_end;
+    dsp->gain_end = g;
+    dsp->target_prev = target;
+    if (g < dsp->min_gain) {
+        dsp->min_gain = g;
+    }
+}
+
+// 输出延迟线中最老的样本并写入新样本（n不跨越分段边界）
+static void limiter_run(fm_dsp_t* dsp, const int32_t* in, int16_t* out, uint32_t n)
+{
+    int32_t* line = dsp->line;
+    uint32_t pos = dsp->pos;
+    uint32_t offset = pos & (FM_DSP_LOOKAHEAD - 1);
+    int32_t g0 = dsp->gain_start;
+    int32_t dg = dsp->gain_end - dsp->gain_start;
+
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t g = g0 + ((dg * (int32_t)(offset + i)) >> LOOKAHEAD_SHIFT);
+        int32_t s = (int32_t)(((int64_t)line[pos + i] * g) >> GAIN_SHIFT);
+        if (s > FM_DSP_LIMIT) s = FM_DSP_LIMIT;
+        if (s < -FM_DSP_LIMIT) s = -FM_DSP_LIMIT;
+        out[i] = (int16_t)s;
+        line[pos + i] = in[i];
+    }
+
+    pos += n;
+    if ((pos & (FM_DSP_LOOKAHEAD - 1)) == 0) {
+        // 刚写满的分段在pos之前，接下来输出的是另一半中较早写入的分段
+        limiter_advance(dsp, &line[pos - FM_DSP_LOOKAHEAD]);
+        pos &= 2 * FM_DSP_LOOKAHEAD - 1;
+    }
+    dsp->pos = pos;
+}
+
+void fm_dsp_process(fm_dsp_t* dsp, const int16_t* in, int16_t* out, size_t frames)
+{
+    int32_t work[FM_DSP_LOOKAHEAD];
+
+    while (frames > 0) {
+        // 每段不跨越限幅器分段边界
+        uint32_t room = FM_DSP_LOOKAHEAD - (dsp->pos & (FM_DSP_LOOKAHEAD - 1));
+        uint32_t n = frames < room ? frames : room;
+
+        preemphasis_run(dsp, in, work, n);
+        lowpass_run(dsp, work, n);
+        limiter_run(dsp, work, out, n);
+
+        in += n;
+        out += n;
+        frames -= n;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef FM_DSP_H
+#define FM_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// 限幅器配置
+#define FM_DSP_LOOKAHEAD 32        // 限幅器分段长度，总预读（延迟）为两段
+#define FM_DSP_LIMIT 32767         // 输出峰值上限，对应±MAX_DEV_HZ
+#define FM_DSP_RELEASE_MS 50       // 增益从0恢复到1所需时间
+#define FM_DSP_LOWPASS_HZ 15000    // 低通截止频率
+
+// 预加重时间常数（微秒），0为关闭
+#if defined(CONFIG_FM_PREEMPHASIS_75US)
+#define FM_DSP_PREEMPHASIS_US 75
+#elif defined(CONFIG_FM_PREEMPHASIS_50US)
+#define FM_DSP_PREEMPHASIS_US 50
+#else
+#define FM_DSP_PREEMPHASIS_US 0
+#endif
+
+#ifdef CONFIG_FM_LOWPASS_15K
+#define FM_DSP_LOWPASS true
+#else
+#define FM_DSP_LOWPASS false
+#endif
+
+// 处理链配置
+typedef struct {
+    uint32_t sample_rate;
+    uint8_t preemphasis_us;    // 0、50或75
+    bool lowpass;              // 15 kHz低通（采样率不足时自动关闭）
+} fm_dsp_config_t;
+
+#define FM_DSP_DEFAULT_CONFIG(rate) {                       \
+    .sample_rate = (rate),                                  \
+    .preemphasis_us = FM_DSP_PREEMPHASIS_US,                \
+    .lowpass = FM_DSP_LOWPASS,                              \
+}
+
+// 处理链状态（系数均为Q14，增益为Q15）
+typedef struct {
+    // 预加重：一阶高频搁架 (1 + s*t1) / (1 + s*t2)
+    bool pe_enabled;
+    int32_t pe_b0, pe_b1, pe_a1;
+    int32_t pe_x1, pe_y1;
+
+    // 低通：二阶Butterworth，直接I型
+    bool lp_enabled;
+    int32_t lp_b0, lp_b1, lp_b2, lp_a1, lp_a2;
+    int32_t lp_x1, lp_x2, lp_y1, lp_y2;
+
+    // 预读峰值限幅器：两段环形延迟线
+    int32_t line[2 * FM_DSP_LOOKAHEAD];
+    uint32_t pos;
+    int32_t target_prev;       // 上一完整分段允许的最大增益
+    int32_t gain_start;        // 当前输出分段的起止增益
+    int32_t gain_end;
+    int32_t release_step;      // 每段最多回升的增益
+    int32_t min_gain;          // 统计：最小增益
+} fm_dsp_t;
+
+// 根据配置计算系数并清空状态
+esp_err_t fm_dsp_init(fm_dsp_t* dsp, const fm_dsp_config_t* config);
+
+// 清空滤波器和限幅器状态
+void fm_dsp_reset(fm_dsp_t* dsp);
+
+// 处理一块样本：预加重 -> 低通 -> 限幅，输出延迟2*FM_DSP_LOOKAHEAD个样本
+// in和out可以相同
+void fm_dsp_process(fm_dsp_t* dsp, const int16_t* in, int16_t* out, size_t frames);
+
+#endif /* FM_DSP_H */
@@ -0,0 +1,108 @@
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "fm_mpx.h"
+#ifdef CONFIG_FM_RDS
+#include "fm_rds.h"
+#endif
+
+// 配置
+#define TAG "FM_MPX"
+#define SINE_SIZE (1 << FM_MPX_SINE_BITS)
+
+#ifdef CONFIG_FM_RDS
+_Static_assert(FM_MPX_RATE_HZ * 2 == FM_RDS_SAMPLES_PER_BIT * 2375, "FM_RDS_SAMPLES_PER_BIT must match FM_MPX_RATE_HZ");
+#endif
+
+// 导频、38 kHz和57 kHz副载波共用的正弦表（Q15）
+static int16_t sine_table[SINE_SIZE];
+
+static inline int32_t sine_at(uint32_t phase)
+{
+    return sine_table[phase >> (32 - FM_MPX_SINE_BITS)];
+}
+
+esp_err_t fm_mpx_init(fm_mpx_t* mpx, uint64_t rate_mhz, audio_render_cb_t source, void* source_ctx)
+{
+    if (!mpx || !source || rate_mhz < 2ULL * FM_MPX_TOP_HZ * 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < SINE_SIZE; i++) {
+        sine_table[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * i / SINE_SIZE));
+    }
+
+    memset(mpx, 0, sizeof(*mpx));
+    mpx->source = source;
+    mpx->source_ctx = source_ctx;
+
+    // 相位增量 = 19000 * 2^32 / fs
+    mpx->pilot_inc = (uint32_t)(((uint64_t)FM_MPX_PILOT_HZ * 1000 << 32) / rate_mhz);
+
+    // 复合信号中导频以上有副载波，低通必须开启
+    fm_dsp_config_t dsp_cfg = FM_DSP_DEFAULT_CONFIG((uint32_t)(rate_mhz / 1000));
+    dsp_cfg.lowpass = true;
+    for (int c = 0; c < 2; c++) {
+        esp_err_t err = fm_dsp_init(&mpx->dsp[c], &dsp_cfg);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+#ifdef CONFIG_FM_RDS
+    // RDS比特率 = 57 kHz / 48 = 导频 * 3 / 48
+    esp_err_t rds_err = fm_rds_init(mpx->pilot_inc / 16);
+    if (rds_err != ESP_OK) {
+        return rds_err;
+    }
+#endif
+
+    ESP_LOGI(TAG, "立体声编码器: %llu.%03llu Hz, 导频电平%d%%",
+             rate_mhz / 1000, rate_mhz % 1000, (FM_MPX_PILOT_LEVEL * 100 + 16384) / 32768);
+    return ESP_OK;
+}
+
+void fm_mpx_render(int16_t* out, size_t frames, void* ctx)
+{
+    fm_mpx_t* mpx = (fm_mpx_t*)ctx;
+    int16_t stereo[2 * FM_MPX_CHUNK];
+    int16_t left[FM_MPX_CHUNK];
+    int16_t right[FM_MPX_CHUNK];
+#ifdef CONFIG_FM_RDS
+    int16_t rds[FM_MPX_CHUNK];
+#endif
+
+    while (frames > 0) {
+        size_t n = frames < FM_MPX_CHUNK ? frames : FM_MPX_CHUNK;
+
+        mpx->source(stereo, n, mpx->source_ctx);
+        for (size_t i = 0; i < n; i++) {
+            left[i] = stereo[2 * i];
+            right[i] = stereo[2 * i + 1];
+        }
+        fm_dsp_process(&mpx->dsp[0], left, left, n);
+        fm_dsp_process(&mpx->dsp[1], right, right, n);
+#ifdef CONFIG_FM_RDS
+        fm_rds_render(rds, n);
+#endif
+
+        // MPX = A * (M + S * sin(2wt)) + P * sin(wt)，|M| + |S| <= 32767
+        uint32_t phase = mpx->pilot_phase;
+        for (size_t i = 0; i < n; i++) {
+            int32_t m = ((int32_t)left[i] + right[i]) >> 1;
+            int32_t s = ((int32_t)left[i] - right[i]) >> 1;
+            int32_t audio = m + ((s * sine_at(phase * 2)) >> 15);
+            int32_t v = ((audio * FM_MPX_AUDIO_LEVEL) >> 15) + ((sine_at(phase) * FM_MPX_PILOT_LEVEL) >> 15);
+#ifdef CONFIG_FM_RDS
+            // RDS副载波与导频三次谐波同相
+            v += (((rds[i] * sine_at(phase * 3)) >> 15) * FM_RDS_LEVEL) >> 15;
+#endif
+            out[i] = (int16_t)v;
+            phase += mpx->pilot_inc;
+        }
+        mpx->pilot_phase = phase;
+
+        out += n;
+        frames -= n;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef FM_MPX_H
+#define FM_MPX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_pipeline.h"
+#include "fm_dsp.h"
+#include "sdkconfig.h"
+
+// 立体声复合信号配置
+#define FM_MPX_PILOT_HZ 19000
+// 复合信号速率取导频的整数倍中奈奎斯特频率高于最高分量的最小值，每个样本对应一次中断
+// APLL系数在两次写入之间保持不变（零阶保持），镜像位于 fs - f，落在75 kHz以上或MPX频带之外
+#ifdef CONFIG_FM_RDS
+#define FM_MPX_TOP_HZ 59400                                   // RDS上边沿（57 kHz + 2.4 kHz）
+#define FM_MPX_OVERSAMPLE 7                                   // 每个导频周期的样本数
+#else
+#define FM_MPX_TOP_HZ 53000                                   // L-R上边沿（38 kHz + 15 kHz）
+#define FM_MPX_OVERSAMPLE 6
+#endif
+#define FM_MPX_RATE_HZ (FM_MPX_PILOT_HZ * FM_MPX_OVERSAMPLE)  // 133 kHz（无RDS时114 kHz）
+#define FM_MPX_CHUNK 64                                       // 内部处理分段长度
+#define FM_MPX_SINE_BITS 10                                   // 导频/副载波正弦表索引位数
+
+// 各分量电平（Q15，相对满频偏），音频、导频与RDS之和不超过1
+#ifdef CONFIG_FM_RDS
+#define FM_MPX_AUDIO_LEVEL 28180   // 86%，为RDS副载波（FM_RDS_LEVEL）让出余量
+#else
+#define FM_MPX_AUDIO_LEVEL 29490   // 90%
+#endif
+#define FM_MPX_PILOT_LEVEL 3276    // 10%
+
+// 编码器状态
+typedef struct {
+    audio_render_cb_t source;      // 上游立体声渲染回调（左右交错，FM_MPX_RATE_HZ）
+    void* source_ctx;
+    fm_dsp_t dsp[2];               // 左右声道各自的预加重/低通/限幅
+    uint32_t pilot_phase;          // 导频相位累加器，副载波取其2倍保证锁相
+    uint32_t pilot_inc;            // 按定时器实际速率计算，使导频准确为19 kHz
+} fm_mpx_t;
+
+// 初始化编码器，rate_mhz为实际输出采样率（毫赫兹）
+esp_err_t fm_mpx_init(fm_mpx_t* mpx, uint64_t rate_mhz, audio_render_cb_t source, void* source_ctx);
+
+// 渲染回调：ctx为fm_mpx_t*，输出单声道复合信号，可直接作为audio_pipeline的render
+void fm_mpx_render(int16_t* out, size_t frames, void* ctx);
+
+#endif /* FM_MPX_H */
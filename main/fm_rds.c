@@ -0,0 +1,365 @@
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "fm_rds.h"
+
+// 配置
+#define TAG "FM_RDS"
+#define SYMBOL_LEN (FM_RDS_SYMBOL_BITS * FM_RDS_SAMPLES_PER_BIT)
+#define RING_LEN 512                    // 符号叠加累加器长度，不小于SYMBOL_LEN的2的幂
+#define GROUP_BITS 104                  // 4块 x 26位
+#define CRC_POLY 0x1B9                  // g(x) = x^10+x^8+x^7+x^5+x^4+x^3+1（不含x^10）
+#define AF_NONE 0xE0CD                  // 0个AF + 填充码
+
+_Static_assert((RING_LEN & (RING_LEN - 1)) == 0 && RING_LEN >= SYMBOL_LEN, "RING_LEN must be a power of 2 >= SYMBOL_LEN");
+
+// 偏移字
+enum {
+    OFFSET_A = 0x0FC,
+    OFFSET_B = 0x198,
+    OFFSET_C = 0x168,
+    OFFSET_D = 0x1B4,
+};
+
+// 预计算表
+static int16_t s_symbol[SYMBOL_LEN];    // 双相成形符号（中心在SYMBOL_LEN/2）
+static uint16_t s_crc_hi[256];          // 高字节的校验余数
+static uint16_t s_crc_lo[256];          // 低字节的校验余数
+
+// 调制状态（仅由渲染任务访问）
+static int32_t s_ring[RING_LEN];        // 符号叠加累加器
+static uint32_t s_ring_pos;
+static uint32_t s_bit_phase;
+static uint32_t s_bit_inc;
+static uint32_t s_group[4];
+static uint32_t s_bit_index = GROUP_BITS;
+static uint8_t s_prev_bit;
+
+// 当前发送的文本（仅由渲染任务访问）
+static uint16_t s_pi = FM_RDS_DEFAULT_PI;
+static char s_ps[FM_RDS_PS_LEN];
+static char s_rt[FM_RDS_RT_LEN];
+static uint8_t s_rt_segments = 1;
+static bool s_rt_ab = false;
+static uint8_t s_ps_seg, s_rt_seg, s_group_seq;
+static uint32_t s_group_count;
+
+// 待生效的设置，在组边界取用
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+    uint16_t pi;
+    char ps[FM_RDS_PS_LEN];
+    char rt[FM_RDS_RT_LEN];
+    uint8_t rt_segments;
+    bool rt_changed;
+    bool dirty;
+} s_pending;
+static bool s_auto = true;
+
+static uint16_t crc_bitwise(uint16_t info)
+{
+    uint16_t reg = 0;
+    for (int bit = 15; bit >= 0; bit--) {
+        uint16_t fb = ((reg >> 9) ^ (info >> bit)) & 1;
+        reg = (reg << 1) & 0x3FF;
+        if (fb) {
+            reg ^= CRC_POLY;
+        }
+    }
+    return reg;
+}
+
+// 数据成形滤波器冲激响应：|H(f)| = cos(pi*f*td/4)，|f| <= 2/td
+static double shaping_impulse(double t, double td)
+{
+    double f = 2.0 / td;
+    double a = M_PI * td / 4.0;
+    double b = 2.0 * M_PI * t;
+    double s1 = fabs(a - b) < 1e-12 ? f : sin((a - b) * f) / (a - b);
+    double s2 = fabs(a + b) < 1e-12 ? f : sin((a + b) * f) / (a + b);
+    return s1 + s2;
+}
+
+static void build_tables(void)
+{
+    for (int i = 0; i < 256; i++) {
+        s_crc_hi[i] = crc_bitwise((uint16_t)(i << 8));
+        s_crc_lo[i] = crc_bitwise((uint16_t)i);
+    }
+
+    // 双相符号 = 正冲激 - 半比特后的负冲激，均经成形滤波
+    const double td = 1.0 / 1187.5;
+    const double fs = FM_RDS_SAMPLES_PER_BIT / td;
+    double wave[SYMBOL_LEN];
+    for (int k = 0; k < SYMBOL_LEN; k++) {
+        double t = (k - SYMBOL_LEN / 2) / fs;
+        wave[k] = shaping_impulse(t + td / 4.0, td) - shaping_impulse(t - td / 4.0, td);
+    }
+
+    // 按最坏情况的符号叠加峰值归一化，保证累加结果不溢出
+    double worst = 0.0;
+    for (int m = 0; m < FM_RDS_SAMPLES_PER_BIT; m++) {
+        double sum = 0.0;
+        for (int k = m; k < SYMBOL_LEN; k += FM_RDS_SAMPLES_PER_BIT) {
+            sum += fabs(wave[k]);
+        }
+        if (sum > worst) worst = sum;
+    }
+    for (int k = 0; k < SYMBOL_LEN; k++) {
+        s_symbol[k] = (int16_t)lrint(wave[k] / worst * 32767.0);
+    }
+}
+
+static inline uint32_t make_block(uint16_t info, uint16_t offset)
+{
+    uint16_t check = (s_crc_hi[info >> 8] ^ s_crc_lo[info & 0xFF] ^ offset) & 0x3FF;
+    return ((uint32_t)info << 10) | check;
+}
+
+// 将文本规整为RDS可显示字符，不足部分填空格
+static void copy_text(char* dst, size_t len, const char* src)
+{
+    size_t i = 0;
+    for (; src && src[i] && i < len; i++) {
+        unsigned char c = (unsigned char)src[i];
+        dst[i] = (c >= 0x20 && c < 0x7F) ? (char)c : ' ';
+    }
+    for (; i < len; i++) {
+        dst[i] = ' ';
+    }
+}
+
+// 广播文本以0x0D结束，返回需要发送的段数
+static uint8_t prepare_rt(char* dst, const char* src)
+{
+    size_t len = src ? strnlen(src, FM_RDS_RT_LEN) : 0;
+    copy_text(dst, FM_RDS_RT_LEN, src);
+    if (len < FM_RDS_RT_LEN) {
+        dst[len] = '\r';
+        len++;
+    }
+    return (uint8_t)((len + 3) / 4);
+}
+
+static void apply_pending(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_pending.dirty) {
+        s_pi = s_pending.pi;
+        memcpy(s_ps, s_pending.ps, sizeof(s_ps));
+        if (s_pending.rt_changed) {
+            memcpy(s_rt, s_pending.rt, sizeof(s_rt));
+            s_rt_segments = s_pending.rt_segments;
+            s_rt_ab = !s_rt_ab;  // 通知接收机清除旧文本
+            s_rt_seg = 0;
+        }
+        s_pending.dirty = false;
+        s_pending.rt_changed = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 组调度：每4个0A组（节目服务名）插入1个2A组（广播文本）
+static void next_group(void)
+{
+    apply_pending();
+
+    uint16_t b, c, d;
+    uint16_t common = (FM_RDS_DEFAULT_PTY & 0x1F) << 5;
+    if (s_group_seq < 4) {
+        // 0A：TA=0, MS=1（音乐），DI的d0（第3段）表示立体声
+        uint16_t di = (s_ps_seg == 3) ? 1 : 0;
+        b = (0 << 12) | common | (1 << 3) | (di << 2) | s_ps_seg;
+        c = AF_NONE;
+        d = ((uint8_t)s_ps[2 * s_ps_seg] << 8) | (uint8_t)s_ps[2 * s_ps_seg + 1];
+        s_ps_seg = (s_ps_seg + 1) & 3;
+    } else {
+        const char* seg = &s_rt[4 * s_rt_seg];
+        b = (2 << 12) | common | ((s_rt_ab ? 1 : 0) << 4) | s_rt_seg;
+        c = ((uint8_t)seg[0] << 8) | (uint8_t)seg[1];
+        d = ((uint8_t)seg[2] << 8) | (uint8_t)seg[3];
+        s_rt_seg = (s_rt_seg + 1) % s_rt_segments;
+    }
+    s_group_seq = (s_group_seq + 1) % 5;
+
+    s_group[0] = make_block(s_pi, OFFSET_A);
+    s_group[1] = make_block(b, OFFSET_B);
+    s_group[2] = make_block(c, OFFSET_C);
+    s_group[3] = make_block(d, OFFSET_D);
+    s_bit_index = 0;
+    s_group_count++;
+}
+
+// 取下一比特，差分编码后将成形符号叠加到累加器
+static void emit_bit(void)
+{
+    if (s_bit_index >= GROUP_BITS) {
+        next_group();
+    }
+    uint32_t block = s_group[s_bit_index / 26];
+    uint8_t bit = (block >> (25 - s_bit_index % 26)) & 1;
+    s_bit_index++;
+
+    s_prev_bit ^= bit;
+    int32_t sign = s_prev_bit ? 1 : -1;
+
+    uint32_t pos = s_ring_pos;
+    for (int k = 0; k < SYMBOL_LEN; k++) {
+        s_ring[(pos + k) & (RING_LEN - 1)] += sign * s_symbol[k];
+    }
+}
+
+esp_err_t fm_rds_init(uint32_t bit_inc)
+{
+    if (bit_inc == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    build_tables();
+    memset(s_ring, 0, sizeof(s_ring));
+    s_ring_pos = 0;
+    s_bit_phase = 0;
+    s_bit_inc = bit_inc;
+    s_bit_index = GROUP_BITS;
+    s_prev_bit = 0;
+
+    copy_text(s_ps, sizeof(s_ps), "ESP32");
+    s_rt_segments = prepare_rt(s_rt, "ESP32 NAT Router");
+
+    ESP_LOGI(TAG, "RDS编码器初始化完成: PI=0x%04X", s_pi);
+    return ESP_OK;
+}
+
+void fm_rds_render(int16_t* out, size_t frames)
+{
+    uint32_t phase = s_bit_phase;
+    uint32_t pos = s_ring_pos;
+
+    for (size_t i = 0; i < frames; i++) {
+        uint32_t next = phase + s_bit_inc;
+        if (next < phase) {
+            s_ring_pos = pos;
+            emit_bit();
+        }
+        phase = next;
+
+        out[i] = (int16_t)s_ring[pos];
+        s_ring[pos] = 0;
+        pos = (pos + 1) & (RING_LEN - 1);
+    }
+
+    s_bit_phase = phase;
+    s_ring_pos = pos;
+}
+
+// 以当前生效值为基础准备一次更新（调用者持有s_lock）
+static void pending_begin(void)
+{
+    if (!s_pending.dirty) {
+        s_pending.pi = s_pi;
+        memcpy(s_pending.ps, s_ps, sizeof(s_ps));
+    }
+}
+
+void fm_rds_set_pi(uint16_t pi)
+{
+    portENTER_CRITICAL(&s_lock);
+    pending_begin();
+    s_pending.pi = pi;
+    s_pending.dirty = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void set_ps(const char* ps)
+{
+    char buf[FM_RDS_PS_LEN];
+    copy_text(buf, sizeof(buf), ps);
+
+    portENTER_CRITICAL(&s_lock);
+    pending_begin();
+    memcpy(s_pending.ps, buf, sizeof(buf));
+    s_pending.dirty = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void set_rt(const char* rt)
+{
+    char buf[FM_RDS_RT_LEN];
+    uint8_t segments = prepare_rt(buf, rt);
+
+    portENTER_CRITICAL(&s_lock);
+    pending_begin();
+    memcpy(s_pending.rt, buf, sizeof(buf));
+    s_pending.rt_segments = segments;
+    s_pending.rt_changed = true;
+    s_pending.dirty = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void fm_rds_set_ps(const char* ps)
+{
+    s_auto = false;
+    set_ps(ps);
+}
+
+void fm_rds_set_rt(const char* rt)
+{
+    s_auto = false;
+    set_rt(rt);
+}
+
+void fm_rds_set_auto(bool enable)
+{
+    s_auto = enable;
+}
+
+bool fm_rds_is_auto(void)
+{
+    return s_auto;
+}
+
+void fm_rds_update_router_state(const char* ap_ssid, uint16_t clients)
+{
+    if (!s_auto) {
+        return;
+    }
+
+    char rt[FM_RDS_RT_LEN + 1];
+    snprintf(rt, sizeof(rt), "%s - %u client%s", ap_ssid ? ap_ssid : "", clients, clients == 1 ? "" : "s");
+    set_ps(ap_ssid);
+    set_rt(rt);
+}
+
+void fm_rds_get_text(uint16_t* pi, char* ps, size_t ps_size, char* rt, size_t rt_size)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool pending = s_pending.dirty;
+    uint16_t cur_pi = pending ? s_pending.pi : s_pi;
+    const char* cur_ps = pending ? s_pending.ps : s_ps;
+    const char* cur_rt = (pending && s_pending.rt_changed) ? s_pending.rt : s_rt;
+
+    if (pi) {
+        *pi = cur_pi;
+    }
+    if (ps && ps_size > 0) {
+        size_t n = ps_size - 1 < FM_RDS_PS_LEN ? ps_size - 1 : FM_RDS_PS_LEN;
+        memcpy(ps, cur_ps, n);
+        ps[n] = '\0';
+    }
+    if (rt && rt_size > 0) {
+        size_t n = 0;
+        while (n < rt_size - 1 && n < FM_RDS_RT_LEN && cur_rt[n] != '\r') {
+            rt[n] = cur_rt[n];
+            n++;
+        }
+        rt[n] = '\0';
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t fm_rds_group_count(void)
+{
+    return s_group_count;
+}
@@ -0,0 +1,45 @@
+#ifndef FM_RDS_H
+#define FM_RDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// RDS配置
+#define FM_RDS_PS_LEN 8                 // 节目服务名（0A组）
+#define FM_RDS_RT_LEN 64                // 广播文本（2A组）
+#define FM_RDS_DEFAULT_PI 0x1234        // 节目识别码
+#define FM_RDS_DEFAULT_PTY 0            // 节目类型
+#define FM_RDS_SYMBOL_BITS 4            // 成形符号跨越的比特数
+#define FM_RDS_SAMPLES_PER_BIT 112      // 133 kHz / 1187.5 bps
+#define FM_RDS_LEVEL 1310               // 57 kHz副载波电平（Q15，约4%）
+
+// 初始化编码器，bit_inc为每个输出样本的比特相位增量（2^32对应一个比特）
+// 由导频相位增量除以16得到，使比特率锁定为57 kHz / 48
+esp_err_t fm_rds_init(uint32_t bit_inc);
+
+// 生成一段双相成形的基带信号（Q15），由调用者乘以57 kHz副载波
+void fm_rds_render(int16_t* out, size_t frames);
+
+// 设置节目识别码
+void fm_rds_set_pi(uint16_t pi);
+
+// 设置节目服务名（最多8字符）和广播文本（最多64字符），会关闭自动文本
+void fm_rds_set_ps(const char* ps);
+void fm_rds_set_rt(const char* rt);
+
+// 自动文本：由路由器状态生成PS/RT
+void fm_rds_set_auto(bool enable);
+bool fm_rds_is_auto(void);
+
+// 路由器状态变化时调用，仅在自动文本模式下生效
+void fm_rds_update_router_state(const char* ap_ssid, uint16_t clients);
+
+// 读取当前设置
+void fm_rds_get_text(uint16_t* pi, char* ps, size_t ps_size, char* rt, size_t rt_size);
+
+// 已发送的组数
+uint32_t fm_rds_group_count(void);
+
+#endif /* FM_RDS_H */
@@ -1,19 +1,55 @@
 #include "fm_transmitter.h"
-#include "driver/i2s.h"
+#include "fm_dsp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/i2s_std.h"
 #include "soc/io_mux_reg.h"
 #include "soc/soc.h"
+#include "soc/i2s_struct.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
 #include "esp_private/rtc_clk.h"
+#include "esp_private/esp_clk.h"
 #include "hal/clk_tree_ll.h"
 #include "hal/efuse_ll.h"
 
 // 配置
 #define TAG "FM_TRANSMITTER"
+#define FM_SDM_PROBE_COUNT 256  // 开机测量APLL系数更新耗时的次数
+
+// 当前载波的APLL配置和频偏查找表：样本高字节 -> 打包系数（含o_div），低字节 -> 分数部分细调
+typedef struct {
+    fm_apll_cfg_t apll;
+    uint32_t lut[256];
+    uint16_t fine[256];
+} fm_carrier_t;
 
 // 状态
 static bool is_enabled = false;
-static fm_apll_cfg_t g_apll;
+static uint32_t g_frequency = FM_FREQUENCY;
+static i2s_chan_handle_t s_tx_chan = NULL;
+
+// 双缓冲：重调谐时在后台副本中计算后切换指针，中断中始终读取完整的配置
+static DRAM_ATTR fm_carrier_t s_carrier[2];
+static const fm_carrier_t* volatile s_active = &s_carrier[0];
+
+// 最近写入APLL的打包系数，中断中只写入变化的寄存器；UINT32_MAX表示下次需完整写入
+static DRAM_ATTR volatile uint32_t s_hw_word = UINT32_MAX;
+
+// 16位音频处理链（预加重、低通、限幅）
+static fm_dsp_t s_dsp;
+
+// 重调谐互斥及耗时统计
+static SemaphoreHandle_t s_retune_lock = NULL;
+static uint32_t s_retune_last_us = 0;
+static uint32_t s_retune_max_us = 0;
+
+// 开机时测得的一次APLL系数更新的CPU周期
+static uint32_t s_sdm_partial_cycles = 0;  // 只写分数部分低字节（多数样本）
+static uint32_t s_sdm_full_cycles = 0;     // 完整写入（频偏跨过sdm2整数边界）
 
 // 获取晶振频率
 static inline uint32_t get_xtal_hz(void)
@@ -21,98 +57,107 @@ static inline uint32_t get_xtal_hz(void)
     return rtc_clk_xtal_freq_get() * 1000000UL;
 }
 
-// 计算APLL配置
-static fm_apll_cfg_t fm_calc_apll(uint32_t fout_hz, uint32_t dev_hz)
+// 完整写入APLL系数（6次模拟总线写，含一次读-改-写）
+static inline void IRAM_ATTR fm_write_sdm(uint32_t word)
 {
-    uint32_t XTAL = get_xtal_hz();
-    fm_apll_cfg_t c = {0};
-    
-    // 1) 选择o_div使VCO ≥350 MHz
-    while (c.o_div < 31) {
-        if (fout_hz * 2 * (c.o_div + 2) >= 350000000UL) break;
-        ++c.o_div;
-    }
-    
-    // 2) 计算分子部分 (4 + sdm2 + frac16/65536)
-    double mul = (double)fout_hz * 2 * (c.o_div + 2) / XTAL;
-    c.sdm2 = (uint8_t)mul - 4;  // 整数部分
-    double frac = mul - (c.sdm2 + 4);  // 0…<1
-    uint32_t f16 = lround(frac * 65536.0);  // 0…65535
-
-    if (f16 == 65536) {  // 处理四舍五入溢出
-        f16 = 0;
-        ++c.sdm2;
-    }
-    c.base_frac16 = (uint16_t)f16;
+    clk_ll_apll_set_config(s_active->apll.is_rev0,
+                          (word >> 24) & 0x1F,
+                          word & 0xFF,
+                          (word >> 8) & 0xFF,
+                          (word >> 16) & 0xFF);
+}
 
-    // 保持至少±dev_frac16的余量
-    if (c.base_frac16 < c.dev_frac16) {
-        c.base_frac16 += c.dev_frac16;
-    } else if (c.base_frac16 > 65535 - c.dev_frac16) {
-        c.base_frac16 -= c.dev_frac16;
+// 只写入与上次不同的系数：相邻样本的频偏差通常小于256 LSB，多数只写分数部分低字节一个寄存器
+// sdm2或o_div变化（频偏跨过整数边界、重调谐后）时才完整写入
+static inline void IRAM_ATTR fm_update_sdm(uint32_t word)
+{
+    uint32_t diff = word ^ s_hw_word;
+    if (diff & 0xFFFF0000) {
+        fm_write_sdm(word);
+    } else if (!s_active->apll.is_rev0) {
+        // rev0芯片不支持分数部分，clk_ll_apll_set_config中也固定为0
+        if (diff & 0xFF00) {
+            REGI2C_WRITE(I2C_APLL, I2C_APLL_DSDM1, (word >> 8) & 0xFF);
+        }
+        if (diff & 0xFF) {
+            REGI2C_WRITE(I2C_APLL, I2C_APLL_DSDM0, word & 0xFF);
+        }
     }
-
-    // 3) 计算在当前o_div下1Hz对应的分数LSB数
-    double lsb_hz = XTAL / (2.0 * (c.o_div + 2) * 65536);
-    c.dev_frac16 = (uint16_t)lround(dev_hz / lsb_hz);
-
-    // 检查是否为ESP32 rev0芯片
-    c.is_rev0 = (efuse_ll_get_chip_ver_rev1() == 0);
-    return c;
+    s_hw_word = word;
 }
 
-// 设置频率偏差
-static inline void fm_set_deviation(int16_t delta_frac16)
+// 16位样本（满幅对应±dev_frac16）-> 打包系数，查表完成，没有乘法和借位/进位分支
+static inline uint32_t IRAM_ATTR fm_sample_sdm(const fm_carrier_t* carrier, int16_t sample)
 {
-    int32_t frac32 = (int32_t)g_apll.base_frac16 + delta_frac16;
-    int32_t sdm2 = g_apll.sdm2;  // 工作副本
+    return fm_lut_sdm(carrier->lut, carrier->fine, sample);
+}
 
-    // 处理分数部分的借位/进位
-    if (frac32 < 0) {
-        int32_t borrow = (-frac32 + 65535) >> 16;  // 借位次数
-        frac32 += borrow * 65536;
-        sdm2 -= borrow;
-    } else if (frac32 > 65535) {
-        int32_t carry = frac32 >> 16;  // 进位次数
-        frac32 -= carry * 65536;
-        sdm2 += carry;
-    }
+// CLK_OUT1输出I2S0 MCLK = APLL / (N + b/a)
+// 驱动按采样率设置分频（8 kHz x 256时N约为3），载波会偏离APLL频率，这里原地改为FM_MCLK_DIV
+static void fm_set_mclk_div(void)
+{
+    I2S0.clkm_conf.clka_en = 1;
+    I2S0.clkm_conf.clkm_div_a = 1;
+    I2S0.clkm_conf.clkm_div_b = 0;
+    I2S0.clkm_conf.clkm_div_num = FM_MCLK_DIV;
+}
 
-    // 限制sdm2在有效范围内(0…63)
-    if (sdm2 < 0) {
-        sdm2 = 0;
-        frac32 = 0;
-    }
-    if (sdm2 > 63) {
-        sdm2 = 63;
-        frac32 = 65535;
-    }
+// 计算新载波的APLL配置和查找表，切换后写入中心频率系数
+// 只改写APLL系数和MCLK分频，不触碰I2S驱动和DMA，调用者需持有s_retune_lock
+static void fm_apll_retune(uint32_t frequency)
+{
+    // 在当前未使用的副本中计算，APLL按MCLK分频后为载波频率
+    fm_carrier_t* next = (s_active == &s_carrier[0]) ? &s_carrier[1] : &s_carrier[0];
+    next->apll = fm_calc_apll(get_xtal_hz(), frequency * FM_MCLK_DIV, MAX_DEV_HZ);
+    next->apll.is_rev0 = (efuse_ll_get_chip_ver_rev1() == 0);
+    fm_build_dev_lut(&next->apll, next->lut);
+    fm_build_dev_fine(&next->apll, next->fine);
 
-    uint8_t sdm0 = frac32 & 0xFF;
-    uint8_t sdm1 = frac32 >> 8;
+    g_frequency = frequency;
+    s_active = next;
 
-    // 设置APLL配置
-    clk_ll_apll_set_config(g_apll.is_rev0,
-                          g_apll.o_div,
-                          sdm0,
-                          sdm1,
-                          (uint8_t)sdm2);
+    // 零偏移（样本128）即载波中心，之后的第一个样本完整写入
+    fm_write_sdm(next->lut[128]);
+    s_hw_word = UINT32_MAX;
+    fm_set_mclk_div();
 }
 
 // 初始化APLL
 static void fm_apll_init(void)
 {
-    g_apll = fm_calc_apll(FM_FREQUENCY, MAX_DEV_HZ);
-
-    uint8_t sdm0 = g_apll.base_frac16 & 0xFF;
-    uint8_t sdm1 = g_apll.base_frac16 >> 8;
-    
-    // 启用APLL
-    rtc_clk_apll_enable(true);
-    rtc_clk_apll_coeff_set(g_apll.o_div, sdm0, sdm1, g_apll.sdm2);
+    // I2S通道启用时已申请APLL，这里覆盖为载波系数
+    fm_apll_retune(FM_FREQUENCY);
 
+    const fm_apll_cfg_t* apll = &s_active->apll;
     ESP_LOGI(TAG, "APLL初始化成功: o_div=%u, sdm2=%u, frac=0x%04X, dev=%u LSB",
-             g_apll.o_div, g_apll.sdm2, g_apll.base_frac16, g_apll.dev_frac16);
+             apll->o_div, apll->sdm2, apll->base_frac16, apll->dev_frac16);
+}
+
+// 测量中断中一次APLL系数更新的CPU周期（含模拟总线写入）
+// 在路由到引脚之前进行，测量期间的频率跳变不会发射出去
+static void fm_measure_sdm_cost(void)
+{
+    uint32_t center = s_active->lut[128];
+    fm_write_sdm(center);
+    s_hw_word = center;
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < FM_SDM_PROBE_COUNT; i++) {
+        fm_update_sdm(center ^ (i & 1));
+    }
+    s_sdm_partial_cycles = (esp_cpu_get_cycle_count() - start) / FM_SDM_PROBE_COUNT;
+
+    start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < FM_SDM_PROBE_COUNT; i++) {
+        fm_update_sdm(center + ((uint32_t)(i & 1) << 16));
+    }
+    s_sdm_full_cycles = (esp_cpu_get_cycle_count() - start) / FM_SDM_PROBE_COUNT;
+
+    fm_write_sdm(center);
+    s_hw_word = UINT32_MAX;
+    ESP_LOGI(TAG, "APLL系数更新: 低字节%lu周期，完整写入%lu周期（%d kHz调制时每样本%lu周期）",
+             s_sdm_partial_cycles, s_sdm_full_cycles, (int)(FM_MOD_RATE_HZ / 1000),
+             (unsigned long)(esp_clk_cpu_freq() / FM_MOD_RATE_HZ));
 }
 
 // 将FM信号路由到GPIO
@@ -128,26 +173,37 @@ static void fm_route_to_pin(void)
     ESP_LOGI(TAG, "FM信号已路由到GPIO%d", FM_FM_PIN);
 }
 
-// 初始化I2S
+// 初始化I2S（标准模式通道驱动，时钟源为APLL）
+// 载波只由APLL系数决定，之后的重调谐不再重新配置通道
 static void fm_i2s_init(void)
 {
-    const i2s_config_t cfg = {
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
-        .sample_rate = WAV_SR_HZ,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
-        .communication_format = I2S_COMM_FORMAT_STAND_PCM_SHORT,
-        .use_apll = true,
-        .fixed_mclk = FM_FREQUENCY,
-        .dma_buf_count = 4,
-        .dma_buf_len = 64,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = 4;
+    chan_cfg.dma_frame_num = 64;
+    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &s_tx_chan, NULL));
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = {
+            .sample_rate_hz = WAV_SR_HZ,
+            .clk_src = I2S_CLK_SRC_APLL,
+            .mclk_multiple = I2S_MCLK_MULTIPLE_256,
+        },
+        .slot_cfg = I2S_STD_PCM_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,  // MCLK经CLK_OUT1输出
+            .bclk = I2S_GPIO_UNUSED,
+            .ws = I2S_GPIO_UNUSED,
+            .dout = I2S_GPIO_UNUSED,
+            .din = I2S_GPIO_UNUSED,
+        },
     };
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_RIGHT;
+
+    ESP_ERROR_CHECK(i2s_channel_init_std_mode(s_tx_chan, &std_cfg));
+    fm_set_mclk_div();
+    ESP_ERROR_CHECK(i2s_channel_enable(s_tx_chan));
     
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM_0, &cfg, 0, NULL));
-    ESP_ERROR_CHECK(i2s_start(I2S_NUM_0));
-    
-    ESP_LOGI(TAG, "I2S初始化成功，MCLK频率: %u Hz", FM_FREQUENCY);
+    ESP_LOGI(TAG, "I2S初始化成功，时钟源: APLL");
 }
 
 // 初始化FM发射器
@@ -155,78 +211,129 @@ esp_err_t fm_transmitter_init(void)
 {
     ESP_LOGI(TAG, "初始化FM发射器");
     
+    s_retune_lock = xSemaphoreCreateMutex();
+    if (!s_retune_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // 初始化音频处理链
+    fm_dsp_config_t dsp_cfg = FM_DSP_DEFAULT_CONFIG(FM_MOD_RATE_HZ);
+    ESP_ERROR_CHECK(fm_dsp_init(&s_dsp, &dsp_cfg));
+    
+    // 初始化I2S
+    fm_i2s_init();
+    
     // 初始化APLL
+    rtc_clk_apll_enable(true);
     fm_apll_init();
+    fm_measure_sdm_cost();
     
     // 路由到GPIO
     fm_route_to_pin();
     
-    // 初始化I2S
-    fm_i2s_init();
-    
     is_enabled = false;
     ESP_LOGI(TAG, "FM发射器初始化完成");
     return ESP_OK;
 }
 
-// 设置FM频率
+// 设置FM频率（快速重调谐，音频不中断）
 esp_err_t fm_transmitter_set_frequency(uint32_t frequency)
 {
-    ESP_LOGI(TAG, "设置FM频率: %lu Hz", frequency);
-    
-    // 重新计算APLL配置
-    g_apll = fm_calc_apll(frequency, MAX_DEV_HZ);
-    
-    uint8_t sdm0 = g_apll.base_frac16 & 0xFF;
-    uint8_t sdm1 = g_apll.base_frac16 >> 8;
-    
-    // 更新APLL配置
-    rtc_clk_apll_enable(true);
-    rtc_clk_apll_coeff_set(g_apll.o_div, sdm0, sdm1, g_apll.sdm2);
-    
-    // 更新I2S配置
-    i2s_stop(I2S_NUM_0);
-    i2s_driver_uninstall(I2S_NUM_0);
+    if (!s_retune_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    const i2s_config_t cfg = {
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
-        .sample_rate = WAV_SR_HZ,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
-        .communication_format = I2S_COMM_FORMAT_STAND_PCM_SHORT,
-        .use_apll = true,
-        .fixed_mclk = frequency,
-        .dma_buf_count = 4,
-        .dma_buf_len = 64,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1
-    };
+    xSemaphoreTake(s_retune_lock, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    fm_apll_retune(frequency);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
     
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM_0, &cfg, 0, NULL));
-    ESP_ERROR_CHECK(i2s_start(I2S_NUM_0));
+    s_retune_last_us = elapsed;
+    if (elapsed > s_retune_max_us) {
+        s_retune_max_us = elapsed;
+    }
+    xSemaphoreGive(s_retune_lock);
     
-    ESP_LOGI(TAG, "FM发射器频率已设置为: %lu Hz", frequency);
+    ESP_LOGD(TAG, "FM频率已设置为: %lu Hz, 耗时 %lu us", frequency, elapsed);
     return ESP_OK;
 }
 
-// 发送音频信号到FM发射器
-esp_err_t fm_transmitter_send_sample(uint8_t audio_sample)
+// 获取当前载波频率
+uint32_t fm_transmitter_get_frequency(void)
+{
+    return g_frequency;
+}
+
+// 获取重调谐耗时（微秒）
+void fm_transmitter_get_retune_us(uint32_t* last_us, uint32_t* max_us)
 {
+    if (last_us) {
+        *last_us = s_retune_last_us;
+    }
+    if (max_us) {
+        *max_us = s_retune_max_us;
+    }
+}
+
+// 获取开机时测得的APLL系数更新耗时（CPU周期）
+void fm_transmitter_get_sdm_cycles(uint32_t* partial, uint32_t* full)
+{
+    if (partial) {
+        *partial = s_sdm_partial_cycles;
+    }
+    if (full) {
+        *full = s_sdm_full_cycles;
+    }
+}
+
+// 发送一块16位PCM：经处理链后逐个写入频偏（由调用者控制节拍）
+esp_err_t fm_transmitter_write(const int16_t* pcm, size_t frames)
+{
+    if (!pcm) {
+        return ESP_ERR_INVALID_ARG;
+    }
     if (!is_enabled) {
         return ESP_OK;
     }
     
-    // 将0-255范围转换为-128到127
-    int16_t audio = (int16_t)audio_sample - 128;
-    
-    // 计算频率偏移（-dev_frac16到+dev_frac16）
-    int16_t delta = (audio * g_apll.dev_frac16) / 128;
-    
-    // 设置频率偏移
-    fm_set_deviation(delta);
-    
+    int16_t chunk[FM_DSP_LOOKAHEAD];
+    while (frames > 0) {
+        size_t n = frames < FM_DSP_LOOKAHEAD ? frames : FM_DSP_LOOKAHEAD;
+        fm_dsp_process(&s_dsp, pcm, chunk, n);
+        for (size_t i = 0; i < n; i++) {
+            fm_update_sdm(fm_sample_sdm(s_active, chunk[i]));
+        }
+        pcm += n;
+        frames -= n;
+    }
     return ESP_OK;
 }
 
+// 将一块PCM经处理链后作为输出字（在音频生产者任务中调用）
+// 频偏换算推迟到中断中进行，重调谐后下一个采样即使用新载波
+void fm_transmitter_encode_block(const int16_t* pcm, uint32_t* words, size_t frames)
+{
+    int16_t chunk[FM_DSP_LOOKAHEAD];
+    while (frames > 0) {
+        size_t n = frames < FM_DSP_LOOKAHEAD ? frames : FM_DSP_LOOKAHEAD;
+        fm_dsp_process(&s_dsp, pcm, chunk, n);
+        for (size_t i = 0; i < n; i++) {
+            words[i] = (uint16_t)chunk[i];
+        }
+        pcm += n;
+        words += n;
+        frames -= n;
+    }
+}
+
+// 在调制定时器中断中按当前载波查表换算频偏，只写入变化的APLL寄存器
+void IRAM_ATTR fm_transmitter_apply_sdm(uint32_t word)
+{
+    if (is_enabled) {
+        fm_update_sdm(fm_sample_sdm(s_active, (int16_t)word));
+    }
+}
+
 // 启用FM发射器
 esp_err_t fm_transmitter_enable(void)
 {
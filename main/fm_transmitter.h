@@ -2,32 +2,50 @@
 #define FM_TRANSMITTER_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "fm_apll.h"
 
 // 配置
 #define FM_FREQUENCY 85000000  // 85.0MHz
 #define FM_FM_PIN 0           // 使用GPIO0作为FM输出（通过CLK_OUT1）
 #define MAX_DEV_HZ 75000UL     // ±75 kHz标准广播
 #define WAV_SR_HZ 8000         // 采样率（8 kHz）
-
-// APLL配置结构
-typedef struct {
-    uint8_t o_div;         // 输出分频器
-    uint8_t sdm2;          // 整数部分
-    uint16_t base_frac16;  // 基准分数部分（16位）
-    uint16_t dev_frac16;   // 偏差分数部分（16位）
-    bool is_rev0;          // 是否为ESP32 rev0芯片
-} fm_apll_cfg_t;
+#ifdef CONFIG_FM_STEREO
+#include "fm_mpx.h"
+#define FM_MOD_RATE_HZ FM_MPX_RATE_HZ  // 立体声：复合信号速率（133 kHz，无RDS时114 kHz）
+#else
+#define FM_MOD_RATE_HZ 32000   // 频偏更新速率（32 kHz）
+#endif
 
 // 初始化FM发射器
 esp_err_t fm_transmitter_init(void);
 
 // 设置FM频率
+// 只改写APLL系数和MCLK分频并切换频偏查找表，不重装I2S驱动，可在播放中调用
 esp_err_t fm_transmitter_set_frequency(uint32_t frequency);
 
-// 发送音频信号到FM发射器
-// audio_sample: 音频样本值（范围：0-255）
-esp_err_t fm_transmitter_send_sample(uint8_t audio_sample);
+// 获取当前载波频率
+uint32_t fm_transmitter_get_frequency(void);
+
+// 获取最近一次和最大的重调谐耗时（微秒）
+void fm_transmitter_get_retune_us(uint32_t* last_us, uint32_t* max_us);
+
+// 开机时测得的一次APLL系数更新的CPU周期：只写分数部分低字节 / 完整写入
+void fm_transmitter_get_sdm_cycles(uint32_t* partial, uint32_t* full);
+
+// 发送一块16位PCM（经预加重、低通和限幅处理，调用者控制节拍）
+esp_err_t fm_transmitter_write(const int16_t* pcm, size_t frames);
+
+// 将一块16位PCM经处理链后作为输出字（低16位为样本）
+// 已处理好的信号（如立体声复合信号）不需要转换，输出字即样本
+void fm_transmitter_encode_block(const int16_t* pcm, uint32_t* words, size_t frames);
+
+// 按16位样本换算频偏并写入APLL系数（在调制定时器中断中调用）
+// 满幅对应±MAX_DEV_HZ，高字节和低字节分别查表，误差不超过APLL分数部分的2 LSB（85 MHz时1 LSB约100 Hz）
+void fm_transmitter_apply_sdm(uint32_t word);
 
 // 启用FM发射器
 esp_err_t fm_transmitter_enable(void);
@@ -38,8 +56,4 @@ esp_err_t fm_transmitter_disable(void);
 // 检查FM发射器是否已启用
 bool fm_transmitter_is_enabled(void);
 
-// 内部函数声明（仅用于实现）
-static fm_apll_cfg_t fm_calc_apll(uint32_t fout_hz, uint32_t dev_hz);
-static inline void fm_set_deviation(int16_t delta_frac16);
-
 #endif /* FM_TRANSMITTER_H */
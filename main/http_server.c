@@ -12,6 +12,7 @@
 #include <esp_log.h>
 #include <esp_system.h>
 #include <esp_timer.h>
+#include <esp_mac.h>
 #include <sys/param.h>
 //#include "nvs_flash.h"
 #include "esp_netif.h"
@@ -25,6 +26,17 @@
 
 #include "pages.h"
 #include "router_globals.h"
+#include "portmap.h"
+#include "napt_stats.h"
+#include "task_config.h"
+#include "www_assets.h"
+#include "captive.h"
+#include "dhcp_leases.h"
+#include "shaper.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_FM_RDS
+#include "fm_rds.h"
+#endif
 
 // 外部函数声明
 extern int set_ap(int argc, char **argv);
@@ -39,6 +51,8 @@ static const char *TAG = "HTTPServer";
 
 // 函数声明
 static esp_err_t modern_index_handler(httpd_req_t *req);
+static const www_asset_t* find_asset(const char* uri);
+static esp_err_t asset_handler(httpd_req_t *req, const www_asset_t* asset);
 static esp_err_t config_post_handler(httpd_req_t *req);
 
 esp_timer_handle_t restart_timer;
@@ -175,6 +189,108 @@ static esp_err_t index_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+static void shaper_limit_to_json(cJSON *parent, const char *name, const shaper_limit_t *limit)
+{
+    cJSON *item = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(item, "up", limit->up_kbps);
+    cJSON_AddNumberToObject(item, "down", limit->down_kbps);
+}
+
+/* 限速配置，速率单位kbps，0表示不限：
+   {"total": {"up": 20000, "down": 50000}, "client": {"up": 0, "down": 0},
+    "rules": [{"client": "aa:bb:cc:dd:ee:ff", "up": 1000, "down": 5000}]} */
+static cJSON *shaper_config_to_json(void)
+{
+    shaper_config_t cfg;
+    shaper_get_config(&cfg);
+    cJSON *shaper = cJSON_CreateObject();
+    shaper_limit_to_json(shaper, "total", &cfg.total);
+    shaper_limit_to_json(shaper, "client", &cfg.client);
+
+    cJSON *list = cJSON_AddArrayToObject(shaper, "rules");
+    shaper_rule_t rules[SHAPER_RULES];
+    size_t n = shaper_get_rules(rules, SHAPER_RULES);
+    for (size_t i = 0; i < n; i++) {
+        char client_str[18];
+        if (rules[i].ip == 0) {
+            snprintf(client_str, sizeof(client_str), MACSTR, MAC2STR(rules[i].mac));
+        } else {
+            esp_ip4_addr_t addr = { .addr = rules[i].ip };
+            snprintf(client_str, sizeof(client_str), IPSTR, IP2STR(&addr));
+        }
+        cJSON *rule = cJSON_CreateObject();
+        cJSON_AddStringToObject(rule, "client", client_str);
+        cJSON_AddNumberToObject(rule, "up", rules[i].limit.up_kbps);
+        cJSON_AddNumberToObject(rule, "down", rules[i].limit.down_kbps);
+        cJSON_AddItemToArray(list, rule);
+    }
+    return shaper;
+}
+
+/* 读取up/down，缺省的字段保持原值 */
+static bool shaper_limit_from_json(const cJSON *item, shaper_limit_t *limit)
+{
+    if (!cJSON_IsObject(item)) {
+        return false;
+    }
+    cJSON *up = cJSON_GetObjectItem(item, "up");
+    cJSON *down = cJSON_GetObjectItem(item, "down");
+    if (cJSON_IsNumber(up) && up->valuedouble >= 0) {
+        limit->up_kbps = (uint32_t)up->valuedouble;
+    }
+    if (cJSON_IsNumber(down) && down->valuedouble >= 0) {
+        limit->down_kbps = (uint32_t)down->valuedouble;
+    }
+    return true;
+}
+
+/* 格式同shaper_config_to_json；"replace": true时先删除全部规则，规则中"delete": true时删除该客户端的规则 */
+static esp_err_t shaper_config_from_json(const cJSON *shaper)
+{
+    esp_err_t err = ESP_OK;
+    shaper_config_t cfg;
+    shaper_get_config(&cfg);
+    bool total = shaper_limit_from_json(cJSON_GetObjectItem(shaper, "total"), &cfg.total);
+    bool client = shaper_limit_from_json(cJSON_GetObjectItem(shaper, "client"), &cfg.client);
+    if (total || client) {
+        err = shaper_set_config(&cfg);
+    }
+    if (err == ESP_OK && cJSON_IsTrue(cJSON_GetObjectItem(shaper, "replace"))) {
+        err = shaper_clear_rules();
+    }
+
+    cJSON *rules = cJSON_GetObjectItem(shaper, "rules");
+    if (err != ESP_OK || !cJSON_IsArray(rules)) {
+        return err;
+    }
+    cJSON *rule;
+    cJSON_ArrayForEach(rule, rules) {
+        cJSON *client_item = cJSON_GetObjectItem(rule, "client");
+        if (!cJSON_IsString(client_item)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint8_t mac[6];
+        const uint8_t *mac_arg = NULL;
+        uint32_t ip = 0;
+        if (dhcp_leases_parse_mac(client_item->valuestring, mac)) {
+            mac_arg = mac;
+        } else {
+            ip = esp_ip4addr_aton(client_item->valuestring);
+        }
+        if (cJSON_IsTrue(cJSON_GetObjectItem(rule, "delete"))) {
+            err = shaper_del_rule(mac_arg, ip);
+        } else {
+            shaper_limit_t limit = { 0 };
+            shaper_limit_from_json(rule, &limit);
+            err = shaper_set_rule(mac_arg, ip, &limit);
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+    }
+    return err;
+}
+
 /* 获取当前配置的API端点 */
 static esp_err_t get_config_handler(httpd_req_t *req)
 {
@@ -196,6 +312,7 @@ static esp_err_t get_config_handler(httpd_req_t *req)
     cJSON_AddStringToObject(response, "ap_ssid", err3 == ESP_OK ? ap_ssid : "ESP32_Repeater");
     cJSON_AddStringToObject(response, "ap_passwd", err4 == ESP_OK ? ap_passwd : "12345678");
     cJSON_AddStringToObject(response, "ap_mac", ""); // 默认空
+    cJSON_AddItemToObject(response, "shaper", shaper_config_to_json());
     
 
     char *response_string = cJSON_Print(response);
@@ -336,6 +453,19 @@ static esp_err_t config_post_handler(httpd_req_t *req)
         free(mac_str);
     }
 
+    /* 处理限速配置，立即生效，不需要重启 */
+    bool shaper_updated = false;
+    cJSON *shaper = cJSON_GetObjectItem(json, "shaper");
+    if (cJSON_IsObject(shaper)) {
+        esp_err_t err = shaper_config_from_json(shaper);
+        if (err == ESP_OK) {
+            shaper_updated = true;
+        } else {
+            ESP_LOGW(TAG, "Shaper config rejected: %s", esp_err_to_name(err));
+            cJSON_AddStringToObject(response, "shaper_error", esp_err_to_name(err));
+        }
+    }
+
     /* 发送响应 */
     if (config_updated) {
         cJSON_AddBoolToObject(response, "success", true);
@@ -343,6 +473,9 @@ static esp_err_t config_post_handler(httpd_req_t *req)
 
         /* 5秒后重启 */
         esp_timer_start_once(restart_timer, 5000000);
+    } else if (shaper_updated) {
+        cJSON_AddBoolToObject(response, "success", true);
+        cJSON_AddStringToObject(response, "message", "Rate limits applied");
     } else {
         cJSON_AddBoolToObject(response, "success", false);
         cJSON_AddStringToObject(response, "error", "No valid configuration provided");
@@ -376,122 +509,574 @@ static httpd_uri_t config_get = {
     .handler   = get_config_handler,
 };
 
-/* 强制门户重定向处理器 */
-static esp_err_t captive_portal_handler(httpd_req_t *req)
+/* 导出端口映射：{"rules": [{"proto": "UDP", "ext_port": 10000, "count": 101, "int_ip": "192.168.4.2", "int_port": 10000}]} */
+static esp_err_t portmap_get_handler(httpd_req_t *req)
+{
+    portmap_entry_t *entries = malloc(sizeof(portmap_entry_t) * PORTMAP_MAX);
+    if (entries == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t n = portmap_get_all(entries, PORTMAP_MAX);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON *rules = cJSON_AddArrayToObject(response, "rules");
+    for (size_t i = 0; i < n; i++) {
+        char ip_str[16];
+        esp_ip4_addr_t addr = { .addr = entries[i].daddr };
+        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&addr));
+
+        cJSON *rule = cJSON_CreateObject();
+        cJSON_AddStringToObject(rule, "proto", entries[i].proto == PROTO_TCP ? "TCP" : "UDP");
+        cJSON_AddNumberToObject(rule, "ext_port", entries[i].mport);
+        cJSON_AddNumberToObject(rule, "count", entries[i].count);
+        cJSON_AddStringToObject(rule, "int_ip", ip_str);
+        cJSON_AddNumberToObject(rule, "int_port", entries[i].dport);
+        cJSON_AddItemToArray(rules, rule);
+    }
+    free(entries);
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+    httpd_resp_send(req, response_string, strlen(response_string));
+
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
+/* 批量导入端口映射，格式与导出相同；"replace": true时先清空已有规则 */
+static esp_err_t portmap_post_handler(httpd_req_t *req)
 {
-    const char* host_header = NULL;
-    size_t host_len = httpd_req_get_hdr_value_len(req, "Host");
+    int ret, remaining = req->content_len;
 
-    if (host_len > 0) {
-        char* host_value = malloc(host_len + 1);
-        if (httpd_req_get_hdr_value_str(req, "Host", host_value, host_len + 1) == ESP_OK) {
-            host_header = host_value;
+    if (remaining <= 0 || remaining > 4096) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Content too long");
+        return ESP_FAIL;
+    }
+
+    char *buf = malloc(remaining + 1);
+    if (buf == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    int received = 0;
+    while (received < remaining) {
+        ret = httpd_req_recv(req, buf + received, remaining - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+            }
+            free(buf);
+            return ESP_FAIL;
         }
+        received += ret;
     }
+    buf[received] = '\0';
 
-    // 检查是否是对192.168.4.1的直接访问
-    if (host_header && (strcmp(host_header, "192.168.4.1") == 0 ||
-                       strcmp(host_header, "192.168.4.1:80") == 0)) {
-        // 直接访问IP，返回配网页面
-        if (host_header) free((void*)host_header);
-        return modern_index_handler(req);
+    cJSON *json = cJSON_Parse(buf);
+    free(buf);
+    if (json == NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
     }
 
-    // 其他域名访问，重定向到配网页面
-    ESP_LOGI(TAG, "Captive portal redirect for host: %s", host_header ? host_header : "unknown");
+    cJSON *rules = cJSON_GetObjectItem(json, "rules");
+    if (!cJSON_IsArray(rules)) {
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing rules");
+        return ESP_FAIL;
+    }
 
-    if (host_header) free((void*)host_header);
+    if (cJSON_IsTrue(cJSON_GetObjectItem(json, "replace"))) {
+        portmap_clear();
+    }
 
-    // 使用标准HTTP重定向
-    httpd_resp_set_status(req, "302 Found");
-    httpd_resp_set_hdr(req, "Location", "http://192.168.4.1/");
+    int added = 0;
+    cJSON *response = cJSON_CreateObject();
+    cJSON *errors = cJSON_CreateArray();
+    cJSON *rule;
+    cJSON_ArrayForEach(rule, rules) {
+        cJSON *proto = cJSON_GetObjectItem(rule, "proto");
+        cJSON *ext_port = cJSON_GetObjectItem(rule, "ext_port");
+        cJSON *count = cJSON_GetObjectItem(rule, "count");
+        cJSON *int_ip = cJSON_GetObjectItem(rule, "int_ip");
+        cJSON *int_port = cJSON_GetObjectItem(rule, "int_port");
+
+        esp_err_t err = ESP_ERR_INVALID_ARG;
+        if (cJSON_IsString(proto) && cJSON_IsNumber(ext_port) && cJSON_IsString(int_ip) && cJSON_IsNumber(int_port) &&
+            ext_port->valueint >= 0 && ext_port->valueint <= 65535 &&
+            int_port->valueint >= 0 && int_port->valueint <= 65535) {
+            uint8_t p = strcmp(proto->valuestring, "TCP") == 0 ? PROTO_TCP :
+                        strcmp(proto->valuestring, "UDP") == 0 ? PROTO_UDP : 0;
+            int n = cJSON_IsNumber(count) ? count->valueint : 1;
+            uint32_t daddr;
+            if (p != 0 && n >= 1 && n <= 65535) {
+                // int_ip也可以是客户端MAC，此时保留其DHCP地址
+                err = resolve_portmap_target(int_ip->valuestring, &daddr);
+                if (err == ESP_OK) {
+                    err = portmap_add_range(p, ext_port->valueint, n, daddr, int_port->valueint);
+                }
+            }
+        }
+
+        if (err == ESP_OK) {
+            added++;
+        } else {
+            cJSON_AddItemToArray(errors, cJSON_CreateString(esp_err_to_name(err)));
+        }
+    }
+    cJSON_Delete(json);
+
+    cJSON_AddBoolToObject(response, "success", cJSON_GetArraySize(errors) == 0);
+    cJSON_AddNumberToObject(response, "added", added);
+    cJSON_AddItemToObject(response, "errors", errors);
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send(req, response_string, strlen(response_string));
+
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
+static httpd_uri_t portmap_get = {
+    .uri       = "/api/portmap",
+    .method    = HTTP_GET,
+    .handler   = portmap_get_handler,
+};
+
+static httpd_uri_t portmap_post = {
+    .uri       = "/api/portmap",
+    .method    = HTTP_POST,
+    .handler   = portmap_post_handler,
+};
+
+/* DHCP租约：{"leases": [{"mac": "aa:bb:cc:dd:ee:ff", "ip": "192.168.4.2", "reserved": true, "bound": true, "remaining": 7000, "hostname": "phone"}]} */
+static esp_err_t leases_get_handler(httpd_req_t *req)
+{
+    dhcp_lease_info_t *leases = malloc(sizeof(dhcp_lease_info_t) * DHCP_LEASES_MAX);
+    if (leases == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t n = dhcp_leases_get_all(leases, DHCP_LEASES_MAX);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON *list = cJSON_AddArrayToObject(response, "leases");
+    for (size_t i = 0; i < n; i++) {
+        char mac_str[18];
+        char ip_str[16];
+        esp_ip4_addr_t addr = { .addr = leases[i].ip };
+        snprintf(mac_str, sizeof(mac_str), MACSTR, MAC2STR(leases[i].mac));
+        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&addr));
+
+        cJSON *lease = cJSON_CreateObject();
+        cJSON_AddStringToObject(lease, "mac", mac_str);
+        cJSON_AddStringToObject(lease, "ip", ip_str);
+        cJSON_AddBoolToObject(lease, "reserved", leases[i].reserved);
+        cJSON_AddBoolToObject(lease, "bound", leases[i].bound);
+        cJSON_AddNumberToObject(lease, "remaining", leases[i].remaining);
+        cJSON_AddStringToObject(lease, "hostname", leases[i].hostname);
+        cJSON_AddItemToArray(list, lease);
+    }
+    free(leases);
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
-    httpd_resp_set_hdr(req, "Pragma", "no-cache");
-    httpd_resp_set_hdr(req, "Expires", "0");
-    httpd_resp_send(req, NULL, 0);
+    httpd_resp_send(req, response_string, strlen(response_string));
 
+    free(response_string);
+    cJSON_Delete(response);
     return ESP_OK;
 }
 
-/* 通配符路由处理器 */
-static esp_err_t wildcard_handler(httpd_req_t *req)
+/* 保留地址：{"mac": "aa:bb:cc:dd:ee:ff", "ip": "192.168.4.20"}，省略ip时保留当前地址；"delete": true取消保留 */
+static esp_err_t leases_post_handler(httpd_req_t *req)
 {
-    // 检查User-Agent是否包含CaptiveNetworkSupport（iOS）或其他强制门户检测
-    size_t user_agent_len = httpd_req_get_hdr_value_len(req, "User-Agent");
-    if (user_agent_len > 0) {
-        char* user_agent = malloc(user_agent_len + 1);
-        if (httpd_req_get_hdr_value_str(req, "User-Agent", user_agent, user_agent_len + 1) == ESP_OK) {
-            // iOS强制门户检测
-            if (strstr(user_agent, "CaptiveNetworkSupport") != NULL) {
-                free(user_agent);
-
-                // 返回简单的成功页面，触发强制门户
-                const char* success_page =
-                    "<!DOCTYPE html><html><head><title>Success</title></head>"
-                    "<body><script>window.location.href='http://192.168.4.1/';</script></body></html>";
-
-                httpd_resp_set_type(req, "text/html");
-                httpd_resp_send(req, success_page, strlen(success_page));
-                return ESP_OK;
+    char buf[128];
+    int len = req->content_len;
+    if (len <= 0 || len >= sizeof(buf)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Content too long");
+        return ESP_FAIL;
+    }
+    int received = 0;
+    while (received < len) {
+        int ret = httpd_req_recv(req, buf + received, len - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
             }
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    buf[received] = '\0';
+
+    cJSON *json = cJSON_Parse(buf);
+    if (json == NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    uint8_t mac[6];
+    cJSON *mac_item = cJSON_GetObjectItem(json, "mac");
+    cJSON *ip_item = cJSON_GetObjectItem(json, "ip");
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (cJSON_IsString(mac_item) && dhcp_leases_parse_mac(mac_item->valuestring, mac)) {
+        if (cJSON_IsTrue(cJSON_GetObjectItem(json, "delete"))) {
+            err = dhcp_leases_unreserve(mac);
+        } else {
+            err = dhcp_leases_reserve(mac, cJSON_IsString(ip_item) ? esp_ip4addr_aton(ip_item->valuestring) : 0);
         }
-        free(user_agent);
     }
+    cJSON_Delete(json);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddBoolToObject(response, "success", err == ESP_OK);
+    if (err != ESP_OK) {
+        cJSON_AddStringToObject(response, "error", esp_err_to_name(err));
+    }
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send(req, response_string, strlen(response_string));
+
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
+static httpd_uri_t leases_get = {
+    .uri       = "/api/leases",
+    .method    = HTTP_GET,
+    .handler   = leases_get_handler,
+};
+
+static httpd_uri_t leases_post = {
+    .uri       = "/api/leases",
+    .method    = HTTP_POST,
+    .handler   = leases_post_handler,
+};
 
-    // 默认重定向到配网页面
-    return captive_portal_handler(req);
+static cJSON *napt_client_to_json(const napt_client_stats_t *c)
+{
+    char ip_str[16];
+    esp_ip4_addr_t addr = { .addr = c->addr };
+    snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&addr));
+
+    cJSON *client = cJSON_CreateObject();
+    cJSON_AddStringToObject(client, "ip", ip_str);
+    cJSON_AddNumberToObject(client, "tx_bytes", (double)c->tx_bytes);
+    cJSON_AddNumberToObject(client, "rx_bytes", (double)c->rx_bytes);
+    cJSON_AddNumberToObject(client, "tx_pkts", c->tx_pkts);
+    cJSON_AddNumberToObject(client, "rx_pkts", c->rx_pkts);
+    cJSON_AddNumberToObject(client, "tx_rate", c->tx_rate);
+    cJSON_AddNumberToObject(client, "rx_rate", c->rx_rate);
+    return client;
 }
 
-/* 处理各种操作系统的连接检测请求 */
-static esp_err_t connectivity_check_handler(httpd_req_t *req)
+/* NAPT连接表和客户端流量统计 */
+static esp_err_t napt_stats_get_handler(httpd_req_t *req)
 {
-    ESP_LOGI(TAG, "Connectivity check request: %s", req->uri);
+    napt_stats_t stats;
+    napt_stats_get(&stats);
 
-    // 对于强制门户，重定向到配网页面而不是返回204
-    // 这样可以更好地触发强制门户弹出
-    httpd_resp_set_status(req, "302 Found");
-    httpd_resp_set_hdr(req, "Location", "http://192.168.4.1/");
+    cJSON *response = cJSON_CreateObject();
+    cJSON *table = cJSON_AddObjectToObject(response, "table");
+    cJSON_AddBoolToObject(table, "valid", stats.table_valid);
+    cJSON_AddNumberToObject(table, "size", stats.table_size);
+    cJSON_AddNumberToObject(table, "tcp", stats.active_tcp);
+    cJSON_AddNumberToObject(table, "udp", stats.active_udp);
+    cJSON_AddNumberToObject(table, "icmp", stats.active_icmp);
+    cJSON_AddNumberToObject(table, "evictions", stats.evictions);
+    cJSON_AddNumberToObject(table, "evict_rate", stats.evict_rate);
+    cJSON_AddNumberToObject(table, "tcp_new", stats.tcp_new);
+    cJSON_AddNumberToObject(table, "tcp_new_rate", stats.tcp_new_rate);
+    cJSON_AddNumberToObject(table, "udp_new", stats.udp_new);
+    cJSON_AddNumberToObject(table, "udp_new_rate", stats.udp_new_rate);
+    cJSON_AddNumberToObject(table, "icmp_new", stats.icmp_new);
+    cJSON_AddNumberToObject(table, "icmp_new_rate", stats.icmp_new_rate);
+
+    cJSON *top = cJSON_AddArrayToObject(response, "top");
+    for (size_t i = 0; i < stats.top_count; i++) {
+        cJSON_AddItemToArray(top, napt_client_to_json(&stats.top[i]));
+    }
+
+    cJSON *clients = cJSON_AddArrayToObject(response, "clients");
+    napt_client_stats_t *list = malloc(sizeof(napt_client_stats_t) * NAPT_STATS_CLIENTS);
+    if (list != NULL) {
+        size_t n = napt_stats_get_clients(list, NAPT_STATS_CLIENTS);
+        for (size_t i = 0; i < n; i++) {
+            cJSON_AddItemToArray(clients, napt_client_to_json(&list[i]));
+        }
+        free(list);
+    }
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
-    httpd_resp_set_hdr(req, "Pragma", "no-cache");
-    httpd_resp_set_hdr(req, "Expires", "0");
-    httpd_resp_send(req, NULL, 0);
+    httpd_resp_send(req, response_string, strlen(response_string));
 
+    free(response_string);
+    cJSON_Delete(response);
     return ESP_OK;
 }
 
-// 各种操作系统的连接检测URL
-static httpd_uri_t generate_204 = {
-    .uri       = "/generate_204",  // Android
+static httpd_uri_t napt_stats_uri = {
+    .uri       = "/api/napt_stats",
     .method    = HTTP_GET,
-    .handler   = connectivity_check_handler,
+    .handler   = napt_stats_get_handler,
 };
 
-static httpd_uri_t hotspot_detect = {
-    .uri       = "/hotspot-detect.html",  // iOS
-    .method    = HTTP_GET,
-    .handler   = captive_portal_handler,
-};
+static cJSON *shaper_queue_to_json(const shaper_queue_stats_t *q)
+{
+    cJSON *item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(item, "depth", q->depth);
+    cJSON_AddNumberToObject(item, "max_depth", q->max_depth);
+    cJSON_AddNumberToObject(item, "passed", q->passed);
+    cJSON_AddNumberToObject(item, "queued", q->queued);
+    cJSON_AddNumberToObject(item, "drops", q->drops);
+    return item;
+}
+
+/* 限速队列计数：各方向合计和每个客户端的队列深度、丢包 */
+static esp_err_t shaper_get_handler(httpd_req_t *req)
+{
+    shaper_stats_t stats;
+    shaper_get_stats(&stats);
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddBoolToObject(response, "running", stats.running);
+    cJSON *up = shaper_queue_to_json(&stats.q[SHAPER_UP]);
+    cJSON_AddBoolToObject(up, "active", stats.active[SHAPER_UP]);
+    cJSON_AddItemToObject(response, "up", up);
+    cJSON *down = shaper_queue_to_json(&stats.q[SHAPER_DOWN]);
+    cJSON_AddBoolToObject(down, "active", stats.active[SHAPER_DOWN]);
+    cJSON_AddItemToObject(response, "down", down);
+
+    cJSON *clients = cJSON_AddArrayToObject(response, "clients");
+    shaper_client_t *list = malloc(sizeof(shaper_client_t) * SHAPER_CLIENTS);
+    if (list != NULL) {
+        size_t n = shaper_get_clients(list, SHAPER_CLIENTS);
+        for (size_t i = 0; i < n; i++) {
+            char ip_str[16];
+            esp_ip4_addr_t addr = { .addr = list[i].addr };
+            snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&addr));
+
+            cJSON *client = cJSON_CreateObject();
+            cJSON_AddStringToObject(client, "ip", ip_str);
+            cJSON_AddNumberToObject(client, "up_kbps", list[i].limit.up_kbps);
+            cJSON_AddNumberToObject(client, "down_kbps", list[i].limit.down_kbps);
+            cJSON_AddItemToObject(client, "up", shaper_queue_to_json(&list[i].q[SHAPER_UP]));
+            cJSON_AddItemToObject(client, "down", shaper_queue_to_json(&list[i].q[SHAPER_DOWN]));
+            cJSON_AddItemToArray(clients, client);
+        }
+        free(list);
+    }
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+    httpd_resp_send(req, response_string, strlen(response_string));
+
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
 
-static httpd_uri_t library_test = {
-    .uri       = "/library/test/success.html",  // iOS
+static httpd_uri_t shaper_uri = {
+    .uri       = "/api/shaper",
     .method    = HTTP_GET,
-    .handler   = captive_portal_handler,
+    .handler   = shaper_get_handler,
 };
 
-static httpd_uri_t ncsi_txt = {
-    .uri       = "/ncsi.txt",  // Windows
+#ifdef CONFIG_FM_RDS
+/* 发送RDS当前设置 */
+static esp_err_t send_rds_state(httpd_req_t *req)
+{
+    uint16_t pi;
+    char ps[FM_RDS_PS_LEN + 1];
+    char rt[FM_RDS_RT_LEN + 1];
+    fm_rds_get_text(&pi, ps, sizeof(ps), rt, sizeof(rt));
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddNumberToObject(response, "pi", pi);
+    cJSON_AddStringToObject(response, "ps", ps);
+    cJSON_AddStringToObject(response, "rt", rt);
+    cJSON_AddBoolToObject(response, "auto", fm_rds_is_auto());
+
+    char *response_string = cJSON_Print(response);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+    httpd_resp_send(req, response_string, strlen(response_string));
+
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
+/* 获取RDS节目服务名和广播文本 */
+static esp_err_t rds_get_handler(httpd_req_t *req)
+{
+    return send_rds_state(req);
+}
+
+/* 设置RDS：{"ps": "...", "rt": "...", "pi": 4660, "auto": false} */
+static esp_err_t rds_post_handler(httpd_req_t *req)
+{
+    char buf[256];
+    int ret, remaining = req->content_len;
+
+    if (remaining >= sizeof(buf)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Content too long");
+        return ESP_FAIL;
+    }
+
+    ret = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
+    if (ret <= 0) {
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            httpd_resp_send_408(req);
+        }
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    cJSON *json = cJSON_Parse(buf);
+    if (json == NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    cJSON *pi = cJSON_GetObjectItem(json, "pi");
+    cJSON *ps = cJSON_GetObjectItem(json, "ps");
+    cJSON *rt = cJSON_GetObjectItem(json, "rt");
+    cJSON *automatic = cJSON_GetObjectItem(json, "auto");
+
+    if (cJSON_IsNumber(pi) && pi->valueint >= 0 && pi->valueint <= 0xFFFF) {
+        fm_rds_set_pi((uint16_t)pi->valueint);
+    }
+    if (cJSON_IsString(ps)) {
+        fm_rds_set_ps(ps->valuestring);
+    }
+    if (cJSON_IsString(rt)) {
+        fm_rds_set_rt(rt->valuestring);
+    }
+    if (cJSON_IsTrue(automatic)) {
+        fm_rds_set_auto(true);
+        fm_rds_update_router_state(ap_ssid, connect_count);
+    }
+
+    cJSON_Delete(json);
+    return send_rds_state(req);
+}
+
+static httpd_uri_t rds_get = {
+    .uri       = "/api/rds",
     .method    = HTTP_GET,
-    .handler   = connectivity_check_handler,
+    .handler   = rds_get_handler,
 };
 
-static httpd_uri_t connecttest = {
-    .uri       = "/connecttest.txt",  // Windows 10
-    .method    = HTTP_GET,
-    .handler   = connectivity_check_handler,
+static httpd_uri_t rds_post = {
+    .uri       = "/api/rds",
+    .method    = HTTP_POST,
+    .handler   = rds_post_handler,
 };
+#endif
+
+/* 强制门户：按请求头查表分类，请求头读到栈上的定长缓冲区 */
+static void req_hdr_copy(httpd_req_t *req, const char* field, char* buf, size_t len)
+{
+    // 过长的值截断后仍可用于匹配
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, buf, len);
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) {
+        buf[0] = '\0';
+    }
+}
+
+static esp_err_t captive_send_redirect(httpd_req_t *req)
+{
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", captive_portal_url());
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+    httpd_resp_set_hdr(req, "Pragma", "no-cache");
+    httpd_resp_set_hdr(req, "Expires", "0");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* 通配符路由处理器 */
+static esp_err_t wildcard_handler(httpd_req_t *req)
+{
+    // www/中的其他资源
+    const www_asset_t* asset = find_asset(req->uri);
+    if (asset) {
+        return asset_handler(req, asset);
+    }
+
+    char host[64];
+    char user_agent[128];
+    req_hdr_copy(req, "Host", host, sizeof(host));
+    req_hdr_copy(req, "User-Agent", user_agent, sizeof(user_agent));
+
+    // 未配置上行时始终弹出配网页面
+    bool online = ap_connect && strlen(ssid) > 0;
+    captive_result_t res = captive_classify(req->uri, host, user_agent, online);
+
+    switch (res.action) {
+    case CAPTIVE_SERVE:
+        // 直接访问AP地址，返回配网页面
+        return modern_index_handler(req);
+
+    case CAPTIVE_ONLINE:
+        // 已联网时回答系统期望的检测结果，避免反复弹出门户
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+        if (res.body == NULL) {
+            httpd_resp_set_status(req, "204 No Content");
+            return httpd_resp_send(req, NULL, 0);
+        }
+        httpd_resp_set_type(req, res.os == CAPTIVE_OS_APPLE ? "text/html" : "text/plain");
+        return httpd_resp_send(req, res.body, HTTPD_RESP_USE_STRLEN);
+
+    case CAPTIVE_APPLE_PAGE: {
+        // Apple CNA收到非Success页面即弹出门户，页面再跳转到配网页面
+        static char apple_page[128];
+        if (apple_page[0] == '\0') {
+            snprintf(apple_page, sizeof(apple_page),
+                "<!DOCTYPE html><html><head><title>Portal</title></head>"
+                "<body><script>window.location.href='%s';</script></body></html>",
+                captive_portal_url());
+        }
+        httpd_resp_set_type(req, "text/html");
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+        return httpd_resp_send(req, apple_page, HTTPD_RESP_USE_STRLEN);
+    }
+
+    case CAPTIVE_REDIRECT:
+    default:
+        ESP_LOGD(TAG, "Captive portal redirect (%s): %s%s", captive_os_name(res.os), host, req->uri);
+        return captive_send_redirect(req);
+    }
+}
 
 static httpd_uri_t captive_portal = {
-    .uri       = "/*",  // 通配符匹配所有路径
+    .uri       = "/*",  // 通配符匹配所有路径，包括各系统的连接检测URL
     .method    = HTTP_GET,
     .handler   = wildcard_handler,
 };
@@ -535,21 +1120,66 @@ char* html_escape(const char* src) {
     return res;
 }
 
-// DNS服务器功能已移除，使用阿里云DNS替代
-
 /* 新的index处理器，直接提供现代化的配网页面 */
-static esp_err_t modern_index_handler(httpd_req_t *req)
+static const www_asset_t* find_asset(const char* uri)
 {
-    extern const char index_html_start[] asm("_binary_index_html_start");
-    extern const char index_html_end[] asm("_binary_index_html_end");
-    const size_t index_html_size = (index_html_end - index_html_start);
+    size_t len = strcspn(uri, "?");
+    for (size_t i = 0; i < www_assets_count; i++) {
+        if (strlen(www_assets[i].uri) == len && strncmp(www_assets[i].uri, uri, len) == 0) {
+            return &www_assets[i];
+        }
+    }
+    return NULL;
+}
 
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
-    httpd_resp_set_hdr(req, "Pragma", "no-cache");
-    httpd_resp_set_hdr(req, "Expires", "0");
-    httpd_resp_send(req, index_html_start, index_html_size);
-    return ESP_OK;
+// 检查请求头中是否包含指定的值（如If-None-Match中的ETag、Accept-Encoding中的gzip）
+static bool req_hdr_contains(httpd_req_t *req, const char* field, const char* value)
+{
+    char buf[128];
+    if (httpd_req_get_hdr_value_str(req, field, buf, sizeof(buf)) != ESP_OK) {
+        return false;
+    }
+    return strstr(buf, value) != NULL;
+}
+
+/* 静态资源：直接从flash发送预压缩的数据，ETag匹配时返回304 */
+static esp_err_t asset_handler(httpd_req_t *req, const www_asset_t* asset)
+{
+    // 先按Accept-Encoding选定编码，ETag和304都针对选定的那一份
+    bool gzip = req_hdr_contains(req, "Accept-Encoding", "gzip");
+    const char* etag = gzip ? asset->etag_gzip : asset->etag;
+    size_t size = gzip ? asset->gzip_size : asset->identity_size;
+
+    // 每次都要求浏览器重新验证，固件更新后ETag随内容变化
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    if (req_hdr_contains(req, "If-None-Match", etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        ESP_LOGI(TAG, "%s: 304, saved %u bytes", asset->uri, (unsigned)size);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // 很小的文件压缩后可能比原文件大，节省量按有符号数输出
+    long saved = (long)asset->raw_size - (long)size;
+    httpd_resp_set_type(req, asset->type);
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        ESP_LOGI(TAG, "%s: %u bytes gzip, saved %ld bytes", asset->uri, (unsigned)size, saved);
+        return httpd_resp_send(req, (const char*)asset->gzip, size);
+    }
+    ESP_LOGI(TAG, "%s: %u bytes, saved %ld bytes", asset->uri, (unsigned)size, saved);
+    return httpd_resp_send(req, (const char*)asset->identity, size);
+}
+
+static esp_err_t modern_index_handler(httpd_req_t *req)
+{
+    const www_asset_t* asset = find_asset("/");
+    if (!asset) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    return asset_handler(req, asset);
 }
 
 static httpd_uri_t modern_index = {
@@ -562,10 +1192,15 @@ httpd_handle_t start_webserver(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = 16;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    const task_placement_t* placement = task_config_get(TASK_HTTPD);
+    config.core_id = placement->core < 0 ? tskNO_AFFINITY : placement->core;
+    config.task_priority = placement->priority;
+    config.stack_size = placement->stack;
 
     esp_timer_create(&restart_timer_args, &restart_timer);
-
-    // DNS服务器已移除，使用阿里云DNS替代
+    captive_init(my_ap_ip);
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -577,15 +1212,18 @@ httpd_handle_t start_webserver(void)
         httpd_register_uri_handler(server, &modern_index);
         httpd_register_uri_handler(server, &config_get);
         httpd_register_uri_handler(server, &config_post);
-
-        // 各种操作系统的连接检测URL
-        httpd_register_uri_handler(server, &generate_204);    // Android
-        httpd_register_uri_handler(server, &hotspot_detect);  // iOS
-        httpd_register_uri_handler(server, &library_test);    // iOS
-        httpd_register_uri_handler(server, &ncsi_txt);        // Windows
-        httpd_register_uri_handler(server, &connecttest);     // Windows 10
-
-        // 注册强制门户通配符处理器（必须最后注册）
+        httpd_register_uri_handler(server, &portmap_get);
+        httpd_register_uri_handler(server, &portmap_post);
+        httpd_register_uri_handler(server, &napt_stats_uri);
+        httpd_register_uri_handler(server, &shaper_uri);
+        httpd_register_uri_handler(server, &leases_get);
+        httpd_register_uri_handler(server, &leases_post);
+#ifdef CONFIG_FM_RDS
+        httpd_register_uri_handler(server, &rds_get);
+        httpd_register_uri_handler(server, &rds_post);
+#endif
+
+        // 注册强制门户通配符处理器（必须最后注册），各系统的连接检测URL由captive查表识别
         httpd_register_uri_handler(server, &captive_portal);
 
         ESP_LOGI(TAG, "Captive portal enabled - all requests will redirect to config page");
@@ -600,8 +1238,6 @@ httpd_handle_t start_webserver(void)
 
 static void stop_webserver(httpd_handle_t server)
 {
-    // DNS服务器已移除，无需停止
-
     // Stop the httpd server
     httpd_stop(server);
 }
@@ -0,0 +1,402 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_event.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "link_manager.h"
+
+// 配置
+#define TAG "LINK_MANAGER"
+#define LINK_LOG_MAGIC 0x4c4e4b31u          // "LNK1"，结构变化时修改
+
+// 断线记录放在RTC内存中，软件重启、看门狗和异常复位后仍在，上电时清空
+// 不写NVS：抖动的上行每分钟可能断开多次，写flash得不偿失
+typedef struct {
+    uint32_t magic;
+    uint32_t boot;
+    uint32_t head;                          // 下一条写入的位置
+    uint32_t count;
+    uint32_t logged;
+    uint8_t ssid[33];                       // 缓存的AP属于哪个SSID，配置修改后不再使用
+    uint8_t bssid[6];
+    uint8_t channel;                        // 0表示没有缓存的AP
+    link_event_t ev[LINK_MANAGER_LOG];
+} link_log_t;
+
+static RTC_NOINIT_ATTR link_log_t s_log;
+
+static SemaphoreHandle_t s_lock;            // 事件循环任务、esp_timer任务和控制台共用的状态
+static esp_timer_handle_t s_retry_timer;
+
+static bool s_up;
+static int64_t s_since_us;                  // 当前连接或断开状态开始的时间
+static int64_t s_total_up_us;
+static int64_t s_total_down_us;
+static int64_t s_retry_at_us;               // 0表示没有等待中的重连
+static int s_pending = -1;                  // 等待恢复的断线记录
+static uint32_t s_attempt;
+static uint32_t s_retries;                  // 本次断线以来的重连次数
+static bool s_fast;                         // 当前这次重连使用缓存的AP
+static bool s_switching;                    // 主动断开以切换上行
+static int8_t s_rssi;
+
+static uint32_t s_connects;
+static uint32_t s_disconnects;
+static uint32_t s_flaps;
+static uint32_t s_fast_reconnects;
+static uint32_t s_last_reconnect_ms;
+
+static void log_reset(void)
+{
+    memset(&s_log, 0, sizeof(s_log));
+    s_log.magic = LINK_LOG_MAGIC;
+}
+
+static bool log_valid(void)
+{
+    return s_log.magic == LINK_LOG_MAGIC && s_log.head < LINK_MANAGER_LOG &&
+        s_log.count <= LINK_MANAGER_LOG;
+}
+
+// 第n次重连前的等待：首次立即，之后指数增长，取上限后在[d/2, d]内随机，避免多台设备同时重连
+static uint32_t backoff_ms(uint32_t n)
+{
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t d = LINK_MANAGER_BACKOFF_MAX_MS;
+    if (n - 1 < 16) {
+        d = LINK_MANAGER_BACKOFF_MIN_MS << (n - 1);
+        if (d > LINK_MANAGER_BACKOFF_MAX_MS) {
+            d = LINK_MANAGER_BACKOFF_MAX_MS;
+        }
+    }
+    return d / 2 + esp_random() % (d / 2 + 1);
+}
+
+// 重连，fast为true时锁定缓存的BSSID和信道，跳过完整扫描
+// 只在设置变化时调用esp_wifi_set_config，配置保存在flash中，不应每次重连都写
+static void connect_now(bool fast)
+{
+    wifi_config_t cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK) {
+        bool changed;
+        if (fast) {
+            changed = !cfg.sta.bssid_set || cfg.sta.channel != s_log.channel ||
+                memcmp(cfg.sta.bssid, s_log.bssid, 6) != 0;
+            cfg.sta.bssid_set = true;
+            memcpy(cfg.sta.bssid, s_log.bssid, 6);
+            cfg.sta.channel = s_log.channel;
+        } else {
+            changed = cfg.sta.bssid_set || cfg.sta.channel != 0;
+            cfg.sta.bssid_set = false;
+            cfg.sta.channel = 0;
+        }
+        if (changed) {
+            esp_wifi_set_config(WIFI_IF_STA, &cfg);
+        }
+    }
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "重连失败: %s", esp_err_to_name(err));
+    }
+}
+
+static bool cache_usable(void)
+{
+    wifi_config_t cfg;
+    return s_log.channel != 0 && esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK &&
+        strncmp((const char*)cfg.sta.ssid, (const char*)s_log.ssid, sizeof(cfg.sta.ssid)) == 0;
+}
+
+static void retry_cb(void* arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_retry_at_us = 0;
+    bool fast = s_fast;
+    xSemaphoreGive(s_lock);
+    connect_now(fast);
+}
+
+// 新建一条断线记录，持锁调用
+static void log_push(int64_t now, uint8_t reason, int8_t rssi, uint32_t up_s)
+{
+    link_event_t* e = &s_log.ev[s_log.head];
+    e->boot = s_log.boot;
+    e->time_s = now / 1000000;
+    e->up_s = up_s;
+    e->reconnect_ms = LINK_MANAGER_NO_RECONNECT;
+    e->reason = reason;
+    e->rssi = rssi;
+    e->channel = s_log.channel;
+    e->retries = 0;
+    s_pending = s_log.head;
+    s_log.head = (s_log.head + 1) % LINK_MANAGER_LOG;
+    if (s_log.count < LINK_MANAGER_LOG) {
+        s_log.count++;
+    }
+    s_log.logged++;
+}
+
+// 连接断开时的计时，返回断开前连接持续的秒数，持锁调用
+static uint32_t mark_down(int64_t now)
+{
+    uint32_t up_s = (now - s_since_us) / 1000000;
+    s_up = false;
+    s_total_up_us += now - s_since_us;
+    s_since_us = now;
+    s_disconnects++;
+    s_retries = 0;
+    return up_s;
+}
+
+static void on_disconnected(const wifi_event_sta_disconnected_t* evt)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_rssi = evt->rssi;
+    if (s_switching) {
+        // 主动切换上行：不计入抖动，也不退避，直接关联新的AP
+        s_switching = false;
+        if (s_up) {
+            uint32_t up_s = mark_down(now);
+            log_push(now, LINK_MANAGER_REASON_SWITCH, evt->rssi, up_s);
+        }
+        xSemaphoreGive(s_lock);
+        esp_wifi_connect();
+        return;
+    }
+    if (s_up) {
+        // 连接断开：新建一条记录
+        uint32_t up_s = mark_down(now);
+        if (up_s >= LINK_MANAGER_STABLE_S) {
+            s_attempt = 0;
+        } else {
+            s_flaps++;
+        }
+        log_push(now, evt->reason, evt->rssi, up_s);
+        ESP_LOGW(TAG, "上行断开，原因%d，RSSI %d，已连接%lus", evt->reason, evt->rssi, up_s);
+    } else {
+        // 重连失败：计入同一条记录；启动后一直没连上时也建一条，原因是第一次失败的
+        s_retries++;
+        if (s_pending < 0) {
+            log_push(now, evt->reason, evt->rssi, 0);
+        }
+        if (s_log.ev[s_pending].retries < UINT8_MAX) {
+            s_log.ev[s_pending].retries++;
+        }
+    }
+
+    // 缓存的AP找不到时直接完整扫描
+    s_fast = s_log.channel != 0 && s_retries < LINK_MANAGER_FAST_TRIES &&
+        evt->reason != WIFI_REASON_NO_AP_FOUND;
+    uint32_t delay = backoff_ms(s_attempt);
+    if (s_attempt < UINT32_MAX) {
+        s_attempt++;
+    }
+    uint32_t attempt = s_attempt;
+    bool fast = s_fast;
+    s_retry_at_us = delay > 0 ? now + (int64_t)delay * 1000 : 0;
+    xSemaphoreGive(s_lock);
+
+    if (delay == 0) {
+        connect_now(fast);
+    } else {
+        ESP_LOGI(TAG, "%lums后第%lu次重连%s", delay, attempt, fast ? "（缓存的AP）" : "");
+        esp_timer_stop(s_retry_timer);
+        esp_timer_start_once(s_retry_timer, (uint64_t)delay * 1000);
+    }
+}
+
+static void on_connected(const wifi_event_sta_connected_t* evt)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(s_log.ssid, evt->ssid, evt->ssid_len < 32 ? evt->ssid_len : 32);
+    s_log.ssid[evt->ssid_len < 32 ? evt->ssid_len : 32] = '\0';
+    memcpy(s_log.bssid, evt->bssid, 6);
+    s_log.channel = evt->channel;
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "已关联 " MACSTR "，信道%d", MAC2STR(evt->bssid), evt->channel);
+}
+
+static void on_got_ip(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!s_up) {
+        s_up = true;
+        s_total_down_us += now - s_since_us;
+        if (s_pending >= 0) {
+            s_last_reconnect_ms = (now - s_since_us) / 1000;
+            s_log.ev[s_pending].reconnect_ms = s_last_reconnect_ms;
+            s_pending = -1;
+            if (s_fast) {
+                s_fast_reconnects++;
+            }
+        }
+        s_since_us = now;
+        s_connects++;
+        s_retries = 0;
+        s_retry_at_us = 0;
+    }
+    xSemaphoreGive(s_lock);
+    esp_timer_stop(s_retry_timer);
+}
+
+static void link_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        // 软件重启后直接连接上次的AP
+        bool fast = cache_usable();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_fast = fast;
+        xSemaphoreGive(s_lock);
+        connect_now(fast);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        on_connected((const wifi_event_sta_connected_t*)event_data);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        on_disconnected((const wifi_event_sta_disconnected_t*)event_data);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        on_got_ip();
+    }
+}
+
+esp_err_t link_manager_init(void)
+{
+    esp_reset_reason_t rst = esp_reset_reason();
+    if (rst == ESP_RST_POWERON || rst == ESP_RST_BROWNOUT || !log_valid()) {
+        log_reset();
+    }
+    s_log.boot++;
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = retry_cb,
+        .name = "link_retry",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_retry_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_since_us = esp_timer_get_time();
+
+    const int32_t wifi_ids[] = { WIFI_EVENT_STA_START, WIFI_EVENT_STA_CONNECTED, WIFI_EVENT_STA_DISCONNECTED };
+    for (size_t i = 0; i < sizeof(wifi_ids) / sizeof(wifi_ids[0]); i++) {
+        err = esp_event_handler_instance_register(WIFI_EVENT, wifi_ids[i], link_event_handler, NULL, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, link_event_handler, NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "第%lu次启动，保留%lu条断线记录", s_log.boot, s_log.count);
+    return ESP_OK;
+}
+
+void link_manager_switch(const wifi_config_t* cfg)
+{
+    if (!s_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // 目标AP作为缓存，关联失败时的前几次重连仍然直接找它
+    if (cfg->sta.bssid_set) {
+        memcpy(s_log.ssid, cfg->sta.ssid, 32);
+        s_log.ssid[32] = '\0';
+        memcpy(s_log.bssid, cfg->sta.bssid, 6);
+        s_log.channel = cfg->sta.channel;
+    } else {
+        s_log.channel = 0;
+    }
+    bool up = s_up;
+    s_switching = up;
+    s_fast = cfg->sta.bssid_set;
+    s_attempt = 0;
+    s_retries = 0;
+    s_retry_at_us = 0;
+    xSemaphoreGive(s_lock);
+    esp_timer_stop(s_retry_timer);
+
+    wifi_config_t sta = *cfg;
+    esp_wifi_set_config(WIFI_IF_STA, &sta);
+    if (up) {
+        esp_wifi_disconnect();
+    } else {
+        esp_wifi_connect();
+    }
+}
+
+void link_manager_get_stats(link_stats_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    wifi_ap_record_t ap;
+    bool have_ap = esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    out->running = true;
+    out->up = s_up;
+    memcpy(out->bssid, s_log.bssid, 6);
+    out->channel = s_log.channel;
+    out->rssi = s_up && have_ap ? ap.rssi : s_rssi;
+    out->boot = s_log.boot;
+    out->up_s = (now - s_since_us) / 1000000;
+    out->total_up_s = (s_total_up_us + (s_up ? now - s_since_us : 0)) / 1000000;
+    out->total_down_s = (s_total_down_us + (s_up ? 0 : now - s_since_us)) / 1000000;
+    out->connects = s_connects;
+    out->disconnects = s_disconnects;
+    out->flaps = s_flaps;
+    out->fast_reconnects = s_fast_reconnects;
+    out->attempt = s_attempt;
+    out->retry_in_ms = s_retry_at_us > now ? (s_retry_at_us - now) / 1000 : 0;
+    out->last_reconnect_ms = s_last_reconnect_ms;
+    out->logged = s_log.logged;
+    xSemaphoreGive(s_lock);
+}
+
+size_t link_manager_get_events(link_event_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t n = s_log.count < max ? s_log.count : max;
+    size_t first = (s_log.head + LINK_MANAGER_LOG - n) % LINK_MANAGER_LOG;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s_log.ev[(first + i) % LINK_MANAGER_LOG];
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void link_manager_clear_events(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_log.head = 0;
+    s_log.count = 0;
+    s_log.logged = 0;
+    s_pending = -1;
+    xSemaphoreGive(s_lock);
+}
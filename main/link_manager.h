@@ -0,0 +1,68 @@
+#ifndef LINK_MANAGER_H
+#define LINK_MANAGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+// 上行STA连接管理：断线后按指数退避加随机抖动重连，记录断线原因、信号强度和重连用时
+
+// 配置
+#define LINK_MANAGER_LOG 32                 // 断线记录环形缓冲区条数
+#define LINK_MANAGER_BACKOFF_MIN_MS 500     // 第二次重连起的退避基数，第一次立即重连
+#define LINK_MANAGER_BACKOFF_MAX_MS 60000
+#define LINK_MANAGER_STABLE_S 30            // 连接持续超过此时间后断开才重置退避，否则计为抖动
+#define LINK_MANAGER_FAST_TRIES 2           // 使用缓存的BSSID和信道重连的次数，之后完整扫描
+
+#define LINK_MANAGER_NO_RECONNECT UINT32_MAX
+#define LINK_MANAGER_REASON_SWITCH 0        // 断线原因：主动切换上行（WiFi原因码从1开始）
+
+// 一次断线
+typedef struct {
+    uint32_t boot;                          // 启动序号，断线记录跨软件重启保留
+    uint32_t time_s;                        // 断开时距启动的秒数
+    uint32_t up_s;                          // 断开前连接持续的时间
+    uint32_t reconnect_ms;                  // 到重新获取地址的用时，尚未恢复时为LINK_MANAGER_NO_RECONNECT
+    uint8_t reason;                         // wifi_err_reason_t
+    int8_t rssi;                            // 断开时的信号强度
+    uint8_t channel;
+    uint8_t retries;                        // 恢复前失败的重连次数
+} link_event_t;
+
+typedef struct {
+    bool running;                           // 未配置上行WiFi时为false
+    bool up;
+    uint8_t bssid[6];                       // 最近一次连接的AP
+    uint8_t channel;
+    int8_t rssi;                            // 当前信号强度，未连接时为断开时的值
+    uint32_t boot;
+    uint32_t up_s;                          // 当前连接或断开状态持续的时间
+    uint32_t total_up_s;                    // 本次启动以来累计
+    uint32_t total_down_s;
+    uint32_t connects;                      // 本次启动以来获取地址的次数
+    uint32_t disconnects;
+    uint32_t flaps;                         // 连接不足LINK_MANAGER_STABLE_S就断开的次数
+    uint32_t fast_reconnects;               // 使用缓存BSSID免扫描重连成功的次数
+    uint32_t attempt;                       // 当前退避序号
+    uint32_t retry_in_ms;                   // 距下一次重连，0表示没有等待中的重连
+    uint32_t last_reconnect_ms;
+    uint32_t logged;                        // 环形缓冲区中记录过的断线总数（含之前的启动）
+} link_stats_t;
+
+// 在esp_wifi_init之后、esp_wifi_start之前调用，接管STA的连接和重连
+esp_err_t link_manager_init(void);
+
+// 切换上行：cfg指定了BSSID和信道时直接关联，不做扫描
+// 已连接时先断开，这次断开记入断线记录，但不计入抖动和退避
+void link_manager_switch(const wifi_config_t* cfg);
+
+void link_manager_get_stats(link_stats_t* out);
+
+// 按时间顺序返回最近的断线记录
+size_t link_manager_get_events(link_event_t* out, size_t max);
+
+void link_manager_clear_events(void);
+
+#endif /* LINK_MANAGER_H */
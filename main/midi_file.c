@@ -0,0 +1,375 @@
+#include <string.h>
+#include "esp_log.h"
+#include "midi_file.h"
+
+// 配置
+#define TAG "MIDI_FILE"
+
+// 读取大端整数
+static inline uint32_t read_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint16_t read_be16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// 重新填充音轨预读缓冲区
+static bool track_refill(midi_file_t* mf, midi_track_t* t)
+{
+    if (t->file_pos >= t->end_pos) {
+        return false;
+    }
+
+    uint32_t len = t->end_pos - t->file_pos;
+    if (len > MIDI_FILE_READAHEAD) {
+        len = MIDI_FILE_READAHEAD;
+    }
+
+    if (fseek(mf->fp, t->file_pos, SEEK_SET) != 0) {
+        return false;
+    }
+    size_t n = fread(t->buf, 1, len, mf->fp);
+    if (n == 0) {
+        return false;
+    }
+
+    t->file_pos += n;
+    t->buf_pos = 0;
+    t->buf_len = (uint8_t)n;
+    return true;
+}
+
+// 从音轨读取一个字节，音轨数据耗尽时返回-1
+static inline int track_read_byte(midi_file_t* mf, midi_track_t* t)
+{
+    if (t->buf_pos >= t->buf_len && !track_refill(mf, t)) {
+        return -1;
+    }
+    return t->buf[t->buf_pos++];
+}
+
+// 跳过音轨中的若干字节
+static bool track_skip(midi_track_t* t, uint32_t len)
+{
+    uint32_t buffered = t->buf_len - t->buf_pos;
+    if (len <= buffered) {
+        t->buf_pos += len;
+        return true;
+    }
+
+    // 直接移动文件位置，丢弃缓冲区
+    len -= buffered;
+    t->buf_pos = t->buf_len = 0;
+    if (len > t->end_pos - t->file_pos) {
+        t->file_pos = t->end_pos;
+        return false;
+    }
+    t->file_pos += len;
+    return true;
+}
+
+// 读取变长数量（VLQ），最多4字节
+static bool track_read_vlq(midi_file_t* mf, midi_track_t* t, uint32_t* value)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = track_read_byte(mf, t);
+        if (c < 0) {
+            return false;
+        }
+        v = (v << 7) | (c & 0x7F);
+        if (!(c & 0x80)) {
+            *value = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 读取下一个delta时间并推进音轨tick
+static void track_advance(midi_file_t* mf, midi_track_t* t)
+{
+    uint32_t delta;
+    if (t->done || !track_read_vlq(mf, t, &delta)) {
+        t->done = true;
+        return;
+    }
+    t->tick += delta;
+}
+
+// 堆比较：tick小者优先，相同tick按音轨序号保持文件顺序
+static inline bool heap_less(const midi_file_t* mf, uint8_t a, uint8_t b)
+{
+    uint32_t ta = mf->tracks[a].tick;
+    uint32_t tb = mf->tracks[b].tick;
+    return ta < tb || (ta == tb && a < b);
+}
+
+static void heap_sift_down(midi_file_t* mf, uint8_t pos)
+{
+    uint8_t* h = mf->heap;
+    for (;;) {
+        uint8_t l = 2 * pos + 1;
+        uint8_t r = l + 1;
+        uint8_t m = pos;
+        if (l < mf->heap_size && heap_less(mf, h[l], h[m])) m = l;
+        if (r < mf->heap_size && heap_less(mf, h[r], h[m])) m = r;
+        if (m == pos) {
+            return;
+        }
+        uint8_t tmp = h[pos];
+        h[pos] = h[m];
+        h[m] = tmp;
+        pos = m;
+    }
+}
+
+static void heap_push(midi_file_t* mf, uint8_t track)
+{
+    uint8_t* h = mf->heap;
+    uint8_t pos = mf->heap_size++;
+    h[pos] = track;
+    while (pos > 0) {
+        uint8_t parent = (pos - 1) / 2;
+        if (!heap_less(mf, h[pos], h[parent])) {
+            break;
+        }
+        uint8_t tmp = h[pos];
+        h[pos] = h[parent];
+        h[parent] = tmp;
+        pos = parent;
+    }
+}
+
+// 移除堆顶（音轨已结束）
+static void heap_pop(midi_file_t* mf)
+{
+    mf->heap[0] = mf->heap[--mf->heap_size];
+    heap_sift_down(mf, 0);
+}
+
+// 根据速度更新tick到采样的换算
+static void set_tempo(midi_file_t* mf, uint32_t tempo_us)
+{
+    if (mf->division & 0x8000) {
+        // SMPTE时间码不受速度事件影响
+        return;
+    }
+    mf->tick_num = (uint64_t)tempo_us * mf->sample_rate;
+    mf->tick_den = 1000000ULL * mf->division;
+}
+
+// 各通道消息的数据字节数
+static inline uint8_t channel_msg_length(uint8_t status)
+{
+    switch (status & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+esp_err_t midi_file_rewind(midi_file_t* mf)
+{
+    if (!mf->fp) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (mf->division & 0x8000) {
+        // SMPTE：高字节为负的帧率，低字节为每帧tick数
+        uint32_t fps = (uint8_t)(-(int8_t)(mf->division >> 8));
+        uint32_t tpf = mf->division & 0xFF;
+        mf->tick_num = mf->sample_rate;
+        mf->tick_den = (uint64_t)fps * tpf;
+    } else {
+        set_tempo(mf, MIDI_DEFAULT_TEMPO);
+    }
+    mf->time_acc = 0;
+    mf->last_tick = 0;
+    mf->heap_size = 0;
+
+    for (uint8_t i = 0; i < mf->num_tracks; i++) {
+        midi_track_t* t = &mf->tracks[i];
+        t->file_pos = t->start_pos;
+        t->tick = 0;
+        t->running_status = 0;
+        t->buf_pos = t->buf_len = 0;
+        t->done = false;
+
+        track_advance(mf, t);
+        if (!t->done) {
+            heap_push(mf, i);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t midi_file_open(midi_file_t* mf, const char* path, uint32_t sample_rate)
+{
+    memset(mf, 0, sizeof(*mf));
+    mf->sample_rate = sample_rate;
+
+    mf->fp = fopen(path, "rb");
+    if (!mf->fp) {
+        ESP_LOGE(TAG, "无法打开MIDI文件: %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 文件头：MThd + 长度 + format/ntrks/division
+    uint8_t hdr[14];
+    if (fread(hdr, 1, sizeof(hdr), mf->fp) != sizeof(hdr) || memcmp(hdr, "MThd", 4) != 0) {
+        ESP_LOGE(TAG, "无效的MIDI文件格式");
+        midi_file_close(mf);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t hdr_len = read_be32(hdr + 4);
+    mf->format = read_be16(hdr + 8);
+    uint16_t ntrks = read_be16(hdr + 10);
+    mf->division = read_be16(hdr + 12);
+
+    if (hdr_len < 6 || mf->format > 1 || mf->division == 0) {
+        ESP_LOGE(TAG, "不支持的MIDI文件: format=%u division=0x%04X", mf->format, mf->division);
+        midi_file_close(mf);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (ntrks > MIDI_FILE_MAX_TRACKS) {
+        ESP_LOGW(TAG, "音轨数%u超过上限，只播放前%d个", ntrks, MIDI_FILE_MAX_TRACKS);
+        ntrks = MIDI_FILE_MAX_TRACKS;
+    }
+
+    // 扫描音轨块，只记录位置
+    uint32_t pos = 8 + hdr_len;
+    while (mf->num_tracks < ntrks) {
+        uint8_t chunk[8];
+        if (fseek(mf->fp, pos, SEEK_SET) != 0 || fread(chunk, 1, sizeof(chunk), mf->fp) != sizeof(chunk)) {
+            break;
+        }
+        uint32_t len = read_be32(chunk + 4);
+        if (memcmp(chunk, "MTrk", 4) == 0) {
+            midi_track_t* t = &mf->tracks[mf->num_tracks++];
+            t->start_pos = pos + 8;
+            t->end_pos = pos + 8 + len;
+        }
+        pos += 8 + len;
+    }
+
+    if (mf->num_tracks == 0) {
+        ESP_LOGE(TAG, "MIDI文件中没有音轨");
+        midi_file_close(mf);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ESP_LOGI(TAG, "MIDI文件: format=%u, 音轨=%u, division=%u",
+             mf->format, mf->num_tracks, mf->division);
+
+    return midi_file_rewind(mf);
+}
+
+esp_err_t midi_file_next_event(midi_file_t* mf, midi_event_t* event)
+{
+    while (mf->heap_size > 0) {
+        uint8_t idx = mf->heap[0];
+        midi_track_t* t = &mf->tracks[idx];
+
+        // 推进全局时间到当前事件
+        mf->time_acc += (uint64_t)(t->tick - mf->last_tick) * mf->tick_num;
+        mf->last_tick = t->tick;
+
+        bool emit = false;
+        int c = track_read_byte(mf, t);
+        if (c < 0) {
+            t->done = true;
+        } else if (c < 0x80) {
+            // running status：首字节即为数据
+            if (t->running_status == 0) {
+                t->done = true;
+            } else {
+                event->status = t->running_status;
+                event->data[0] = (uint8_t)c;
+                event->length = channel_msg_length(event->status);
+                if (event->length == 2) {
+                    int d = track_read_byte(mf, t);
+                    if (d < 0) {
+                        t->done = true;
+                    }
+                    event->data[1] = (uint8_t)d;
+                }
+                emit = !t->done;
+            }
+        } else if (c < 0xF0) {
+            // 通道消息
+            t->running_status = (uint8_t)c;
+            event->status = (uint8_t)c;
+            event->length = channel_msg_length(event->status);
+            for (int i = 0; i < event->length; i++) {
+                int d = track_read_byte(mf, t);
+                if (d < 0) {
+                    t->done = true;
+                    break;
+                }
+                event->data[i] = (uint8_t)d;
+            }
+            emit = !t->done;
+        } else if (c == 0xFF) {
+            // 元事件：与SysEx一样清除running status（SMF规范）
+            t->running_status = 0;
+            int type = track_read_byte(mf, t);
+            uint32_t len;
+            if (type < 0 || !track_read_vlq(mf, t, &len)) {
+                t->done = true;
+            } else if (type == 0x2F) {
+                t->done = true;
+            } else if (type == 0x51 && len == 3) {
+                uint32_t tempo = 0;
+                for (int i = 0; i < 3; i++) {
+                    int d = track_read_byte(mf, t);
+                    tempo = (tempo << 8) | (d < 0 ? 0 : d);
+                }
+                if (tempo > 0) {
+                    set_tempo(mf, tempo);
+                }
+            } else if (!track_skip(t, len)) {
+                t->done = true;
+            }
+        } else if (c == 0xF0 || c == 0xF7) {
+            // SysEx：跳过，并清除running status
+            uint32_t len;
+            t->running_status = 0;
+            if (!track_read_vlq(mf, t, &len) || !track_skip(t, len)) {
+                t->done = true;
+            }
+        } else {
+            // 音轨中不应出现的系统实时/公共消息
+            t->done = true;
+        }
+
+        // 读取该音轨下一事件的delta并调整堆
+        track_advance(mf, t);
+        if (t->done) {
+            heap_pop(mf);
+        } else {
+            heap_sift_down(mf, 0);
+        }
+
+        if (emit) {
+            event->sample = mf->time_acc / mf->tick_den;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void midi_file_close(midi_file_t* mf)
+{
+    if (mf->fp) {
+        fclose(mf->fp);
+        mf->fp = NULL;
+    }
+    mf->heap_size = 0;
+}
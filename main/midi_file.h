@@ -0,0 +1,63 @@
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// SMF解析配置
+#define MIDI_FILE_MAX_TRACKS 16
+#define MIDI_FILE_READAHEAD 64     // 每个音轨的预读缓冲区（字节）
+#define MIDI_DEFAULT_TEMPO 500000  // 默认速度：每四分音符500000微秒（120 BPM）
+
+// 解析出的MIDI通道事件
+typedef struct {
+    uint64_t sample;    // 事件的绝对采样位置（基于合成器采样时钟）
+    uint8_t status;     // 状态字节（已展开running status）
+    uint8_t data[2];    // 数据字节
+    uint8_t length;     // 数据字节数（1或2）
+} midi_event_t;
+
+// 单个音轨的增量读取游标
+typedef struct {
+    uint32_t file_pos;        // 预读缓冲区之后的文件偏移
+    uint32_t start_pos;       // 音轨数据起始偏移（用于重绕）
+    uint32_t end_pos;         // 音轨数据结束偏移
+    uint32_t tick;            // 下一个事件的绝对tick
+    uint8_t running_status;   // 当前running status
+    uint8_t buf_pos;          // 预读缓冲区读位置
+    uint8_t buf_len;          // 预读缓冲区有效长度
+    bool done;                // 音轨是否已结束
+    uint8_t buf[MIDI_FILE_READAHEAD];
+} midi_track_t;
+
+// SMF读取器状态
+typedef struct {
+    FILE* fp;
+    uint16_t format;          // 0或1
+    uint16_t num_tracks;
+    uint16_t division;        // 文件头中的时间分辨率
+    uint32_t sample_rate;     // 目标采样时钟
+    uint64_t tick_num;        // 每tick对应的采样数分子
+    uint64_t tick_den;        // 每tick对应的采样数分母
+    uint64_t time_acc;        // 已累计的采样时间（单位：1/tick_den采样）
+    uint32_t last_tick;       // 上一个已合并事件的tick
+    uint8_t heap[MIDI_FILE_MAX_TRACKS];  // 以下一事件tick为键的音轨最小堆
+    uint8_t heap_size;
+    midi_track_t tracks[MIDI_FILE_MAX_TRACKS];
+} midi_file_t;
+
+// 打开SMF文件并解析文件头和音轨块（只读取块头，不加载音轨数据）
+esp_err_t midi_file_open(midi_file_t* mf, const char* path, uint32_t sample_rate);
+
+// 回到文件开头重新播放
+esp_err_t midi_file_rewind(midi_file_t* mf);
+
+// 按时间顺序取出下一个通道事件，文件结束时返回ESP_ERR_NOT_FOUND
+esp_err_t midi_file_next_event(midi_file_t* mf, midi_event_t* event);
+
+// 关闭文件
+void midi_file_close(midi_file_t* mf);
+
+#endif /* MIDI_FILE_H */
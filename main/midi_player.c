@@ -1,17 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_vfs_fat.h"
 #include "midi_player.h"
+#include "midi_file.h"
+#include "midi_synth.h"
 
 // 配置
 #define TAG "MIDI_PLAYER"
-#define MIDI_TASK_STACK_SIZE 8192
-#define MIDI_TASK_PRIORITY 5
 
 // MIDI音符频率表（C0到B8）
 const float midi_note_frequencies[128] = {
@@ -32,99 +32,43 @@ const float midi_note_frequencies[128] = {
 #define MIDI_EVENT_NOTE_OFF 0x80
 #define MIDI_EVENT_CONTROL_CHANGE 0xB0
 
-// 音符状态
-typedef struct {
-    bool active;
-    float frequency;
-    float phase;
-    uint8_t velocity;
-    uint32_t start_time;
-} midi_note_t;
-
-// 通道状态
-typedef struct {
-    midi_note_t notes[128];
-    uint8_t volume;
-    uint8_t pan;
-} midi_channel_t;
-
 // 播放器状态
-static bool is_playing = false;
+static volatile bool is_playing = false;
 static bool loop_playback = false;
-static char current_midi_file[256] = "";
-static TaskHandle_t midi_task_handle = NULL;
-static midi_channel_t channels[MIDI_MAX_CHANNELS];
-static uint8_t current_sample = 128;
+static SemaphoreHandle_t player_lock = NULL;
+static midi_file_t midi_file;
+static midi_event_t next_event;
+static bool has_event = false;
+static uint64_t sample_clock = 0;   // 合成器采样时钟
+static uint32_t synth_rate = MIDI_SAMPLE_RATE;
 
 // 初始化MIDI播放器
-esp_err_t midi_player_init(void)
+esp_err_t midi_player_init(uint32_t sample_rate)
 {
     ESP_LOGI(TAG, "初始化MIDI播放器");
     
-    // 初始化通道状态
-    memset(channels, 0, sizeof(channels));
-    for (int i = 0; i < MIDI_MAX_CHANNELS; i++) {
-        channels[i].volume = MIDI_VOLUME;
-        channels[i].pan = 64;
+    // 初始化合成器
+    esp_err_t err = midi_synth_init(sample_rate);
+    if (err != ESP_OK) {
+        return err;
     }
-    
+
+    if (player_lock == NULL) {
+        player_lock = xSemaphoreCreateMutex();
+        if (player_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    synth_rate = sample_rate;
     is_playing = false;
     loop_playback = false;
-    current_sample = 128;
+    sample_clock = 0;
     
     ESP_LOGI(TAG, "MIDI播放器初始化完成");
     return ESP_OK;
 }
 
-// 生成正弦波样本
-static float generate_sine_wave(float frequency, float* phase, float sample_rate)
-{
-    float sample = sin(*phase);
-    *phase += 2 * M_PI * frequency / sample_rate;
-    if (*phase >= 2 * M_PI) {
-        *phase -= 2 * M_PI;
-    }
-    return sample;
-}
-
-// 混合所有激活的音符
-static uint8_t mix_notes(void)
-{
-    float mix = 0.0f;
-    int active_notes = 0;
-    
-    // 混合所有通道的所有激活音符
-    for (int ch = 0; ch < MIDI_MAX_CHANNELS; ch++) {
-        for (int note = 0; note < 128; note++) {
-            if (channels[ch].notes[note].active) {
-                float sample = generate_sine_wave(
-                    channels[ch].notes[note].frequency,
-                    &channels[ch].notes[note].phase,
-                    MIDI_SAMPLE_RATE
-                );
-                
-                // 应用音量
-                float volume = (float)channels[ch].notes[note].velocity / 127.0f;
-                volume *= (float)channels[ch].volume / 127.0f;
-                
-                mix += sample * volume;
-                active_notes++;
-            }
-        }
-    }
-    
-    // 如果没有激活的音符，返回中心值
-    if (active_notes == 0) {
-        return 128;
-    }
-    
-    // 归一化并转换为uint8_t
-    mix /= (float)active_notes;
-    mix = fmaxf(-1.0f, fminf(1.0f, mix));
-    
-    return (uint8_t)((mix + 1.0f) * 127.5f);
-}
-
 // 解析MIDI消息
 static void parse_midi_message(uint8_t* message, size_t length)
 {
@@ -137,43 +81,20 @@ static void parse_midi_message(uint8_t* message, size_t length)
     switch (event) {
         case MIDI_EVENT_NOTE_ON:
             if (length >= 3) {
-                uint8_t note = message[1];
-                uint8_t velocity = message[2];
-                
-                if (velocity > 0) {
-                    // 音符开启
-                    channels[channel].notes[note].active = true;
-                    channels[channel].notes[note].frequency = midi_note_frequencies[note];
-                    channels[channel].notes[note].phase = 0.0f;
-                    channels[channel].notes[note].velocity = velocity;
-                    channels[channel].notes[note].start_time = xTaskGetTickCount();
-                } else {
-                    // 速度为0表示音符关闭
-                    channels[channel].notes[note].active = false;
-                }
+                // 速度为0表示音符关闭，由合成器处理
+                midi_synth_note_on(channel, message[1], message[2]);
             }
             break;
             
         case MIDI_EVENT_NOTE_OFF:
             if (length >= 3) {
-                uint8_t note = message[1];
-                channels[channel].notes[note].active = false;
+                midi_synth_note_off(channel, message[1]);
             }
             break;
             
         case MIDI_EVENT_CONTROL_CHANGE:
             if (length >= 3) {
-                uint8_t control = message[1];
-                uint8_t value = message[2];
-                
-                switch (control) {
-                    case 0x07:  // 音量控制
-                        channels[channel].volume = value;
-                        break;
-                    case 0x0A:  // 声像控制
-                        channels[channel].pan = value;
-                        break;
-                }
+                midi_synth_control_change(channel, message[1], message[2]);
             }
             break;
             
@@ -183,86 +104,76 @@ static void parse_midi_message(uint8_t* message, size_t length)
     }
 }
 
-// MIDI播放任务
-static void midi_play_task(void* arg)
+// 派发到期事件，返回下一事件距当前的采样数（无事件时返回UINT32_MAX）
+static uint32_t dispatch_due_events(void)
 {
-    char* file_path = (char*)arg;
-    FILE* fp = fopen(file_path, "rb");
-    
-    if (!fp) {
-        ESP_LOGE(TAG, "无法打开MIDI文件: %s", file_path);
-        is_playing = false;
-        vTaskDelete(NULL);
-        return;
-    }
-    
-    ESP_LOGI(TAG, "开始播放MIDI文件: %s", file_path);
-    
-    // 读取MIDI文件头
-    uint8_t header[14];
-    if (fread(header, 1, 14, fp) != 14) {
-        ESP_LOGE(TAG, "无法读取MIDI文件头");
-        fclose(fp);
-        is_playing = false;
-        vTaskDelete(NULL);
-        return;
-    }
-    
-    // 检查是否为有效的MIDI文件
-    if (memcmp(header, "MThd", 4) != 0) {
-        ESP_LOGE(TAG, "无效的MIDI文件格式");
-        fclose(fp);
-        is_playing = false;
-        vTaskDelete(NULL);
-        return;
+    for (;;) {
+        while (has_event && next_event.sample <= sample_clock) {
+            uint8_t message[3] = {next_event.status, next_event.data[0] & 0x7F, next_event.data[1] & 0x7F};
+            parse_midi_message(message, 1 + next_event.length);
+            has_event = (midi_file_next_event(&midi_file, &next_event) == ESP_OK);
+        }
+
+        if (has_event) {
+            uint64_t gap = next_event.sample - sample_clock;
+            return gap > UINT32_MAX ? UINT32_MAX : (uint32_t)gap;
+        }
+
+        // 文件结束
+        if (!loop_playback || midi_file_rewind(&midi_file) != ESP_OK) {
+            ESP_LOGI(TAG, "MIDI播放完成");
+            midi_file_close(&midi_file);
+            midi_synth_all_notes_off();
+            is_playing = false;
+            return UINT32_MAX;
+        }
+
+        // 循环播放：从头开始
+        midi_synth_all_notes_off();
+        sample_clock = 0;
+        has_event = (midi_file_next_event(&midi_file, &next_event) == ESP_OK);
+        if (!has_event) {
+            midi_file_close(&midi_file);
+            is_playing = false;
+            return UINT32_MAX;
+        }
     }
-    
-    // 简化实现：循环生成音频样本
-    // 实际应用中需要解析完整的MIDI文件结构
-    const int sample_delay = 1000 / MIDI_SAMPLE_RATE;
-    
-    while (is_playing) {
-        // 混合所有激活的音符生成样本
-        current_sample = mix_notes();
-        
-        // 模拟MIDI消息（测试用）
-        // 实际应用中需要从文件中读取并解析MIDI消息
-        static bool test_note_active = false;
-        static uint32_t test_note_time = 0;
-        uint32_t current_time = xTaskGetTickCount();
-        
-        if (current_time - test_note_time > 1000) {
-            test_note_time = current_time;
-            test_note_active = !test_note_active;
-            
-            if (test_note_active) {
-                // 发送音符开启消息
-                uint8_t note_on_msg[] = {MIDI_EVENT_NOTE_ON, 60, 100}; // C4音符，力度100
-                parse_midi_message(note_on_msg, sizeof(note_on_msg));
-            } else {
-                // 发送音符关闭消息
-                uint8_t note_off_msg[] = {MIDI_EVENT_NOTE_OFF, 60, 0}; // C4音符
-                parse_midi_message(note_off_msg, sizeof(note_off_msg));
+}
+
+// 渲染一块音频，事件在块内按采样位置精确生效
+static void player_render(int16_t* buf, size_t frames, size_t channels)
+{
+    size_t done = 0;
+
+    xSemaphoreTake(player_lock, portMAX_DELAY);
+    while (done < frames) {
+        size_t n = frames - done;
+        if (is_playing) {
+            uint32_t gap = dispatch_due_events();
+            if (gap < n) {
+                n = gap;
             }
         }
-        
-        // 延迟以达到采样率
-        vTaskDelay(sample_delay / portTICK_PERIOD_MS);
-    }
-    
-    fclose(fp);
-    ESP_LOGI(TAG, "MIDI播放完成");
-    
-    // 停止所有音符
-    for (int ch = 0; ch < MIDI_MAX_CHANNELS; ch++) {
-        for (int note = 0; note < 128; note++) {
-            channels[ch].notes[note].active = false;
+
+        if (channels == 2) {
+            midi_synth_render_stereo(buf + 2 * done, n);
+        } else {
+            midi_synth_render(buf + done, n);
         }
+        done += n;
+        sample_clock += n;
     }
-    
-    current_sample = 128;
-    is_playing = false;
-    vTaskDelete(NULL);
+    xSemaphoreGive(player_lock);
+}
+
+void midi_player_render(int16_t* buf, size_t frames, void* ctx)
+{
+    player_render(buf, frames, 1);
+}
+
+void midi_player_render_stereo(int16_t* buf, size_t frames, void* ctx)
+{
+    player_render(buf, frames, 2);
 }
 
 // 加载并播放MIDI文件
@@ -275,45 +186,34 @@ esp_err_t midi_player_play_file(const char* file_path, bool loop)
     if (is_playing) {
         midi_player_stop();
     }
-    
-    // 保存当前播放的文件路径
-    strncpy(current_midi_file, file_path, sizeof(current_midi_file) - 1);
-    loop_playback = loop;
-    
-    // 创建播放任务
-    if (xTaskCreate(midi_play_task, "midi_play_task", MIDI_TASK_STACK_SIZE, 
-                    (void*)current_midi_file, MIDI_TASK_PRIORITY, &midi_task_handle) != pdPASS) {
-        ESP_LOGE(TAG, "创建MIDI播放任务失败");
-        return ESP_FAIL;
-    }
-    
-    is_playing = true;
-    return ESP_OK;
+
+    xSemaphoreTake(player_lock, portMAX_DELAY);
+    esp_err_t err = midi_file_open(&midi_file, file_path, synth_rate);
+    if (err == ESP_OK) {
+        loop_playback = loop;
+        sample_clock = 0;
+        has_event = (midi_file_next_event(&midi_file, &next_event) == ESP_OK);
+        is_playing = true;
+        ESP_LOGI(TAG, "开始播放MIDI文件: %s", file_path);
+    }
+    xSemaphoreGive(player_lock);
+
+    return err;
 }
 
 // 停止播放
 esp_err_t midi_player_stop(void)
 {
-    if (!is_playing) {
-        return ESP_OK;
-    }
-    
-    is_playing = false;
-    
-    // 等待任务结束
-    if (midi_task_handle != NULL) {
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        midi_task_handle = NULL;
+    xSemaphoreTake(player_lock, portMAX_DELAY);
+    if (is_playing) {
+        is_playing = false;
+        midi_file_close(&midi_file);
     }
-    
+
     // 停止所有音符
-    for (int ch = 0; ch < MIDI_MAX_CHANNELS; ch++) {
-        for (int note = 0; note < 128; note++) {
-            channels[ch].notes[note].active = false;
-        }
-    }
-    
-    current_sample = 128;
+    midi_synth_all_notes_off();
+    xSemaphoreGive(player_lock);
+
     return ESP_OK;
 }
 
@@ -322,9 +222,3 @@ bool midi_player_is_playing(void)
 {
     return is_playing;
 }
-
-// 获取当前播放的音频样本
-uint8_t midi_player_get_current_sample(void)
-{
-    return current_sample;
-}
@@ -2,18 +2,21 @@
 #define MIDI_PLAYER_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
 
 // MIDI配置
 #define MIDI_MAX_CHANNELS 16
-#define MIDI_SAMPLE_RATE 44100
+#define MIDI_SAMPLE_RATE CONFIG_MIDI_SAMPLE_RATE  // 合成器渲染采样率
 #define MIDI_VOLUME 127
 
 // MIDI音符频率表（C0到B8）
 extern const float midi_note_frequencies[128];
 
-// 初始化MIDI播放器
-esp_err_t midi_player_init(void);
+// 初始化MIDI播放器，sample_rate为合成器渲染采样率
+esp_err_t midi_player_init(uint32_t sample_rate);
 
 // 加载并播放MIDI文件
 esp_err_t midi_player_play_file(const char* file_path, bool loop);
@@ -24,7 +27,10 @@ esp_err_t midi_player_stop(void);
 // 检查是否正在播放
 bool midi_player_is_playing(void);
 
-// 获取当前播放的音频样本
-uint8_t midi_player_get_current_sample(void);
+// 渲染一块16位PCM音频（audio_pipeline的渲染回调）
+void midi_player_render(int16_t* buf, size_t frames, void* ctx);
+
+// 渲染一块立体声音频，buf为左右交错的2*frames个样本
+void midi_player_render_stereo(int16_t* buf, size_t frames, void* ctx);
 
 #endif /* MIDI_PLAYER_H */
@@ -0,0 +1,416 @@
+#include <string.h>
+#include <math.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "midi_player.h"
+#include "midi_synth.h"
+
+// 配置
+#define TAG "MIDI_SYNTH"
+#define VOICE_NONE 0xFF
+#define GAIN_SHIFT 14                   // 力度×通道音量（最大127×127）约为Q14
+#define ENV_SHIFT 8                     // 包络为Q24，取高16位参与运算
+#define ENV_MAX ((int32_t)0xFFFFFF)
+#define SUSTAIN_LEVEL ((int32_t)MIDI_SYNTH_SUSTAIN_LEVEL << ENV_SHIFT)
+
+// 包络阶段
+enum {
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_DECAY,
+    ENV_SUSTAIN,
+    ENV_RELEASE,
+};
+
+// 声部状态
+typedef struct {
+    uint32_t phase;         // 32位相位累加器
+    uint32_t inc;           // 相位增量
+    int32_t env;            // 包络电平（Q24）
+    uint32_t age;           // 分配序号，越小越老
+    uint16_t gain;          // 力度×通道音量
+    uint8_t channel;
+    uint8_t note;
+    uint8_t velocity;
+    uint8_t stage;
+} midi_voice_t;
+
+// 通道状态
+typedef struct {
+    uint8_t volume;
+    uint8_t pan;
+} midi_channel_t;
+
+// 正弦表多一个点用于插值时免回绕
+static DRAM_ATTR int16_t sine_table[MIDI_SYNTH_SINE_SIZE + 1];
+static uint32_t phase_inc[128];
+
+// 等功率声像增益（Q15）：左声道取pan_gain[127 - pan]，右声道取pan_gain[pan]
+static int16_t pan_gain[128];
+
+// 包络每采样步长（Q24）
+static int32_t attack_step;
+static int32_t decay_step;
+static int32_t release_step;
+
+static midi_channel_t channels[MIDI_MAX_CHANNELS];
+static midi_voice_t voices[MIDI_SYNTH_MAX_VOICES];
+
+// (通道, 音符) -> 声部索引，O(1)查找
+static uint8_t voice_map[MIDI_MAX_CHANNELS][128];
+
+// 占用中的声部列表和空闲栈
+static uint8_t active_list[MIDI_SYNTH_MAX_VOICES];
+static uint32_t active_count = 0;
+static uint8_t free_list[MIDI_SYNTH_MAX_VOICES];
+static uint32_t free_count = 0;
+
+static uint32_t next_age = 0;
+static uint32_t steal_count = 0;
+
+static int32_t env_step(uint32_t sample_rate, uint32_t ms, int32_t range)
+{
+    uint32_t samples = sample_rate * ms / 1000;
+    if (samples == 0) {
+        return range;
+    }
+    int32_t step = range / (int32_t)samples;
+    return step > 0 ? step : 1;
+}
+
+esp_err_t midi_synth_init(uint32_t sample_rate)
+{
+    if (sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i <= MIDI_SYNTH_SINE_SIZE; i++) {
+        sine_table[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * i / MIDI_SYNTH_SINE_SIZE));
+    }
+
+    for (int p = 0; p < 128; p++) {
+        pan_gain[p] = (int16_t)lrintf(32767.0f * sinf((float)M_PI / 2.0f * p / 127.0f));
+    }
+
+    // 相位增量 = f * 2^32 / fs
+    for (int n = 0; n < 128; n++) {
+        phase_inc[n] = (uint32_t)llround((double)midi_note_frequencies[n] * 4294967296.0 / sample_rate);
+    }
+
+    attack_step = env_step(sample_rate, MIDI_SYNTH_ATTACK_MS, ENV_MAX);
+    decay_step = env_step(sample_rate, MIDI_SYNTH_DECAY_MS, ENV_MAX - SUSTAIN_LEVEL);
+    release_step = env_step(sample_rate, MIDI_SYNTH_RELEASE_MS, SUSTAIN_LEVEL);
+
+    midi_synth_reset();
+
+    ESP_LOGI(TAG, "合成器初始化完成: %lu Hz, %d声部, 正弦表%d点",
+             sample_rate, MIDI_SYNTH_MAX_VOICES, MIDI_SYNTH_SINE_SIZE);
+    return ESP_OK;
+}
+
+// 将声部放回空闲栈（调用者负责维护active_list）
+static void voice_free(uint8_t v)
+{
+    midi_voice_t* voice = &voices[v];
+    if (voice_map[voice->channel][voice->note] == v) {
+        voice_map[voice->channel][voice->note] = VOICE_NONE;
+    }
+    voice->stage = ENV_IDLE;
+    free_list[free_count++] = v;
+}
+
+static void active_remove_at(uint32_t pos)
+{
+    active_list[pos] = active_list[--active_count];
+}
+
+// 选择被抢占的声部：优先释音中的，其次最安静的，相同时取最老的
+static uint32_t pick_victim(void)
+{
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < active_count; i++) {
+        const midi_voice_t* a = &voices[active_list[i]];
+        const midi_voice_t* b = &voices[active_list[best]];
+
+        bool a_rel = (a->stage == ENV_RELEASE);
+        bool b_rel = (b->stage == ENV_RELEASE);
+        if (a_rel != b_rel) {
+            if (a_rel) best = i;
+            continue;
+        }
+
+        uint32_t la = (uint32_t)(a->env >> ENV_SHIFT) * a->gain;
+        uint32_t lb = (uint32_t)(b->env >> ENV_SHIFT) * b->gain;
+        if (la < lb || (la == lb && (int32_t)(a->age - b->age) < 0)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void midi_synth_note_on(uint8_t channel, uint8_t note, uint8_t velocity)
+{
+    if (channel >= MIDI_MAX_CHANNELS || note > 127) {
+        return;
+    }
+    if (velocity == 0) {
+        midi_synth_note_off(channel, note);
+        return;
+    }
+
+    uint8_t v = voice_map[channel][note];
+    if (v == VOICE_NONE) {
+        if (free_count == 0) {
+            // 抢占声部，保留其在active_list中的位置
+            uint32_t pos = pick_victim();
+            v = active_list[pos];
+            midi_voice_t* victim = &voices[v];
+            if (voice_map[victim->channel][victim->note] == v) {
+                voice_map[victim->channel][victim->note] = VOICE_NONE;
+            }
+            steal_count++;
+        } else {
+            v = free_list[--free_count];
+            active_list[active_count++] = v;
+            voices[v].phase = 0;
+            voices[v].env = 0;
+        }
+        voice_map[channel][note] = v;
+    }
+
+    // 重新触发时保留相位和当前电平，避免爆音
+    midi_voice_t* voice = &voices[v];
+    voice->channel = channel;
+    voice->note = note;
+    voice->velocity = velocity;
+    voice->inc = phase_inc[note];
+    voice->gain = (uint16_t)(velocity * channels[channel].volume);
+    voice->age = next_age++;
+    voice->stage = ENV_ATTACK;
+}
+
+void midi_synth_note_off(uint8_t channel, uint8_t note)
+{
+    if (channel >= MIDI_MAX_CHANNELS || note > 127) {
+        return;
+    }
+
+    uint8_t v = voice_map[channel][note];
+    if (v != VOICE_NONE) {
+        voices[v].stage = ENV_RELEASE;
+        voice_map[channel][note] = VOICE_NONE;
+    }
+}
+
+void midi_synth_control_change(uint8_t channel, uint8_t control, uint8_t value)
+{
+    if (channel >= MIDI_MAX_CHANNELS) {
+        return;
+    }
+
+    midi_channel_t* ch = &channels[channel];
+    switch (control) {
+        case 0x07:  // 音量控制
+            ch->volume = value;
+            // 更新该通道占用声部的增益
+            for (uint32_t i = 0; i < active_count; i++) {
+                midi_voice_t* voice = &voices[active_list[i]];
+                if (voice->channel == channel) {
+                    voice->gain = (uint16_t)(voice->velocity * value);
+                }
+            }
+            break;
+        case 0x0A:  // 声像控制
+            ch->pan = value;
+            break;
+        case 0x78:  // 全部声音关闭：立即静音
+            for (uint32_t i = active_count; i > 0; i--) {
+                if (voices[active_list[i - 1]].channel == channel) {
+                    voice_free(active_list[i - 1]);
+                    active_remove_at(i - 1);
+                }
+            }
+            break;
+        case 0x7B:  // 全部音符关闭：进入释音
+            for (uint32_t i = 0; i < active_count; i++) {
+                midi_voice_t* voice = &voices[active_list[i]];
+                if (voice->channel == channel && voice->stage != ENV_RELEASE) {
+                    midi_synth_note_off(channel, voice->note);
+                }
+            }
+            break;
+    }
+}
+
+void midi_synth_all_notes_off(void)
+{
+    while (active_count > 0) {
+        voice_free(active_list[--active_count]);
+    }
+}
+
+void midi_synth_reset(void)
+{
+    memset(voices, 0, sizeof(voices));
+    memset(voice_map, VOICE_NONE, sizeof(voice_map));
+    for (int c = 0; c < MIDI_MAX_CHANNELS; c++) {
+        channels[c].volume = MIDI_VOLUME;
+        channels[c].pan = 64;
+    }
+
+    active_count = 0;
+    free_count = 0;
+    for (int v = MIDI_SYNTH_MAX_VOICES - 1; v >= 0; v--) {
+        free_list[free_count++] = (uint8_t)v;
+    }
+}
+
+// 按控制周期推进包络，返回false表示释音结束
+static bool envelope_advance(midi_voice_t* voice, uint32_t n)
+{
+    switch (voice->stage) {
+        case ENV_ATTACK:
+            voice->env += attack_step * (int32_t)n;
+            if (voice->env >= ENV_MAX) {
+                voice->env = ENV_MAX;
+                voice->stage = ENV_DECAY;
+            }
+            break;
+        case ENV_DECAY:
+            voice->env -= decay_step * (int32_t)n;
+            if (voice->env <= SUSTAIN_LEVEL) {
+                voice->env = SUSTAIN_LEVEL;
+                voice->stage = ENV_SUSTAIN;
+            }
+            break;
+        case ENV_RELEASE:
+            voice->env -= release_step * (int32_t)n;
+            if (voice->env <= 0) {
+                voice->env = 0;
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// 线性插值正弦查表：高10位为索引，其后16位为插值系数
+static inline int32_t sine_lookup(uint32_t phase)
+{
+    uint32_t idx = phase >> (32 - MIDI_SYNTH_SINE_BITS);
+    int32_t frac = (phase >> (16 - MIDI_SYNTH_SINE_BITS)) & 0xFFFF;
+    int32_t a = sine_table[idx];
+    int32_t b = sine_table[idx + 1];
+    return a + (((b - a) * frac) >> 16);
+}
+
+// 渲染单个声部并累加，增益在分段内线性过渡
+// acc_r为NULL时只累加单声道，否则按通道声像分配到左右声道
+static bool render_voice(midi_voice_t* voice, int32_t* acc_l, int32_t* acc_r, uint32_t n)
+{
+    int32_t g0 = (int32_t)(((uint32_t)(voice->env >> ENV_SHIFT) * voice->gain) >> 16);
+    bool alive = envelope_advance(voice, n);
+    int32_t g1 = (int32_t)(((uint32_t)(voice->env >> ENV_SHIFT) * voice->gain) >> 16);
+
+    int32_t g = g0 << 16;
+    int32_t dg = ((g1 - g0) << 16) / (int32_t)n;
+    uint32_t phase = voice->phase;
+    uint32_t inc = voice->inc;
+
+    if (!acc_r) {
+        for (uint32_t i = 0; i < n; i++) {
+            acc_l[i] += (sine_lookup(phase) * (g >> 16)) >> GAIN_SHIFT;
+            phase += inc;
+            g += dg;
+        }
+    } else {
+        uint8_t pan = channels[voice->channel].pan;
+        int32_t pl = pan_gain[127 - pan];
+        int32_t pr = pan_gain[pan];
+        for (uint32_t i = 0; i < n; i++) {
+            int32_t v = (sine_lookup(phase) * (g >> 16)) >> GAIN_SHIFT;
+            acc_l[i] += (v * pl) >> 15;
+            acc_r[i] += (v * pr) >> 15;
+            phase += inc;
+            g += dg;
+        }
+    }
+    voice->phase = phase;
+    return alive;
+}
+
+static inline int16_t mix_clip(int32_t acc, int32_t scale)
+{
+    int32_t s = (int32_t)(((int64_t)acc * scale) >> 16);
+    if (s > 32767) s = 32767;
+    if (s < -32768) s = -32768;
+    return (int16_t)s;
+}
+
+// 渲染一块音频，stereo为true时输出左右交错的样本
+static void synth_render(int16_t* buf, size_t frames, bool stereo)
+{
+    int32_t acc_l[MIDI_SYNTH_CHUNK];
+    int32_t acc_r[MIDI_SYNTH_CHUNK];
+    size_t channels_out = stereo ? 2 : 1;
+
+    while (frames > 0) {
+        uint32_t n = frames < MIDI_SYNTH_CHUNK ? frames : MIDI_SYNTH_CHUNK;
+
+        if (active_count == 0) {
+            memset(buf, 0, frames * channels_out * sizeof(int16_t));
+            return;
+        }
+
+        // 按占用声部数归一化
+        int32_t scale = 65536 / (int32_t)active_count;
+        memset(acc_l, 0, n * sizeof(int32_t));
+        if (stereo) {
+            memset(acc_r, 0, n * sizeof(int32_t));
+        }
+
+        for (uint32_t i = active_count; i > 0; i--) {
+            uint8_t v = active_list[i - 1];
+            if (!render_voice(&voices[v], acc_l, stereo ? acc_r : NULL, n)) {
+                voice_free(v);
+                active_remove_at(i - 1);
+            }
+        }
+
+        if (stereo) {
+            for (uint32_t i = 0; i < n; i++) {
+                buf[2 * i] = mix_clip(acc_l[i], scale);
+                buf[2 * i + 1] = mix_clip(acc_r[i], scale);
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                buf[i] = mix_clip(acc_l[i], scale);
+            }
+        }
+
+        buf += n * channels_out;
+        frames -= n;
+    }
+}
+
+void midi_synth_render(int16_t* buf, size_t frames)
+{
+    synth_render(buf, frames, false);
+}
+
+void midi_synth_render_stereo(int16_t* buf, size_t frames)
+{
+    synth_render(buf, frames, true);
+}
+
+uint32_t midi_synth_active_count(void)
+{
+    return active_count;
+}
+
+uint32_t midi_synth_steal_count(void)
+{
+    return steal_count;
+}
@@ -0,0 +1,49 @@
+#ifndef MIDI_SYNTH_H
+#define MIDI_SYNTH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// 振荡器配置
+#define MIDI_SYNTH_SINE_BITS 10                          // 正弦表索引位数
+#define MIDI_SYNTH_SINE_SIZE (1 << MIDI_SYNTH_SINE_BITS) // 1024点
+#define MIDI_SYNTH_MAX_VOICES CONFIG_MIDI_MAX_VOICES     // 声部池大小
+#define MIDI_SYNTH_CHUNK 64                              // 内部混音分段长度（包络控制周期）
+
+// ADSR包络参数
+#define MIDI_SYNTH_ATTACK_MS 5
+#define MIDI_SYNTH_DECAY_MS 120
+#define MIDI_SYNTH_SUSTAIN_LEVEL 45000                   // 持续电平（满幅65535）
+#define MIDI_SYNTH_RELEASE_MS 80
+
+// 初始化合成器：生成正弦表和各音符的相位增量
+esp_err_t midi_synth_init(uint32_t sample_rate);
+
+// 音符开/关
+void midi_synth_note_on(uint8_t channel, uint8_t note, uint8_t velocity);
+void midi_synth_note_off(uint8_t channel, uint8_t note);
+
+// 控制器变化（音量0x07、声像0x0A）
+void midi_synth_control_change(uint8_t channel, uint8_t control, uint8_t value);
+
+// 停止所有音符并恢复通道默认值
+void midi_synth_reset(void);
+
+// 停止所有音符
+void midi_synth_all_notes_off(void);
+
+// 渲染若干16位PCM样本
+void midi_synth_render(int16_t* buf, size_t frames);
+
+// 按通道声像渲染立体声，buf为左右交错的2*frames个样本
+void midi_synth_render_stereo(int16_t* buf, size_t frames);
+
+// 当前占用的声部数（含释音阶段）
+uint32_t midi_synth_active_count(void);
+
+// 因声部不足被抢占的次数
+uint32_t midi_synth_steal_count(void);
+
+#endif /* MIDI_SYNTH_H */
@@ -0,0 +1,113 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "lwip/opt.h"
+#include "lwip/lwip_napt.h"
+#include "sdkconfig.h"
+#include "napt_config.h"
+#include "router_globals.h"
+
+// 配置
+#define TAG "NAPT_CONFIG"
+
+static napt_config_t s_config;
+
+static uint16_t read_requested_entries(void)
+{
+    nvs_handle_t nvs;
+    int32_t value = 0;
+    if (nvs_open(PARAM_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_i32(nvs, NAPT_CONFIG_NVS_MAX, &value) != ESP_OK) {
+            value = 0;
+        }
+        nvs_close(nvs);
+    }
+    if (value < 0 || value > UINT16_MAX) {
+        value = 0;
+    }
+    return (uint16_t)value;
+}
+
+esp_err_t napt_config_apply(void)
+{
+    memset(&s_config, 0, sizeof(s_config));
+
+#ifdef IP_NAPT_TIMEOUT_MS_TCP
+    s_config.tcp_timeout_s = IP_NAPT_TIMEOUT_MS_TCP / 1000;
+#endif
+#ifdef IP_NAPT_TIMEOUT_MS_TCP_DISCON
+    s_config.tcp_fin_timeout_s = IP_NAPT_TIMEOUT_MS_TCP_DISCON / 1000;
+#endif
+#ifdef IP_NAPT_TIMEOUT_MS_UDP
+    s_config.udp_timeout_s = IP_NAPT_TIMEOUT_MS_UDP / 1000;
+#endif
+#ifdef IP_NAPT_TIMEOUT_MS_ICMP
+    s_config.icmp_timeout_s = IP_NAPT_TIMEOUT_MS_ICMP / 1000;
+#endif
+
+    // lwIP的内存分配在开启CONFIG_SPIRAM_TRY_ALLOCATE_WIFI_LWIP时优先使用PSRAM
+    size_t free_bytes;
+#if CONFIG_SPIRAM_TRY_ALLOCATE_WIFI_LWIP
+    s_config.psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#endif
+    if (s_config.psram) {
+        free_bytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    } else {
+        free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    size_t budget = free_bytes / NAPT_CONFIG_HEAP_SHARE / NAPT_CONFIG_ENTRY_BYTES;
+
+    s_config.requested = read_requested_entries();
+    uint32_t entries = s_config.requested ? s_config.requested : IP_NAPT_MAX;
+    if (entries > NAPT_CONFIG_MAX_ENTRIES) {
+        entries = NAPT_CONFIG_MAX_ENTRIES;
+    }
+    if (entries > budget) {
+        ESP_LOGW(TAG, "可用内存只够%u个表项，请求%lu", (unsigned)budget, entries);
+        entries = budget;
+    }
+    if (entries < NAPT_CONFIG_MIN_ENTRIES) {
+        entries = NAPT_CONFIG_MIN_ENTRIES;
+    }
+    s_config.entries = (uint16_t)entries;
+
+    // ip_napt_enable在表未初始化时按IP_NAPT_MAX分配，提前初始化即可改变容量
+    ip_napt_init(s_config.entries, IP_PORTMAP_MAX);
+
+    ESP_LOGI(TAG, "NAPT表: %u项（%s），超时 TCP %lus / UDP %lus",
+             s_config.entries, s_config.psram ? "PSRAM" : "内部RAM",
+             s_config.tcp_timeout_s, s_config.udp_timeout_s);
+    return ESP_OK;
+}
+
+void napt_config_get(napt_config_t* out)
+{
+    *out = s_config;
+}
+
+esp_err_t napt_config_set_entries(uint16_t entries)
+{
+    if (entries != 0 && (entries < NAPT_CONFIG_MIN_ENTRIES || entries > NAPT_CONFIG_MAX_ENTRIES)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (entries == 0) {
+        err = nvs_erase_key(nvs, NAPT_CONFIG_NVS_MAX);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        err = nvs_set_i32(nvs, NAPT_CONFIG_NVS_MAX, entries);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
@@ -0,0 +1,36 @@
+#ifndef NAPT_CONFIG_H
+#define NAPT_CONFIG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// NAPT连接表配置
+#define NAPT_CONFIG_NVS_MAX "napt_max"      // esp32_nat命名空间中的表项数键
+#define NAPT_CONFIG_MIN_ENTRIES 64
+#define NAPT_CONFIG_MAX_ENTRIES 4096        // lwIP按链表查找，过大的表增加每包开销
+#define NAPT_CONFIG_ENTRY_BYTES 32          // 每个表项的内存估计（含分配开销）
+#define NAPT_CONFIG_HEAP_SHARE 8            // 最多占用可用内存的1/8
+
+// 生效的连接表配置
+typedef struct {
+    uint16_t requested;                 // NVS中的设置，0表示未设置
+    uint16_t entries;                   // 实际分配的表项数
+    bool psram;                         // lwIP分配是否可使用PSRAM
+    uint32_t tcp_timeout_s;             // lwIP编译期空闲超时（只读）
+    uint32_t tcp_fin_timeout_s;
+    uint32_t udp_timeout_s;
+    uint32_t icmp_timeout_s;
+} napt_config_t;
+
+// 从NVS读取表项数，按可用内存限制后初始化lwIP NAPT表
+// 必须在ip_napt_enable和第一次ip_portmap_add之前调用
+esp_err_t napt_config_apply(void);
+
+// 读取生效的配置
+void napt_config_get(napt_config_t* out);
+
+// 保存表项数到NVS，0表示恢复默认，重启后生效
+esp_err_t napt_config_set_entries(uint16_t entries);
+
+#endif /* NAPT_CONFIG_H */
@@ -0,0 +1,336 @@
+#include <string.h>
+#include "esp_log.h"
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "lwip/lwip_napt.h"
+#include "lwip/prot/tcp.h"
+#include "napt_pkt.h"
+#include "napt_fastpath.h"
+
+// 配置
+#define TAG "NAPT_FASTPATH"
+
+// 刷新间隔必须短于lwIP最短的空闲超时，否则lwIP可能回收仍在使用的外网端口
+#if defined(IP_NAPT_TIMEOUT_MS_UDP) && IP_NAPT_TIMEOUT_MS_UDP <= NAPT_FASTPATH_REFRESH_MS
+#error "NAPT_FASTPATH_REFRESH_MS must be shorter than IP_NAPT_TIMEOUT_MS_UDP"
+#endif
+#if NAPT_FASTPATH_SETS * NAPT_FASTPATH_WAYS > UINT8_MAX
+#error "s_in_index stores flow ids in uint8_t"
+#endif
+
+// 一条双向流，地址和端口均为网络字节序
+typedef struct {
+    uint32_t client_addr;
+    uint32_t remote_addr;
+    uint32_t ext_addr;                  // 学习时的上行地址，地址变化后表项自然失效
+    uint16_t client_port;
+    uint16_t remote_port;
+    uint16_t ext_port;                  // lwIP NAPT分配的外网端口
+    uint8_t proto;
+    uint8_t valid;
+    uint8_t closing;                    // 已见到FIN/RST，余下的包都交给lwIP
+    struct eth_addr client_mac;
+    struct eth_addr next_hop_mac;
+    uint32_t last_used;                 // sys_now()毫秒
+    uint32_t last_slow;
+} flow_t;
+
+// 出站未命中时记下的客户端一侧信息，只在一次ethernet_input调用期间有效
+typedef struct {
+    bool valid;
+    uint8_t proto;
+    uint32_t client_addr;
+    uint32_t remote_addr;
+    uint16_t client_port;
+    uint16_t remote_port;
+    struct eth_addr client_mac;
+} pending_t;
+
+// 只在tcpip线程中访问
+static flow_t s_flows[NAPT_FASTPATH_SETS][NAPT_FASTPATH_WAYS];
+static uint8_t s_in_index[NAPT_FASTPATH_IN_INDEX];     // 流编号+1，0为空
+static pending_t s_pending;
+static napt_fastpath_stats_t s_stats = {
+#ifdef CONFIG_NAPT_FASTPATH
+    .enabled = true,
+#endif
+};
+
+static inline uint32_t flow_hash(uint32_t a, uint32_t b, uint16_t pa, uint16_t pb, uint8_t proto)
+{
+    uint32_t h = a * 0x9E3779B1u ^ b;
+    h = (h ^ (((uint32_t)pa << 16) | pb)) * 0x85EBCA6Bu;
+    h ^= proto;
+    return h ^ (h >> 15);
+}
+
+static inline flow_t* flow_at(unsigned id)
+{
+    return &s_flows[id / NAPT_FASTPATH_WAYS][id % NAPT_FASTPATH_WAYS];
+}
+
+static flow_t* find_out(uint8_t proto, uint32_t caddr, uint16_t cport, uint32_t raddr, uint16_t rport)
+{
+    flow_t* set = s_flows[flow_hash(caddr, raddr, cport, rport, proto) % NAPT_FASTPATH_SETS];
+    for (int w = 0; w < NAPT_FASTPATH_WAYS; w++) {
+        flow_t* f = &set[w];
+        if (f->valid && f->client_addr == caddr && f->remote_addr == raddr &&
+            f->client_port == cport && f->remote_port == rport && f->proto == proto) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+static flow_t* find_in(uint8_t proto, uint32_t raddr, uint16_t rport, uint32_t eaddr, uint16_t eport)
+{
+    uint8_t id = s_in_index[flow_hash(raddr, eaddr, rport, eport, proto) % NAPT_FASTPATH_IN_INDEX];
+    if (id == 0) {
+        return NULL;
+    }
+    // 索引表直接覆盖，需要核对表项
+    flow_t* f = flow_at(id - 1);
+    if (f->valid && f->remote_addr == raddr && f->ext_addr == eaddr &&
+        f->remote_port == rport && f->ext_port == eport && f->proto == proto) {
+        return f;
+    }
+    return NULL;
+}
+
+static void flush_all(void)
+{
+    memset(s_flows, 0, sizeof(s_flows));
+    memset(s_in_index, 0, sizeof(s_in_index));
+    s_pending.valid = false;
+}
+
+// 连接建立和拆除的包交给lwIP，以维护NAPT表项的TCP状态
+// 拆除开始后表项保留为closing，避免随后的ACK重新学习而让lwIP看不到连接关闭
+static bool tcp_control(const napt_pkt_t* pkt, flow_t* f)
+{
+    if (pkt->proto != IP_PROTO_TCP) {
+        return false;
+    }
+    uint8_t flags = pkt->l4[TCP_OFF_FLAGS];
+    if (f && (flags & (TCP_FIN | TCP_RST))) {
+        f->closing = 1;
+    }
+    if (f && (flags & TCP_SYN) && f->closing) {
+        f->valid = 0;               // 同一五元组上的新连接
+    }
+    return (flags & (TCP_SYN | TCP_FIN | TCP_RST)) != 0;
+}
+
+// 命中后检查是否需要让这个包走慢路径刷新lwIP表项
+static inline bool need_refresh(flow_t* f, uint32_t now)
+{
+    if (now - f->last_used > NAPT_FASTPATH_IDLE_MS) {
+        f->valid = 0;
+        return true;
+    }
+    if (now - f->last_slow >= NAPT_FASTPATH_REFRESH_MS) {
+        f->last_slow = now;
+        s_stats.refreshes++;
+        return true;
+    }
+    return false;
+}
+
+// 记下客户端一侧的五元组，等待lwIP转发结果
+static void learn_begin(const napt_pkt_t* pkt, struct pbuf* p)
+{
+    const struct eth_hdr* eth = (const struct eth_hdr*)p->payload;
+    s_pending.proto = pkt->proto;
+    s_pending.client_addr = rd32(pkt->ip + IP_OFF_SRC);
+    s_pending.remote_addr = rd32(pkt->ip + IP_OFF_DST);
+    s_pending.client_port = rd16(pkt->l4 + L4_OFF_SPORT);
+    s_pending.remote_port = rd16(pkt->l4 + L4_OFF_DPORT);
+    SMEMCPY(&s_pending.client_mac, &eth->src, ETH_HWADDR_LEN);
+    s_pending.valid = true;
+}
+
+bool napt_fastpath_outbound(struct pbuf* p, struct netif* ap, struct netif* sta)
+{
+    napt_pkt_t pkt;
+    if (!s_stats.enabled || !napt_parse(p, &pkt)) {
+        return false;
+    }
+
+    ip4_addr_t dst;
+    dst.addr = rd32(pkt.ip + IP_OFF_DST);
+    if (ip4_addr_netcmp(&dst, netif_ip4_addr(ap), netif_ip4_netmask(ap))) {
+        return false;
+    }
+
+    uint32_t caddr = rd32(pkt.ip + IP_OFF_SRC);
+    uint16_t cport = rd16(pkt.l4 + L4_OFF_SPORT);
+    uint16_t rport = rd16(pkt.l4 + L4_OFF_DPORT);
+    flow_t* f = find_out(pkt.proto, caddr, cport, dst.addr, rport);
+
+    if (tcp_control(&pkt, f) || (f && f->closing)) {
+        return false;
+    }
+
+    uint32_t now = sys_now();
+    if (!f || f->ext_addr != netif_ip4_addr(sta)->addr || !netif_is_link_up(sta) || need_refresh(f, now)) {
+        learn_begin(&pkt, p);
+        return false;
+    }
+    if (!napt_dec_ttl(&pkt)) {
+        return false;
+    }
+
+    napt_rewrite(&pkt, IP_OFF_SRC, L4_OFF_SPORT, f->ext_addr, f->ext_port);
+    struct eth_hdr* eth = (struct eth_hdr*)p->payload;
+    SMEMCPY(&eth->dest, &f->next_hop_mac, ETH_HWADDR_LEN);
+    SMEMCPY(&eth->src, sta->hwaddr, ETH_HWADDR_LEN);
+    sta->linkoutput(sta, p);
+    pbuf_free(p);
+
+    f->last_used = now;
+    s_stats.hits_out++;
+    return true;
+}
+
+bool napt_fastpath_inbound(struct pbuf* p, struct netif* sta, struct netif* ap)
+{
+    napt_pkt_t pkt;
+    if (!s_stats.enabled || !napt_parse(p, &pkt)) {
+        return false;
+    }
+
+    uint32_t eaddr = rd32(pkt.ip + IP_OFF_DST);
+    if (eaddr != netif_ip4_addr(sta)->addr) {
+        return false;
+    }
+    flow_t* f = find_in(pkt.proto, rd32(pkt.ip + IP_OFF_SRC), rd16(pkt.l4 + L4_OFF_SPORT),
+                        eaddr, rd16(pkt.l4 + L4_OFF_DPORT));
+    if (!f) {
+        return false;
+    }
+
+    if (tcp_control(&pkt, f) || f->closing) {
+        return false;
+    }
+
+    uint32_t now = sys_now();
+    if (!netif_is_link_up(ap) || need_refresh(f, now) || !napt_dec_ttl(&pkt)) {
+        return false;
+    }
+
+    napt_rewrite(&pkt, IP_OFF_DST, L4_OFF_DPORT, f->client_addr, f->client_port);
+    struct eth_hdr* eth = (struct eth_hdr*)p->payload;
+    SMEMCPY(&eth->dest, &f->client_mac, ETH_HWADDR_LEN);
+    SMEMCPY(&eth->src, ap->hwaddr, ETH_HWADDR_LEN);
+    ap->linkoutput(ap, p);
+    pbuf_free(p);
+
+    f->last_used = now;
+    s_stats.hits_in++;
+    return true;
+}
+
+void napt_fastpath_learn(struct pbuf* p, struct netif* sta)
+{
+    if (!s_pending.valid) {
+        return;
+    }
+
+    napt_pkt_t pkt;
+    if (!napt_parse(p, &pkt) || pkt.proto != s_pending.proto ||
+        rd32(pkt.ip + IP_OFF_SRC) != netif_ip4_addr(sta)->addr ||
+        rd32(pkt.ip + IP_OFF_DST) != s_pending.remote_addr ||
+        rd16(pkt.l4 + L4_OFF_DPORT) != s_pending.remote_port) {
+        return;
+    }
+    s_pending.valid = false;
+
+    // 组内已有则更新，否则用空位或最久未用的一路
+    unsigned set = flow_hash(s_pending.client_addr, s_pending.remote_addr,
+                             s_pending.client_port, s_pending.remote_port, s_pending.proto) % NAPT_FASTPATH_SETS;
+    flow_t* f = find_out(s_pending.proto, s_pending.client_addr, s_pending.client_port,
+                         s_pending.remote_addr, s_pending.remote_port);
+    uint32_t now = sys_now();
+    if (!f) {
+        unsigned way = 0;
+        for (unsigned w = 0; w < NAPT_FASTPATH_WAYS; w++) {
+            const flow_t* c = &s_flows[set][w];
+            if (!c->valid) {
+                way = w;
+                break;
+            }
+            if (now - c->last_used > now - s_flows[set][way].last_used) {
+                way = w;
+            }
+        }
+        f = &s_flows[set][way];
+        if (f->valid) {
+            s_stats.replaced++;
+        }
+        s_stats.learned++;
+    }
+
+    const struct eth_hdr* eth = (const struct eth_hdr*)p->payload;
+    f->proto = s_pending.proto;
+    f->client_addr = s_pending.client_addr;
+    f->remote_addr = s_pending.remote_addr;
+    f->client_port = s_pending.client_port;
+    f->remote_port = s_pending.remote_port;
+    f->ext_addr = rd32(pkt.ip + IP_OFF_SRC);
+    f->ext_port = rd16(pkt.l4 + L4_OFF_SPORT);
+    f->client_mac = s_pending.client_mac;
+    SMEMCPY(&f->next_hop_mac, &eth->dest, ETH_HWADDR_LEN);
+    f->last_used = now;
+    f->last_slow = now;
+    f->closing = 0;
+    f->valid = 1;
+
+    unsigned id = set * NAPT_FASTPATH_WAYS + (unsigned)(f - s_flows[set]);
+    s_in_index[flow_hash(f->remote_addr, f->ext_addr, f->remote_port, f->ext_port, f->proto)
+               % NAPT_FASTPATH_IN_INDEX] = (uint8_t)(id + 1);
+}
+
+void napt_fastpath_learn_end(void)
+{
+    s_pending.valid = false;
+}
+
+static void set_enabled_cb(void* arg)
+{
+    flush_all();
+    s_stats.enabled = arg != NULL;
+}
+
+static void flush_cb(void* arg)
+{
+    flush_all();
+}
+
+esp_err_t napt_fastpath_set_enabled(bool enabled)
+{
+    if (tcpip_callback(set_enabled_cb, enabled ? (void*)1 : NULL) != ERR_OK) {
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "快速路径已%s", enabled ? "开启" : "关闭");
+    return ESP_OK;
+}
+
+esp_err_t napt_fastpath_flush(void)
+{
+    return tcpip_callback(flush_cb, NULL) == ERR_OK ? ESP_OK : ESP_FAIL;
+}
+
+void napt_fastpath_get_stats(napt_fastpath_stats_t* out)
+{
+    // 计数只在tcpip线程中写，这里的读取允许个别值不同步
+    *out = s_stats;
+    out->flows = 0;
+    uint32_t now = sys_now();
+    for (unsigned id = 0; id < NAPT_FASTPATH_SETS * NAPT_FASTPATH_WAYS; id++) {
+        const flow_t* f = flow_at(id);
+        if (f->valid && !f->closing && now - f->last_used <= NAPT_FASTPATH_IDLE_MS) {
+            out->flows++;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef NAPT_FASTPATH_H
+#define NAPT_FASTPATH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "sdkconfig.h"
+
+// 流缓存配置
+#define NAPT_FASTPATH_SETS 64           // 2路组相联，共128条流
+#define NAPT_FASTPATH_WAYS 2
+#define NAPT_FASTPATH_IN_INDEX 256      // 入站方向的索引表大小
+#define NAPT_FASTPATH_REFRESH_MS 1000   // 每条流每隔这么久让一个包走lwIP，刷新NAPT表项的空闲计时
+#define NAPT_FASTPATH_IDLE_MS 30000     // 超过这么久未命中的流视为失效
+
+// 快速路径计数
+typedef struct {
+    bool enabled;
+    uint32_t flows;                     // 缓存中的有效流
+    uint32_t hits_out;                  // 客户端 -> 外网 直接转发的包
+    uint32_t hits_in;                   // 外网 -> 客户端 直接转发的包
+    uint32_t learned;                   // 从lwIP转发结果学习到的流
+    uint32_t replaced;                  // 缓存组满时替换掉的流
+    uint32_t refreshes;                 // 为刷新lwIP表项送回慢路径的包
+} napt_fastpath_stats_t;
+
+// 以下函数由napt_hook在tcpip线程中调用，p为完整以太网帧
+// 命中已学习的流时改写头部并从另一个接口发出，返回true表示已接管并释放pbuf
+bool napt_fastpath_outbound(struct pbuf* p, struct netif* ap, struct netif* sta);
+bool napt_fastpath_inbound(struct pbuf* p, struct netif* sta, struct netif* ap);
+
+// 学习：outbound未命中时记下客户端一侧的五元组，lwIP NAPT转发后在上行发送时
+// 取得外网端口和下一跳MAC，建立双向表项
+void napt_fastpath_learn(struct pbuf* p, struct netif* sta);
+void napt_fastpath_learn_end(void);
+
+// 开关和清空，可在任意任务中调用（转到tcpip线程执行）
+esp_err_t napt_fastpath_set_enabled(bool enabled);
+esp_err_t napt_fastpath_flush(void);
+
+void napt_fastpath_get_stats(napt_fastpath_stats_t* out);
+
+#endif /* NAPT_FASTPATH_H */
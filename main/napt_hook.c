@@ -0,0 +1,245 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/etharp.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/prot/icmp.h"
+#include "netif/ethernet.h"
+#include "portmap.h"
+#include "napt_stats.h"
+#include "napt_pkt.h"
+#include "napt_fastpath.h"
+#include "shaper.h"
+#include "napt_hook.h"
+
+// 配置
+#define TAG "NAPT_HOOK"
+
+static struct netif* s_sta;
+static struct netif* s_ap;
+static netif_linkoutput_fn s_ap_linkoutput;
+static netif_linkoutput_fn s_sta_linkoutput;
+
+// 上行计数：客户端发往AP网段以外的包，客户端发起的TCP SYN即NAPT新建表项，UDP和ICMP回显按流判断
+// 返回客户端地址，不是上行流量时返回0
+static uint32_t napt_hook_count_uplink(struct pbuf* p, struct netif* inp)
+{
+    uint8_t* ip = frame_ipv4(p);
+    if (!ip) {
+        return 0;
+    }
+    ip4_addr_t dst;
+    dst.addr = rd32(ip + IP_OFF_DST);
+    if (ip4_addr_netcmp(&dst, netif_ip4_addr(inp), netif_ip4_netmask(inp))) {
+        return 0;
+    }
+
+    bool syn = false;
+    size_t hlen = (size_t)(ip[0] & 0x0F) * 4;
+    if (ip[9] == IP_PROTO_TCP && p->len > SIZEOF_ETH_HDR + hlen + TCP_OFF_FLAGS) {
+        uint8_t flags = ip[hlen + TCP_OFF_FLAGS];
+        syn = (flags & (TCP_SYN | TCP_ACK)) == TCP_SYN;
+    }
+    uint32_t src = rd32(ip + IP_OFF_SRC);
+    napt_stats_uplink(src, p->tot_len - SIZEOF_ETH_HDR, syn);
+
+    // lwIP按(源, 源端口, 目的, 目的端口)建表，ICMP回显以标识代替端口
+    if (ip[9] == IP_PROTO_UDP && p->len >= SIZEOF_ETH_HDR + hlen + 4) {
+        napt_stats_flow(IP_PROTO_UDP, src, dst.addr ^ rd32(ip + hlen + L4_OFF_SPORT));
+    } else if (ip[9] == IP_PROTO_ICMP && p->len >= SIZEOF_ETH_HDR + hlen + 6 && ip[hlen] == ICMP_ECHO) {
+        napt_stats_flow(IP_PROTO_ICMP, src, dst.addr ^ rd16(ip + hlen + 4));
+    }
+    return src;
+}
+
+// 下行计数：从AP接口发给客户端、源地址在AP网段以外的包，有限速时交给shaper排队
+static err_t ap_linkoutput(struct netif* netif, struct pbuf* p)
+{
+    uint8_t* ip = frame_ipv4(p);
+    if (ip) {
+        ip4_addr_t src;
+        src.addr = rd32(ip + IP_OFF_SRC);
+        if (!ip4_addr_netcmp(&src, netif_ip4_addr(netif), netif_ip4_netmask(netif))) {
+            uint32_t dst = rd32(ip + IP_OFF_DST);
+            napt_stats_downlink(dst, p->tot_len - SIZEOF_ETH_HDR);
+            if (shaper_enqueue(SHAPER_DOWN, dst, p)) {
+                return ERR_OK;
+            }
+        }
+    }
+    return s_ap_linkoutput(netif, p);
+}
+
+// 排队后的下行包
+static void ap_shaped_output(struct pbuf* p, struct netif* netif)
+{
+    s_ap_linkoutput(netif, p);
+    pbuf_free(p);
+}
+
+// 上行发送：lwIP转发出的包用于快速路径学习NAPT映射
+static err_t sta_linkoutput(struct netif* netif, struct pbuf* p)
+{
+    napt_fastpath_learn(p, netif);
+    return s_sta_linkoutput(netif, p);
+}
+
+// 入站：改写目的地址后由lwIP按路由转发到AP侧
+static void napt_hook_inbound(struct pbuf* p, struct netif* inp)
+{
+    napt_pkt_t pkt;
+    if (!napt_parse(p, &pkt)) {
+        return;
+    }
+    if (rd32(pkt.ip + IP_OFF_DST) != netif_ip4_addr(inp)->addr) {
+        return;
+    }
+
+    uint32_t daddr;
+    uint16_t dport;
+    if (!portmap_range_match_in(pkt.proto, lwip_ntohs(rd16(pkt.l4 + L4_OFF_DPORT)), &daddr, &dport)) {
+        return;
+    }
+    napt_rewrite(&pkt, IP_OFF_DST, L4_OFF_DPORT, daddr, lwip_htons(dport));
+}
+
+// 出站：命中区间规则时改写源地址并直接从STA发出，返回true表示已接管pbuf
+static bool napt_hook_outbound(struct pbuf* p, struct netif* inp)
+{
+    napt_pkt_t pkt;
+    if (!napt_parse(p, &pkt)) {
+        return false;
+    }
+    if (!netif_is_up(s_sta) || !netif_is_link_up(s_sta) || ip4_addr_isany(netif_ip4_addr(s_sta))) {
+        return false;
+    }
+
+    ip4_addr_t src, dst;
+    src.addr = rd32(pkt.ip + IP_OFF_SRC);
+    dst.addr = rd32(pkt.ip + IP_OFF_DST);
+
+    // 局域网内部的流量不处理
+    if (ip4_addr_netcmp(&dst, netif_ip4_addr(inp), netif_ip4_netmask(inp))) {
+        return false;
+    }
+
+    uint16_t mport;
+    if (!portmap_range_match_out(pkt.proto, src.addr, lwip_ntohs(rd16(pkt.l4 + L4_OFF_SPORT)), &mport)) {
+        return false;
+    }
+
+    // TTL耗尽的包交给lwIP生成ICMP
+    if (!napt_dec_ttl(&pkt)) {
+        return false;
+    }
+
+    const ip4_addr_t* next_hop = ip4_addr_netcmp(&dst, netif_ip4_addr(s_sta), netif_ip4_netmask(s_sta)) ?
+                                 &dst : netif_ip4_gw(s_sta);
+
+    napt_rewrite(&pkt, IP_OFF_SRC, L4_OFF_SPORT, netif_ip4_addr(s_sta)->addr, lwip_htons(mport));
+
+    // 下一跳在ARP缓存中时原地改写以太网头，直接交给驱动发送
+    struct eth_addr* mac;
+    const ip4_addr_t* cached_ip;
+    if (etharp_find_addr(s_sta, next_hop, &mac, &cached_ip) >= 0) {
+        struct eth_hdr* eth = (struct eth_hdr*)p->payload;
+        SMEMCPY(&eth->dest, mac, ETH_HWADDR_LEN);
+        SMEMCPY(&eth->src, s_sta->hwaddr, ETH_HWADDR_LEN);
+        s_sta->linkoutput(s_sta, p);
+        pbuf_free(p);
+        return true;
+    }
+
+    // 否则复制一份，由etharp负责地址解析
+    pbuf_remove_header(p, SIZEOF_ETH_HDR);
+    struct pbuf* q = pbuf_clone(PBUF_LINK, PBUF_RAM, p);
+    pbuf_free(p);
+    if (q) {
+        s_sta->output(s_sta, q, next_hop);
+        pbuf_free(q);
+    }
+    return true;
+}
+
+static err_t sta_ethernet_input(struct pbuf* p, struct netif* inp)
+{
+    if (napt_fastpath_inbound(p, inp, s_ap)) {
+        return ERR_OK;
+    }
+    napt_hook_inbound(p, inp);
+    return ethernet_input(p, inp);
+}
+
+// 客户端上行包的转发：区间映射、快速路径，其余经lwIP
+static err_t ap_forward(struct pbuf* p, struct netif* inp)
+{
+    if (napt_hook_outbound(p, inp)) {
+        return ERR_OK;
+    }
+    if (napt_fastpath_outbound(p, inp, s_sta)) {
+        return ERR_OK;
+    }
+    // 未命中的包经lwIP转发，期间由sta_linkoutput学习映射
+    err_t err = ethernet_input(p, inp);
+    napt_fastpath_learn_end();
+    return err;
+}
+
+// 排队后的上行包
+static void ap_shaped_forward(struct pbuf* p, struct netif* inp)
+{
+    ap_forward(p, inp);
+}
+
+static err_t ap_ethernet_input(struct pbuf* p, struct netif* inp)
+{
+    uint32_t client = napt_hook_count_uplink(p, inp);
+    // 有限速时复制入队，由shaper按令牌和轮询顺序再送入转发
+    if (client && shaper_enqueue(SHAPER_UP, client, p)) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    return ap_forward(p, inp);
+}
+
+// 驱动收包入口：与tcpip_input相同，但在tcpip线程中先经过钩子
+static err_t sta_input(struct pbuf* p, struct netif* inp)
+{
+    return tcpip_inpkt(p, inp, sta_ethernet_input);
+}
+
+static err_t ap_input(struct pbuf* p, struct netif* inp)
+{
+    return tcpip_inpkt(p, inp, ap_ethernet_input);
+}
+
+esp_err_t napt_hook_install(esp_netif_t* sta, esp_netif_t* ap)
+{
+    struct netif* sta_netif = esp_netif_get_netif_impl(sta);
+    struct netif* ap_netif = esp_netif_get_netif_impl(ap);
+    if (!sta_netif || !ap_netif) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 只替换默认的tcpip_input，其他输入函数说明协议栈配置不同，不做处理
+    if (sta_netif->input != tcpip_input || ap_netif->input != tcpip_input) {
+        ESP_LOGW(TAG, "接口输入函数不是tcpip_input，跳过挂接");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_sta = sta_netif;
+    s_ap = ap_netif;
+    s_sta->input = sta_input;
+    s_ap->input = ap_input;
+    s_ap_linkoutput = s_ap->linkoutput;
+    s_ap->linkoutput = ap_linkoutput;
+    s_sta_linkoutput = s_sta->linkoutput;
+    s_sta->linkoutput = sta_linkoutput;
+    shaper_attach(s_ap, ap_shaped_forward, ap_shaped_output);
+
+    ESP_LOGI(TAG, "收包钩子已挂接");
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#ifndef NAPT_HOOK_H
+#define NAPT_HOOK_H
+
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// 在上行(STA)和下行(AP)接口的收包入口挂接钩子，在tcpip线程中先于lwIP处理
+// 入站：目的为上行地址且命中区间端口映射的包改写目的地址端口，交由lwIP转发
+// 出站：来自区间映射内网端口的包改写源地址端口后直接从上行接口发出，不经过NAPT
+// 其余流量先查napt_fastpath流缓存，命中时跳过lwIP直接转发
+// 同时在两个方向上为napt_stats计数，并把客户端的上行和下行流量交给shaper限速排队
+esp_err_t napt_hook_install(esp_netif_t* sta, esp_netif_t* ap);
+
+#endif /* NAPT_HOOK_H */
@@ -0,0 +1,158 @@
+#ifndef NAPT_PKT_H
+#define NAPT_PKT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lwip/pbuf.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+
+// 转发路径共用的以太网帧解析与头部改写
+
+// IPv4头字段偏移
+#define IP_OFF_FRAG 6
+#define IP_OFF_TTL 8
+#define IP_OFF_CHKSUM 10
+#define IP_OFF_SRC 12
+#define IP_OFF_DST 16
+
+// TCP/UDP头字段偏移
+#define L4_OFF_SPORT 0
+#define L4_OFF_DPORT 2
+#define TCP_OFF_FLAGS 13
+#define TCP_OFF_CHKSUM 16
+#define UDP_OFF_CHKSUM 6
+
+// 解析后的IPv4 TCP/UDP包，指针指向以太网帧内部
+// 帧内的IP头只保证2字节对齐，字段一律用memcpy读写
+typedef struct {
+    uint8_t* ip;
+    uint8_t* l4;
+    uint8_t proto;
+    uint8_t l4_chksum_off;
+} napt_pkt_t;
+
+static inline uint16_t rd16(const uint8_t* p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void wr16(uint8_t* p, uint16_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t rd32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void wr32(uint8_t* p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+// 校验和增量更新（RFC 1624）：HC' = ~(~HC + ~m + m')
+// 反码和与字节序无关，各值直接使用内存中的原始16位字
+static inline uint16_t chksum_adjust16(uint16_t sum, uint16_t old_val, uint16_t new_val)
+{
+    uint32_t s = (uint16_t)~sum + (uint16_t)~old_val + new_val;
+    s = (s & 0xFFFF) + (s >> 16);
+    s = (s & 0xFFFF) + (s >> 16);
+    return (uint16_t)~s;
+}
+
+static inline uint16_t chksum_adjust32(uint16_t sum, uint32_t old_val, uint32_t new_val)
+{
+    sum = chksum_adjust16(sum, (uint16_t)old_val, (uint16_t)new_val);
+    return chksum_adjust16(sum, (uint16_t)(old_val >> 16), (uint16_t)(new_val >> 16));
+}
+
+// 返回帧中的IPv4头，非IPv4返回NULL
+static inline uint8_t* frame_ipv4(struct pbuf* p)
+{
+    if (p->len < SIZEOF_ETH_HDR + IP_HLEN) {
+        return NULL;
+    }
+    struct eth_hdr* eth = (struct eth_hdr*)p->payload;
+    if (eth->type != PP_HTONS(ETHTYPE_IP)) {
+        return NULL;
+    }
+    return (uint8_t*)p->payload + SIZEOF_ETH_HDR;
+}
+
+// 只处理未分片的IPv4 TCP/UDP包，且头部都在第一个pbuf内
+static inline bool napt_parse(struct pbuf* p, napt_pkt_t* pkt)
+{
+    uint8_t* ip = frame_ipv4(p);
+    if (!ip || (ip[0] >> 4) != 4) {
+        return false;
+    }
+    if (rd16(ip + IP_OFF_FRAG) & PP_HTONS(IP_OFFMASK | IP_MF)) {
+        return false;
+    }
+
+    size_t hlen = (size_t)(ip[0] & 0x0F) * 4;
+    uint8_t proto = ip[9];
+    size_t need;
+    if (proto == IP_PROTO_TCP) {
+        pkt->l4_chksum_off = TCP_OFF_CHKSUM;
+        need = 20;
+    } else if (proto == IP_PROTO_UDP) {
+        pkt->l4_chksum_off = UDP_OFF_CHKSUM;
+        need = 8;
+    } else {
+        return false;
+    }
+    if (hlen < IP_HLEN || p->len < SIZEOF_ETH_HDR + hlen + need) {
+        return false;
+    }
+
+    pkt->ip = ip;
+    pkt->l4 = ip + hlen;
+    pkt->proto = proto;
+    return true;
+}
+
+// 改写地址和端口，addr_off/port_off选择源或目的字段
+static inline void napt_rewrite(napt_pkt_t* pkt, int addr_off, int port_off, uint32_t addr, uint16_t port)
+{
+    uint32_t old_addr = rd32(pkt->ip + addr_off);
+    uint16_t old_port = rd16(pkt->l4 + port_off);
+
+    wr16(pkt->ip + IP_OFF_CHKSUM, chksum_adjust32(rd16(pkt->ip + IP_OFF_CHKSUM), old_addr, addr));
+    wr32(pkt->ip + addr_off, addr);
+
+    // UDP校验和为0表示未使用
+    uint16_t l4_sum = rd16(pkt->l4 + pkt->l4_chksum_off);
+    if (pkt->proto == IP_PROTO_TCP || l4_sum != 0) {
+        l4_sum = chksum_adjust32(l4_sum, old_addr, addr);
+        l4_sum = chksum_adjust16(l4_sum, old_port, port);
+        if (pkt->proto == IP_PROTO_UDP && l4_sum == 0) {
+            l4_sum = 0xFFFF;
+        }
+        wr16(pkt->l4 + pkt->l4_chksum_off, l4_sum);
+    }
+    wr16(pkt->l4 + port_off, port);
+}
+
+// TTL减一并更新IP头校验和，TTL耗尽返回false（交给lwIP生成ICMP）
+static inline bool napt_dec_ttl(napt_pkt_t* pkt)
+{
+    uint8_t ttl = pkt->ip[IP_OFF_TTL];
+    if (ttl <= 1) {
+        return false;
+    }
+    uint16_t old_word = rd16(pkt->ip + IP_OFF_TTL);
+    pkt->ip[IP_OFF_TTL] = ttl - 1;
+    wr16(pkt->ip + IP_OFF_CHKSUM, chksum_adjust16(rd16(pkt->ip + IP_OFF_CHKSUM), old_word, rd16(pkt->ip + IP_OFF_TTL)));
+    return true;
+}
+
+#endif /* NAPT_PKT_H */
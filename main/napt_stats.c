@@ -0,0 +1,362 @@
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/lwip_napt.h"
+#include "lwip/stats.h"
+#include "lwip/prot/ip.h"
+#include "napt_stats.h"
+#include "napt_config.h"
+
+// 配置
+#define TAG "NAPT_STATS"
+
+#if !IP_NAPT_STATS
+#warning "IP_NAPT_STATS未启用（CONFIG_LWIP_STATS），napt_stats不显示连接表占用和淘汰"
+#endif
+
+// 新建表项按协议计数
+enum {
+    NEW_TCP = 0,
+    NEW_UDP,
+    NEW_ICMP,
+    NEW_PROTOS
+};
+
+// 转发路径写入的计数器，32位即可，采样时按差值累加到64位总量
+typedef struct {
+    uint32_t tx_pkts;
+    uint32_t rx_pkts;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+} client_counter_t;
+
+// 每个CPU核一个桶
+// 同一核上的任务抢占可能丢失个别计数，统计用途可以接受，换来转发路径无锁无原子操作
+typedef struct {
+    client_counter_t clients[NAPT_STATS_CLIENTS];
+    uint32_t new_flows[NEW_PROTOS];
+} stats_bucket_t;
+
+// UDP/ICMP流过滤表，各核共用，并发写入只会多计或少计个别新建表项
+typedef struct {
+    uint32_t tag;                       // 流的哈希，0为空
+    TickType_t last;                    // 最近一次上行的时间
+} flow_slot_t;
+
+// 采样器状态
+typedef struct {
+    client_counter_t prev;              // 上次采样时各桶之和
+    napt_client_stats_t total;
+} client_state_t;
+
+static stats_bucket_t* s_buckets[portNUM_PROCESSORS];
+static client_state_t* s_clients;
+static flow_slot_t* s_flows;
+static TickType_t s_udp_idle;           // 超过lwIP的空闲超时再出现的流已被lwIP删除，按新建计
+static TickType_t s_icmp_idle;
+static uint32_t s_prev_new[NEW_PROTOS];
+static uint32_t s_prev_evictions;
+static int64_t s_prev_sample_us;
+static uint32_t s_net;
+static uint32_t s_mask;
+
+static napt_stats_t s_snapshot;
+static SemaphoreHandle_t s_lock;          // 保护s_clients和s_snapshot，转发路径不使用，采样定时器只尝试获取
+static esp_timer_handle_t s_timer;
+
+// 网段内地址的主机号，不在网段内返回-1
+static inline int client_index(uint32_t addr)
+{
+    if ((addr & s_mask) != s_net) {
+        return -1;
+    }
+    return ((const uint8_t*)&addr)[3];
+}
+
+void napt_stats_uplink(uint32_t src, size_t len, bool tcp_syn)
+{
+    stats_bucket_t* b = s_buckets[xPortGetCoreID()];
+    int i = client_index(src);
+    if (!b || i < 0) {
+        return;
+    }
+    b->clients[i].tx_pkts++;
+    b->clients[i].tx_bytes += len;
+    if (tcp_syn) {
+        b->new_flows[NEW_TCP]++;
+    }
+}
+
+void napt_stats_flow(uint8_t proto, uint32_t src, uint32_t flow)
+{
+    stats_bucket_t* b = s_buckets[xPortGetCoreID()];
+    if (!b || client_index(src) < 0) {
+        return;
+    }
+
+    uint32_t h = (src * 0x9E3779B1u) ^ flow ^ proto;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 16;
+    uint32_t tag = h | 1;
+    flow_slot_t* f = &s_flows[h & (NAPT_STATS_FLOWS - 1)];
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t idle = proto == IP_PROTO_UDP ? s_udp_idle : s_icmp_idle;
+    if (f->tag != tag || now - f->last > idle) {
+        b->new_flows[proto == IP_PROTO_UDP ? NEW_UDP : NEW_ICMP]++;
+        f->tag = tag;
+    }
+    f->last = now;
+}
+
+void napt_stats_downlink(uint32_t dst, size_t len)
+{
+    stats_bucket_t* b = s_buckets[xPortGetCoreID()];
+    int i = client_index(dst);
+    if (!b || i < 0) {
+        return;
+    }
+    b->clients[i].rx_pkts++;
+    b->clients[i].rx_bytes += len;
+}
+
+static void insert_top(napt_client_stats_t* top, size_t* count, const napt_client_stats_t* c)
+{
+    uint64_t rate = (uint64_t)c->tx_rate + c->rx_rate;
+    size_t j = *count < NAPT_STATS_TOP ? (*count)++ : NAPT_STATS_TOP;
+    while (j > 0 && (uint64_t)top[j - 1].tx_rate + top[j - 1].rx_rate < rate) {
+        if (j < NAPT_STATS_TOP) {
+            top[j] = top[j - 1];
+        }
+        j--;
+    }
+    if (j < NAPT_STATS_TOP) {
+        top[j] = *c;
+    }
+}
+
+// 按实际采样间隔换算为每秒
+static inline uint32_t per_sec(uint32_t n, uint32_t elapsed_us)
+{
+    return (uint32_t)((uint64_t)n * 1000000 / elapsed_us);
+}
+
+// 周期采样：汇总各核计数，计算速率和排行，读取lwIP连接表统计
+// 读取者持锁时跳过本次，差值留到下次按实际间隔换算，不阻塞esp_timer任务
+static void sample_timer_cb(void* arg)
+{
+    if (xSemaphoreTake(s_lock, 0) != pdTRUE) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed_us = (uint32_t)(now - s_prev_sample_us);
+    s_prev_sample_us = now;
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    napt_stats_t snap = { 0 };
+    uint32_t new_flows[NEW_PROTOS] = { 0 };
+    uint32_t tx_pkts = 0;
+    uint32_t tx_total = 0;
+    uint32_t rx_total = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        for (int k = 0; k < NEW_PROTOS; k++) {
+            new_flows[k] += s_buckets[core]->new_flows[k];
+        }
+    }
+
+    for (int i = 0; i < NAPT_STATS_CLIENTS; i++) {
+        client_counter_t sum = { 0 };
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            const client_counter_t* c = &s_buckets[core]->clients[i];
+            sum.tx_pkts += c->tx_pkts;
+            sum.rx_pkts += c->rx_pkts;
+            sum.tx_bytes += c->tx_bytes;
+            sum.rx_bytes += c->rx_bytes;
+        }
+
+        client_state_t* st = &s_clients[i];
+        uint32_t tx_bytes = sum.tx_bytes - st->prev.tx_bytes;
+        uint32_t rx_bytes = sum.rx_bytes - st->prev.rx_bytes;
+        tx_pkts += sum.tx_pkts - st->prev.tx_pkts;
+        tx_total += tx_bytes;
+        rx_total += rx_bytes;
+        st->total.tx_pkts += sum.tx_pkts - st->prev.tx_pkts;
+        st->total.rx_pkts += sum.rx_pkts - st->prev.rx_pkts;
+        st->total.tx_bytes += tx_bytes;
+        st->total.rx_bytes += rx_bytes;
+        st->total.tx_rate = per_sec(tx_bytes, elapsed_us);
+        st->total.rx_rate = per_sec(rx_bytes, elapsed_us);
+        st->prev = sum;
+
+        if (st->total.tx_pkts || st->total.rx_pkts) {
+            snap.clients++;
+            insert_top(snap.top, &snap.top_count, &st->total);
+        }
+    }
+
+    uint32_t delta[NEW_PROTOS];
+    for (int k = 0; k < NEW_PROTOS; k++) {
+        delta[k] = new_flows[k] - s_prev_new[k];
+        s_prev_new[k] = new_flows[k];
+    }
+    snap.tcp_new = s_snapshot.tcp_new + delta[NEW_TCP];
+    snap.tcp_new_rate = per_sec(delta[NEW_TCP], elapsed_us);
+    snap.udp_new = s_snapshot.udp_new + delta[NEW_UDP];
+    snap.udp_new_rate = per_sec(delta[NEW_UDP], elapsed_us);
+    snap.icmp_new = s_snapshot.icmp_new + delta[NEW_ICMP];
+    snap.icmp_new_rate = per_sec(delta[NEW_ICMP], elapsed_us);
+    snap.new_rate = per_sec(delta[NEW_TCP] + delta[NEW_UDP] + delta[NEW_ICMP], elapsed_us);
+    snap.uplink_pkt_rate = per_sec(tx_pkts, elapsed_us);
+    snap.uplink_byte_rate = per_sec(tx_total, elapsed_us);
+    snap.downlink_byte_rate = per_sec(rx_total, elapsed_us);
+
+    napt_config_t config;
+    napt_config_get(&config);
+    snap.table_size = config.entries;
+#if IP_NAPT_STATS
+    struct stats_ip_napt napt;
+    ip_napt_get_stats(&napt);
+    snap.table_valid = true;
+    snap.active_tcp = napt.nr_active_tcp;
+    snap.active_udp = napt.nr_active_udp;
+    snap.active_icmp = napt.nr_active_icmp;
+    snap.evictions = napt.nr_forced_evictions;
+    snap.evict_rate = per_sec(napt.nr_forced_evictions - s_prev_evictions, elapsed_us);
+    s_prev_evictions = napt.nr_forced_evictions;
+#endif
+
+    s_snapshot = snap;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t napt_stats_init(uint32_t ap_ip, uint32_t netmask)
+{
+    if (s_timer) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // 客户端按主机号索引，与shaper一样只支持/24以内的网段
+    if (lwip_ntohl(netmask) < 0xFFFFFF00u) {
+        netmask = PP_HTONL(0xFFFFFF00u);
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    stats_bucket_t* buckets[portNUM_PROCESSORS] = { 0 };
+    s_lock = xSemaphoreCreateMutex();
+    s_clients = calloc(NAPT_STATS_CLIENTS, sizeof(client_state_t));
+    s_flows = calloc(NAPT_STATS_FLOWS, sizeof(flow_slot_t));
+    if (!s_lock || !s_clients || !s_flows) {
+        goto fail;
+    }
+    for (int i = 0; i < NAPT_STATS_CLIENTS; i++) {
+        ((uint8_t*)&s_clients[i].total.addr)[3] = (uint8_t)i;
+        s_clients[i].total.addr |= ap_ip & netmask;
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        buckets[core] = calloc(1, sizeof(stats_bucket_t));
+        if (!buckets[core]) {
+            goto fail;
+        }
+    }
+
+    s_net = ap_ip & netmask;
+    s_mask = netmask;
+
+    napt_config_t config;
+    napt_config_get(&config);
+    s_udp_idle = pdMS_TO_TICKS(config.udp_timeout_s ? config.udp_timeout_s * 1000 : NAPT_STATS_FLOW_IDLE_MS);
+    s_icmp_idle = pdMS_TO_TICKS(config.icmp_timeout_s ? config.icmp_timeout_s * 1000 : NAPT_STATS_FLOW_IDLE_MS);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = sample_timer_cb,
+        .name = "napt_stats",
+    };
+    err = esp_timer_create(&timer_args, &s_timer);
+    if (err != ESP_OK) {
+        s_timer = NULL;
+        goto fail;
+    }
+
+    // 计数器就绪后再对转发路径可见
+    s_prev_sample_us = esp_timer_get_time();
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        s_buckets[core] = buckets[core];
+    }
+
+    ESP_LOGI(TAG, "流量统计已启动，%d个CPU核分桶计数", portNUM_PROCESSORS);
+    return esp_timer_start_periodic(s_timer, NAPT_STATS_PERIOD_MS * 1000);
+
+fail:
+    // 失败后各接口按s_lock/s_timer为NULL视为未初始化
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        free(buckets[core]);
+    }
+    free(s_clients);
+    free(s_flows);
+    s_clients = NULL;
+    s_flows = NULL;
+    if (s_lock) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+    }
+    return err;
+}
+
+void napt_stats_get(napt_stats_t* out)
+{
+    if (!s_lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_snapshot;
+    xSemaphoreGive(s_lock);
+}
+
+size_t napt_stats_get_clients(napt_client_stats_t* out, size_t max)
+{
+    size_t n = 0;
+    if (!s_timer) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < NAPT_STATS_CLIENTS && n < max; i++) {
+        const napt_client_stats_t* c = &s_clients[i].total;
+        if (c->tx_pkts || c->rx_pkts) {
+            out[n++] = *c;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void napt_stats_reset(void)
+{
+    if (!s_timer) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < NAPT_STATS_CLIENTS; i++) {
+        napt_client_stats_t* c = &s_clients[i].total;
+        c->tx_bytes = c->rx_bytes = 0;
+        c->tx_pkts = c->rx_pkts = 0;
+        c->tx_rate = c->rx_rate = 0;
+    }
+    s_snapshot.tcp_new = 0;
+    s_snapshot.udp_new = 0;
+    s_snapshot.icmp_new = 0;
+    s_snapshot.clients = 0;
+    s_snapshot.top_count = 0;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,71 @@
+#ifndef NAPT_STATS_H
+#define NAPT_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// 统计配置
+#define NAPT_STATS_CLIENTS 256          // 按AP网段（/24）主机号索引
+#define NAPT_STATS_TOP 5                // 流量排行条数
+#define NAPT_STATS_PERIOD_MS 1000       // 采样周期，速率按实际采样间隔计算
+#define NAPT_STATS_FLOWS 1024           // UDP/ICMP新建表项判断用的流过滤表大小，须为2的幂
+#define NAPT_STATS_FLOW_IDLE_MS 2000    // lwIP未给出UDP/ICMP超时时使用的空闲时间
+
+// 单个客户端的累计流量（上行为客户端发往外网，下行为外网发往客户端）
+typedef struct {
+    uint32_t addr;                      // 客户端地址（网络字节序）
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t tx_pkts;
+    uint32_t rx_pkts;
+    uint32_t tx_rate;                   // 最近一个周期的速率（字节/秒）
+    uint32_t rx_rate;
+} napt_client_stats_t;
+
+// NAPT整体统计
+typedef struct {
+    bool table_valid;                   // lwIP是否提供连接表统计（IP_NAPT_STATS）
+    uint32_t table_size;                // 连接表容量（napt_config生效的表项数）
+    uint32_t active_tcp;
+    uint32_t active_udp;
+    uint32_t active_icmp;
+    uint32_t evictions;                 // 表满时强制淘汰的连接数
+    uint32_t evict_rate;                // 次/秒
+    uint32_t tcp_new;                   // 客户端发起的TCP连接数（SYN），即新建表项
+    uint32_t tcp_new_rate;              // 次/秒
+    uint32_t udp_new;                   // 空闲超时内未出现过的UDP流，即新建表项（哈希冲突时略偏多）
+    uint32_t udp_new_rate;
+    uint32_t icmp_new;                  // 同上，ICMP回显按标识区分
+    uint32_t icmp_new_rate;
+    uint32_t new_rate;                  // 各协议新建表项之和（次/秒），即连接表未命中
+    uint32_t uplink_pkt_rate;           // 客户端上行包速率（包/秒），用于估算连接表命中率
+    uint32_t uplink_byte_rate;          // 全部客户端的上行/下行速率（字节/秒）
+    uint32_t downlink_byte_rate;
+    uint32_t clients;                   // 有流量记录的客户端数
+    size_t top_count;
+    napt_client_stats_t top[NAPT_STATS_TOP];   // 按最近一个周期总速率排序
+} napt_stats_t;
+
+// 分配计数器并启动周期采样，ap_ip/netmask为AP网段（网络字节序）
+esp_err_t napt_stats_init(uint32_t ap_ip, uint32_t netmask);
+
+// 转发路径计数，可在任意任务中无锁调用
+// 计数器按CPU核分桶，每个核只写自己的桶，由采样定时器汇总
+void napt_stats_uplink(uint32_t src, size_t len, bool tcp_syn);
+// UDP和ICMP回显没有建立连接的标志，按流判断是否新建表项
+// flow为目的地址与端口（ICMP为回显标识）的组合，同一流取值不变即可
+void napt_stats_flow(uint8_t proto, uint32_t src, uint32_t flow);
+void napt_stats_downlink(uint32_t dst, size_t len);
+
+// 读取最近一次采样结果
+void napt_stats_get(napt_stats_t* out);
+
+// 复制所有有流量记录的客户端，返回条数
+size_t napt_stats_get_clients(napt_client_stats_t* out, size_t max);
+
+// 清零累计值
+void napt_stats_reset(void);
+
+#endif /* NAPT_STATS_H */
@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/tcpip.h"
+#include "portmap.h"
+#include "router_globals.h"
+
+// 配置
+#define TAG "PORTMAP"
+#define HASH_SIZE (1 << PORTMAP_HASH_BITS)
+#define HASH_MASK (HASH_SIZE - 1)
+#define SLOT_EMPTY (-1)
+
+_Static_assert(PORTMAP_MAX * 2 <= HASH_SIZE, "portmap hash index too small");
+_Static_assert(PORTMAP_MAX <= 100, "portmap NVS keys use two digits");
+
+// 规则按槽位存放，槽位号即NVS键号，增删不移动其他规则
+static portmap_entry_t s_entries[PORTMAP_MAX];
+static bool s_applied[PORTMAP_MAX];     // 是否已安装到lwIP
+static uint32_t s_applied_ip;           // 已安装规则使用的外部地址，0表示尚未安装
+
+// (proto, mport)开放寻址索引，存放槽位号
+static int8_t s_index[HASH_SIZE];
+
+// 空闲槽位栈
+static uint8_t s_free[PORTMAP_MAX];
+static size_t s_free_count;
+
+static SemaphoreHandle_t s_lock;
+
+// 区间规则快照，只在tcpip线程中读取，不加锁
+// 修改时在堆上构建新表，经tcpip_callback在tcpip线程中替换并释放旧表，读者不会遇到正在改写的表
+typedef struct {
+    size_t n;
+    portmap_entry_t by_mport[PORTMAP_MAX];  // 按(proto, mport)排序，入站匹配
+    portmap_entry_t by_daddr[PORTMAP_MAX];  // 按(proto, daddr, dport)排序，出站匹配
+} range_table_t;
+
+static range_table_t* s_ranges;        // 没有区间规则时为NULL
+
+static inline uint32_t portmap_hash(uint8_t proto, uint16_t mport)
+{
+    uint32_t key = ((uint32_t)proto << 16) | mport;
+    return (key * 2654435761u) >> (32 - PORTMAP_HASH_BITS);
+}
+
+// 返回索引表中的位置，未找到时返回应插入的空位置
+static uint32_t index_probe(uint8_t proto, uint16_t mport, bool* found)
+{
+    uint32_t i = portmap_hash(proto, mport);
+    while (s_index[i] != SLOT_EMPTY) {
+        const portmap_entry_t* e = &s_entries[s_index[i]];
+        if (e->proto == proto && e->mport == mport) {
+            *found = true;
+            return i;
+        }
+        i = (i + 1) & HASH_MASK;
+    }
+    *found = false;
+    return i;
+}
+
+// 线性探测的后移删除，不留墓碑
+static void index_remove(uint32_t i)
+{
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & HASH_MASK;
+        if (s_index[j] == SLOT_EMPTY) {
+            break;
+        }
+        const portmap_entry_t* e = &s_entries[s_index[j]];
+        uint32_t k = portmap_hash(e->proto, e->mport);
+        // k不在(i, j]循环区间内时，j处的元素可以前移到i
+        bool movable = (i <= j) ? (k <= i || k > j) : (k <= i && k > j);
+        if (movable) {
+            s_index[i] = s_index[j];
+            i = j;
+        }
+    }
+    s_index[i] = SLOT_EMPTY;
+}
+
+static void slot_key(char* key, size_t size, int slot)
+{
+    snprintf(key, size, PORTMAP_NVS_PREFIX "%02d", slot);
+}
+
+// 只写入一个槽位的规则
+static esp_err_t slot_store(nvs_handle_t nvs, int slot)
+{
+    char key[8];
+    slot_key(key, sizeof(key), slot);
+    return nvs_set_blob(nvs, key, &s_entries[slot], sizeof(portmap_entry_t));
+}
+
+static esp_err_t slot_persist(int slot, bool erase)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (erase) {
+        char key[8];
+        slot_key(key, sizeof(key), slot);
+        err = nvs_erase_key(nvs, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        err = slot_store(nvs, slot);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+static inline uint32_t key_in(uint8_t proto, uint16_t mport)
+{
+    return ((uint32_t)proto << 16) | mport;
+}
+
+static inline uint64_t key_out(uint8_t proto, uint32_t daddr, uint16_t dport)
+{
+    return ((uint64_t)proto << 48) | ((uint64_t)daddr << 16) | dport;
+}
+
+// 在tcpip线程中替换快照
+static void ranges_publish_cb(void* arg)
+{
+    range_table_t* old = s_ranges;
+    s_ranges = (range_table_t*)arg;
+    free(old);
+}
+
+// 重建区间规则快照（调用者持有s_lock）
+// boot为true时tcpip线程尚未启动、没有读者，直接替换
+static void rebuild_ranges(bool boot)
+{
+    range_table_t* t = NULL;
+    for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+        if (s_entries[slot].valid && s_entries[slot].count > 1) {
+            t = malloc(sizeof(range_table_t));
+            if (!t) {
+                ESP_LOGE(TAG, "区间规则快照内存不足，保留旧表");
+                return;
+            }
+            break;
+        }
+    }
+
+    size_t n = 0;
+    for (int slot = 0; t && slot < PORTMAP_MAX; slot++) {
+        const portmap_entry_t* e = &s_entries[slot];
+        if (!e->valid || e->count <= 1) {
+            continue;
+        }
+
+        // 两个数组分别插入排序，规则数很少
+        size_t j = n;
+        while (j > 0 && key_in(t->by_mport[j - 1].proto, t->by_mport[j - 1].mport) > key_in(e->proto, e->mport)) {
+            t->by_mport[j] = t->by_mport[j - 1];
+            j--;
+        }
+        t->by_mport[j] = *e;
+
+        j = n;
+        while (j > 0 && key_out(t->by_daddr[j - 1].proto, t->by_daddr[j - 1].daddr, t->by_daddr[j - 1].dport) >
+                        key_out(e->proto, e->daddr, e->dport)) {
+            t->by_daddr[j] = t->by_daddr[j - 1];
+            j--;
+        }
+        t->by_daddr[j] = *e;
+        n++;
+    }
+    if (t) {
+        t->n = n;
+    }
+
+    if (boot) {
+        ranges_publish_cb(t);
+    } else if (tcpip_callback(ranges_publish_cb, t) != ERR_OK) {
+        ESP_LOGE(TAG, "区间规则快照提交失败，保留旧表");
+        free(t);
+    }
+}
+
+static inline bool ranges_overlap(uint16_t a, uint16_t a_count, uint16_t b, uint16_t b_count)
+{
+    return (uint32_t)a < (uint32_t)b + b_count && (uint32_t)b < (uint32_t)a + a_count;
+}
+
+// 检查新规则与其他规则是否冲突（调用者持有s_lock），skip为正在更新的槽位
+static bool rule_conflicts(const portmap_entry_t* r, int skip)
+{
+    for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+        const portmap_entry_t* e = &s_entries[slot];
+        if (slot == skip || !e->valid || e->proto != r->proto) {
+            continue;
+        }
+        if (ranges_overlap(e->mport, e->count, r->mport, r->count)) {
+            return true;
+        }
+        // 区间规则按内网地址端口反查外部端口，内网端口也不能重叠
+        if ((e->count > 1 || r->count > 1) && e->daddr == r->daddr &&
+            ranges_overlap(e->dport, e->count, r->dport, r->count)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void slot_install(int slot)
+{
+    const portmap_entry_t* e = &s_entries[slot];
+    if (e->count > 1) {
+        return;
+    }
+    ip_portmap_add(e->proto, s_applied_ip, e->mport, e->daddr, e->dport);
+    s_applied[slot] = true;
+}
+
+static void slot_uninstall(int slot)
+{
+    if (s_applied[slot]) {
+        ip_portmap_remove(s_entries[slot].proto, s_entries[slot].mport);
+        s_applied[slot] = false;
+    }
+}
+
+// 放入指定槽位并建立索引，重复规则返回false
+static bool slot_insert(int slot, const portmap_entry_t* entry)
+{
+    bool found;
+    uint32_t i = index_probe(entry->proto, entry->mport, &found);
+    if (found) {
+        return false;
+    }
+    s_entries[slot] = *entry;
+    s_entries[slot].valid = 1;
+    if (entry->count == 0 || (uint32_t)entry->mport + entry->count > 65536 ||
+        (uint32_t)entry->dport + entry->count > 65536) {
+        s_entries[slot].count = 1;
+    }
+    s_index[i] = (int8_t)slot;
+    return true;
+}
+
+static void rebuild_free_list(void)
+{
+    s_free_count = 0;
+    for (int slot = PORTMAP_MAX - 1; slot >= 0; slot--) {
+        if (!s_entries[slot].valid) {
+            s_free[s_free_count++] = (uint8_t)slot;
+        }
+    }
+}
+
+// 旧版把整张表存成一个blob，迁移为每条规则一个键后删除
+static void migrate_legacy(nvs_handle_t nvs)
+{
+    size_t len = 0;
+    if (nvs_get_blob(nvs, PORTMAP_NVS_LEGACY, NULL, &len) != ESP_OK) {
+        return;
+    }
+
+    portmap_entry_t* legacy = NULL;
+    if (len == sizeof(portmap_entry_t) * PORTMAP_MAX) {
+        legacy = malloc(len);
+    }
+    if (legacy && nvs_get_blob(nvs, PORTMAP_NVS_LEGACY, legacy, &len) == ESP_OK) {
+        int migrated = 0;
+        for (int i = 0; i < PORTMAP_MAX; i++) {
+            if (!legacy[i].valid) {
+                continue;
+            }
+            if (s_free_count == 0) {
+                break;
+            }
+            // 旧版记录中count所在的两个字节是结构体填充，内容不确定，不能当作区间长度
+            legacy[i].count = 1;
+            int slot = s_free[s_free_count - 1];
+            if (slot_insert(slot, &legacy[i])) {
+                s_free_count--;
+                if (slot_store(nvs, slot) == ESP_OK) {
+                    migrated++;
+                }
+            }
+        }
+        ESP_LOGI(TAG, "已迁移%d条旧版端口映射", migrated);
+    } else {
+        ESP_LOGW(TAG, "旧版端口映射表长度不符，已丢弃");
+    }
+    free(legacy);
+
+    nvs_erase_key(nvs, PORTMAP_NVS_LEGACY);
+    nvs_commit(nvs);
+}
+
+esp_err_t portmap_init(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_applied, 0, sizeof(s_applied));
+    memset(s_index, SLOT_EMPTY, sizeof(s_index));
+    s_applied_ip = 0;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        rebuild_free_list();
+        return err;
+    }
+
+    for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+        char key[8];
+        portmap_entry_t entry;
+        size_t len = sizeof(entry);
+        slot_key(key, sizeof(key), slot);
+        if (nvs_get_blob(nvs, key, &entry, &len) != ESP_OK || len != sizeof(entry) || !entry.valid) {
+            continue;
+        }
+        if (!slot_insert(slot, &entry)) {
+            nvs_erase_key(nvs, key);
+        }
+    }
+    rebuild_free_list();
+
+    migrate_legacy(nvs);
+    nvs_close(nvs);
+    rebuild_ranges(true);
+
+    ESP_LOGI(TAG, "加载%d条端口映射", PORTMAP_MAX - (int)s_free_count);
+    return ESP_OK;
+}
+
+esp_err_t portmap_add(uint8_t proto, uint16_t mport, uint32_t daddr, uint16_t dport)
+{
+    return portmap_add_range(proto, mport, 1, daddr, dport);
+}
+
+esp_err_t portmap_add_range(uint8_t proto, uint16_t mport, uint16_t count, uint32_t daddr, uint16_t dport)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0 || (uint32_t)mport + count > 65536 || (uint32_t)dport + count > 65536) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portmap_entry_t rule = {
+        .daddr = daddr,
+        .mport = mport,
+        .dport = dport,
+        .proto = proto,
+        .valid = 1,
+        .count = count,
+    };
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    bool found;
+    uint32_t i = index_probe(proto, mport, &found);
+    int slot = found ? s_index[i] : -1;
+
+    if (rule_conflicts(&rule, slot)) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (found) {
+        portmap_entry_t* e = &s_entries[slot];
+        if (e->daddr == daddr && e->dport == dport && e->count == count) {
+            xSemaphoreGive(s_lock);
+            return ESP_OK;
+        }
+        ESP_LOGI(TAG, "更新已有映射 %s %u", proto == PROTO_TCP ? "TCP" : "UDP", mport);
+        slot_uninstall(slot);
+        *e = rule;
+    } else if (s_free_count == 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    } else {
+        slot = s_free[--s_free_count];
+        s_entries[slot] = rule;
+        s_index[i] = (int8_t)slot;
+    }
+
+    err = slot_persist(slot, false);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "保存端口映射失败: %s", esp_err_to_name(err));
+    }
+    if (s_applied_ip != 0) {
+        slot_install(slot);
+    }
+    rebuild_ranges(false);
+
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t portmap_del(uint8_t proto, uint16_t mport)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    bool found;
+    uint32_t i = index_probe(proto, mport, &found);
+    if (!found) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int slot = s_index[i];
+    slot_uninstall(slot);
+    index_remove(i);
+    s_entries[slot].valid = 0;
+    s_free[s_free_count++] = (uint8_t)slot;
+    rebuild_ranges(false);
+
+    esp_err_t err = slot_persist(slot, true);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "删除端口映射失败: %s", esp_err_to_name(err));
+    }
+
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t portmap_clear(void)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+        if (!s_entries[slot].valid) {
+            continue;
+        }
+        slot_uninstall(slot);
+        s_entries[slot].valid = 0;
+        if (err == ESP_OK) {
+            char key[8];
+            slot_key(key, sizeof(key), slot);
+            nvs_erase_key(nvs, key);
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+
+    memset(s_index, SLOT_EMPTY, sizeof(s_index));
+    rebuild_free_list();
+    rebuild_ranges(false);
+
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+bool portmap_find(uint8_t proto, uint16_t mport, portmap_entry_t* out)
+{
+    if (!s_lock) {
+        return false;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool found;
+    uint32_t i = index_probe(proto, mport, &found);
+    if (found && out) {
+        *out = s_entries[s_index[i]];
+    }
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+void portmap_apply(uint32_t ext_ip)
+{
+    if (!s_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    int removed = 0;
+    int installed = 0;
+
+    // 外部地址变化时，已安装规则的maddr失效，需要重新安装
+    if (ext_ip != s_applied_ip) {
+        for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+            if (s_applied[slot]) {
+                slot_uninstall(slot);
+                removed++;
+            }
+        }
+        s_applied_ip = ext_ip;
+    }
+
+    if (s_applied_ip != 0) {
+        for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+            if (s_entries[slot].valid && s_entries[slot].count == 1 && !s_applied[slot]) {
+                slot_install(slot);
+                installed++;
+            }
+        }
+    }
+
+    xSemaphoreGive(s_lock);
+
+    if (removed || installed) {
+        ESP_LOGI(TAG, "端口映射同步: 移除%d条, 安装%d条", removed, installed);
+    }
+}
+
+bool portmap_range_match_in(uint8_t proto, uint16_t mport, uint32_t* daddr, uint16_t* dport)
+{
+    const range_table_t* t = s_ranges;
+    if (!t) {
+        return false;
+    }
+    uint32_t key = key_in(proto, mport);
+
+    // 找到起始键不大于key的最后一条规则
+    size_t lo = 0, hi = t->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (key_in(t->by_mport[mid].proto, t->by_mport[mid].mport) <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return false;
+    }
+
+    const portmap_entry_t* e = &t->by_mport[lo - 1];
+    if (e->proto != proto || mport - e->mport >= e->count) {
+        return false;
+    }
+    *daddr = e->daddr;
+    *dport = e->dport + (mport - e->mport);
+    return true;
+}
+
+bool portmap_range_match_out(uint8_t proto, uint32_t saddr, uint16_t sport, uint16_t* mport)
+{
+    const range_table_t* t = s_ranges;
+    if (!t) {
+        return false;
+    }
+    uint64_t key = key_out(proto, saddr, sport);
+
+    size_t lo = 0, hi = t->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const portmap_entry_t* e = &t->by_daddr[mid];
+        if (key_out(e->proto, e->daddr, e->dport) <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return false;
+    }
+
+    const portmap_entry_t* e = &t->by_daddr[lo - 1];
+    if (e->proto != proto || e->daddr != saddr || sport - e->dport >= e->count) {
+        return false;
+    }
+    *mport = e->mport + (sport - e->dport);
+    return true;
+}
+
+size_t portmap_get_all(portmap_entry_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+
+    size_t n = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int slot = 0; slot < PORTMAP_MAX && n < max; slot++) {
+        if (s_entries[slot].valid) {
+            out[n++] = s_entries[slot];
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void portmap_print(void)
+{
+    portmap_entry_t entries[PORTMAP_MAX];
+    size_t n = portmap_get_all(entries, PORTMAP_MAX);
+
+    for (size_t i = 0; i < n; i++) {
+        printf ("%s", entries[i].proto == PROTO_TCP?"TCP ":"UDP ");
+        ip4_addr_t addr;
+        addr.addr = my_ip;
+        if (entries[i].count > 1) {
+            printf (IPSTR":%d-%d -> ", IP2STR(&addr), entries[i].mport, entries[i].mport + entries[i].count - 1);
+            addr.addr = entries[i].daddr;
+            printf (IPSTR":%d-%d\n", IP2STR(&addr), entries[i].dport, entries[i].dport + entries[i].count - 1);
+        } else {
+            printf (IPSTR":%d -> ", IP2STR(&addr), entries[i].mport);
+            addr.addr = entries[i].daddr;
+            printf (IPSTR":%d\n", IP2STR(&addr), entries[i].dport);
+        }
+    }
+}
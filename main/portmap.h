@@ -0,0 +1,65 @@
+#ifndef PORTMAP_H
+#define PORTMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lwip/opt.h"
+#include "lwip/lwip_napt.h"
+
+// 端口映射表配置
+#define PORTMAP_MAX IP_PORTMAP_MAX      // 与lwIP NAPT端口映射表容量一致
+#define PORTMAP_HASH_BITS 7             // 索引表大小2^7，负载因子不超过1/2
+#define PORTMAP_NVS_PREFIX "pm"         // 每条规则一个NVS键：pm00 ~ pmNN
+#define PORTMAP_NVS_LEGACY "portmap_tab" // 旧版整表blob，启动时迁移
+
+// 端口映射规则（同时作为NVS中的存储格式，前10字节与旧版整表的元素布局相同）
+// count为1的单端口规则交给lwIP NAPT端口映射表；区间规则由napt_hook在收包路径上匹配
+typedef struct {
+    uint32_t daddr;                     // 内网地址（网络字节序）
+    uint16_t mport;                     // 外部起始端口
+    uint16_t dport;                     // 内网起始端口
+    uint8_t proto;                      // PROTO_TCP / PROTO_UDP
+    uint8_t valid;
+    uint16_t count;                     // 端口数量（旧版记录此处为填充，按1处理）
+} portmap_entry_t;
+
+// 从NVS加载规则并建立索引，需在其他接口之前调用
+esp_err_t portmap_init(void);
+
+// 添加规则，只写入该规则对应的NVS键
+// 相同(proto, mport)且目标一致时直接返回ESP_OK；目标不同时原地更新
+// 表满返回ESP_ERR_NO_MEM
+esp_err_t portmap_add(uint8_t proto, uint16_t mport, uint32_t daddr, uint16_t dport);
+
+// 添加端口区间规则：外部[mport, mport + count)映射到内网[dport, dport + count)
+// 与已有规则的外部端口重叠，或区间规则的内网端口重叠时返回ESP_ERR_INVALID_STATE
+esp_err_t portmap_add_range(uint8_t proto, uint16_t mport, uint16_t count, uint32_t daddr, uint16_t dport);
+
+// 删除规则并擦除其NVS键，规则不存在返回ESP_ERR_NOT_FOUND
+esp_err_t portmap_del(uint8_t proto, uint16_t mport);
+
+// 删除全部规则
+esp_err_t portmap_clear(void);
+
+// 按(proto, 外部起始端口)查找规则，找到时复制到out（可为NULL）并返回true
+bool portmap_find(uint8_t proto, uint16_t mport, portmap_entry_t* out);
+
+// 将规则同步到lwIP NAPT，ext_ip为上行接口地址
+// 只安装尚未安装的规则；地址变化时才重新安装全部规则
+void portmap_apply(uint32_t ext_ip);
+
+// 收包路径使用的区间匹配，端口均为主机字节序，可在tcpip线程中无锁调用
+// 入站：外部端口落在某条区间规则内时返回true，并给出内网地址和端口
+bool portmap_range_match_in(uint8_t proto, uint16_t mport, uint32_t* daddr, uint16_t* dport);
+// 出站：内网地址和端口属于某条区间规则时返回true，并给出外部端口
+bool portmap_range_match_out(uint8_t proto, uint32_t saddr, uint16_t sport, uint16_t* mport);
+
+// 复制当前所有规则，返回条数
+size_t portmap_get_all(portmap_entry_t* out, size_t max);
+
+// 打印规则表
+void portmap_print(void);
+
+#endif /* PORTMAP_H */
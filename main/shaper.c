@@ -0,0 +1,695 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/def.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "router_globals.h"
+#include "dhcp_leases.h"
+#include "shaper.h"
+
+// 配置
+#define TAG "SHAPER"
+#define SHAPER_MAX_KBPS 1000000         // 1Gbps，换算成字节/秒不溢出
+
+_Static_assert(SHAPER_RULES <= 100, "shaper NVS keys use two digits");
+_Static_assert(SHAPER_QUEUE_DEPTH <= 255, "queue depth is stored in a byte");
+
+// 令牌桶，单位字节
+typedef struct {
+    uint32_t rate;                      // 字节/秒，0表示不限
+    uint32_t burst;
+    int32_t tokens;
+    int64_t last_us;
+} bucket_t;
+
+// 一个客户端在一个方向上的队列，只在tcpip线程中访问
+typedef struct {
+    struct pbuf* ring[SHAPER_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    bool listed;                        // 在轮询环中
+    int32_t deficit;                    // DRR差额计数
+    bucket_t bucket;
+    shaper_queue_stats_t stats;
+} client_queue_t;
+
+typedef struct {
+    bool active;
+    bool draining;
+    bool timer_pending;
+    shaper_output_fn output;
+    bucket_t total;
+    uint32_t rate[SHAPER_CLIENTS];      // 各客户端速率（字节/秒）
+    client_queue_t* queues[SHAPER_CLIENTS]; // 首次需要排队时分配
+    uint8_t ring[SHAPER_CLIENTS];       // 有包排队的客户端，按轮询顺序
+    uint16_t ring_head;
+    uint16_t ring_count;
+    uint16_t queued;
+} direction_t;
+
+// 发往tcpip线程的速率表
+typedef struct {
+    shaper_limit_t total;
+    shaper_limit_t host[SHAPER_CLIENTS];
+} limits_t;
+
+static direction_t s_dirs[SHAPER_DIRS];
+static struct netif* s_ap;
+static uint32_t s_net;
+static uint32_t s_mask;
+
+static SemaphoreHandle_t s_lock;        // 保护配置和规则，转发路径不使用
+static shaper_config_t s_config;
+static shaper_rule_t s_rules[SHAPER_RULES];
+
+// 网段内地址的主机号，不在网段内返回-1
+static inline int client_index(uint32_t addr)
+{
+    if ((addr & s_mask) != s_net) {
+        return -1;
+    }
+    return ((const uint8_t*)&addr)[3];
+}
+
+static inline uint32_t limit_of(const shaper_limit_t* l, int dir)
+{
+    return dir == SHAPER_UP ? l->up_kbps : l->down_kbps;
+}
+
+static void bucket_set(bucket_t* b, uint32_t kbps)
+{
+    b->rate = kbps * 125;
+    uint32_t burst = (uint32_t)((uint64_t)b->rate * SHAPER_BURST_MS / 1000);
+    b->burst = burst > SHAPER_BURST_MIN ? burst : SHAPER_BURST_MIN;
+    if (b->tokens > (int32_t)b->burst) {
+        b->tokens = b->burst;
+    }
+}
+
+static void bucket_refill(bucket_t* b, int64_t now)
+{
+    if (!b->rate) {
+        return;
+    }
+    int64_t elapsed = now - b->last_us;
+    if (elapsed > 1000000) {
+        elapsed = 1000000;
+    }
+    // 不足一个字节时不更新时间，留到下次累计
+    int64_t add = elapsed * b->rate / 1000000;
+    if (add <= 0) {
+        return;
+    }
+    b->last_us = now;
+    int64_t tokens = b->tokens + add;
+    b->tokens = tokens > b->burst ? (int32_t)b->burst : (int32_t)tokens;
+}
+
+// 令牌足够时返回0，否则返回还需等待的微秒数
+static uint32_t bucket_wait(const bucket_t* b, uint16_t len)
+{
+    if (!b->rate || b->tokens >= len) {
+        return 0;
+    }
+    return (uint32_t)(((int64_t)len - b->tokens) * 1000000 / b->rate) + 1;
+}
+
+static void bucket_take(bucket_t* b, uint16_t len)
+{
+    if (b->rate) {
+        b->tokens -= len;
+    }
+}
+
+static void ring_push(direction_t* d, uint8_t i)
+{
+    d->ring[(d->ring_head + d->ring_count) % SHAPER_CLIENTS] = i;
+    d->ring_count++;
+    d->queues[i]->listed = true;
+}
+
+static uint8_t ring_pop(direction_t* d)
+{
+    uint8_t i = d->ring[d->ring_head];
+    d->ring_head = (d->ring_head + 1) % SHAPER_CLIENTS;
+    d->ring_count--;
+    d->queues[i]->listed = false;
+    return i;
+}
+
+static struct pbuf* queue_pop(direction_t* d, client_queue_t* q)
+{
+    struct pbuf* p = q->ring[q->head];
+    q->head = (q->head + 1) % SHAPER_QUEUE_DEPTH;
+    q->count--;
+    d->queued--;
+    return p;
+}
+
+static void drain_timeout(void* arg);
+
+// DRR调度：每轮给每个有包的队列SHAPER_QUANTUM字节的额度，
+// 队首包不超过额度且客户端和方向总令牌都足够时发出；一整轮都发不出时等待令牌
+static void drain(direction_t* d, int64_t now)
+{
+    // 发送函数中的转发可能再次进入本方向，由外层循环继续处理
+    if (d->draining || !d->output) {
+        return;
+    }
+    d->draining = true;
+    bucket_refill(&d->total, now);
+
+    uint32_t wait_us = 0;
+    bool progress = true;
+    while (d->ring_count > 0 && progress) {
+        progress = false;
+        wait_us = UINT32_MAX;
+        for (uint16_t n = d->ring_count; n > 0; n--) {
+            uint8_t i = ring_pop(d);
+            client_queue_t* q = d->queues[i];
+            bucket_refill(&q->bucket, now);
+            // 等待令牌的队列不无限积累额度
+            q->deficit += SHAPER_QUANTUM;
+            if (q->deficit > 2 * SHAPER_QUANTUM) {
+                q->deficit = 2 * SHAPER_QUANTUM;
+            }
+            while (q->count > 0) {
+                uint16_t len = q->ring[q->head]->tot_len;
+                if (len > q->deficit) {
+                    break;
+                }
+                uint32_t w = bucket_wait(&q->bucket, len);
+                uint32_t wt = bucket_wait(&d->total, len);
+                w = w > wt ? w : wt;
+                if (w) {
+                    wait_us = w < wait_us ? w : wait_us;
+                    break;
+                }
+                bucket_take(&q->bucket, len);
+                bucket_take(&d->total, len);
+                q->deficit -= len;
+                q->stats.queued++;
+                d->output(queue_pop(d, q), s_ap);
+                progress = true;
+            }
+            if (q->count > 0) {
+                ring_push(d, i);
+            } else {
+                q->deficit = 0;
+            }
+        }
+    }
+    d->draining = false;
+
+    if (d->ring_count > 0 && !d->timer_pending) {
+        uint32_t ms = wait_us / 1000 + 1;
+        d->timer_pending = true;
+        sys_timeout(ms < SHAPER_WAIT_MAX_MS ? ms : SHAPER_WAIT_MAX_MS, drain_timeout, d);
+    }
+}
+
+static void drain_timeout(void* arg)
+{
+    direction_t* d = arg;
+    d->timer_pending = false;
+    drain(d, esp_timer_get_time());
+}
+
+// 方向队列满时丢弃最长队列的队首，新来的包所在队列就是最长的则返回false
+static bool drop_longest(direction_t* d, const client_queue_t* self)
+{
+    client_queue_t* longest = NULL;
+    for (uint16_t n = 0; n < d->ring_count; n++) {
+        client_queue_t* q = d->queues[d->ring[(d->ring_head + n) % SHAPER_CLIENTS]];
+        if (!longest || q->count > longest->count) {
+            longest = q;
+        }
+    }
+    if (!longest || longest->count <= self->count) {
+        return false;
+    }
+    pbuf_free(queue_pop(d, longest));
+    longest->stats.drops++;
+    return true;
+}
+
+static client_queue_t* queue_get(direction_t* d, int i)
+{
+    if (!d->queues[i]) {
+        client_queue_t* q = calloc(1, sizeof(client_queue_t));
+        if (!q) {
+            return NULL;
+        }
+        bucket_set(&q->bucket, d->rate[i] / 125);
+        d->queues[i] = q;
+    }
+    return d->queues[i];
+}
+
+bool shaper_enqueue(shaper_dir_t dir, uint32_t client, struct pbuf* p)
+{
+    direction_t* d = &s_dirs[dir];
+    if (!d->active) {
+        return false;
+    }
+    int i = client_index(client);
+    if (i < 0 || (!d->rate[i] && !d->total.rate)) {
+        return false;
+    }
+    client_queue_t* q = queue_get(d, i);
+    if (!q) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint16_t len = p->tot_len;
+    bucket_refill(&q->bucket, now);
+    bucket_refill(&d->total, now);
+
+    // 自己没有包在排队、也不需要和其他客户端分享总速率时，令牌足够就直接放行，不复制
+    if (q->count == 0 && (d->queued == 0 || !d->total.rate) &&
+        !bucket_wait(&q->bucket, len) && !bucket_wait(&d->total, len)) {
+        bucket_take(&q->bucket, len);
+        bucket_take(&d->total, len);
+        q->stats.passed++;
+        return false;
+    }
+
+    if (q->count >= SHAPER_QUEUE_DEPTH || (d->queued >= SHAPER_QUEUE_TOTAL && !drop_longest(d, q))) {
+        q->stats.drops++;
+        return true;
+    }
+    // 复制一份排队，上行收到的驱动缓冲区立即归还
+    struct pbuf* c = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (!c) {
+        q->stats.drops++;
+        return true;
+    }
+    q->ring[(q->head + q->count) % SHAPER_QUEUE_DEPTH] = c;
+    q->count++;
+    d->queued++;
+    if (q->count > q->stats.max_depth) {
+        q->stats.max_depth = q->count;
+    }
+    if (!q->listed) {
+        ring_push(d, i);
+    }
+    drain(d, now);
+    return true;
+}
+
+// 在tcpip线程中换上新的速率表，取消限速后还在排队的包立即发出
+static void apply_cb(void* arg)
+{
+    limits_t* t = arg;
+    for (int dir = 0; dir < SHAPER_DIRS; dir++) {
+        direction_t* d = &s_dirs[dir];
+        bucket_set(&d->total, limit_of(&t->total, dir));
+        bool active = d->total.rate != 0;
+        for (int i = 0; i < SHAPER_CLIENTS; i++) {
+            uint32_t kbps = limit_of(&t->host[i], dir);
+            d->rate[i] = kbps * 125;
+            active |= kbps != 0;
+            if (d->queues[i]) {
+                bucket_set(&d->queues[i]->bucket, kbps);
+            }
+        }
+        d->active = active;
+        drain(d, esp_timer_get_time());
+    }
+    free(t);
+}
+
+static bool rule_by_mac(const shaper_rule_t* r)
+{
+    static const uint8_t zero[6] = { 0 };
+    return memcmp(r->mac, zero, 6) != 0;
+}
+
+// 按默认速率和规则生成各客户端的速率表交给tcpip线程（调用者持有s_lock）
+// MAC规则按当前租约找到地址，客户端换了地址时由分配地址事件重新生成
+static esp_err_t publish(void)
+{
+    limits_t* t = malloc(sizeof(limits_t));
+    if (!t) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->total = s_config.total;
+    for (int i = 0; i < SHAPER_CLIENTS; i++) {
+        t->host[i] = s_config.client;
+    }
+
+    dhcp_lease_info_t* leases = NULL;
+    size_t n_leases = 0;
+    for (int slot = 0; slot < SHAPER_RULES; slot++) {
+        if (s_rules[slot].valid && rule_by_mac(&s_rules[slot])) {
+            leases = malloc(sizeof(dhcp_lease_info_t) * DHCP_LEASES_MAX);
+            if (leases) {
+                n_leases = dhcp_leases_get_all(leases, DHCP_LEASES_MAX);
+            }
+            break;
+        }
+    }
+
+    // 先按地址后按MAC，同一客户端两种规则都有时MAC规则优先
+    for (int pass = 0; pass < 2; pass++) {
+        for (int slot = 0; slot < SHAPER_RULES; slot++) {
+            const shaper_rule_t* r = &s_rules[slot];
+            if (!r->valid || rule_by_mac(r) != (pass == 1)) {
+                continue;
+            }
+            uint32_t ip = r->ip;
+            if (pass == 1) {
+                ip = 0;
+                for (size_t j = 0; j < n_leases; j++) {
+                    if ((leases[j].bound || leases[j].reserved) && memcmp(leases[j].mac, r->mac, 6) == 0) {
+                        ip = leases[j].ip;
+                        break;
+                    }
+                }
+            }
+            int i = client_index(ip);
+            if (i >= 0) {
+                t->host[i] = r->limit;
+            }
+        }
+    }
+    free(leases);
+
+    if (tcpip_callback(apply_cb, t) != ERR_OK) {
+        free(t);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void slot_key(char* key, size_t size, int slot)
+{
+    snprintf(key, size, SHAPER_NVS_PREFIX "%02d", slot);
+}
+
+static esp_err_t slot_persist(int slot)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char key[8];
+    slot_key(key, sizeof(key), slot);
+    if (s_rules[slot].valid) {
+        err = nvs_set_blob(nvs, key, &s_rules[slot], sizeof(shaper_rule_t));
+    } else {
+        err = nvs_erase_key(nvs, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+static int find_rule(const uint8_t* mac, uint32_t ip)
+{
+    for (int slot = 0; slot < SHAPER_RULES; slot++) {
+        const shaper_rule_t* r = &s_rules[slot];
+        if (!r->valid) {
+            continue;
+        }
+        if (mac ? memcmp(r->mac, mac, 6) == 0 : (!rule_by_mac(r) && r->ip == ip)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static bool limit_valid(const shaper_limit_t* l)
+{
+    return l->up_kbps <= SHAPER_MAX_KBPS && l->down_kbps <= SHAPER_MAX_KBPS;
+}
+
+static void shaper_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    const ip_event_ap_staipassigned_t* evt = event_data;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (find_rule(evt->mac, 0) >= 0) {
+        publish();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t shaper_init(uint32_t ap_ip, uint32_t netmask)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    // 与租约表一样按主机号索引，只支持/24以内的网段
+    if (lwip_ntohl(netmask) < 0xFFFFFF00u) {
+        netmask = PP_HTONL(0xFFFFFF00u);
+    }
+    s_net = ap_ip & netmask;
+    s_mask = netmask;
+
+    int n = 0;
+    nvs_handle_t nvs;
+    if (nvs_open(PARAM_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        size_t len = sizeof(s_config);
+        if (nvs_get_blob(nvs, SHAPER_NVS_CONFIG, &s_config, &len) != ESP_OK || len != sizeof(s_config)) {
+            memset(&s_config, 0, sizeof(s_config));
+        }
+        for (int slot = 0; slot < SHAPER_RULES; slot++) {
+            char key[8];
+            shaper_rule_t r;
+            len = sizeof(r);
+            slot_key(key, sizeof(key), slot);
+            if (nvs_get_blob(nvs, key, &r, &len) == ESP_OK && len == sizeof(r) && r.valid) {
+                s_rules[slot] = r;
+                n++;
+            }
+        }
+        nvs_close(nvs);
+    }
+
+    esp_err_t err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED,
+                                                        shaper_event_handler, NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    err = publish();
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "总速率 %lu/%lu kbps，默认 %lu/%lu kbps，%d条客户端规则",
+             s_config.total.up_kbps, s_config.total.down_kbps,
+             s_config.client.up_kbps, s_config.client.down_kbps, n);
+    return err;
+}
+
+void shaper_attach(struct netif* ap, shaper_output_fn up, shaper_output_fn down)
+{
+    s_ap = ap;
+    s_dirs[SHAPER_UP].output = up;
+    s_dirs[SHAPER_DOWN].output = down;
+}
+
+esp_err_t shaper_set_config(const shaper_config_t* cfg)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!limit_valid(&cfg->total) || !limit_valid(&cfg->client)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_config = *cfg;
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, SHAPER_NVS_CONFIG, &s_config, sizeof(s_config));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err == ESP_OK) {
+        err = publish();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void shaper_get_config(shaper_config_t* out)
+{
+    if (!s_lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_config;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t shaper_set_rule(const uint8_t* mac, uint32_t ip, const shaper_limit_t* limit)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!limit_valid(limit) || (!mac && client_index(ip) < 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_rule(mac, ip);
+    if (slot < 0) {
+        for (int i = 0; i < SHAPER_RULES; i++) {
+            if (!s_rules[i].valid) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            xSemaphoreGive(s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        memset(&s_rules[slot], 0, sizeof(shaper_rule_t));
+        if (mac) {
+            memcpy(s_rules[slot].mac, mac, 6);
+        } else {
+            s_rules[slot].ip = ip;
+        }
+        s_rules[slot].valid = 1;
+    }
+    s_rules[slot].limit = *limit;
+    esp_err_t err = slot_persist(slot);
+    if (err == ESP_OK) {
+        err = publish();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t shaper_del_rule(const uint8_t* mac, uint32_t ip)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_rule(mac, ip);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (slot >= 0) {
+        s_rules[slot].valid = 0;
+        err = slot_persist(slot);
+        if (err == ESP_OK) {
+            err = publish();
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t shaper_clear_rules(void)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    for (int slot = 0; slot < SHAPER_RULES && err == ESP_OK; slot++) {
+        if (s_rules[slot].valid) {
+            s_rules[slot].valid = 0;
+            err = slot_persist(slot);
+        }
+    }
+    if (err == ESP_OK) {
+        err = publish();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+size_t shaper_get_rules(shaper_rule_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+
+    size_t n = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int slot = 0; slot < SHAPER_RULES && n < max; slot++) {
+        if (s_rules[slot].valid) {
+            out[n++] = s_rules[slot];
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+// 队列计数只在tcpip线程中写，以下读取允许个别值不同步
+
+void shaper_get_stats(shaper_stats_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    out->running = s_lock != NULL;
+    for (int dir = 0; dir < SHAPER_DIRS; dir++) {
+        const direction_t* d = &s_dirs[dir];
+        shaper_queue_stats_t* sum = &out->q[dir];
+        out->active[dir] = d->active;
+        sum->depth = d->queued;
+        for (int i = 0; i < SHAPER_CLIENTS; i++) {
+            const client_queue_t* q = d->queues[i];
+            if (!q) {
+                continue;
+            }
+            if (q->stats.max_depth > sum->max_depth) {
+                sum->max_depth = q->stats.max_depth;
+            }
+            sum->passed += q->stats.passed;
+            sum->queued += q->stats.queued;
+            sum->drops += q->stats.drops;
+        }
+    }
+}
+
+size_t shaper_get_clients(shaper_client_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < SHAPER_CLIENTS && n < max; i++) {
+        if (!s_dirs[SHAPER_UP].queues[i] && !s_dirs[SHAPER_DOWN].queues[i]) {
+            continue;
+        }
+        shaper_client_t* c = &out[n++];
+        memset(c, 0, sizeof(*c));
+        c->addr = s_net;
+        ((uint8_t*)&c->addr)[3] = (uint8_t)i;
+        c->limit.up_kbps = s_dirs[SHAPER_UP].rate[i] / 125;
+        c->limit.down_kbps = s_dirs[SHAPER_DOWN].rate[i] / 125;
+        for (int dir = 0; dir < SHAPER_DIRS; dir++) {
+            const client_queue_t* q = s_dirs[dir].queues[i];
+            if (q) {
+                c->q[dir] = q->stats;
+                c->q[dir].depth = q->count;
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,102 @@
+#ifndef SHAPER_H
+#define SHAPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+// 客户端限速和公平排队：每个客户端（按AP网段主机号）一个令牌桶和一个小队列，
+// 队列之间按差额轮询（DRR）调度，另有一个方向总令牌桶作为共享瓶颈
+// 上行在客户端的包进入转发路径（NAPT、快速路径）之前排队，即发往STA之前；下行在AP接口发送前排队
+// 没有配置任何限速的方向不排队，转发路径只多一次判断
+
+// 配置
+#define SHAPER_CLIENTS 256              // 按AP网段（/24）主机号索引
+#define SHAPER_RULES 16
+#define SHAPER_NVS_PREFIX "sh"          // 每条规则一个NVS键：sh00 ~ sh15
+#define SHAPER_NVS_CONFIG "shaper"      // 总速率和默认速率
+#define SHAPER_QUEUE_DEPTH 12           // 每个客户端每个方向最多排队的包数
+#define SHAPER_QUEUE_TOTAL 24           // 每个方向最多排队的包数，满时丢弃最长队列的队首
+#define SHAPER_QUANTUM 1600             // DRR每轮给每个队列的字节数，不小于最大帧长
+#define SHAPER_BURST_MS 50              // 令牌桶容量按此时间的流量计算
+#define SHAPER_BURST_MIN 3028           // 至少容纳两个最大帧
+#define SHAPER_WAIT_MAX_MS 50           // 等待令牌的最长间隔
+
+typedef enum {
+    SHAPER_UP = 0,                      // 客户端发往外网
+    SHAPER_DOWN,                        // 外网发往客户端
+    SHAPER_DIRS
+} shaper_dir_t;
+
+// 速率（kbps），0表示不限
+typedef struct {
+    uint32_t up_kbps;
+    uint32_t down_kbps;
+} shaper_limit_t;
+
+// 整体配置（同时作为NVS中的存储格式）
+typedef struct {
+    shaper_limit_t total;               // 全部客户端共用的上行/下行速率，按上游带宽略低一点设置时排队发生在本机
+    shaper_limit_t client;              // 没有单独规则的客户端的默认速率
+} shaper_config_t;
+
+// 单个客户端的规则（同时作为NVS中的存储格式），按MAC或地址指定
+typedef struct {
+    uint8_t mac[6];                     // 全0表示按地址指定
+    uint32_t ip;                        // 网络字节序，按MAC指定时为0
+    shaper_limit_t limit;               // 覆盖默认速率，0表示该客户端不限速
+    uint8_t valid;
+} shaper_rule_t;
+
+// 一个方向上一个队列的计数
+typedef struct {
+    uint16_t depth;                     // 当前排队的包数
+    uint16_t max_depth;
+    uint32_t passed;                    // 令牌足够、未排队直接放行的包
+    uint32_t queued;                    // 经过队列发出的包
+    uint32_t drops;                     // 队列满或内存不足丢弃的包
+} shaper_queue_stats_t;
+
+typedef struct {
+    uint32_t addr;                      // 网络字节序
+    shaper_limit_t limit;               // 生效的速率
+    shaper_queue_stats_t q[SHAPER_DIRS];
+} shaper_client_t;
+
+typedef struct {
+    bool running;
+    bool active[SHAPER_DIRS];           // 该方向有限速，包经过调度器
+    shaper_queue_stats_t q[SHAPER_DIRS];    // 各客户端之和
+} shaper_stats_t;
+
+// 发送函数，接管并释放p
+typedef void (*shaper_output_fn)(struct pbuf* p, struct netif* netif);
+
+// ap_ip/netmask为AP网段（网络字节序）；从NVS加载配置，客户端获取地址后按MAC规则更新速率
+esp_err_t shaper_init(uint32_t ap_ip, uint32_t netmask);
+
+// 由napt_hook在挂接时调用，调度器把排队的包交给对应方向的发送函数
+void shaper_attach(struct netif* ap, shaper_output_fn up, shaper_output_fn down);
+
+// 由napt_hook在tcpip线程中调用，p为完整以太网帧，client为客户端地址
+// 返回false时调用者照常转发；返回true时包已复制入队或被丢弃，p仍由调用者释放
+bool shaper_enqueue(shaper_dir_t dir, uint32_t client, struct pbuf* p);
+
+// 以下可在任意任务中调用，写入NVS后转到tcpip线程生效
+esp_err_t shaper_set_config(const shaper_config_t* cfg);
+void shaper_get_config(shaper_config_t* out);
+// mac为NULL时按地址；已有同一客户端的规则时覆盖
+esp_err_t shaper_set_rule(const uint8_t* mac, uint32_t ip, const shaper_limit_t* limit);
+esp_err_t shaper_del_rule(const uint8_t* mac, uint32_t ip);
+esp_err_t shaper_clear_rules(void);
+size_t shaper_get_rules(shaper_rule_t* out, size_t max);
+
+void shaper_get_stats(shaper_stats_t* out);
+
+// 复制经过调度器的客户端，返回条数
+size_t shaper_get_clients(shaper_client_t* out, size_t max);
+
+#endif /* SHAPER_H */
@@ -0,0 +1,225 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "router_globals.h"
+#include "status_ui.h"
+
+// 配置
+#define TAG "STATUS_UI"
+#define LED_BLINK_MS 50                 // 常态下每次闪烁的亮/灭时间
+#define LED_PAUSE_MS 1000
+#define LED_HOLD_MS 100                 // 按住按键时的快闪
+#define LED_CANCEL_MS 150               // 未到5秒松开：闪两次表示取消
+#define LED_CANCEL_STEPS 4
+#define LED_RESET_DELAY_MS 2000         // 确认后LED常亮的时间
+
+ESP_EVENT_DEFINE_BASE(STATUS_UI_EVENT);
+
+typedef enum {
+    LED_NORMAL,
+    LED_HOLD,
+    LED_CANCEL,
+    LED_RESET,
+} led_mode_t;
+
+static SemaphoreHandle_t s_lock;        // 事件循环任务和esp_timer任务共用的状态
+static esp_timer_handle_t s_led_timer;
+static esp_timer_handle_t s_debounce_timer;
+static esp_timer_handle_t s_hold_timer;
+static esp_timer_handle_t s_reset_timer;
+static status_ui_reset_cb_t s_on_reset;
+
+static led_mode_t s_mode;
+static int s_step;
+static bool s_pressed;
+static int64_t s_press_start_us;
+
+// 输出当前步骤的电平并安排下一步，持锁调用
+static void led_step(void)
+{
+    uint32_t delay_ms;
+    switch (s_mode) {
+    case LED_NORMAL:
+        if (connect_count == 0) {
+            gpio_set_level(BLINK_GPIO, ap_connect);
+            return;
+        }
+        if (s_step < connect_count * 2) {
+            gpio_set_level(BLINK_GPIO, (s_step % 2 == 0) ? !ap_connect : ap_connect);
+            delay_ms = LED_BLINK_MS;
+            s_step++;
+        } else {
+            gpio_set_level(BLINK_GPIO, ap_connect);
+            delay_ms = LED_PAUSE_MS;
+            s_step = 0;
+        }
+        break;
+    case LED_HOLD:
+        gpio_set_level(BLINK_GPIO, s_step & 1);
+        delay_ms = LED_HOLD_MS;
+        s_step++;
+        break;
+    case LED_CANCEL:
+        if (s_step >= LED_CANCEL_STEPS) {
+            s_mode = LED_NORMAL;
+            s_step = 0;
+            led_step();
+            return;
+        }
+        gpio_set_level(BLINK_GPIO, s_step % 2);
+        delay_ms = LED_CANCEL_MS;
+        s_step++;
+        break;
+    case LED_RESET:
+    default:
+        gpio_set_level(BLINK_GPIO, 1);
+        return;
+    }
+    esp_timer_start_once(s_led_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void set_mode(led_mode_t mode)
+{
+    esp_timer_stop(s_led_timer);
+    s_mode = mode;
+    s_step = 0;
+    led_step();
+}
+
+static void led_timer_cb(void* arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    led_step();
+    xSemaphoreGive(s_lock);
+}
+
+static void hold_timer_cb(void* arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool confirmed = s_pressed;
+    if (confirmed) {
+        ESP_LOGI(TAG, "BOOT button held for %d ms, initiating factory reset!", BUTTON_PRESS_TIME_MS);
+        set_mode(LED_RESET);
+        esp_timer_start_once(s_reset_timer, (uint64_t)LED_RESET_DELAY_MS * 1000);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void reset_timer_cb(void* arg)
+{
+    if (s_on_reset) {
+        s_on_reset();
+    }
+}
+
+// 消抖结束：按电平判断按下或松开，然后重新打开中断
+static void debounce_timer_cb(void* arg)
+{
+    bool pressed = gpio_get_level(BOOT_BUTTON_GPIO) == 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (pressed && !s_pressed) {
+        s_pressed = true;
+        s_press_start_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "BOOT button pressed, starting timer...");
+        esp_timer_start_once(s_hold_timer, (uint64_t)BUTTON_PRESS_TIME_MS * 1000);
+        set_mode(LED_HOLD);
+    } else if (!pressed && s_pressed) {
+        s_pressed = false;
+        esp_timer_stop(s_hold_timer);
+        ESP_LOGI(TAG, "BOOT button released after %lld ms", (esp_timer_get_time() - s_press_start_us) / 1000);
+        if (s_mode != LED_RESET) {
+            set_mode(LED_CANCEL);
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    gpio_intr_enable(BOOT_BUTTON_GPIO);
+}
+
+static void button_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    esp_timer_stop(s_debounce_timer);
+    esp_timer_start_once(s_debounce_timer, (uint64_t)BUTTON_DEBOUNCE_MS * 1000);
+}
+
+// 边沿中断：关闭中断直到消抖完成，事件交给默认事件循环
+static void IRAM_ATTR button_isr(void* arg)
+{
+    gpio_intr_disable(BOOT_BUTTON_GPIO);
+    BaseType_t woken = pdFALSE;
+    // 事件队列已满时没有人会再打开中断，这里重新打开，由下一个边沿重试
+    if (esp_event_isr_post(STATUS_UI_EVENT, STATUS_UI_EVENT_BUTTON, NULL, 0, &woken) != ESP_OK) {
+        gpio_intr_enable(BOOT_BUTTON_GPIO);
+    }
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+esp_err_t status_ui_init(status_ui_reset_cb_t on_reset)
+{
+    s_on_reset = on_reset;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timers[] = {
+        { .callback = led_timer_cb, .name = "status_led" },
+        { .callback = debounce_timer_cb, .name = "button_debounce" },
+        { .callback = hold_timer_cb, .name = "button_hold" },
+        { .callback = reset_timer_cb, .name = "factory_reset" },
+    };
+    esp_timer_handle_t* handles[] = { &s_led_timer, &s_debounce_timer, &s_hold_timer, &s_reset_timer };
+    for (size_t i = 0; i < sizeof(timers) / sizeof(timers[0]); i++) {
+        esp_err_t err = esp_timer_create(&timers[i], handles[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    gpio_reset_pin(BLINK_GPIO);
+    gpio_set_direction(BLINK_GPIO, GPIO_MODE_OUTPUT);
+
+    const gpio_config_t button_cfg = {
+        .pin_bit_mask = 1ULL << BOOT_BUTTON_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&button_cfg));
+
+    esp_err_t err = esp_event_handler_register(STATUS_UI_EVENT, STATUS_UI_EVENT_BUTTON, button_event_handler, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // ISR服务可能已被其他驱动安装
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+    err = gpio_isr_handler_add(BOOT_BUTTON_GPIO, button_isr, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    status_ui_update();
+    ESP_LOGI(TAG, "BOOT button monitor started on GPIO%d", BOOT_BUTTON_GPIO);
+    return ESP_OK;
+}
+
+void status_ui_update(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_mode == LED_NORMAL) {
+        set_mode(LED_NORMAL);
+    }
+    xSemaphoreGive(s_lock);
+}
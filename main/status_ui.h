@@ -0,0 +1,37 @@
+#ifndef STATUS_UI_H
+#define STATUS_UI_H
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "sdkconfig.h"
+
+// On board LED
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define BLINK_GPIO 44
+#else
+#define BLINK_GPIO 2
+#endif
+
+// BOOT button GPIO (usually GPIO0 on most ESP32 boards)
+#define BOOT_BUTTON_GPIO 0
+#define BUTTON_PRESS_TIME_MS 5000       // 长按5秒触发出厂重置
+#define BUTTON_DEBOUNCE_MS 20
+
+// 按键中断经默认事件循环转到任务上下文处理
+ESP_EVENT_DECLARE_BASE(STATUS_UI_EVENT);
+enum {
+    STATUS_UI_EVENT_BUTTON,
+};
+
+// 长按确认后调用，不返回（重启）
+typedef void (*status_ui_reset_cb_t)(void);
+
+// 配置LED和按键：按键使用GPIO边沿中断，LED闪烁由esp_timer状态机驱动，不占用任务
+// 必须在默认事件循环创建之后调用
+esp_err_t status_ui_init(status_ui_reset_cb_t on_reset);
+
+// 上游连接状态或客户端数量变化后调用，重新开始闪烁
+// 常态：LED电平表示是否连上上游，每个客户端反相闪一次，然后停1秒；没有客户端时不需要定时器
+void status_ui_update(void);
+
+#endif /* STATUS_UI_H */
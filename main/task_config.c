@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "router_globals.h"
+#include "task_config.h"
+
+// 配置
+#define TAG "TASK_CONFIG"
+#define TASK_CONFIG_NVS_PREFIX "tp_"
+
+static const char* const s_names[TASK_COUNT] = {
+    [TASK_AUDIO] = "audio",
+    [TASK_HTTPD] = "httpd",
+    [TASK_DNS] = "dns",
+};
+
+// 任务布局：音频独占核心1，Wi-Fi、tcpip、Web服务器和DNS转发在核心0
+static const task_placement_t s_defaults[TASK_COUNT] = {
+    [TASK_AUDIO] = { CONFIG_TASK_AUDIO_CORE, CONFIG_TASK_AUDIO_PRIORITY, CONFIG_TASK_AUDIO_STACK },
+    [TASK_HTTPD] = { CONFIG_TASK_HTTPD_CORE, CONFIG_TASK_HTTPD_PRIORITY, CONFIG_TASK_HTTPD_STACK },
+    [TASK_DNS] = { CONFIG_TASK_DNS_CORE, CONFIG_TASK_DNS_PRIORITY, CONFIG_TASK_DNS_STACK },
+};
+
+static task_placement_t s_table[TASK_COUNT];
+static bool s_overridden[TASK_COUNT];
+
+static bool placement_valid(const task_placement_t* p)
+{
+    return p->core >= -1 && p->core < portNUM_PROCESSORS &&
+           p->priority >= 1 && p->priority < configMAX_PRIORITIES &&
+           p->stack >= TASK_CONFIG_MIN_STACK && p->stack <= TASK_CONFIG_MAX_STACK;
+}
+
+static void nvs_key(task_id_t id, char* key, size_t len)
+{
+    snprintf(key, len, TASK_CONFIG_NVS_PREFIX "%s", s_names[id]);
+}
+
+void task_config_init(void)
+{
+    memcpy(s_table, s_defaults, sizeof(s_table));
+    memset(s_overridden, 0, sizeof(s_overridden));
+
+    nvs_handle_t nvs;
+    if (nvs_open(PARAM_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    for (int id = 0; id < TASK_COUNT; id++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        task_placement_t p;
+        size_t len = sizeof(p);
+        nvs_key(id, key, sizeof(key));
+        if (nvs_get_blob(nvs, key, &p, &len) != ESP_OK || len != sizeof(p)) {
+            continue;
+        }
+        if (!placement_valid(&p)) {
+            ESP_LOGW(TAG, "忽略无效的任务配置 %s", key);
+            continue;
+        }
+        s_table[id] = p;
+        s_overridden[id] = true;
+        ESP_LOGI(TAG, "%s: 核心%d 优先级%u 栈%u（NVS）", s_names[id], p.core, p.priority, p.stack);
+    }
+    nvs_close(nvs);
+}
+
+const task_placement_t* task_config_get(task_id_t id)
+{
+    return &s_table[id];
+}
+
+const task_placement_t* task_config_default(task_id_t id)
+{
+    return &s_defaults[id];
+}
+
+const char* task_config_name(task_id_t id)
+{
+    return s_names[id];
+}
+
+bool task_config_is_overridden(task_id_t id)
+{
+    return s_overridden[id];
+}
+
+int task_config_find(const char* name)
+{
+    for (int id = 0; id < TASK_COUNT; id++) {
+        if (strcmp(s_names[id], name) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+esp_err_t task_config_set(task_id_t id, const task_placement_t* placement)
+{
+    if (id >= TASK_COUNT || !placement_valid(placement)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(id, key, sizeof(key));
+    err = nvs_set_blob(nvs, key, placement, sizeof(*placement));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t task_config_reset(task_id_t id)
+{
+    if (id >= TASK_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_key(id, key, sizeof(key));
+    err = nvs_erase_key(nvs, key);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
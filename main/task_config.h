@@ -0,0 +1,42 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// 路由器启动的任务
+typedef enum {
+    TASK_AUDIO,
+    TASK_HTTPD,
+    TASK_DNS,
+    TASK_COUNT
+} task_id_t;
+
+// 任务的核心、优先级和栈大小
+typedef struct {
+    int8_t core;                        // -1表示不绑定核心
+    uint8_t priority;
+    uint16_t stack;                     // 字节
+} task_placement_t;
+
+#define TASK_CONFIG_MIN_STACK 1024
+#define TASK_CONFIG_MAX_STACK 16384
+
+// 以Kconfig为默认值，读取NVS中保存的覆盖值
+void task_config_init(void);
+
+// 生效的配置
+const task_placement_t* task_config_get(task_id_t id);
+const task_placement_t* task_config_default(task_id_t id);
+const char* task_config_name(task_id_t id);
+bool task_config_is_overridden(task_id_t id);
+
+// 按名称查找，找不到返回-1
+int task_config_find(const char* name);
+
+// 保存到NVS，重启后生效；reset删除覆盖值恢复Kconfig默认
+esp_err_t task_config_set(task_id_t id, const task_placement_t* placement);
+esp_err_t task_config_reset(task_id_t id);
+
+#endif /* TASK_CONFIG_H */
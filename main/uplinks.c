@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_eap_client.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "router_globals.h"
+#include "link_manager.h"
+#include "napt_stats.h"
+#include "dns_forwarder.h"
+#include "uplinks.h"
+#include "wifi_scan.h"
+
+// 配置
+#define TAG "UPLINKS"
+
+_Static_assert(UPLINKS_MAX <= 100, "uplink NVS keys use two digits");
+
+typedef struct {
+    uplink_profile_t profile;
+    bool seen;
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t bssid[6];
+    int64_t cooldown_until_us;
+    bool dirty;                         // peak_kbps尚未写入NVS
+} uplink_t;
+
+static SemaphoreHandle_t s_lock;        // esp_timer任务、事件循环任务和控制台共用的状态
+static SemaphoreHandle_t s_nvs_lock;    // 串行化NVS写入，见slot_save
+static esp_timer_handle_t s_timer;
+static esp_netif_t* s_sta;
+static bool s_has_static;
+static esp_netif_ip_info_t s_static_ip;
+static bool s_enterprise;               // 主上行使用企业认证
+static int s_addr_pending = -1;         // 断开后再切换静态地址/DHCP，避免在原网络上提前发出获取地址事件
+
+static uplink_t s_uplinks[UPLINKS_MAX];
+static int s_current;                   // 当前使用（或正在连接）的上行
+static int s_last_up = -1;              // 最近一次获取到地址时的上行
+static bool s_scanning;
+static int64_t s_last_scan_us;
+static int64_t s_last_save_us;
+
+static bool s_switch_pending;
+static int64_t s_switch_us;
+
+static uplink_roam_t s_history[UPLINKS_HISTORY];
+static size_t s_history_head;
+static size_t s_history_count;
+
+static void slot_key(char* key, size_t size, int slot)
+{
+    snprintf(key, size, UPLINKS_NVS_PREFIX "%02d", slot);
+}
+
+// 持锁复制一份再释放锁写NVS，写flash期间不阻塞esp_timer任务和事件循环
+// s_nvs_lock保证各处按复制的先后顺序写入，避免旧的副本覆盖新的；先取s_nvs_lock再取s_lock
+static esp_err_t slot_save(int slot)
+{
+    xSemaphoreTake(s_nvs_lock, portMAX_DELAY);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uplink_profile_t p = s_uplinks[slot].profile;
+    s_uplinks[slot].dirty = false;
+    xSemaphoreGive(s_lock);
+
+    // 主上行的密码已在配置中，不再保存一份
+    if (slot == 0) {
+        memset(p.passwd, 0, sizeof(p.passwd));
+    }
+    char key[8];
+    slot_key(key, sizeof(key), slot);
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PARAM_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (p.valid) {
+            err = nvs_set_blob(nvs, key, &p, sizeof(p));
+        } else {
+            err = nvs_erase_key(nvs, key);
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                err = ESP_OK;
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "保存上行%d失败: %s", slot, esp_err_to_name(err));
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_uplinks[slot].dirty = true;
+        xSemaphoreGive(s_lock);
+    }
+    xSemaphoreGive(s_nvs_lock);
+    return err;
+}
+
+static int find_ssid(const char* ssid)
+{
+    for (int i = 0; i < UPLINKS_MAX; i++) {
+        if (s_uplinks[i].profile.valid && strcmp(s_uplinks[i].profile.ssid, ssid) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 评分，持锁调用；rssi为当前连接的实时值，未连接时使用扫描结果
+static int score(int i, int64_t now)
+{
+    const uplink_t* u = &s_uplinks[i];
+    if (!u->profile.valid || !u->seen || u->cooldown_until_us > now) {
+        return UPLINKS_NO_SCORE;
+    }
+    int s = u->rssi + 100;
+    if (u->channel > 14) {
+        s += UPLINKS_5G_BONUS;
+    }
+    uint32_t mbps = u->profile.peak_kbps / 1000;
+    s += mbps < UPLINKS_THR_MAX_BONUS ? (int)mbps : UPLINKS_THR_MAX_BONUS;
+    s -= u->profile.priority * UPLINKS_PRIO_PENALTY;
+    return s;
+}
+
+static int profile_count(void)
+{
+    int n = 0;
+    for (int i = 0; i < UPLINKS_MAX; i++) {
+        n += s_uplinks[i].profile.valid;
+    }
+    return n;
+}
+
+// 静态地址只属于主上行，备用上行使用DHCP
+static void apply_addr_mode(int idx)
+{
+    if (idx == 0) {
+        esp_netif_dhcpc_stop(s_sta);
+        esp_netif_set_ip_info(s_sta, &s_static_ip);
+    } else {
+        esp_netif_dhcpc_start(s_sta);
+    }
+}
+
+// 切换到第idx个上行，锁定扫描到的BSSID和信道，关联时不再扫描
+// 端口映射和DNS不在这里处理，新地址可用后由STA获取地址的事件处理
+static void switch_to(int idx, bool lost, bool up, int score_from, int score_to)
+{
+    int64_t now = esp_timer_get_time();
+    wifi_config_t cfg = { 0 };
+    esp_wifi_get_config(WIFI_IF_STA, &cfg);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const uplink_t* u = &s_uplinks[idx];
+    int from = s_current;
+    bool save = false;
+    memset(cfg.sta.ssid, 0, sizeof(cfg.sta.ssid));
+    memset(cfg.sta.password, 0, sizeof(cfg.sta.password));
+    memcpy(cfg.sta.ssid, u->profile.ssid, strnlen(u->profile.ssid, sizeof(cfg.sta.ssid)));
+    if (idx != 0 || !s_enterprise) {
+        strlcpy((char*)cfg.sta.password, u->profile.passwd, sizeof(cfg.sta.password));
+    }
+    cfg.sta.bssid_set = true;
+    memcpy(cfg.sta.bssid, u->bssid, 6);
+    cfg.sta.channel = u->channel;
+
+    // 断开期间重新锁定同一上行的AP不算切换
+    if (from != idx) {
+        uplink_roam_t* h = &s_history[s_history_head];
+        h->time_s = now / 1000000;
+        h->from = from;
+        h->to = idx;
+        h->lost = lost;
+        h->score_from = score_from;
+        h->score_to = score_to;
+        h->downtime_ms = UINT32_MAX;
+        s_history_head = (s_history_head + 1) % UPLINKS_HISTORY;
+        if (s_history_count < UPLINKS_HISTORY) {
+            s_history_count++;
+        }
+        ESP_LOGI(TAG, "切换上行 %s -> %s（评分%d -> %d）", s_uplinks[from].profile.ssid, u->profile.ssid,
+            score_from, score_to);
+        save = s_uplinks[from].dirty;
+    }
+    s_current = idx;
+    s_switch_pending = true;
+    s_switch_us = now;
+    bool addr_change = s_has_static && (from == 0) != (idx == 0);
+    if (addr_change && up) {
+        s_addr_pending = idx;
+        addr_change = false;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (save) {
+        slot_save(from);
+    }
+    // 企业认证只属于主上行
+    if (s_enterprise) {
+        if (idx == 0) {
+            esp_wifi_sta_enterprise_enable();
+        } else {
+            esp_wifi_sta_enterprise_disable();
+        }
+    }
+    if (addr_change) {
+        apply_addr_mode(idx);
+    }
+    link_manager_switch(&cfg);
+}
+
+static void on_scan_done(void)
+{
+    uint16_t n = UPLINKS_SCAN_RECORDS;
+    wifi_ap_record_t* recs = malloc(sizeof(wifi_ap_record_t) * n);
+    if (!recs) {
+        esp_wifi_clear_ap_list();
+        return;
+    }
+    if (esp_wifi_scan_get_ap_records(&n, recs) != ESP_OK) {
+        n = 0;
+    }
+
+    link_stats_t link;
+    link_manager_get_stats(&link);
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_scanning = false;
+    for (int i = 0; i < UPLINKS_MAX; i++) {
+        uplink_t* u = &s_uplinks[i];
+        u->seen = false;
+        if (!u->profile.valid) {
+            continue;
+        }
+        // 扫描结果按信号强度排序，第一个匹配的就是最强的AP
+        for (uint16_t k = 0; k < n; k++) {
+            if (strncmp((const char*)recs[k].ssid, u->profile.ssid, sizeof(recs[k].ssid)) == 0) {
+                u->seen = true;
+                u->rssi = recs[k].rssi;
+                u->channel = recs[k].primary;
+                memcpy(u->bssid, recs[k].bssid, 6);
+                break;
+            }
+        }
+    }
+    // 当前上行以实际连接的AP为准
+    uplink_t* cur = &s_uplinks[s_current];
+    if (link.up) {
+        cur->seen = true;
+        cur->rssi = link.rssi;
+        cur->channel = link.channel;
+        memcpy(cur->bssid, link.bssid, 6);
+    }
+
+    int best = -1;
+    int best_score = UPLINKS_NO_SCORE;
+    for (int i = 0; i < UPLINKS_MAX; i++) {
+        int s = score(i, now);
+        if (s > best_score) {
+            best = i;
+            best_score = s;
+        }
+    }
+    int cur_score = score(s_current, now);
+    int current = s_current;
+    bool pending = s_switch_pending;
+    xSemaphoreGive(s_lock);
+    free(recs);
+
+    if (best < 0 || pending) {
+        return;
+    }
+    if (link.up) {
+        if (best != current && best_score >= cur_score + UPLINKS_ROAM_MARGIN) {
+            switch_to(best, false, true, cur_score, best_score);
+        }
+    } else {
+        // 断开期间link_manager可能正处于较长的退避中，扫描到可用的上行就立即连接
+        switch_to(best, true, false, cur_score, best_score);
+    }
+}
+
+static void start_scan(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_scanning) {
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    s_scanning = true;
+    s_last_scan_us = esp_timer_get_time();
+    xSemaphoreGive(s_lock);
+
+    // 正在关联或channel_plan正在扫描时会被拒绝，下个周期再试
+    if (wifi_scan_start("uplinks", on_scan_done) != ESP_OK) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_scanning = false;
+        xSemaphoreGive(s_lock);
+    }
+}
+
+// 周期调度：记录吞吐量，检查切换是否超时，按连接状态安排扫描
+static void tick_cb(void* arg)
+{
+    link_stats_t link;
+    link_manager_get_stats(&link);
+    int64_t now = esp_timer_get_time();
+    napt_stats_t stats = { 0 };
+    if (link.up) {
+        napt_stats_get(&stats);
+    }
+
+    bool scan = false;
+    int save = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uplink_t* cur = &s_uplinks[s_current];
+    if (link.up && !s_switch_pending) {
+        uint32_t kbps = ((uint64_t)stats.uplink_byte_rate + stats.downlink_byte_rate) * 8 / 1000;
+        if (kbps > cur->profile.peak_kbps) {
+            cur->profile.peak_kbps = kbps;
+            cur->dirty = true;
+        }
+        if (cur->dirty && now - s_last_save_us >= (int64_t)UPLINKS_SAVE_S * 1000000) {
+            s_last_save_us = now;
+            save = s_current;
+        }
+    }
+
+    if (s_switch_pending && now - s_switch_us >= (int64_t)UPLINKS_SWITCH_TIMEOUT_S * 1000000) {
+        ESP_LOGW(TAG, "上行 %s 未能获取地址，%d秒内不再使用", cur->profile.ssid, UPLINKS_COOLDOWN_S);
+        s_switch_pending = false;
+        cur->cooldown_until_us = now + (int64_t)UPLINKS_COOLDOWN_S * 1000000;
+    }
+
+    // 只有一个上行时由link_manager自行重连，不需要扫描
+    if (!s_scanning && !s_switch_pending && profile_count() > 1) {
+        int64_t since = now - s_last_scan_us;
+        if (link.up) {
+            scan = since >= (int64_t)UPLINKS_SCAN_UP_S * 1000000;
+        } else {
+            scan = link.up_s >= UPLINKS_SCAN_DOWN_S && since >= (int64_t)UPLINKS_SCAN_DOWN_S * 1000000;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (save >= 0) {
+        slot_save(save);
+    }
+    if (scan) {
+        start_scan();
+    }
+}
+
+static void on_got_ip(void)
+{
+    int64_t now = esp_timer_get_time();
+    bool changed;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_switch_pending) {
+        s_switch_pending = false;
+        size_t last = (s_history_head + UPLINKS_HISTORY - 1) % UPLINKS_HISTORY;
+        s_history[last].downtime_ms = (now - s_switch_us) / 1000;
+    }
+    s_uplinks[s_current].cooldown_until_us = 0;
+    changed = s_last_up >= 0 && s_last_up != s_current;
+    s_last_up = s_current;
+    xSemaphoreGive(s_lock);
+
+#ifdef CONFIG_DNS_FORWARDER
+    // 换了网络后缓存的应答可能指向原网络的内网地址
+    if (changed) {
+        dns_forwarder_flush();
+    }
+#endif
+}
+
+static void uplinks_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        // link_manager已在此前的处理函数中开始关联新的AP，关联完成前改好地址方式
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int idx = s_addr_pending;
+        s_addr_pending = -1;
+        xSemaphoreGive(s_lock);
+        if (idx >= 0) {
+            apply_addr_mode(idx);
+        }
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        on_got_ip();
+    }
+}
+
+esp_err_t uplinks_init(esp_netif_t* sta, const esp_netif_ip_info_t* static_ip)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_nvs_lock = xSemaphoreCreateMutex();
+    if (!s_lock || !s_nvs_lock) {
+        if (s_lock) {
+            vSemaphoreDelete(s_lock);
+            s_lock = NULL;
+        }
+        if (s_nvs_lock) {
+            vSemaphoreDelete(s_nvs_lock);
+            s_nvs_lock = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    s_sta = sta;
+    if (static_ip) {
+        s_has_static = true;
+        s_static_ip = *static_ip;
+    }
+    s_enterprise = strlen(ent_username) > 0;
+
+    nvs_handle_t nvs;
+    if (nvs_open(PARAM_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        for (int slot = 0; slot < UPLINKS_MAX; slot++) {
+            char key[8];
+            uplink_profile_t p;
+            size_t len = sizeof(p);
+            slot_key(key, sizeof(key), slot);
+            if (nvs_get_blob(nvs, key, &p, &len) == ESP_OK && len == sizeof(p) && p.valid) {
+                p.ssid[sizeof(p.ssid) - 1] = '\0';
+                p.passwd[sizeof(p.passwd) - 1] = '\0';
+                s_uplinks[slot].profile = p;
+            }
+        }
+        nvs_close(nvs);
+    }
+
+    // 0号始终是配置中的上游WiFi，SSID改过之后原来的吞吐量记录不再适用
+    uplink_profile_t* primary = &s_uplinks[0].profile;
+    if (!primary->valid || strcmp(primary->ssid, ssid) != 0) {
+        memset(primary, 0, sizeof(*primary));
+        primary->valid = 1;
+    }
+    strlcpy(primary->ssid, ssid, sizeof(primary->ssid));
+    strlcpy(primary->passwd, passwd, sizeof(primary->passwd));
+
+    const esp_timer_create_args_t args = {
+        .callback = tick_cb,
+        .name = "uplinks",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = wifi_scan_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, uplinks_event_handler, NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, uplinks_event_handler, NULL, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_last_scan_us = esp_timer_get_time();
+    s_last_save_us = s_last_scan_us;
+    err = esp_timer_start_periodic(s_timer, UPLINKS_TICK_MS * 1000);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "%d个上行", profile_count());
+    return ESP_OK;
+}
+
+esp_err_t uplinks_add(const char* ssid, const char* passwd, uint8_t priority)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(ssid) == 0 || strlen(ssid) > 32 || strlen(passwd) > 64) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_ssid(ssid);
+    if (slot == 0) {
+        s_uplinks[0].profile.priority = priority;
+    } else {
+        if (slot < 0) {
+            for (int i = 1; i < UPLINKS_MAX; i++) {
+                if (!s_uplinks[i].profile.valid) {
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot < 0) {
+                xSemaphoreGive(s_lock);
+                return ESP_ERR_NO_MEM;
+            }
+            memset(&s_uplinks[slot], 0, sizeof(uplink_t));
+            strlcpy(s_uplinks[slot].profile.ssid, ssid, sizeof(s_uplinks[slot].profile.ssid));
+            s_uplinks[slot].profile.valid = 1;
+        }
+        strlcpy(s_uplinks[slot].profile.passwd, passwd, sizeof(s_uplinks[slot].profile.passwd));
+        s_uplinks[slot].profile.priority = priority;
+        s_uplinks[slot].cooldown_until_us = 0;
+    }
+    xSemaphoreGive(s_lock);
+    return slot_save(slot);
+}
+
+esp_err_t uplinks_del(const char* ssid)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = find_ssid(ssid);
+    esp_err_t err;
+    if (slot < 0) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (slot == 0) {
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        // 正在使用的上行删除后仍保持连接，断开后不再选择它
+        s_uplinks[slot].profile.valid = 0;
+        s_uplinks[slot].seen = false;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    if (err == ESP_OK) {
+        err = slot_save(slot);
+    }
+    return err;
+}
+
+esp_err_t uplinks_scan(void)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    start_scan();
+    return ESP_OK;
+}
+
+size_t uplinks_get_all(uplink_info_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+
+    int64_t now = esp_timer_get_time();
+    size_t n = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < UPLINKS_MAX && n < max; i++) {
+        const uplink_t* u = &s_uplinks[i];
+        if (!u->profile.valid) {
+            continue;
+        }
+        uplink_info_t* o = &out[n++];
+        o->index = i;
+        o->profile = u->profile;
+        memset(o->profile.passwd, 0, sizeof(o->profile.passwd));
+        o->current = i == s_current;
+        o->seen = u->seen;
+        o->cooling = u->cooldown_until_us > now;
+        o->rssi = u->rssi;
+        o->channel = u->channel;
+        memcpy(o->bssid, u->bssid, 6);
+        o->score = score(i, now);
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+size_t uplinks_get_history(uplink_roam_t* out, size_t max)
+{
+    if (!s_lock) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t n = s_history_count < max ? s_history_count : max;
+    size_t first = (s_history_head + UPLINKS_HISTORY - n) % UPLINKS_HISTORY;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s_history[(first + i) % UPLINKS_HISTORY];
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
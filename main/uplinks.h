@@ -0,0 +1,80 @@
+#ifndef UPLINKS_H
+#define UPLINKS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// 多上行：0号为配置中的上游WiFi，其余为备用上行，按扫描结果选择最合适的一个
+// 评分 = (RSSI + 100) + 5GHz加分 + 历史吞吐量加分 - 优先级 * UPLINKS_PRIO_PENALTY
+
+// 配置
+#define UPLINKS_MAX 8                   // 含0号主上行
+#define UPLINKS_NVS_PREFIX "ul"         // 每条一个NVS键：ul00 ~ ul07，ul00只保存主上行的优先级和吞吐量
+#define UPLINKS_TICK_MS 1000            // 调度和吞吐量采样周期
+#define UPLINKS_SCAN_DOWN_S 10          // 上行断开超过此时间后每隔此时间扫描一次
+#define UPLINKS_SCAN_UP_S 300           // 已连接时扫描更好上行的间隔
+#define UPLINKS_SCAN_RECORDS 20         // 每次扫描处理的AP数
+#define UPLINKS_ROAM_MARGIN 15          // 已连接时，候选评分至少高出这么多才切换
+#define UPLINKS_PRIO_PENALTY 10         // 优先级每低一级扣的分
+#define UPLINKS_5G_BONUS 10
+#define UPLINKS_THR_MAX_BONUS 20        // 吞吐量加分上限，每Mbps一分
+#define UPLINKS_SWITCH_TIMEOUT_S 20     // 切换后超过此时间仍未获取地址，视为该上行不可用
+#define UPLINKS_COOLDOWN_S 300          // 不可用的上行在此时间内不参与选择
+#define UPLINKS_SAVE_S 600              // 吞吐量记录写入NVS的最短间隔
+#define UPLINKS_HISTORY 8
+
+#define UPLINKS_NO_SCORE (-1000)
+
+// 上行配置（同时作为NVS中的存储格式）
+typedef struct {
+    char ssid[33];
+    char passwd[65];
+    uint8_t priority;                   // 0最优先
+    uint8_t valid;
+    uint32_t peak_kbps;                 // 在该上行上观测到的最高吞吐量
+} uplink_profile_t;
+
+// 对外展示的上行状态
+typedef struct {
+    uint8_t index;                      // 切换记录中使用的编号
+    uplink_profile_t profile;
+    bool current;
+    bool seen;                          // 最近一次扫描中找到
+    bool cooling;                       // 切换失败后暂不使用
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t bssid[6];
+    int score;                          // 未找到或暂不使用时为UPLINKS_NO_SCORE
+} uplink_info_t;
+
+// 一次切换
+typedef struct {
+    uint32_t time_s;                    // 距启动的秒数
+    uint8_t from;
+    uint8_t to;
+    bool lost;                          // 原上行已断开，而不是发现了更好的上行
+    int16_t score_from;
+    int16_t score_to;
+    uint32_t downtime_ms;               // 切换到新地址可用的时间，未完成或失败时为UINT32_MAX
+} uplink_roam_t;
+
+// 在link_manager_init之后调用；static_ip不为NULL时主上行使用静态地址，备用上行使用DHCP
+esp_err_t uplinks_init(esp_netif_t* sta, const esp_netif_ip_info_t* static_ip);
+
+// 添加或修改备用上行，写入NVS；ssid与主上行相同时只修改优先级
+esp_err_t uplinks_add(const char* ssid, const char* passwd, uint8_t priority);
+// 删除备用上行，主上行不能删除
+esp_err_t uplinks_del(const char* ssid);
+
+// 立即扫描，扫描完成后按评分决定是否切换
+esp_err_t uplinks_scan(void);
+
+size_t uplinks_get_all(uplink_info_t* out, size_t max);
+
+// 按时间顺序返回最近的切换记录
+size_t uplinks_get_history(uplink_roam_t* out, size_t max);
+
+#endif /* UPLINKS_H */
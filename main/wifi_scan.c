@@ -0,0 +1,70 @@
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "wifi_scan.h"
+
+// 配置
+#define TAG "WIFI_SCAN"
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static wifi_scan_done_cb_t s_done;      // 正在扫描的模块，NULL表示空闲
+static const char* s_owner;
+static bool s_registered;
+
+static void wifi_scan_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    portENTER_CRITICAL(&s_mux);
+    wifi_scan_done_cb_t done = s_done;
+    portEXIT_CRITICAL(&s_mux);
+
+    // 没有发起者的SCAN_DONE（例如其他代码直接调用了esp_wifi_scan_start）不处理
+    if (done) {
+        done();
+    }
+
+    // 回调读完结果后才释放，之前发起的扫描会被拒绝，不会在读取前覆盖结果列表
+    portENTER_CRITICAL(&s_mux);
+    s_done = NULL;
+    s_owner = NULL;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+esp_err_t wifi_scan_init(void)
+{
+    if (s_registered) {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                                        wifi_scan_event_handler, NULL, NULL);
+    if (err == ESP_OK) {
+        s_registered = true;
+    }
+    return err;
+}
+
+esp_err_t wifi_scan_start(const char* owner, wifi_scan_done_cb_t done)
+{
+    const char* busy;
+    portENTER_CRITICAL(&s_mux);
+    busy = s_owner;
+    if (!busy) {
+        s_done = done;
+        s_owner = owner;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (busy) {
+        ESP_LOGD(TAG, "%s正在扫描，%s稍后再试", busy, owner);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = esp_wifi_scan_start(NULL, false);
+    if (err != ESP_OK) {
+        portENTER_CRITICAL(&s_mux);
+        s_done = NULL;
+        s_owner = NULL;
+        portEXIT_CRITICAL(&s_mux);
+    }
+    return err;
+}
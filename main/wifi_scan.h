@@ -0,0 +1,20 @@
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+// STA扫描的唯一入口：同一时间只有一个模块在扫描，WIFI_EVENT_SCAN_DONE只交给发起扫描的模块
+// uplinks和channel_plan各自扫描，扫描结果列表只有一份，不能同时使用
+
+// 扫描完成后在事件循环任务中调用，回调内读取esp_wifi_scan_get_ap_records；返回后才允许下一次扫描
+typedef void (*wifi_scan_done_cb_t)(void);
+
+// 注册SCAN_DONE处理函数，可重复调用
+esp_err_t wifi_scan_init(void);
+
+// 开始一次异步扫描，owner用于日志
+// 其他模块的扫描尚未完成时返回ESP_ERR_INVALID_STATE，esp_wifi_scan_start失败时返回其错误码
+esp_err_t wifi_scan_start(const char* owner, wifi_scan_done_cb_t done);
+
+#endif /* WIFI_SCAN_H */
@@ -0,0 +1,23 @@
+#ifndef WWW_ASSETS_H
+#define WWW_ASSETS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 构建时由tools/www_assets.py从www/目录生成，数据位于flash中
+typedef struct {
+    const char* uri;                    // index.html对应"/"
+    const char* type;
+    const char* etag;                   // identity的强ETag，含引号
+    const char* etag_gzip;              // gzip的强ETag（etag加"-gz"后缀），两种编码各自验证
+    const uint8_t* gzip;
+    size_t gzip_size;
+    const uint8_t* identity;            // 压缩前（已精简），供不支持gzip的客户端
+    size_t identity_size;
+    size_t raw_size;                    // www/中原始文件大小
+} www_asset_t;
+
+extern const www_asset_t www_assets[];
+extern const size_t www_assets_count;
+
+#endif /* WWW_ASSETS_H */
@@ -0,0 +1,109 @@
+#include <math.h>
+#include <stdlib.h>
+#include "host_test.h"
+// 直接包含实现以便单独测量各级的静态函数
+#include "fm_dsp.c"
+
+// 处理链各级吞吐量（样本/秒）：预加重、低通、限幅，以及完整的fm_dsp_process
+// 按立体声复合信号所需的两路133 kHz给出余量倍数
+
+#define BENCH_RATE 133000
+#define BENCH_FRAMES (BENCH_RATE * 2)
+#define BENCH_CHANNELS 2
+#define BENCH_MAX_CLIPPED 0    // 预读增益应使削波前的样本都不越界，硬削波只是保险
+
+static int16_t s_in[BENCH_FRAMES];
+static int32_t s_wide[BENCH_FRAMES];
+static int16_t s_out[BENCH_FRAMES];
+
+// 1 kHz + 9 kHz音调，加上高频提升后超过满幅，使限幅器实际工作
+static void make_input(void)
+{
+    srand(1);
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        double t = (double)i / BENCH_RATE;
+        double v = 0.6 * sin(2 * M_PI * 1000 * t) + 0.35 * sin(2 * M_PI * 9000 * t);
+        v += ((rand() & 1023) - 512) / 32768.0;
+        s_in[i] = (int16_t)lrint(v * 32767 * 0.95);
+    }
+}
+
+static double rate_of(uint64_t elapsed_ns)
+{
+    return (double)BENCH_FRAMES * 1e9 / (double)(elapsed_ns ? elapsed_ns : 1);
+}
+
+static void report(const char* stage, double rate)
+{
+    double need = (double)BENCH_RATE * BENCH_CHANNELS;
+    printf("%-14s %8.2f Msamples/s  %7.1fx real time\n", stage, rate / 1e6, rate / need);
+    HOST_CHECK(rate > need, "%s: %.0f samples/s below the %.0f needed", stage, rate, need);
+}
+
+int main(void)
+{
+    make_input();
+
+    fm_dsp_config_t cfg = {.sample_rate = BENCH_RATE, .preemphasis_us = 50, .lowpass = true};
+    fm_dsp_t dsp;
+    ESP_ERROR_CHECK(fm_dsp_init(&dsp, &cfg));
+
+    // 预加重
+    uint64_t start = host_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; i += FM_DSP_LOOKAHEAD) {
+        preemphasis_run(&dsp, &s_in[i], &s_wide[i], FM_DSP_LOOKAHEAD);
+    }
+    report("pre-emphasis", rate_of(host_now_ns() - start));
+
+    // 低通（原位处理预加重的输出）
+    start = host_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; i += FM_DSP_LOOKAHEAD) {
+        lowpass_run(&dsp, &s_wide[i], FM_DSP_LOOKAHEAD);
+    }
+    report("lowpass", rate_of(host_now_ns() - start));
+
+    // 限幅：按分段调用，每段结束时计算下一段的增益
+    start = host_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; i += FM_DSP_LOOKAHEAD) {
+        limiter_run(&dsp, &s_wide[i], &s_out[i], FM_DSP_LOOKAHEAD);
+    }
+    report("limiter", rate_of(host_now_ns() - start));
+    HOST_CHECK(dsp.min_gain < GAIN_ONE, "test signal never engaged the limiter");
+
+    // 完整处理链（与fm_transmitter_encode_block的分段一致）
+    fm_dsp_reset(&dsp);
+    start = host_now_ns();
+    for (int i = 0; i < BENCH_FRAMES; i += FM_DSP_LOOKAHEAD) {
+        fm_dsp_process(&dsp, &s_in[i], &s_out[i], FM_DSP_LOOKAHEAD);
+    }
+    report("fm_dsp_process", rate_of(host_now_ns() - start));
+
+    // 输出端的硬削波掩盖了增益错误，逐段重放一遍：调用前按当前增益斜坡计算即将输出的
+    // 延迟线样本在削波前的值，统计越界的样本数，并检查增益回升不快于FM_DSP_RELEASE_MS
+    fm_dsp_reset(&dsp);
+    uint32_t clipped = 0;
+    uint32_t fast_release = 0;
+    int32_t worst = 0;
+    for (int i = 0; i < BENCH_FRAMES; i += FM_DSP_LOOKAHEAD) {
+        int32_t g0 = dsp.gain_start;
+        int32_t dg = dsp.gain_end - dsp.gain_start;
+        for (uint32_t k = 0; k < FM_DSP_LOOKAHEAD; k++) {
+            int32_t g = g0 + ((dg * (int32_t)k) >> LOOKAHEAD_SHIFT);
+            int32_t s = (int32_t)(((int64_t)dsp.line[dsp.pos + k] * g) >> GAIN_SHIFT);
+            int32_t a = s < 0 ? -s : s;
+            if (a > FM_DSP_LIMIT) clipped++;
+            if (a > worst) worst = a;
+        }
+        if (dg > dsp.release_step || dsp.gain_end > GAIN_ONE) {
+            fast_release++;
+        }
+        fm_dsp_process(&dsp, &s_in[i], &s_out[i], FM_DSP_LOOKAHEAD);
+    }
+    printf("limiter: %u of %d samples above the limit before clamping (worst %d)\n",
+           (unsigned)clipped, BENCH_FRAMES, (int)worst);
+    HOST_CHECK(clipped <= BENCH_MAX_CLIPPED, "%u samples relied on the hard clamp", (unsigned)clipped);
+    HOST_CHECK(fast_release == 0, "gain rose faster than the release time in %u segments",
+               (unsigned)fast_release);
+
+    return host_result("bench_fm_dsp");
+}
@@ -0,0 +1,165 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "host_test.h"
+#include "midi_player.h"
+#include "midi_synth.h"
+
+// 合成器基准：新的定点声部池与原midi_player中逐通道逐音符的浮点mix_notes对比
+// 输出每样本耗时（ns/sample），并要求64声部时新实现不慢于原实现
+
+#define BENCH_SECONDS 1
+#define BENCH_BLOCK 256
+
+// midi_player.c中的频率表（此目标不链接播放器）
+const float midi_note_frequencies[128] = {
+    8.18, 8.66, 9.18, 9.72, 10.30, 10.91, 11.56, 12.25, 12.98, 13.75, 14.57, 15.43,
+    16.35, 17.32, 18.35, 19.45, 20.60, 21.83, 23.12, 24.50, 25.96, 27.50, 29.14, 30.87,
+    32.70, 34.65, 36.71, 38.89, 41.20, 43.65, 46.25, 49.00, 51.91, 55.00, 58.27, 61.74,
+    65.41, 69.30, 73.42, 77.78, 82.41, 87.31, 92.50, 98.00, 103.83, 110.00, 116.54, 123.47,
+    130.81, 138.59, 146.83, 155.56, 164.81, 174.61, 185.00, 196.00, 207.65, 220.00, 233.08, 246.94,
+    261.63, 277.18, 293.66, 311.13, 329.63, 349.23, 369.99, 392.00, 415.30, 440.00, 466.16, 493.88,
+    523.25, 554.37, 587.33, 622.25, 659.25, 698.46, 739.99, 783.99, 830.61, 880.00, 932.33, 987.77,
+    1046.50, 1108.73, 1174.66, 1244.51, 1318.51, 1396.91, 1479.98, 1567.98, 1661.22, 1760.00, 1864.66, 1975.53,
+    2093.00, 2217.46, 2349.32, 2489.02, 2637.02, 2793.83, 2959.96, 3135.96, 3322.44, 3520.00, 3729.31, 3951.07,
+    4186.01, 4434.92, 4698.63, 4978.03, 5274.04, 5587.65, 5919.91, 6271.93, 6644.88, 7040.00, 7458.62, 7902.13
+};
+
+// ---- 原实现（midi_player.c，合成器重构前） ----
+
+typedef struct {
+    bool active;
+    float frequency;
+    float phase;
+    uint8_t velocity;
+    uint32_t start_time;
+} ref_note_t;
+
+typedef struct {
+    ref_note_t notes[128];
+    uint8_t volume;
+    uint8_t pan;
+} ref_channel_t;
+
+static ref_channel_t ref_channels[MIDI_MAX_CHANNELS];
+
+static float generate_sine_wave(float frequency, float* phase, float sample_rate)
+{
+    float sample = sin(*phase);
+    *phase += 2 * M_PI * frequency / sample_rate;
+    if (*phase >= 2 * M_PI) {
+        *phase -= 2 * M_PI;
+    }
+    return sample;
+}
+
+static int16_t mix_notes(void)
+{
+    float mix = 0;
+    int active_notes = 0;
+
+    for (int ch = 0; ch < MIDI_MAX_CHANNELS; ch++) {
+        for (int note = 0; note < 128; note++) {
+            if (ref_channels[ch].notes[note].active) {
+                float sample = generate_sine_wave(ref_channels[ch].notes[note].frequency,
+                                                  &ref_channels[ch].notes[note].phase,
+                                                  MIDI_SAMPLE_RATE);
+                float volume = ref_channels[ch].notes[note].velocity / 127.0f *
+                               ref_channels[ch].volume / 127.0f;
+                mix += sample * volume;
+                active_notes++;
+            }
+        }
+    }
+
+    if (active_notes == 0) {
+        return 0;
+    }
+    mix /= active_notes;
+    if (mix > 1.0f) {
+        mix = 1.0f;
+    } else if (mix < -1.0f) {
+        mix = -1.0f;
+    }
+    return (int16_t)(mix * 32767);
+}
+
+// ---- 测量 ----
+
+// 第i个声部：分散到16个通道，音高不重复
+static void voice_slot(int i, int* ch, int* note)
+{
+    *ch = i % MIDI_MAX_CHANNELS;
+    *note = 36 + i;
+}
+
+static double bench_reference(int voices)
+{
+    memset(ref_channels, 0, sizeof(ref_channels));
+    for (int ch = 0; ch < MIDI_MAX_CHANNELS; ch++) {
+        ref_channels[ch].volume = MIDI_VOLUME;
+    }
+    for (int i = 0; i < voices; i++) {
+        int ch, note;
+        voice_slot(i, &ch, &note);
+        ref_note_t* n = &ref_channels[ch].notes[note];
+        n->active = true;
+        n->frequency = midi_note_frequencies[note];
+        n->velocity = 100;
+    }
+
+    int16_t buf[BENCH_BLOCK];
+    uint32_t frames = MIDI_SAMPLE_RATE * BENCH_SECONDS;
+    int32_t sink = 0;
+    uint64_t start = host_now_ns();
+    for (uint32_t done = 0; done < frames; done += BENCH_BLOCK) {
+        for (int i = 0; i < BENCH_BLOCK; i++) {
+            buf[i] = mix_notes();
+        }
+        sink += buf[BENCH_BLOCK - 1];
+    }
+    uint64_t elapsed = host_now_ns() - start;
+    (void)sink;
+    return (double)elapsed / frames;
+}
+
+static double bench_synth(int voices)
+{
+    midi_synth_reset();
+    for (int i = 0; i < voices; i++) {
+        int ch, note;
+        voice_slot(i, &ch, &note);
+        midi_synth_note_on(ch, note, 100);
+    }
+
+    int16_t buf[BENCH_BLOCK];
+    uint32_t frames = MIDI_SAMPLE_RATE * BENCH_SECONDS;
+    uint64_t start = host_now_ns();
+    for (uint32_t done = 0; done < frames; done += BENCH_BLOCK) {
+        midi_synth_render(buf, BENCH_BLOCK);
+    }
+    uint64_t elapsed = host_now_ns() - start;
+
+    HOST_CHECK(midi_synth_active_count() == (uint32_t)voices,
+               "%d voices requested, %u active", voices, midi_synth_active_count());
+    return (double)elapsed / frames;
+}
+
+int main(void)
+{
+    static const int counts[] = {1, 8, 32, 64};
+
+    ESP_ERROR_CHECK(midi_synth_init(MIDI_SAMPLE_RATE));
+
+    printf("%-8s %14s %14s %8s\n", "voices", "mix_notes", "midi_synth", "speedup");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        int v = counts[i];
+        double ref = bench_reference(v);
+        double syn = bench_synth(v);
+        printf("%-8d %11.1f ns %11.1f ns %7.1fx\n", v, ref, syn, ref / syn);
+        if (v == MIDI_SYNTH_MAX_VOICES) {
+            HOST_CHECK(syn <= ref, "64 voices: synth %.1f ns/sample slower than reference %.1f", syn, ref);
+        }
+    }
+    return host_result("bench_midi_synth");
+}
@@ -0,0 +1,34 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// 主机测试公共工具：单调时钟和断言计数
+
+static int host_failures = 0;
+
+static inline uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#define HOST_CHECK(cond, ...) do {                                      \
+        if (!(cond)) {                                                  \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                 \
+            printf(__VA_ARGS__);                                        \
+            printf("\n");                                               \
+            host_failures++;                                            \
+        }                                                               \
+    } while (0)
+
+static inline int host_result(const char* name)
+{
+    printf("%s: %s\n", name, host_failures ? "FAILED" : "OK");
+    return host_failures ? 1 : 0;
+}
+
+#endif /* HOST_TEST_H */
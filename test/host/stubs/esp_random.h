@@ -0,0 +1,13 @@
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// 主机测试用的esp_random.h
+static inline uint32_t esp_random(void)
+{
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+#endif /* ESP_RANDOM_H */
@@ -0,0 +1,66 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+// 主机测试用的esp_timer.h：单调时钟加上测试可调的偏移；定时器只记录是否启动，回调由测试手动调用
+static int64_t esp_timer_stub_offset_us;
+
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 + esp_timer_stub_offset_us;
+}
+
+typedef struct {
+    void (*callback)(void* arg);
+    void* arg;
+    const char* name;
+} esp_timer_create_args_t;
+
+typedef struct esp_timer_stub {
+    esp_timer_create_args_t args;
+    bool active;
+} * esp_timer_handle_t;
+
+static struct esp_timer_stub esp_timer_stub_pool[4];
+static int esp_timer_stub_count;
+
+static inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out)
+{
+    if (esp_timer_stub_count >= 4) {
+        return ESP_ERR_NO_MEM;
+    }
+    *out = &esp_timer_stub_pool[esp_timer_stub_count++];
+    (*out)->args = *args;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    t->active = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    t->active = true;
+    return ESP_OK;
+}
+
+static inline esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    t->active = false;
+    return ESP_OK;
+}
+
+static inline bool esp_timer_is_active(esp_timer_handle_t t)
+{
+    return t->active;
+}
+
+#endif /* ESP_TIMER_H */
@@ -0,0 +1,13 @@
+#ifndef FREERTOS_H_STUB
+#define FREERTOS_H_STUB
+
+// 主机测试单线程运行，临界区为空
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) do { (void)(mux); } while (0)
+#define portEXIT_CRITICAL(mux) do { (void)(mux); } while (0)
+
+#define pdFALSE 0
+#define pdTRUE 1
+
+#endif /* FREERTOS_H_STUB */
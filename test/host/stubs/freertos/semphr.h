@@ -0,0 +1,32 @@
+#ifndef FREERTOS_SEMPHR_H_STUB
+#define FREERTOS_SEMPHR_H_STUB
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// 主机测试单线程运行，互斥量只是一个非空句柄
+typedef int* SemaphoreHandle_t;
+#define portMAX_DELAY 0xFFFFFFFFu
+
+static int semphr_stub_handle;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return &semphr_stub_handle;
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t h)
+{
+}
+
+static inline int xSemaphoreTake(SemaphoreHandle_t h, uint32_t ticks)
+{
+    return 1;
+}
+
+static inline int xSemaphoreGive(SemaphoreHandle_t h)
+{
+    return 1;
+}
+
+#endif /* FREERTOS_SEMPHR_H_STUB */
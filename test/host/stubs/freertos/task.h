@@ -0,0 +1,21 @@
+#ifndef FREERTOS_TASK_H_STUB
+#define FREERTOS_TASK_H_STUB
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// 主机测试不创建任务，只提供被测文件引用到的声明
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+#define pdPASS 1
+#define pdFAIL 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+static inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stack,
+                                                 void* arg, int prio, TaskHandle_t* handle, BaseType_t core)
+{
+    return pdFAIL;
+}
+
+#endif /* FREERTOS_TASK_H_STUB */
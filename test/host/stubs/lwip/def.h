@@ -0,0 +1,14 @@
+#ifndef LWIP_DEF_H_STUB
+#define LWIP_DEF_H_STUB
+
+#include <arpa/inet.h>
+#include "lwip/opt.h"
+
+// 主机测试用的字节序转换，主机为小端
+#define PP_HTONL(x) ((u32_t)((((x) & 0x000000FFUL) << 24) | (((x) & 0x0000FF00UL) << 8) | \
+                             (((x) & 0x00FF0000UL) >> 8) | (((x) & 0xFF000000UL) >> 24)))
+#define PP_NTOHL(x) PP_HTONL(x)
+#define lwip_htonl(x) htonl(x)
+#define lwip_ntohl(x) ntohl(x)
+
+#endif /* LWIP_DEF_H_STUB */
@@ -0,0 +1,15 @@
+#ifndef LWIP_IP4_ADDR_H_STUB
+#define LWIP_IP4_ADDR_H_STUB
+
+#include <stdint.h>
+
+// 主机测试用的最小ip4_addr.h
+typedef struct {
+    uint32_t addr;                      // 网络字节序
+} ip4_addr_t;
+
+#define IPSTR "%d.%d.%d.%d"
+#define ip4_addr_get_byte(a, i) (((const uint8_t*)&(a)->addr)[i])
+#define IP2STR(a) ip4_addr_get_byte(a, 0), ip4_addr_get_byte(a, 1), ip4_addr_get_byte(a, 2), ip4_addr_get_byte(a, 3)
+
+#endif /* LWIP_IP4_ADDR_H_STUB */
@@ -0,0 +1,21 @@
+#ifndef LWIP_NAPT_H_STUB
+#define LWIP_NAPT_H_STUB
+
+#include "lwip/opt.h"
+
+// 主机测试不安装到lwIP，只统计安装的单端口规则数
+static int napt_stub_installed;
+
+static inline u8_t ip_portmap_add(u8_t proto, u32_t maddr, u16_t mport, u32_t daddr, u16_t dport)
+{
+    napt_stub_installed++;
+    return 1;
+}
+
+static inline u8_t ip_portmap_remove(u8_t proto, u16_t mport)
+{
+    napt_stub_installed--;
+    return 1;
+}
+
+#endif /* LWIP_NAPT_H_STUB */
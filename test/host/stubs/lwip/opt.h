@@ -0,0 +1,19 @@
+#ifndef LWIP_OPT_H_STUB
+#define LWIP_OPT_H_STUB
+
+#include <stdint.h>
+
+// 主机测试用的lwIP选项，取esp-lwip的默认值
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM (-1)
+
+#ifndef IP_PORTMAP_MAX
+#define IP_PORTMAP_MAX 32
+#endif
+
+#endif /* LWIP_OPT_H_STUB */
@@ -0,0 +1,14 @@
+#ifndef LWIP_PBUF_H_STUB
+#define LWIP_PBUF_H_STUB
+
+#include "lwip/opt.h"
+
+// 主机测试用的pbuf：只有单个连续缓冲区
+struct pbuf {
+    struct pbuf* next;
+    void* payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+#endif /* LWIP_PBUF_H_STUB */
@@ -0,0 +1,24 @@
+#ifndef LWIP_PROT_ETHERNET_H_STUB
+#define LWIP_PROT_ETHERNET_H_STUB
+
+#include "lwip/opt.h"
+
+// 主机测试用的以太网头，主机为小端
+#define PP_HTONS(x) ((u16_t)((((x) & 0x00FFu) << 8) | (((x) & 0xFF00u) >> 8)))
+
+#define ETH_HWADDR_LEN 6
+#define SIZEOF_ETH_HDR 14
+#define ETHTYPE_IP 0x0800U
+#define ETHTYPE_ARP 0x0806U
+
+struct eth_addr {
+    u8_t addr[ETH_HWADDR_LEN];
+};
+
+struct eth_hdr {
+    struct eth_addr dest;
+    struct eth_addr src;
+    u16_t type;
+};
+
+#endif /* LWIP_PROT_ETHERNET_H_STUB */
@@ -0,0 +1,9 @@
+#ifndef LWIP_PROT_IP_H_STUB
+#define LWIP_PROT_IP_H_STUB
+
+// 主机测试用的IP协议号
+#define IP_PROTO_ICMP 1
+#define IP_PROTO_UDP 17
+#define IP_PROTO_TCP 6
+
+#endif /* LWIP_PROT_IP_H_STUB */
@@ -0,0 +1,11 @@
+#ifndef LWIP_PROT_IP4_H_STUB
+#define LWIP_PROT_IP4_H_STUB
+
+// 主机测试用的IPv4头常量
+#define IP_HLEN 20
+#define IP_RF 0x8000U
+#define IP_DF 0x4000U
+#define IP_MF 0x2000U
+#define IP_OFFMASK 0x1FFFU
+
+#endif /* LWIP_PROT_IP4_H_STUB */
@@ -0,0 +1,11 @@
+#ifndef LWIP_SOCKETS_H_STUB
+#define LWIP_SOCKETS_H_STUB
+
+// 主机测试直接使用系统的BSD套接字
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif /* LWIP_SOCKETS_H_STUB */
@@ -0,0 +1,13 @@
+#ifndef LWIP_TCPIP_H_STUB
+#define LWIP_TCPIP_H_STUB
+
+#include "lwip/opt.h"
+
+// 主机测试没有tcpip线程，回调立即执行
+static inline err_t tcpip_callback(void (*fn)(void*), void* ctx)
+{
+    fn(ctx);
+    return ERR_OK;
+}
+
+#endif /* LWIP_TCPIP_H_STUB */
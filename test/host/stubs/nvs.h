@@ -0,0 +1,103 @@
+#ifndef NVS_H_STUB
+#define NVS_H_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_err.h"
+
+// 主机测试用的nvs.h：进程内的键值表，不区分命名空间，提交为空操作
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define NVS_STUB_KEYS 128
+#define NVS_STUB_BLOB 1024
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+typedef struct {
+    char key[16];
+    size_t len;
+    uint8_t data[NVS_STUB_BLOB];
+    int used;
+} nvs_stub_entry_t;
+
+static nvs_stub_entry_t nvs_stub[NVS_STUB_KEYS];
+
+static inline nvs_stub_entry_t* nvs_stub_find(const char* key)
+{
+    for (int i = 0; i < NVS_STUB_KEYS; i++) {
+        if (nvs_stub[i].used && strcmp(nvs_stub[i].key, key) == 0) {
+            return &nvs_stub[i];
+        }
+    }
+    return NULL;
+}
+
+static inline void nvs_stub_reset(void)
+{
+    memset(nvs_stub, 0, sizeof(nvs_stub));
+}
+
+static inline esp_err_t nvs_open(const char* ns, nvs_open_mode_t mode, nvs_handle_t* out)
+{
+    *out = 1;
+    return ESP_OK;
+}
+
+static inline void nvs_close(nvs_handle_t h)
+{
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t h)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t h, const char* key, void* out, size_t* len)
+{
+    nvs_stub_entry_t* e = nvs_stub_find(key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out) {
+        if (*len < e->len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(out, e->data, e->len);
+    }
+    *len = e->len;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle_t h, const char* key, const void* data, size_t len)
+{
+    if (len > NVS_STUB_BLOB || strlen(key) >= sizeof(nvs_stub[0].key)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    nvs_stub_entry_t* e = nvs_stub_find(key);
+    for (int i = 0; !e && i < NVS_STUB_KEYS; i++) {
+        if (!nvs_stub[i].used) {
+            e = &nvs_stub[i];
+            e->used = 1;
+            strcpy(e->key, key);
+        }
+    }
+    if (!e) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(e->data, data, len);
+    e->len = len;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_erase_key(nvs_handle_t h, const char* key)
+{
+    nvs_stub_entry_t* e = nvs_stub_find(key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->used = 0;
+    return ESP_OK;
+}
+
+#endif /* NVS_H_STUB */
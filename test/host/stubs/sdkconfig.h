@@ -0,0 +1,12 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// 主机测试用的配置，取Kconfig上限或默认值；测试目标可用编译定义覆盖
+#ifndef CONFIG_MIDI_MAX_VOICES
+#define CONFIG_MIDI_MAX_VOICES 64
+#endif
+#ifndef CONFIG_MIDI_SAMPLE_RATE
+#define CONFIG_MIDI_SAMPLE_RATE 44100
+#endif
+
+#endif /* SDKCONFIG_H */
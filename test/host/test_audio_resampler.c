@@ -0,0 +1,167 @@
+#include <math.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "audio_resampler.h"
+
+// 重采样器：1 kHz音调的信噪比（含失真）检查和吞吐量基准
+// 单声道44.1→8/16/32 kHz（WAV_SR_HZ可选的调制采样率），立体声44.1→133 kHz（FM_MPX_RATE_HZ，含RDS）
+
+#define IN_RATE 44100
+#define TONE_HZ 1000.0
+#define TONE_AMPL 16384.0              // -6 dBFS
+#define BLOCK 256                      // 与AUDIO_PIPELINE_BLOCK_SIZE一致
+#define SETTLE_FRAMES 1024             // 跳过滤波器启动过程
+#define AUDIO_BAND_HZ 20000.0
+#define LPF_TAPS 255
+#define SNR_MIN_DB 75.0                // 通过门限（20 kHz带内，-6 dBFS音调）
+
+#define BENCH_SECONDS 2
+
+typedef struct {
+    uint64_t n;                        // 已渲染的输入帧数
+    uint8_t channels;
+} tone_src_t;
+
+// 上游：左右声道相同的1 kHz正弦
+static void tone_render(int16_t* buf, size_t frames, void* ctx)
+{
+    tone_src_t* src = (tone_src_t*)ctx;
+    for (size_t i = 0; i < frames; i++, src->n++) {
+        int16_t v = (int16_t)lrint(TONE_AMPL * sin(2 * M_PI * TONE_HZ * src->n / IN_RATE));
+        for (uint8_t c = 0; c < src->channels; c++) {
+            buf[i * src->channels + c] = v;
+        }
+    }
+}
+
+// 按已知频率对输出做最小二乘正弦拟合，残差即噪声和失真
+// band_hz非0且低于奈奎斯特频率时残差先经band_hz低通（Hann窗sinc），只计音频带内的部分
+static double tone_snr_db(const int16_t* x, size_t n, size_t stride, uint32_t rate, double band_hz)
+{
+    // 取整数个音调周期，使正弦、余弦和直流三项正交
+    uint32_t g = rate, r = (uint32_t)TONE_HZ;
+    while (r) {
+        uint32_t t = g % r;
+        g = r;
+        r = t;
+    }
+    uint32_t period = rate / g;
+    n -= n % period;
+
+    double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, x0 = 0;
+    for (size_t i = 0; i < n; i++) {
+        double w = 2 * M_PI * TONE_HZ * i / rate;
+        double s = sin(w), c = cos(w), v = x[i * stride];
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        xs += v * s;
+        xc += v * c;
+        x0 += v;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (xs * cc - xc * sc) / det;
+    double b = (xc * ss - xs * sc) / det;
+    double dc = x0 / n;
+
+    double* e = malloc(n * sizeof(double));
+    double sig = 0;
+    for (size_t i = 0; i < n; i++) {
+        double w = 2 * M_PI * TONE_HZ * i / rate;
+        double fit = a * sin(w) + b * cos(w) + dc;
+        e[i] = x[i * stride] - fit;
+        sig += fit * fit;
+    }
+
+    double err = 0;
+    size_t counted = 0;
+    if (band_hz == 0 || band_hz >= rate / 2.0) {
+        for (size_t i = 0; i < n; i++) {
+            err += e[i] * e[i];
+        }
+        counted = n;
+    } else {
+        double h[LPF_TAPS];
+        double fc = band_hz / rate;
+        for (int t = 0; t < LPF_TAPS; t++) {
+            double d = t - (LPF_TAPS - 1) / 2.0;
+            double sinc = d == 0 ? 2 * fc : sin(2 * M_PI * fc * d) / (M_PI * d);
+            h[t] = sinc * (0.5 - 0.5 * cos(2 * M_PI * t / (LPF_TAPS - 1)));
+        }
+        for (size_t i = LPF_TAPS; i < n; i++) {
+            double y = 0;
+            for (int t = 0; t < LPF_TAPS; t++) {
+                y += h[t] * e[i - t];
+            }
+            err += y * y;
+        }
+        counted = n - LPF_TAPS;
+    }
+    free(e);
+    err *= (double)n / counted;
+    return 10 * log10(sig / (err > 1e-9 ? err : 1e-9));
+}
+
+static void run(uint32_t out_rate, uint8_t channels)
+{
+    tone_src_t src = {.n = 0, .channels = channels};
+    audio_resampler_t rs;
+    ESP_ERROR_CHECK(audio_resampler_init(&rs, IN_RATE, out_rate, channels, BLOCK, tone_render, &src));
+
+    // 信噪比：一秒输出
+    size_t frames = out_rate;
+    int16_t* out = malloc(frames * channels * sizeof(int16_t));
+    for (size_t done = 0; done < frames; done += BLOCK) {
+        size_t n = frames - done < BLOCK ? frames - done : BLOCK;
+        audio_resampler_render(out + done * channels, n, &rs);
+    }
+    for (uint8_t c = 0; c < channels; c++) {
+        const int16_t* x = out + SETTLE_FRAMES * channels + c;
+        double snr = tone_snr_db(x, frames - SETTLE_FRAMES, channels, out_rate, AUDIO_BAND_HZ);
+        double wide = tone_snr_db(x, frames - SETTLE_FRAMES, channels, out_rate, 0);
+        printf("%u -> %lu Hz, %u ch, ch%u: SNR %.1f dB (min %.0f), broadband %.1f dB\n",
+               IN_RATE, (unsigned long)out_rate, channels, c, snr, SNR_MIN_DB, wide);
+        HOST_CHECK(snr >= SNR_MIN_DB, "%lu Hz ch%u: SNR %.1f dB below %.0f dB",
+                   (unsigned long)out_rate, c, snr, SNR_MIN_DB);
+    }
+
+    // 输入按比例拉取：一秒输出约消耗一秒输入，最后一个输出帧与一秒末尾最多差一个输出周期的输入
+    uint64_t expect = IN_RATE;
+    uint64_t slack = IN_RATE / out_rate + 1 > 2 ? IN_RATE / out_rate + 1 : 2;
+    HOST_CHECK(src.n + slack >= expect && src.n <= expect + AUDIO_RESAMPLER_TAPS + 2,
+               "%lu Hz: pulled %llu input frames for 1 s of output",
+               (unsigned long)out_rate, (unsigned long long)src.n);
+    free(out);
+
+    // 吞吐量
+    int16_t block[BLOCK * 2];
+    uint32_t bench_frames = out_rate * BENCH_SECONDS;
+    uint64_t start = host_now_ns();
+    for (uint32_t done = 0; done < bench_frames; done += BLOCK) {
+        audio_resampler_render(block, BLOCK, &rs);
+    }
+    uint64_t elapsed = host_now_ns() - start;
+    double ns = (double)elapsed / bench_frames;
+    printf("%u -> %lu Hz, %u ch: %.1f ns/output frame, %.1fx real time\n",
+           IN_RATE, (unsigned long)out_rate, channels, ns, 1e9 / ns / out_rate);
+
+    audio_resampler_deinit(&rs);
+}
+
+int main(void)
+{
+    // 输出采样率低于40 kHz时20 kHz带宽超过奈奎斯特频率，按全带宽计算
+    static const struct {
+        uint32_t out_rate;
+        uint8_t channels;
+    } cases[] = {
+        { 8000, 1 },
+        { 16000, 1 },
+        { 32000, 1 },
+        { 133000, 2 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        run(cases[i].out_rate, cases[i].channels);
+    }
+    return host_result("test_audio_resampler");
+}
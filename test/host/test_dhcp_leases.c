@@ -0,0 +1,138 @@
+#include <string.h>
+#include "host_test.h"
+
+// newlib有strlcpy，glibc 2.38之前没有
+static size_t host_strlcpy(char* dst, const char* src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#define strlcpy host_strlcpy
+
+// 直接包含实现以便调用刷新定时器的回调
+#include "dhcp_leases.c"
+
+// 租约表：DECLINE的地址在冷却期内不再分配，客户端换到另一个地址，冷却期过后恢复；
+// 保留地址被DECLINE时绑定不变；绑定和删除经刷新定时器写入NVS
+
+uint32_t my_ip;
+
+#define AP_IP PP_HTONL(0xC0A80401u)     // 192.168.4.1
+#define NETMASK PP_HTONL(0xFFFFFF00u)
+
+static const uint8_t MAC_A[6] = { 0x02, 0, 0, 0, 0, 0x0A };
+static const uint8_t MAC_B[6] = { 0x02, 0, 0, 0, 0, 0x0B };
+
+static uint8_t host_of(uint32_t ip)
+{
+    return (uint8_t)(lwip_ntohl(ip) & 0xFF);
+}
+
+static uint32_t bind_new(const uint8_t mac[6])
+{
+    uint32_t ip = 0, lease;
+    HOST_CHECK(dhcp_leases_offer(mac, 0, &ip) == ESP_OK, "offer failed");
+    HOST_CHECK(dhcp_leases_bind(mac, ip, NULL, &lease) == ESP_OK, "bind of offered address failed");
+    return ip;
+}
+
+static bool stored(int host)
+{
+    for (int slot = 0; slot < DHCP_LEASES_MAX; slot++) {
+        char key[8];
+        lease_record_t rec;
+        size_t len = sizeof(rec);
+        slot_key(key, sizeof(key), slot);
+        if (nvs_get_blob(0, key, &rec, &len) == ESP_OK && rec.host == host) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void check_decline(void)
+{
+    nvs_stub_reset();
+    ESP_ERROR_CHECK(dhcp_leases_init(AP_IP, NETMASK));
+
+    uint32_t first = bind_new(MAC_A);
+    flush_timer_cb(NULL);
+    HOST_CHECK(stored(host_of(first)), "binding not written to NVS");
+
+    // 其他地址的DECLINE忽略
+    dhcp_leases_decline(MAC_A, first ^ PP_HTONL(0x10));
+    uint32_t ip = 0, lease;
+    HOST_CHECK(dhcp_leases_offer(MAC_A, 0, &ip) == ESP_OK && ip == first, "unrelated DECLINE dropped the binding");
+
+    dhcp_leases_decline(MAC_A, first);
+    flush_timer_cb(NULL);
+    HOST_CHECK(!stored(host_of(first)), "declined binding still in NVS");
+
+    // 同一客户端即使请求原地址也换一个，其他客户端也拿不到
+    HOST_CHECK(dhcp_leases_offer(MAC_A, first, &ip) == ESP_OK, "offer after DECLINE failed");
+    HOST_CHECK(ip != first, "declined address offered again");
+    uint32_t second = ip;
+    HOST_CHECK(dhcp_leases_bind(MAC_A, second, NULL, &lease) == ESP_OK, "bind of new address failed");
+    HOST_CHECK(dhcp_leases_offer(MAC_B, first, &ip) == ESP_OK && ip != first, "declined address offered to B");
+    // INIT-REBOOT直接REQUEST被拒绝的地址也不认可
+    const uint8_t mac_d[6] = { 0x02, 0, 0, 0, 0, 0x0D };
+    HOST_CHECK(dhcp_leases_bind(mac_d, first, NULL, &lease) == ESP_ERR_INVALID_STATE, "declined address bound");
+
+    // 冷却期过后可以再分配
+    esp_timer_stub_offset_us += (int64_t)(DHCP_LEASES_DECLINE_S + 1) * 1000000;
+    dhcp_leases_release(MAC_B);
+    const uint8_t mac_c[6] = { 0x02, 0, 0, 0, 0, 0x0C };
+    HOST_CHECK(dhcp_leases_offer(mac_c, first, &ip) == ESP_OK && ip == first, "address still blocked after holdoff");
+}
+
+static void check_pool(void)
+{
+    nvs_stub_reset();
+    ESP_ERROR_CHECK(dhcp_leases_init(AP_IP, NETMASK));
+
+    // 每个新客户端都拒绝分到的地址，整个池用完后不再分配
+    int declined = 0;
+    for (int i = 0; i < DHCP_LEASES_DECLINE_MAX; i++) {
+        uint8_t mac[6] = { 0x02, 1, 0, 0, 0, (uint8_t)i };
+        uint32_t ip = bind_new(mac);
+        dhcp_leases_decline(mac, ip);
+        declined++;
+    }
+    int offered = 0;
+    for (int i = 0; i < DHCP_LEASES_POOL_SIZE; i++) {
+        uint8_t mac[6] = { 0x02, 2, 0, 0, 0, (uint8_t)i };
+        uint32_t ip;
+        if (dhcp_leases_offer(mac, 0, &ip) == ESP_OK) {
+            uint8_t h = host_of(ip);
+            HOST_CHECK(!host_declined(h, now_s()), "declined host %u offered", h);
+            offered++;
+        }
+    }
+    HOST_CHECK(offered == DHCP_LEASES_POOL_SIZE - declined, "%d addresses offered, want %d", offered,
+               DHCP_LEASES_POOL_SIZE - declined);
+}
+
+static void check_reserved(void)
+{
+    nvs_stub_reset();
+    ESP_ERROR_CHECK(dhcp_leases_init(AP_IP, NETMASK));
+
+    uint32_t ip = PP_HTONL(0xC0A80464u);  // 192.168.4.100
+    ESP_ERROR_CHECK(dhcp_leases_reserve(MAC_A, ip));
+    dhcp_leases_decline(MAC_A, ip);
+    uint32_t got;
+    HOST_CHECK(dhcp_leases_offer(MAC_A, 0, &got) == ESP_OK && got == ip, "reserved address lost after DECLINE");
+}
+
+int main(void)
+{
+    check_decline();
+    check_pool();
+    check_reserved();
+    return host_result("test_dhcp_leases");
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+#include "host_test.h"
+#include "captive.h"
+#include "task_config.h"
+// 直接包含实现以便测试静态的parse_question
+#include "dns_forwarder.c"
+
+// 问题段解析：最长的合法域名、超长一个字节的域名、普通查询和格式错误的报文
+
+bool captive_is_probe_host(const char* host)
+{
+    return false;
+}
+
+const task_placement_t* task_config_get(task_id_t id)
+{
+    static const task_placement_t placement = { -1, 5, 4096 };
+    return &placement;
+}
+
+// 组装只有一个问题的查询，labels为各标签长度，以0结束；返回报文长度
+static size_t build_query(uint8_t* msg, const uint8_t* labels, uint16_t arcount)
+{
+    memset(msg, 0, DNS_HDR_LEN);
+    put16(msg, 0x1234);
+    put16(msg + 2, DNS_FLAG_RD);
+    put16(msg + 4, 1);
+    put16(msg + 10, arcount);
+    size_t off = DNS_HDR_LEN;
+    for (const uint8_t* l = labels; *l; l++) {
+        msg[off++] = *l;
+        memset(msg + off, 'A', *l);
+        off += *l;
+    }
+    msg[off++] = 0;
+    put16(msg + off, DNS_TYPE_A);
+    put16(msg + off + 2, DNS_CLASS_IN);
+    return off + 4;
+}
+
+int main(void)
+{
+    static uint8_t msg[DNS_FORWARDER_MAX_MSG];
+    dns_key_t key;
+    char name[DNS_NAME_MAX + 1];
+
+    // 3个63字节标签和1个61字节标签：线格式连同根标签正好255字节
+    static const uint8_t longest[] = { 63, 63, 63, 61, 0 };
+    size_t len = build_query(msg, longest, 1);
+    memset(&key, 0xAA, sizeof(key));
+    bool ok = parse_question(msg, len, &key, name);
+    HOST_CHECK(ok, "255-byte name rejected");
+    HOST_CHECK(key.len == DNS_NAME_MAX + 5, "key length %u, expected %u", key.len, DNS_NAME_MAX + 5);
+    HOST_CHECK(key.len <= DNS_KEY_MAX, "key length %u exceeds buffer %u", key.len, DNS_KEY_MAX);
+    HOST_CHECK(key.qend == len, "question end %u, expected %zu", key.qend, len);
+    HOST_CHECK(key.data[key.len - 1] == 1, "EDNS flag not set");
+    HOST_CHECK(strlen(name) == 63 * 3 + 61 + 3, "name length %zu", strlen(name));
+    printf("255-byte name: ok=%d key.len=%u\n", ok, key.len);
+
+    // 标签共255字节，加根标签为256字节：必须拒绝，否则EDNS标志写出键缓冲区
+    static const uint8_t too_long[] = { 63, 63, 63, 62, 0 };
+    len = build_query(msg, too_long, 0);
+    ok = parse_question(msg, len, &key, name);
+    HOST_CHECK(!ok, "256-byte name accepted, key.len=%u", key.len);
+    printf("256-byte name: ok=%d\n", ok);
+
+    // 普通查询
+    static const uint8_t normal[] = { 3, 7, 3, 0 };
+    len = build_query(msg, normal, 0);
+    memcpy(msg + DNS_HDR_LEN + 1, "www", 3);
+    memcpy(msg + DNS_HDR_LEN + 5, "Example", 7);
+    memcpy(msg + DNS_HDR_LEN + 13, "com", 3);
+    ok = parse_question(msg, len, &key, name);
+    HOST_CHECK(ok && strcmp(name, "www.example.com") == 0, "normal query: ok=%d name=%s", ok, name);
+    HOST_CHECK(key.len == 17 + 5 && key.qtype == DNS_TYPE_A && key.data[key.len - 1] == 0,
+               "normal query key: len=%u qtype=%u", key.len, key.qtype);
+
+    // 截断的问题段和压缩指针
+    HOST_CHECK(!parse_question(msg, len - 1, &key, name), "truncated question accepted");
+    msg[DNS_HDR_LEN] = 0xC0;
+    HOST_CHECK(!parse_question(msg, len, &key, name), "compression pointer accepted");
+
+    return host_result("test_dns_parse");
+}
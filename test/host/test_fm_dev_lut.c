@@ -0,0 +1,191 @@
+#include <stdbool.h>
+#include <math.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "fm_apll.h"
+
+// 频偏查找表：每个载波下256项都必须等于原fm_transmitter_send_sample -> fm_set_deviation逐样本计算的系数
+// 载波频率：按系数算出的APLL输出经MCLK分频后，中心和±满幅频偏都要落在目标频率的1 LSB以内
+// 16位样本查表（中断中使用）：全部65536个样本与逐样本乘法计算的系数相差不超过2 LSB，并比较两者的耗时
+
+#define DEV_HZ 75000
+
+// ---- 原实现（fm_transmitter.c，查找表引入前），写寄存器改为返回系数 ----
+
+typedef struct {
+    uint8_t o_div, sdm0, sdm1, sdm2;
+} ref_coeff_t;
+
+static fm_apll_cfg_t g_apll;
+
+static inline ref_coeff_t fm_set_deviation(int16_t delta_frac16)
+{
+    int32_t frac32 = (int32_t)g_apll.base_frac16 + delta_frac16;
+    int32_t sdm2 = g_apll.sdm2;  // 工作副本
+
+    // 处理分数部分的借位/进位
+    if (frac32 < 0) {
+        int32_t borrow = (-frac32 + 65535) >> 16;  // 借位次数
+        frac32 += borrow * 65536;
+        sdm2 -= borrow;
+    } else if (frac32 > 65535) {
+        int32_t carry = frac32 >> 16;  // 进位次数
+        frac32 -= carry * 65536;
+        sdm2 += carry;
+    }
+
+    // 限制sdm2在有效范围内(0…63)
+    if (sdm2 < 0) {
+        sdm2 = 0;
+        frac32 = 0;
+    }
+    if (sdm2 > 63) {
+        sdm2 = 63;
+        frac32 = 65535;
+    }
+
+    uint8_t sdm0 = frac32 & 0xFF;
+    uint8_t sdm1 = frac32 >> 8;
+
+    return (ref_coeff_t){g_apll.o_div, sdm0, sdm1, (uint8_t)sdm2};
+}
+
+static ref_coeff_t fm_transmitter_send_sample(uint8_t audio_sample)
+{
+    // 将0-255范围转换为-128到127
+    int16_t audio = (int16_t)audio_sample - 128;
+
+    // 计算频率偏移（-dev_frac16到+dev_frac16）
+    int16_t delta = (audio * g_apll.dev_frac16) / 128;
+
+    return fm_set_deviation(delta);
+}
+
+// ---- 比较 ----
+
+static void check_config(const fm_apll_cfg_t* cfg, const char* what)
+{
+    uint32_t lut[256];
+    fm_build_dev_lut(cfg, lut);
+    g_apll = *cfg;
+
+    int mismatches = 0;
+    for (int i = 0; i < 256; i++) {
+        ref_coeff_t r = fm_transmitter_send_sample((uint8_t)i);
+        ref_coeff_t l = {
+            (uint8_t)((lut[i] >> 24) & 0x1F),
+            (uint8_t)(lut[i] & 0xFF),
+            (uint8_t)((lut[i] >> 8) & 0xFF),
+            (uint8_t)((lut[i] >> 16) & 0xFF),
+        };
+        if (l.o_div != r.o_div || l.sdm0 != r.sdm0 || l.sdm1 != r.sdm1 || l.sdm2 != r.sdm2) {
+            if (mismatches++ < 4) {
+                HOST_CHECK(false, "%s entry %d: lut o_div=%u sdm=%u/%u/%u, reference o_div=%u sdm=%u/%u/%u",
+                           what, i, l.o_div, l.sdm0, l.sdm1, l.sdm2, r.o_div, r.sdm0, r.sdm1, r.sdm2);
+            }
+        }
+    }
+    HOST_CHECK(mismatches == 0, "%s: %d of 256 entries differ", what, mismatches);
+}
+
+// 中心频率和满幅频偏，误差以APLL分数部分的LSB计
+static void check_frequency(uint32_t xtal, uint32_t f, const fm_apll_cfg_t* cfg, const char* what)
+{
+    uint32_t lut[256];
+    fm_build_dev_lut(cfg, lut);
+    double lsb = xtal / (2.0 * (cfg->o_div + 2) * 65536) / FM_MCLK_DIV;
+
+    double center = fm_apll_out_hz(xtal, lut[128]) / FM_MCLK_DIV;
+    double low = fm_apll_out_hz(xtal, lut[0]) / FM_MCLK_DIV;
+    HOST_CHECK(fabs(center - f) <= lsb, "%s: carrier %.0f Hz, off by %.0f Hz (LSB %.1f Hz)",
+               what, center, center - f, lsb);
+    HOST_CHECK(fabs(center - low - DEV_HZ) <= lsb, "%s: deviation %.0f Hz, expected %d Hz",
+               what, center - low, DEV_HZ);
+}
+
+#define FINE_MAX_ERR 2
+
+static uint64_t s_lut_ns;
+static uint64_t s_mul_ns;
+static int s_fine_configs;
+static volatile uint32_t s_sink;
+
+// 高字节查表 + 低字节细调与fm_calc_sdm(cfg, (s * dev) >> 15)比较，打包字去掉o_div后按整数比较
+static void check_fine(const fm_apll_cfg_t* cfg, const char* what)
+{
+    uint32_t lut[256];
+    uint16_t fine[256];
+    fm_build_dev_lut(cfg, lut);
+    fm_build_dev_fine(cfg, fine);
+
+    int worst = 0;
+    for (int32_t s = -32768; s <= 32767; s++) {
+        uint32_t a = fm_lut_sdm(lut, fine, (int16_t)s);
+        uint32_t b = fm_calc_sdm(cfg, (s * cfg->dev_frac16) >> 15);
+        int err = abs((int)(a & 0xFFFFFF) - (int)(b & 0xFFFFFF));
+        if (err > worst) {
+            worst = err;
+        }
+        if ((a >> 24) != (b >> 24)) {
+            worst = INT32_MAX;
+        }
+    }
+    HOST_CHECK(worst <= FINE_MAX_ERR, "%s: lookup differs from per-sample math by %d LSB", what, worst);
+
+    // 中断中的两种换算方式，各跑一遍全部样本
+    uint32_t acc = 0;
+    uint64_t t0 = host_now_ns();
+    for (int32_t s = -32768; s <= 32767; s++) {
+        acc += fm_lut_sdm(lut, fine, (int16_t)s);
+    }
+    uint64_t t1 = host_now_ns();
+    for (int32_t s = -32768; s <= 32767; s++) {
+        acc += fm_calc_sdm(cfg, (s * cfg->dev_frac16) >> 15);
+    }
+    uint64_t t2 = host_now_ns();
+    s_sink += acc;
+    s_lut_ns += t1 - t0;
+    s_mul_ns += t2 - t1;
+    s_fine_configs++;
+}
+
+int main(void)
+{
+    static const uint32_t xtals[] = {40000000, 26000000};
+    int configs = 0;
+
+    // 整个广播频段，100 kHz步进
+    for (size_t x = 0; x < sizeof(xtals) / sizeof(xtals[0]); x++) {
+        for (uint32_t f = 76000000; f <= 108000000; f += 100000) {
+            char what[48];
+            snprintf(what, sizeof(what), "xtal %lu Hz, %lu Hz",
+                     (unsigned long)xtals[x], (unsigned long)f);
+            fm_apll_cfg_t cfg = fm_calc_apll(xtals[x], f * FM_MCLK_DIV, DEV_HZ);
+            check_config(&cfg, what);
+            check_frequency(xtals[x], f, &cfg, what);
+            check_fine(&cfg, what);
+            configs++;
+        }
+    }
+
+    // 边界：分数部分贴近0和65535时借位/进位到sdm2，以及sdm2被限幅
+    static const fm_apll_cfg_t edges[] = {
+        {.o_div = 1, .sdm2 = 8, .base_frac16 = 0, .dev_frac16 = 737},
+        {.o_div = 1, .sdm2 = 8, .base_frac16 = 65535, .dev_frac16 = 737},
+        {.o_div = 0, .sdm2 = 0, .base_frac16 = 100, .dev_frac16 = 1000},
+        {.o_div = 0, .sdm2 = 63, .base_frac16 = 65500, .dev_frac16 = 1000},
+        {.o_div = 31, .sdm2 = 20, .base_frac16 = 32768, .dev_frac16 = 65535},
+    };
+    for (size_t e = 0; e < sizeof(edges) / sizeof(edges[0]); e++) {
+        char what[24];
+        snprintf(what, sizeof(what), "edge case %zu", e);
+        check_config(&edges[e], what);
+        configs++;
+    }
+
+    printf("%d configurations x 256 entries compared\n", configs);
+    double samples = 65536.0 * s_fine_configs;
+    printf("16-bit sample -> APLL word: lookup %.2f ns, multiply + carry %.2f ns per sample (host)\n",
+           s_lut_ns / samples, s_mul_ns / samples);
+    return host_result("test_fm_dev_lut");
+}
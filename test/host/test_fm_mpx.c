@@ -0,0 +1,118 @@
+#include <math.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "fm_mpx.h"
+
+// 立体声复合信号：只有左声道的1 kHz音调
+// 检查导频电平、38 kHz副载波与导频锁相（相位为导频的2倍）、L-R两个边带的电平和左右分离度
+
+#define TONE_HZ 1000
+#define TONE_AMPL 16384                 // -6 dBFS，不触发限幅器
+#define SETTLE_MS 10                    // 跳过处理链启动过程
+#define MEASURE_MS 1000                 // 1 ms含所有分量的整数个周期
+#define PHASE_TOL_DEG 1.0
+#define LEVEL_TOL_DB 0.2
+#define SEPARATION_MIN_DB 40.0
+
+#define DEG(rad) ((rad) * 180.0 / M_PI)
+
+static uint64_t s_n;
+
+// 上游：左声道音调，右声道静音
+static void left_tone(int16_t* buf, size_t frames, void* ctx)
+{
+    for (size_t i = 0; i < frames; i++, s_n++) {
+        buf[2 * i] = (int16_t)lrint(TONE_AMPL * sin(2 * M_PI * TONE_HZ * (double)s_n / FM_MPX_RATE_HZ));
+        buf[2 * i + 1] = 0;
+    }
+}
+
+// x = A * sin(w*n + phase)：按频率相关求幅度和相位
+static void tone_measure(const int16_t* x, size_t n, double hz, double* ampl, double* phase)
+{
+    double i_sum = 0, q_sum = 0;
+    for (size_t k = 0; k < n; k++) {
+        double w = 2 * M_PI * hz * k / FM_MPX_RATE_HZ;
+        i_sum += x[k] * sin(w);
+        q_sum += x[k] * cos(w);
+    }
+    *ampl = 2 * hypot(i_sum, q_sum) / n;
+    *phase = atan2(q_sum, i_sum);
+}
+
+static double wrap(double a)
+{
+    while (a > M_PI) a -= 2 * M_PI;
+    while (a <= -M_PI) a += 2 * M_PI;
+    return a;
+}
+
+int main(void)
+{
+    fm_mpx_t mpx;
+    ESP_ERROR_CHECK(fm_mpx_init(&mpx, (uint64_t)FM_MPX_RATE_HZ * 1000, left_tone, NULL));
+
+    size_t skip = FM_MPX_RATE_HZ / 1000 * SETTLE_MS;
+    size_t n = FM_MPX_RATE_HZ / 1000 * MEASURE_MS;
+    int16_t* out = malloc((skip + n) * sizeof(int16_t));
+    for (size_t done = 0; done < skip + n; done += FM_MPX_CHUNK) {
+        size_t len = skip + n - done < FM_MPX_CHUNK ? skip + n - done : FM_MPX_CHUNK;
+        fm_mpx_render(out + done, len, &mpx);
+    }
+    const int16_t* x = out + skip;
+
+    // 导频
+    double pilot, pilot_ph;
+    tone_measure(x, n, FM_MPX_PILOT_HZ, &pilot, &pilot_ph);
+    double pilot_db = 20 * log10(pilot / FM_MPX_PILOT_LEVEL);
+    printf("pilot: %.1f (expected %d, %+.2f dB), phase %.2f deg\n", pilot, FM_MPX_PILOT_LEVEL, pilot_db, DEG(pilot_ph));
+    HOST_CHECK(fabs(pilot_db) < LEVEL_TOL_DB, "pilot level off by %.2f dB", pilot_db);
+
+    // L+R与L-R边带：s*sin(2wt+p38)中s = S*sin(wa*t+ps)，
+    // 下边带 = S/2*sin((2w-wa)t + p38 - ps + 90°)，上边带 = S/2*sin((2w+wa)t + p38 + ps - 90°)
+    double mono, mono_ph, lsb, lsb_ph, usb, usb_ph;
+    tone_measure(x, n, TONE_HZ, &mono, &mono_ph);
+    tone_measure(x, n, 2 * FM_MPX_PILOT_HZ - TONE_HZ, &lsb, &lsb_ph);
+    tone_measure(x, n, 2 * FM_MPX_PILOT_HZ + TONE_HZ, &usb, &usb_ph);
+
+    // 只有左声道时L-R = L+R，每个边带为L+R分量的一半
+    double lsb_db = 20 * log10(2 * lsb / mono);
+    double usb_db = 20 * log10(2 * usb / mono);
+    printf("L+R: %.1f, lower sideband %.1f (%+.2f dB), upper sideband %.1f (%+.2f dB)\n",
+           mono, lsb, lsb_db, usb, usb_db);
+    HOST_CHECK(fabs(lsb_db) < LEVEL_TOL_DB, "lower sideband %+.2f dB relative to L+R/2", lsb_db);
+    HOST_CHECK(fabs(usb_db) < LEVEL_TOL_DB, "upper sideband %+.2f dB relative to L+R/2", usb_db);
+
+    // 副载波相位：由两个边带相位之和求出，必须为导频相位的2倍
+    double sub_ph = wrap((lsb_ph + usb_ph) / 2);
+    double lock_err = wrap(sub_ph - 2 * pilot_ph);
+    if (lock_err > M_PI / 2) lock_err -= M_PI;          // 边带和只确定到180°以内，由下面的分离度检查符号
+    if (lock_err < -M_PI / 2) lock_err += M_PI;
+    printf("38 kHz subcarrier phase %.2f deg, 2 x pilot %.2f deg, error %.3f deg\n",
+           DEG(sub_ph), DEG(wrap(2 * pilot_ph)), DEG(lock_err));
+    HOST_CHECK(fabs(DEG(lock_err)) < PHASE_TOL_DEG, "subcarrier not locked to 2 x pilot: %.3f deg", DEG(lock_err));
+
+    // 接收端以2倍导频相位同步解调：S的相位分别由两个边带求出后平均
+    double ref = 2 * pilot_ph;
+    double s_re = 0, s_im = 0;
+    double ps_l = ref + M_PI / 2 - lsb_ph;
+    double ps_u = usb_ph - ref + M_PI / 2;
+    s_re = lsb * cos(ps_l) + usb * cos(ps_u);
+    s_im = lsb * sin(ps_l) + usb * sin(ps_u);
+    double m_re = mono * cos(mono_ph), m_im = mono * sin(mono_ph);
+    double left = hypot(m_re + s_re, m_im + s_im);
+    double right = hypot(m_re - s_re, m_im - s_im);
+    double sep_db = 20 * log10(left / (right > 1e-9 ? right : 1e-9));
+    printf("decoded L %.1f, R %.1f, separation %.1f dB (min %.0f)\n", left, right, sep_db, SEPARATION_MIN_DB);
+    HOST_CHECK(sep_db >= SEPARATION_MIN_DB, "separation %.1f dB", sep_db);
+
+    // 复合信号不应被削顶
+    int peak = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (abs(x[k]) > peak) peak = abs(x[k]);
+    }
+    HOST_CHECK(peak < 32767, "composite clipped");
+
+    free(out);
+    return host_result("test_fm_mpx");
+}
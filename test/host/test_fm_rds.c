@@ -0,0 +1,178 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "fm_mpx.h"
+#include "fm_rds.h"
+
+// RDS往返：编码器经MPX渲染后，用独立的解码器恢复PI、PS和RT
+// 解码：57 kHz同步解调 -> 按比特前后半段积分判决双相符号 -> 差分解码 -> 按校验字同步块
+// 节目音频为两个音调，检查RDS在有导频和L-R副载波时仍0坏块
+
+#define TEST_PI 0xC0DE
+#define TEST_PS "HOSTTEST"
+#define TEST_RT "Round trip through the MPX encoder"
+#define SECONDS 6                       // RT为9段，每5组发一段，约4秒一轮
+#define GROUP_BITS 104
+#define BLOCK_BITS 26
+
+#define SPB FM_RDS_SAMPLES_PER_BIT
+#define TOTAL (FM_MPX_RATE_HZ * SECONDS)
+#define MAX_BITS (TOTAL / SPB)
+
+static const uint16_t s_offsets[4] = {0x0FC, 0x198, 0x168, 0x1B4};  // A、B、C、D
+
+static uint64_t s_n;
+
+static void program(int16_t* buf, size_t frames, void* ctx)
+{
+    for (size_t i = 0; i < frames; i++, s_n++) {
+        double t = (double)s_n / FM_MPX_RATE_HZ;
+        buf[2 * i] = (int16_t)lrint(12000 * sin(2 * M_PI * 1000 * t));
+        buf[2 * i + 1] = (int16_t)lrint(12000 * sin(2 * M_PI * 2500 * t));
+    }
+}
+
+// 按标准逐位计算的10位校验（不含偏移字）
+static uint16_t syndrome(uint32_t block)
+{
+    uint16_t reg = 0;
+    uint16_t info = block >> 10;
+    for (int bit = 15; bit >= 0; bit--) {
+        uint16_t fb = ((reg >> 9) ^ (info >> bit)) & 1;
+        reg = (reg << 1) & 0x3FF;
+        if (fb) {
+            reg ^= 0x1B9;
+        }
+    }
+    return (reg ^ block) & 0x3FF;
+}
+
+static uint32_t take_block(const uint8_t* bits, int pos)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < BLOCK_BITS; i++) {
+        v = (v << 1) | bits[pos + i];
+    }
+    return v;
+}
+
+int main(void)
+{
+    fm_mpx_t mpx;
+    ESP_ERROR_CHECK(fm_mpx_init(&mpx, (uint64_t)FM_MPX_RATE_HZ * 1000, program, NULL));
+    fm_rds_set_pi(TEST_PI);
+    fm_rds_set_ps(TEST_PS);
+    fm_rds_set_rt(TEST_RT);
+
+    int16_t* out = malloc(TOTAL * sizeof(int16_t));
+    for (int done = 0; done < TOTAL; done += FM_MPX_CHUNK) {
+        int len = TOTAL - done < FM_MPX_CHUNK ? TOTAL - done : FM_MPX_CHUNK;
+        fm_mpx_render(out + done, len, &mpx);
+    }
+
+    // 同步解调：RDS副载波与导频三次谐波同相，导频从相位0开始
+    double* bb = malloc(TOTAL * sizeof(double));
+    for (int i = 0; i < TOTAL; i++) {
+        bb[i] = out[i] * sin(2 * M_PI * 57000.0 * i / FM_MPX_RATE_HZ);
+    }
+
+    // 比特定时：选使各比特前后半段积分差绝对值之和最大的起点
+    int nbits = MAX_BITS - 1;
+    int best_off = 0;
+    double best = -1;
+    for (int off = 0; off < SPB; off++) {
+        double metric = 0;
+        for (int j = 0; j < nbits; j++) {
+            const double* p = &bb[off + j * SPB];
+            double a = 0;
+            for (int k = 0; k < SPB / 2; k++) {
+                a += p[k] - p[k + SPB / 2];
+            }
+            metric += fabs(a);
+        }
+        if (metric > best) {
+            best = metric;
+            best_off = off;
+        }
+    }
+    static uint8_t bits[MAX_BITS];
+    uint8_t prev = 0;
+    for (int j = 0; j < nbits; j++) {
+        const double* p = &bb[best_off + j * SPB];
+        double a = 0;
+        for (int k = 0; k < SPB / 2; k++) {
+            a += p[k] - p[k + SPB / 2];
+        }
+        uint8_t d = a > 0;
+        bits[j] = d ^ prev;
+        prev = d;
+    }
+
+    // 块同步：找到连续4块校验均与A、B、C、D偏移字相符的位置
+    int sync = -1;
+    for (int p = 1; p + GROUP_BITS <= nbits && sync < 0; p++) {
+        bool ok = true;
+        for (int b = 0; b < 4 && ok; b++) {
+            ok = syndrome(take_block(bits, p + b * BLOCK_BITS)) == s_offsets[b];
+        }
+        if (ok) {
+            sync = p;
+        }
+    }
+    HOST_CHECK(sync >= 0, "no block sync in %d bits", nbits);
+    if (sync < 0) {
+        return host_result("test_fm_rds");
+    }
+
+    int groups = 0, bad = 0;
+    uint16_t pi = 0;
+    bool pi_ok = true;
+    char ps[FM_RDS_PS_LEN + 1];
+    char rt[FM_RDS_RT_LEN + 1];
+    memset(ps, 0, sizeof(ps));
+    memset(rt, 0, sizeof(rt));
+    for (int g = sync; g + GROUP_BITS <= nbits; g += GROUP_BITS) {
+        uint16_t info[4];
+        for (int b = 0; b < 4; b++) {
+            uint32_t block = take_block(bits, g + b * BLOCK_BITS);
+            if (syndrome(block) != s_offsets[b]) {
+                bad++;
+            }
+            info[b] = block >> 10;
+        }
+        groups++;
+        pi = info[0];
+        pi_ok = pi_ok && pi == TEST_PI;
+
+        uint8_t type = info[1] >> 12;
+        if (type == 0) {
+            int seg = info[1] & 3;
+            ps[2 * seg] = (char)(info[3] >> 8);
+            ps[2 * seg + 1] = (char)(info[3] & 0xFF);
+        } else if (type == 2) {
+            int seg = info[1] & 15;
+            rt[4 * seg] = (char)(info[2] >> 8);
+            rt[4 * seg + 1] = (char)(info[2] & 0xFF);
+            rt[4 * seg + 2] = (char)(info[3] >> 8);
+            rt[4 * seg + 3] = (char)(info[3] & 0xFF);
+        }
+    }
+    char* end = strchr(rt, '\r');
+    if (end) {
+        *end = '\0';
+    }
+
+    printf("bit offset %d, sync at bit %d, %d groups, %d bad blocks\n", best_off, sync, groups, bad);
+    printf("PI %04X, PS '%s', RT '%s'\n", pi, ps, rt);
+    HOST_CHECK(groups >= 40, "only %d groups decoded", groups);
+    HOST_CHECK(bad == 0, "%d bad blocks", bad);
+    HOST_CHECK(pi_ok, "PI %04X, expected %04X", pi, TEST_PI);
+    HOST_CHECK(strcmp(ps, TEST_PS) == 0, "PS '%s', expected '%s'", ps, TEST_PS);
+    HOST_CHECK(end && strcmp(rt, TEST_RT) == 0, "RT '%s', expected '%s'", rt, TEST_RT);
+    HOST_CHECK(fm_rds_group_count() >= (uint32_t)groups, "encoder counted %u groups", fm_rds_group_count());
+
+    free(bb);
+    free(out);
+    return host_result("test_fm_rds");
+}
@@ -0,0 +1,98 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "host_test.h"
+#include "midi_file.h"
+
+// SMF解析：通道消息之间的running status，以及元事件和SysEx之后running status失效
+
+#define RATE 44100
+
+// 写入只有一个音轨的格式0文件
+static void write_smf(const char* path, const uint8_t* track, size_t len)
+{
+    uint8_t hdr[] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+        'M', 'T', 'r', 'k', (uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len,
+    };
+    FILE* fp = fopen(path, "wb");
+    fwrite(hdr, 1, sizeof(hdr), fp);
+    fwrite(track, 1, len, fp);
+    fclose(fp);
+}
+
+// 返回解析出的通道事件数，状态字节依次写入status
+static int parse(const char* path, const uint8_t* track, size_t len, uint8_t* status, int max)
+{
+    write_smf(path, track, len);
+    static midi_file_t mf;
+    ESP_ERROR_CHECK(midi_file_open(&mf, path, RATE));
+    midi_event_t e;
+    int n = 0;
+    while (midi_file_next_event(&mf, &e) == ESP_OK && n < max) {
+        status[n++] = e.status;
+    }
+    midi_file_close(&mf);
+    return n;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test_midi_file_XXXXXX";
+    int fd = mkstemp(path);
+    HOST_CHECK(fd >= 0, "mkstemp failed");
+    close(fd);
+    uint8_t st[8];
+
+    // 音符开、running status的音符开（力度0）、结束
+    static const uint8_t running[] = {
+        0x00, 0x90, 0x3C, 0x40,
+        0x10, 0x3C, 0x00,
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    int n = parse(path, running, sizeof(running), st, 8);
+    HOST_CHECK(n == 2 && st[0] == 0x90 && st[1] == 0x90, "running status between channel messages: %d events", n);
+
+    // 元事件之后的数据字节没有可用的running status，不能当作音符开
+    static const uint8_t after_meta[] = {
+        0x00, 0x90, 0x3C, 0x40,
+        0x00, 0xFF, 0x01, 0x02, 'h', 'i',
+        0x10, 0x3C, 0x00,
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    n = parse(path, after_meta, sizeof(after_meta), st, 8);
+    HOST_CHECK(n == 1, "running status survived a meta event: %d events", n);
+
+    // 速度元事件同样清除
+    static const uint8_t after_tempo[] = {
+        0x00, 0xB0, 0x07, 0x64,
+        0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20,
+        0x10, 0x07, 0x50,
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    n = parse(path, after_tempo, sizeof(after_tempo), st, 8);
+    HOST_CHECK(n == 1, "running status survived a tempo event: %d events", n);
+
+    // SysEx之后同样清除
+    static const uint8_t after_sysex[] = {
+        0x00, 0x90, 0x3C, 0x40,
+        0x00, 0xF0, 0x03, 0x7E, 0x09, 0xF7,
+        0x10, 0x3C, 0x00,
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    n = parse(path, after_sysex, sizeof(after_sysex), st, 8);
+    HOST_CHECK(n == 1, "running status survived SysEx: %d events", n);
+
+    // 元事件后重新给出状态字节的消息正常解析
+    static const uint8_t restated[] = {
+        0x00, 0x90, 0x3C, 0x40,
+        0x00, 0xFF, 0x01, 0x00,
+        0x10, 0x80, 0x3C, 0x00,
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    n = parse(path, restated, sizeof(restated), st, 8);
+    HOST_CHECK(n == 2 && st[1] == 0x80, "explicit status after a meta event: %d events", n);
+
+    unlink(path);
+    return host_result("test_midi_file");
+}
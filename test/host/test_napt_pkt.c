@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include "host_test.h"
+#include "napt_pkt.h"
+
+// napt_pkt.h的增量校验和与完整重算对照：随机生成带正确校验和的TCP/UDP帧，
+// 改写地址端口、TTL减一后，IP头和TCP/UDP校验和必须与按RFC 791/768/793重算的值相同
+
+#define ROUNDS 200000
+#define FRAME_MAX 128
+
+static uint8_t s_frame[FRAME_MAX];
+
+// 对内存中的16位字求反码和，字节序与napt_pkt.h一致直接使用原始字
+static uint32_t sum_words(uint32_t sum, const uint8_t* p, size_t len)
+{
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += rd16(p + i);
+    }
+    if (len & 1) {
+        uint8_t last[2] = { p[len - 1], 0 };
+        sum += rd16(last);
+    }
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+static uint16_t ip_chksum_full(const uint8_t* ip, size_t hlen)
+{
+    uint8_t hdr[60];
+    memcpy(hdr, ip, hlen);
+    wr16(hdr + IP_OFF_CHKSUM, 0);
+    return fold(sum_words(0, hdr, hlen));
+}
+
+// 伪首部 + TCP/UDP头和负载
+static uint16_t l4_chksum_full(const uint8_t* ip, const uint8_t* l4, size_t l4_len, uint8_t proto, uint8_t off)
+{
+    uint8_t seg[FRAME_MAX];
+    memcpy(seg, l4, l4_len);
+    wr16(seg + off, 0);
+    uint8_t pseudo[12];
+    memcpy(pseudo, ip + IP_OFF_SRC, 8);
+    pseudo[8] = 0;
+    pseudo[9] = proto;
+    pseudo[10] = (uint8_t)(l4_len >> 8);
+    pseudo[11] = (uint8_t)l4_len;
+    uint16_t s = fold(sum_words(sum_words(0, pseudo, sizeof(pseudo)), seg, l4_len));
+    // UDP用全1表示计算结果为0
+    if (proto == IP_PROTO_UDP && s == 0) {
+        s = 0xFFFF;
+    }
+    return s;
+}
+
+// 0x0000和0xFFFF在反码中都表示零，TCP的完整重算不会给出0xFFFF以外的零，两者视为相同
+static bool same_sum(uint16_t a, uint16_t b)
+{
+    return a == b || ((a == 0 || a == 0xFFFF) && (b == 0 || b == 0xFFFF));
+}
+
+static uint32_t rnd32(void)
+{
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+// 构造以太网帧，返回长度；udp_zero为true时UDP不带校验和
+static size_t build_frame(uint8_t proto, size_t opt_len, size_t payload, bool udp_zero, uint8_t ttl)
+{
+    memset(s_frame, 0, sizeof(s_frame));
+    for (int i = 0; i < 12; i++) {
+        s_frame[i] = (uint8_t)rand();
+    }
+    wr16(s_frame + 12, PP_HTONS(ETHTYPE_IP));
+
+    uint8_t* ip = s_frame + SIZEOF_ETH_HDR;
+    size_t hlen = IP_HLEN + opt_len;
+    size_t l4_hlen = proto == IP_PROTO_TCP ? 20 : 8;
+    size_t l4_len = l4_hlen + payload;
+    size_t total = hlen + l4_len;
+
+    ip[0] = 0x40 | (uint8_t)(hlen / 4);
+    ip[1] = (uint8_t)rand();
+    ip[2] = (uint8_t)(total >> 8);
+    ip[3] = (uint8_t)total;
+    wr16(ip + 4, (uint16_t)rand());
+    wr16(ip + IP_OFF_FRAG, (rand() & 1) ? PP_HTONS(IP_DF) : 0);
+    ip[IP_OFF_TTL] = ttl;
+    ip[9] = proto;
+    wr32(ip + IP_OFF_SRC, rnd32());
+    wr32(ip + IP_OFF_DST, rnd32());
+    for (size_t i = IP_HLEN; i < hlen; i++) {
+        ip[i] = (uint8_t)rand();
+    }
+    wr16(ip + IP_OFF_CHKSUM, ip_chksum_full(ip, hlen));
+
+    uint8_t* l4 = ip + hlen;
+    for (size_t i = 0; i < l4_len; i++) {
+        l4[i] = (uint8_t)rand();
+    }
+    if (proto == IP_PROTO_UDP) {
+        l4[4] = (uint8_t)(l4_len >> 8);
+        l4[5] = (uint8_t)l4_len;
+        wr16(l4 + UDP_OFF_CHKSUM, udp_zero ? 0 : l4_chksum_full(ip, l4, l4_len, proto, UDP_OFF_CHKSUM));
+    } else {
+        wr16(l4 + TCP_OFF_CHKSUM, l4_chksum_full(ip, l4, l4_len, proto, TCP_OFF_CHKSUM));
+    }
+    return SIZEOF_ETH_HDR + total;
+}
+
+static void check_parse(void)
+{
+    struct pbuf p = { .payload = s_frame };
+    napt_pkt_t pkt;
+
+    p.len = p.tot_len = (uint16_t)build_frame(IP_PROTO_TCP, 8, 4, false, 64);
+    HOST_CHECK(napt_parse(&p, &pkt), "TCP frame with options rejected");
+    HOST_CHECK(pkt.l4 == s_frame + SIZEOF_ETH_HDR + 28, "l4 offset ignores IP options");
+    HOST_CHECK(pkt.l4_chksum_off == TCP_OFF_CHKSUM, "wrong TCP checksum offset");
+
+    p.len = p.tot_len = (uint16_t)build_frame(IP_PROTO_UDP, 0, 0, false, 64);
+    HOST_CHECK(napt_parse(&p, &pkt) && pkt.l4_chksum_off == UDP_OFF_CHKSUM, "UDP frame rejected");
+
+    // 头部不完整
+    p.len = SIZEOF_ETH_HDR + IP_HLEN + 7;
+    HOST_CHECK(!napt_parse(&p, &pkt), "truncated UDP header accepted");
+    p.len = (uint16_t)build_frame(IP_PROTO_TCP, 0, 0, false, 64) - 1;
+    HOST_CHECK(!napt_parse(&p, &pkt), "truncated TCP header accepted");
+
+    // 分片：MF或非零偏移
+    p.len = (uint16_t)build_frame(IP_PROTO_UDP, 0, 8, false, 64);
+    wr16(s_frame + SIZEOF_ETH_HDR + IP_OFF_FRAG, PP_HTONS(IP_MF));
+    HOST_CHECK(!napt_parse(&p, &pkt), "first fragment accepted");
+    wr16(s_frame + SIZEOF_ETH_HDR + IP_OFF_FRAG, PP_HTONS(IP_DF | 3));
+    HOST_CHECK(!napt_parse(&p, &pkt), "later fragment accepted");
+
+    // 其他协议、头长度不足、非IPv4
+    build_frame(IP_PROTO_UDP, 0, 8, false, 64);
+    s_frame[SIZEOF_ETH_HDR + 9] = IP_PROTO_ICMP;
+    HOST_CHECK(!napt_parse(&p, &pkt), "ICMP accepted");
+    build_frame(IP_PROTO_UDP, 0, 8, false, 64);
+    s_frame[SIZEOF_ETH_HDR] = 0x44;
+    HOST_CHECK(!napt_parse(&p, &pkt), "IHL below 5 accepted");
+    build_frame(IP_PROTO_UDP, 0, 8, false, 64);
+    wr16(s_frame + 12, PP_HTONS(ETHTYPE_ARP));
+    HOST_CHECK(!napt_parse(&p, &pkt), "ARP accepted");
+}
+
+static void check_rewrite(void)
+{
+    struct pbuf p = { .payload = s_frame };
+    int ip_bad = 0, l4_bad = 0, zero_bad = 0, ttl_bad = 0;
+
+    for (int r = 0; r < ROUNDS; r++) {
+        uint8_t proto = (r & 1) ? IP_PROTO_TCP : IP_PROTO_UDP;
+        bool udp_zero = proto == IP_PROTO_UDP && (r % 7) == 0;
+        size_t opt_len = (size_t)(rand() % 3) * 4;
+        size_t payload = (size_t)(rand() % 48);
+        uint8_t ttl = (uint8_t)(rand() % 256);
+        p.len = p.tot_len = (uint16_t)build_frame(proto, opt_len, payload, udp_zero, ttl);
+
+        napt_pkt_t pkt;
+        if (!napt_parse(&p, &pkt)) {
+            HOST_CHECK(false, "round %d: valid frame rejected", r);
+            continue;
+        }
+        size_t hlen = pkt.l4 - pkt.ip;
+        size_t l4_len = (size_t)(pkt.ip[2] << 8 | pkt.ip[3]) - hlen;
+
+        // 出站改源、入站改目的，两个方向交替；偶尔写入相同的值
+        bool src = (r & 2) != 0;
+        uint32_t addr = (r % 11) == 0 ? rd32(pkt.ip + (src ? IP_OFF_SRC : IP_OFF_DST)) : rnd32();
+        uint16_t port = (uint16_t)rand();
+        napt_rewrite(&pkt, src ? IP_OFF_SRC : IP_OFF_DST, src ? L4_OFF_SPORT : L4_OFF_DPORT, addr, port);
+
+        bool alive = napt_dec_ttl(&pkt);
+        if (alive != (ttl > 1) || (alive && pkt.ip[IP_OFF_TTL] != ttl - 1) || (!alive && pkt.ip[IP_OFF_TTL] != ttl)) {
+            ttl_bad++;
+        }
+
+        if (!same_sum(rd16(pkt.ip + IP_OFF_CHKSUM), ip_chksum_full(pkt.ip, hlen))) {
+            ip_bad++;
+        }
+        uint16_t l4_sum = rd16(pkt.l4 + pkt.l4_chksum_off);
+        if (udp_zero) {
+            zero_bad += l4_sum != 0;
+        } else {
+            if (proto == IP_PROTO_UDP && l4_sum == 0) {
+                zero_bad++;
+            }
+            if (!same_sum(l4_sum, l4_chksum_full(pkt.ip, pkt.l4, l4_len, proto, pkt.l4_chksum_off))) {
+                l4_bad++;
+            }
+        }
+    }
+    printf("%d frames: %d IP, %d TCP/UDP checksum mismatches, %d zero-checksum and %d TTL errors\n",
+           ROUNDS, ip_bad, l4_bad, zero_bad, ttl_bad);
+    HOST_CHECK(ip_bad == 0, "%d IP header checksums differ from a full recompute", ip_bad);
+    HOST_CHECK(l4_bad == 0, "%d TCP/UDP checksums differ from a full recompute", l4_bad);
+    HOST_CHECK(zero_bad == 0, "%d UDP zero-checksum errors", zero_bad);
+    HOST_CHECK(ttl_bad == 0, "%d TTL errors", ttl_bad);
+}
+
+int main(void)
+{
+    srand(1);
+    check_parse();
+    check_rewrite();
+    return host_result("test_napt_pkt");
+}
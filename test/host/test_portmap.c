@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include "host_test.h"
+// 直接包含实现以便检查索引表和区间快照
+#include "portmap.c"
+
+// 端口映射规则表：区间冲突检查、端口上下限、区间匹配，以及增删后(proto, mport)索引与规则表一致
+
+uint32_t my_ip;
+
+#define DADDR_A 0x0A04A8C0u             // 192.168.4.10
+#define DADDR_B 0x0B04A8C0u             // 192.168.4.11
+#define RANDOM_OPS 20000
+
+static void reset(void)
+{
+    nvs_stub_reset();
+    ESP_ERROR_CHECK(portmap_init());
+}
+
+// 逐个外部端口与规则表暴力比对
+static void expect_in(uint8_t proto, uint16_t mport, bool hit, uint32_t daddr, uint16_t dport)
+{
+    uint32_t a = 0;
+    uint16_t p = 0;
+    bool found = portmap_range_match_in(proto, mport, &a, &p);
+    HOST_CHECK(found == hit, "match_in(%u, %u) = %d, want %d", proto, mport, found, hit);
+    if (found && hit) {
+        HOST_CHECK(a == daddr && p == dport, "match_in(%u, %u) -> %08x:%u, want %08x:%u",
+                   proto, mport, (unsigned)a, p, (unsigned)daddr, dport);
+    }
+}
+
+static void expect_out(uint8_t proto, uint32_t saddr, uint16_t sport, bool hit, uint16_t mport)
+{
+    uint16_t m = 0;
+    bool found = portmap_range_match_out(proto, saddr, sport, &m);
+    HOST_CHECK(found == hit, "match_out(%u, %08x:%u) = %d, want %d", proto, (unsigned)saddr, sport, found, hit);
+    if (found && hit) {
+        HOST_CHECK(m == mport, "match_out(%u, %08x:%u) -> %u, want %u", proto, (unsigned)saddr, sport, m, mport);
+    }
+}
+
+static void check_overlaps(void)
+{
+    reset();
+    ESP_ERROR_CHECK(portmap_add_range(PROTO_TCP, 1000, 100, DADDR_A, 5000));
+
+    // 外部端口重叠：内含、跨越起点、跨越终点、包含整个区间
+    HOST_CHECK(portmap_add(PROTO_TCP, 1050, DADDR_B, 80) == ESP_ERR_INVALID_STATE, "single port inside range");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 990, 11, DADDR_B, 80) == ESP_ERR_INVALID_STATE, "overlap at start");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 1099, 5, DADDR_B, 80) == ESP_ERR_INVALID_STATE, "overlap at end");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 900, 300, DADDR_B, 80) == ESP_ERR_INVALID_STATE, "covering range");
+    // 紧邻的区间和另一协议不冲突
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 990, 10, DADDR_B, 80) == ESP_OK, "adjacent below rejected");
+    HOST_CHECK(portmap_add(PROTO_TCP, 1100, DADDR_B, 90) == ESP_OK, "adjacent above rejected");
+    HOST_CHECK(portmap_add_range(PROTO_UDP, 1000, 100, DADDR_A, 5000) == ESP_OK, "other protocol rejected");
+
+    // 同一内网地址的内网端口也不能重叠，不同内网地址可以
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 2000, 10, DADDR_A, 5095) == ESP_ERR_INVALID_STATE, "inner ports overlap");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 2000, 10, DADDR_B, 5095) == ESP_OK, "other host rejected");
+    // 单端口规则之间只比外部端口
+    HOST_CHECK(portmap_add(PROTO_TCP, 3000, DADDR_B, 7000) == ESP_OK, "single rules share inner port");
+    HOST_CHECK(portmap_add(PROTO_TCP, 3001, DADDR_B, 7000) == ESP_OK, "single rules share inner port");
+
+    // 同一起始端口原地更新时不与自身冲突
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 1000, 50, DADDR_A, 6000) == ESP_OK, "update in place rejected");
+    expect_in(PROTO_TCP, 1049, true, DADDR_A, 6049);
+    expect_in(PROTO_TCP, 1050, false, 0, 0);
+    expect_out(PROTO_TCP, DADDR_A, 5000, false, 0);
+    expect_out(PROTO_TCP, DADDR_A, 6000, true, 1000);
+}
+
+static void check_limits(void)
+{
+    reset();
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 100, 0, DADDR_A, 100) == ESP_ERR_INVALID_ARG, "count 0 accepted");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 65500, 37, DADDR_A, 100) == ESP_ERR_INVALID_ARG, "mport past 65535");
+    HOST_CHECK(portmap_add_range(PROTO_TCP, 100, 37, DADDR_A, 65500) == ESP_ERR_INVALID_ARG, "dport past 65535");
+
+    // 区间正好到65535，以及从0开始
+    ESP_ERROR_CHECK(portmap_add_range(PROTO_TCP, 65500, 36, DADDR_A, 65500));
+    ESP_ERROR_CHECK(portmap_add_range(PROTO_UDP, 0, 10, DADDR_A, 0));
+    expect_in(PROTO_TCP, 65499, false, 0, 0);
+    expect_in(PROTO_TCP, 65500, true, DADDR_A, 65500);
+    expect_in(PROTO_TCP, 65535, true, DADDR_A, 65535);
+    expect_out(PROTO_TCP, DADDR_A, 65535, true, 65535);
+    expect_in(PROTO_UDP, 0, true, DADDR_A, 0);
+    expect_in(PROTO_UDP, 9, true, DADDR_A, 9);
+    expect_in(PROTO_UDP, 10, false, 0, 0);
+    // 协议不同的键排在一起时不能越过协议边界匹配
+    expect_in(PROTO_UDP, 65535, false, 0, 0);
+    expect_in(PROTO_TCP, 0, false, 0, 0);
+    expect_out(PROTO_UDP, DADDR_A, 65535, false, 0);
+    expect_out(PROTO_UDP, DADDR_B, 0, false, 0);
+
+    // 单端口规则不进入区间快照，删除后区间快照为空
+    ESP_ERROR_CHECK(portmap_add(PROTO_TCP, 8080, DADDR_B, 80));
+    expect_in(PROTO_TCP, 8080, false, 0, 0);
+    ESP_ERROR_CHECK(portmap_del(PROTO_TCP, 65500));
+    ESP_ERROR_CHECK(portmap_del(PROTO_UDP, 0));
+    HOST_CHECK(s_ranges == NULL, "range snapshot kept without range rules");
+
+    // 表满
+    reset();
+    for (int i = 0; i < PORTMAP_MAX; i++) {
+        ESP_ERROR_CHECK(portmap_add_range(PROTO_TCP, (uint16_t)(i * 10), 5, DADDR_A, (uint16_t)(i * 10)));
+    }
+    HOST_CHECK(portmap_add(PROTO_UDP, 1, DADDR_A, 1) == ESP_ERR_NO_MEM, "rule accepted past PORTMAP_MAX");
+    for (int i = 0; i < PORTMAP_MAX; i++) {
+        expect_in(PROTO_TCP, (uint16_t)(i * 10 + 4), true, DADDR_A, (uint16_t)(i * 10 + 4));
+        expect_in(PROTO_TCP, (uint16_t)(i * 10 + 5), false, 0, 0);
+    }
+}
+
+// 索引表与规则表一致：每条有效规则都能找到，索引中没有多余或重复的槽位
+static int index_errors(void)
+{
+    int errors = 0;
+    int used = 0;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        if (s_index[i] == SLOT_EMPTY) {
+            continue;
+        }
+        used++;
+        if (!s_entries[s_index[i]].valid) {
+            errors++;
+        }
+    }
+    int valid = 0;
+    for (int slot = 0; slot < PORTMAP_MAX; slot++) {
+        if (!s_entries[slot].valid) {
+            continue;
+        }
+        valid++;
+        bool found;
+        uint32_t i = index_probe(s_entries[slot].proto, s_entries[slot].mport, &found);
+        if (!found || s_index[i] != slot) {
+            errors++;
+        }
+    }
+    return errors + (used != valid) + (valid + (int)s_free_count != PORTMAP_MAX);
+}
+
+// 同一散列位置附近的键，用来制造长探测链和后移删除
+static uint16_t colliding_port(uint8_t proto, uint32_t bucket, int n)
+{
+    for (uint32_t port = 1; port < 65536; port++) {
+        if (((portmap_hash(proto, (uint16_t)port) - bucket) & HASH_MASK) < 2 && n-- == 0) {
+            return (uint16_t)port;
+        }
+    }
+    return 0;
+}
+
+static void check_index(void)
+{
+    reset();
+    // 一串冲突的键，删掉中间的之后后面的仍能找到
+    uint16_t ports[12];
+    for (int i = 0; i < 12; i++) {
+        ports[i] = colliding_port(PROTO_TCP, 5, i);
+        ESP_ERROR_CHECK(portmap_add(PROTO_TCP, ports[i], DADDR_A, ports[i]));
+    }
+    for (int i = 0; i < 12; i += 3) {
+        ESP_ERROR_CHECK(portmap_del(PROTO_TCP, ports[i]));
+    }
+    for (int i = 0; i < 12; i++) {
+        bool want = i % 3 != 0;
+        HOST_CHECK(portmap_find(PROTO_TCP, ports[i], NULL) == want, "colliding port %u lookup wrong", ports[i]);
+    }
+    HOST_CHECK(index_errors() == 0, "index inconsistent after collision deletes");
+
+    // 随机增删单端口和区间规则，与朴素模型比较
+    reset();
+    typedef struct {
+        bool valid;
+        uint16_t count;
+        uint32_t daddr;
+        uint16_t dport;
+    } model_t;
+    static model_t model[2][256];       // 外部端口取0~255，便于整段比对
+    memset(model, 0, sizeof(model));
+    int bad = 0;
+    int idx_bad = 0;
+    for (int op = 0; op < RANDOM_OPS; op++) {
+        int pi = rand() & 1;
+        uint8_t proto = pi ? PROTO_UDP : PROTO_TCP;
+        uint16_t mport = (uint16_t)(rand() % 256);
+        if (rand() % 3 == 0) {
+            esp_err_t err = portmap_del(proto, mport);
+            if ((err == ESP_OK) != model[pi][mport].valid) {
+                bad++;
+            }
+            model[pi][mport].valid = false;
+        } else {
+            uint16_t count = (rand() & 1) ? 1 : (uint16_t)(1 + rand() % 8);
+            if (mport + count > 256) {
+                count = (uint16_t)(256 - mport);
+            }
+            uint32_t daddr = (rand() & 1) ? DADDR_A : DADDR_B;
+            uint16_t dport = (uint16_t)(1000 + rand() % 256);
+            esp_err_t err = portmap_add_range(proto, mport, count, daddr, dport);
+            if (err == ESP_OK) {
+                model[pi][mport] = (model_t){ true, count, daddr, dport };
+            }
+        }
+        if (index_errors()) {
+            idx_bad++;
+        }
+    }
+
+    // 模型中的规则互不重叠，按模型逐端口检查find和区间匹配
+    int rules = 0;
+    for (int pi = 0; pi < 2; pi++) {
+        uint8_t proto = pi ? PROTO_UDP : PROTO_TCP;
+        int owner = -1;
+        for (int port = 0; port < 256; port++) {
+            const model_t* m = &model[pi][port];
+            if (m->valid) {
+                rules++;
+                portmap_entry_t e;
+                if (!portmap_find(proto, (uint16_t)port, &e) || e.count != m->count || e.daddr != m->daddr ||
+                    e.dport != m->dport) {
+                    bad++;
+                }
+                owner = port;
+            } else if (portmap_find(proto, (uint16_t)port, NULL)) {
+                bad++;
+            }
+            bool in_range = owner >= 0 && port - owner < model[pi][owner].count && model[pi][owner].count > 1;
+            uint32_t a;
+            uint16_t d;
+            bool hit = portmap_range_match_in(proto, (uint16_t)port, &a, &d);
+            if (hit != in_range ||
+                (hit && (a != model[pi][owner].daddr || d != model[pi][owner].dport + (port - owner)))) {
+                bad++;
+            }
+        }
+    }
+    printf("%d random add/del operations, %d rules left: %d mismatches, %d index errors\n",
+           RANDOM_OPS, rules, bad, idx_bad);
+    HOST_CHECK(bad == 0, "%d mismatches against the model", bad);
+    HOST_CHECK(idx_bad == 0, "index inconsistent after %d operations", idx_bad);
+}
+
+// 重启后按槽位从NVS恢复，索引和区间快照与重启前相同
+static void check_reload(void)
+{
+    reset();
+    ESP_ERROR_CHECK(portmap_add_range(PROTO_TCP, 4000, 20, DADDR_A, 4000));
+    ESP_ERROR_CHECK(portmap_add(PROTO_UDP, 53, DADDR_B, 5353));
+    ESP_ERROR_CHECK(portmap_init());
+    expect_in(PROTO_TCP, 4019, true, DADDR_A, 4019);
+    portmap_entry_t e;
+    HOST_CHECK(portmap_find(PROTO_UDP, 53, &e) && e.dport == 5353 && e.count == 1, "single rule lost on reload");
+    HOST_CHECK(index_errors() == 0, "index inconsistent after reload");
+}
+
+// 旧版整表blob迁移：填充字节中的任意内容都按单端口规则处理
+static void check_legacy(void)
+{
+    nvs_stub_reset();
+    portmap_entry_t legacy[PORTMAP_MAX];
+    memset(legacy, 0, sizeof(legacy));
+    legacy[0] = (portmap_entry_t){ .daddr = DADDR_A, .mport = 80, .dport = 8080, .proto = PROTO_TCP, .valid = 1,
+                                   .count = 0xA5A5 };
+    legacy[3] = (portmap_entry_t){ .daddr = DADDR_B, .mport = 53, .dport = 53, .proto = PROTO_UDP, .valid = 1,
+                                   .count = 16 };
+    nvs_set_blob(0, PORTMAP_NVS_LEGACY, legacy, sizeof(legacy));
+    ESP_ERROR_CHECK(portmap_init());
+
+    portmap_entry_t e;
+    HOST_CHECK(portmap_find(PROTO_TCP, 80, &e) && e.count == 1 && e.dport == 8080, "legacy TCP rule not migrated");
+    HOST_CHECK(portmap_find(PROTO_UDP, 53, &e) && e.count == 1, "legacy padding taken as count %u", e.count);
+    expect_in(PROTO_UDP, 54, false, 0, 0);
+    HOST_CHECK(s_ranges == NULL, "legacy rules became range rules");
+    size_t len = 0;
+    HOST_CHECK(nvs_get_blob(0, PORTMAP_NVS_LEGACY, NULL, &len) == ESP_ERR_NVS_NOT_FOUND, "legacy blob kept");
+
+    // 迁移后按新格式重新加载
+    ESP_ERROR_CHECK(portmap_init());
+    HOST_CHECK(portmap_find(PROTO_UDP, 53, &e) && e.count == 1, "migrated rule lost on reload");
+}
+
+int main(void)
+{
+    srand(1);
+    check_overlaps();
+    check_limits();
+    check_index();
+    check_reload();
+    check_legacy();
+    return host_result("test_portmap");
+}
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Minify, gzip and embed the web UI assets under www/ as a C source file.
+
+Usage: www_assets.py <www dir> <output .c>
+
+Each asset is embedded twice, gzip-compressed and minified identity. Both
+representations get their own strong ETag, derived from the content, with a
+"-gz" suffix on the gzip one (RFC 9110 8.8.3: a strong validator names one
+exact representation). The sizes are printed so the savings of a page load can
+be seen at build time.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+    '.png': 'image/png',
+    '.txt': 'text/plain',
+}
+
+TEXT_TYPES = ('.html', '.css', '.js', '.json', '.svg', '.txt')
+
+
+def minify(name, data):
+    """Conservative minification: only indentation, blank lines and comments
+    are removed. Line breaks are kept, both for ASI in scripts and for the
+    whitespace between inline elements."""
+    ext = os.path.splitext(name)[1]
+    if ext not in TEXT_TYPES:
+        return data
+    text = data.decode('utf-8')
+    if ext in ('.html', '.svg'):
+        text = re.sub(r'<!--(?!\[if).*?-->', '', text, flags=re.S)
+    if ext == '.css':
+        text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    lines = (line.strip() for line in text.splitlines())
+    text = '\n'.join(line for line in lines if line)
+    return text.encode('utf-8')
+
+
+def c_bytes(data):
+    out = []
+    for i in range(0, len(data), 16):
+        out.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '\n'.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    www_dir, output = sys.argv[1], sys.argv[2]
+
+    assets = []
+    for name in sorted(os.listdir(www_dir)):
+        ext = os.path.splitext(name)[1]
+        if ext not in CONTENT_TYPES:
+            continue
+        with open(os.path.join(www_dir, name), 'rb') as f:
+            raw = f.read()
+        identity = minify(name, raw)
+        gz = gzip.compress(identity, compresslevel=9, mtime=0)
+        etag = hashlib.sha256(identity).hexdigest()[:16]
+        uri = '/' if name == 'index.html' else '/' + name
+        assets.append((name, uri, CONTENT_TYPES[ext], raw, identity, gz, etag))
+        print('www: %-16s %6d raw -> %6d minified -> %6d gzip (%d%% saved per load)'
+              % (name, len(raw), len(identity), len(gz), 100 - len(gz) * 100 // max(len(raw), 1)))
+
+    lines = ['/* Generated by tools/www_assets.py, do not edit */',
+             '#include "www_assets.h"', '']
+    for i, (name, uri, ctype, raw, identity, gz, etag) in enumerate(assets):
+        lines.append('/* %s */' % name)
+        lines.append('static const uint8_t asset%d_gzip[] = {\n%s\n};' % (i, c_bytes(gz)))
+        lines.append('static const uint8_t asset%d_identity[] = {\n%s\n};' % (i, c_bytes(identity)))
+        lines.append('')
+    lines.append('const www_asset_t www_assets[] = {')
+    for i, (name, uri, ctype, raw, identity, gz, etag) in enumerate(assets):
+        lines.append('    { "%s", "%s", "\\"%s\\"", "\\"%s-gz\\"", asset%d_gzip, %d, asset%d_identity, %d, %d },'
+                     % (uri, ctype, etag, etag, i, len(gz), i, len(identity), len(raw)))
+    lines.append('};')
+    lines.append('const size_t www_assets_count = %d;' % len(assets))
+
+    content = '\n'.join(lines) + '\n'
+    try:
+        with open(output) as f:
+            if f.read() == content:
+                return
+    except OSError:
+        pass
+    with open(output, 'w') as f:
+        f.write(content)
+
+
+if __name__ == '__main__':
+    main()